@@ -5,6 +5,7 @@
 #include <filters.h>
 
 #include <stdexcept>
+#include <algorithm>
 #include <immintrin.h>	// _rdrand32_step
 
 
@@ -52,6 +53,77 @@ std::string AESWrapper::encrypt(const char* plain, unsigned int length)
 }
 
 
+struct AESStreamEncryptor::State
+{
+	CryptoPP::AES::Encryption aesEncryption;
+	CryptoPP::CBC_Mode_ExternalCipher::Encryption cbcEncryption;
+
+	State(const unsigned char* key, unsigned int length, const CryptoPP::byte* iv) : aesEncryption(key, length), cbcEncryption(aesEncryption, iv) {}
+};
+
+AESStreamEncryptor::AESStreamEncryptor(const unsigned char* key, unsigned int length) : _pendingLength(0)
+{
+	if (length != AESWrapper::DEFAULT_KEYLENGTH)
+		throw std::length_error("key length must be 32 bytes");
+
+	CryptoPP::byte iv[CryptoPP::AES::BLOCKSIZE] = { 0 };	// the same fixed iv as AESWrapper::encrypt, so the server decrypts both alike.
+	_state = std::make_unique<State>(key, length, iv);
+}
+
+AESStreamEncryptor::~AESStreamEncryptor()
+{
+}
+
+void AESStreamEncryptor::update(const char* plain, size_t length, std::string& cipher)
+{
+	const CryptoPP::byte* in = reinterpret_cast<const CryptoPP::byte*>(plain);
+
+	// Complete the block left over from the previous piece first.
+	if (_pendingLength) {
+		size_t amount = std::min(length, sizeof(_pending) - _pendingLength);
+		memcpy(_pending + _pendingLength, in, amount);
+		_pendingLength += amount;
+		in += amount;
+		length -= amount;
+		if (_pendingLength < sizeof(_pending))
+			return;
+
+		size_t offset = cipher.size();
+		cipher.resize(offset + sizeof(_pending));
+		_state->cbcEncryption.ProcessData(reinterpret_cast<CryptoPP::byte*>(&cipher[offset]), _pending, sizeof(_pending));
+		_pendingLength = 0;
+	}
+
+	// The CBC chaining carries over between calls, whole blocks are encrypted straight into the ciphertext.
+	size_t blocks = length - length % sizeof(_pending);
+	if (blocks) {
+		size_t offset = cipher.size();
+		cipher.resize(offset + blocks);
+		_state->cbcEncryption.ProcessData(reinterpret_cast<CryptoPP::byte*>(&cipher[offset]), in, blocks);
+	}
+
+	memcpy(_pending, in + blocks, length - blocks);
+	_pendingLength = length - blocks;
+}
+
+void AESStreamEncryptor::final(std::string& cipher)
+{
+	// PKCS #7 - a full block of padding if the plaintext ends on a block boundary.
+	unsigned char padding = static_cast<unsigned char>(sizeof(_pending) - _pendingLength);
+	memset(_pending + _pendingLength, padding, padding);
+
+	size_t offset = cipher.size();
+	cipher.resize(offset + sizeof(_pending));
+	_state->cbcEncryption.ProcessData(reinterpret_cast<CryptoPP::byte*>(&cipher[offset]), _pending, sizeof(_pending));
+	_pendingLength = 0;
+}
+
+uint64_t AESStreamEncryptor::cipherLength(uint64_t plainLength)
+{
+	return (plainLength / CryptoPP::AES::BLOCKSIZE + 1) * CryptoPP::AES::BLOCKSIZE;
+}
+
+
 std::string AESWrapper::decrypt(const char* cipher, unsigned int length)
 {
 	CryptoPP::byte iv[CryptoPP::AES::BLOCKSIZE] = { 0 };	// for practical use iv should never be a fixed value!
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <string>
+#include <memory>
+#include <cstdint>
 
 
 class AESWrapper
@@ -21,4 +23,26 @@ public:
 
 	std::string encrypt(const char* plain, unsigned int length);
 	std::string decrypt(const char* cipher, unsigned int length);
+};
+
+
+// Encrypts like AESWrapper::encrypt (CBC, PKCS #7 padding), a piece of the plaintext at a time - for content too large to hold in memory.
+class AESStreamEncryptor
+{
+	struct State;
+	std::unique_ptr<State> _state;
+	unsigned char _pending[16];
+	size_t _pendingLength;
+	AESStreamEncryptor(const AESStreamEncryptor& aes);
+public:
+	AESStreamEncryptor(const unsigned char* key, unsigned int length);
+	~AESStreamEncryptor();
+
+	// Encrypts the next piece of the plaintext, appending the ciphertext of every block completed so far to cipher.
+	void update(const char* plain, size_t length, std::string& cipher);
+	// Pads and encrypts the last block, appending it to cipher. The encryptor can't be used afterwards.
+	void final(std::string& cipher);
+
+	// The length of the ciphertext of plaintext of the given length.
+	static uint64_t cipherLength(uint64_t plainLength);
 };
\ No newline at end of file
@@ -0,0 +1,59 @@
+#include "ECDHWrapper.h"
+
+#include <hkdf.h>
+#include <sha.h>
+
+#include <stdexcept>
+
+
+static const char HKDF_INFO[] = "FinalProject AES key";
+
+
+X25519Wrapper::X25519Wrapper()
+{
+	_domain.GenerateKeyPair(_rng, _privateKey, _publicKey);
+}
+
+X25519Wrapper::X25519Wrapper(const char* key, unsigned int length)
+{
+	if (length != KEYSIZE)
+		throw std::length_error("x25519 private key length must be 32 bytes");
+	memcpy_s(_privateKey, KEYSIZE, key, length);
+	_domain.GeneratePublicKey(_rng, _privateKey, _publicKey);
+}
+
+X25519Wrapper::X25519Wrapper(const std::string& key) : X25519Wrapper(key.c_str(), static_cast<unsigned int>(key.size()))
+{
+}
+
+X25519Wrapper::~X25519Wrapper()
+{
+}
+
+std::string X25519Wrapper::getPrivateKey() const
+{
+	return std::string(reinterpret_cast<const char*>(_privateKey), KEYSIZE);
+}
+
+std::string X25519Wrapper::getPublicKey() const
+{
+	return std::string(reinterpret_cast<const char*>(_publicKey), KEYSIZE);
+}
+
+std::string X25519Wrapper::deriveAesKey(const std::string& peerPublicKey, const std::string& salt)
+{
+	if (peerPublicKey.size() != KEYSIZE)
+		throw std::length_error("x25519 public key length must be 32 bytes");
+
+	CryptoPP::byte shared[KEYSIZE];
+	if (!_domain.Agree(shared, _privateKey, reinterpret_cast<const CryptoPP::byte*>(peerPublicKey.c_str())))
+		throw std::invalid_argument("invalid x25519 public key");
+
+	CryptoPP::byte derived[AES_KEYSIZE];
+	CryptoPP::HKDF<CryptoPP::SHA256> hkdf;
+	hkdf.DeriveKey(derived, sizeof(derived), shared, sizeof(shared),
+		reinterpret_cast<const CryptoPP::byte*>(salt.c_str()), salt.size(),
+		reinterpret_cast<const CryptoPP::byte*>(HKDF_INFO), sizeof(HKDF_INFO) - 1);
+
+	return std::string(reinterpret_cast<const char*>(derived), sizeof(derived));
+}
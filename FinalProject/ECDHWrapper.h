@@ -0,0 +1,35 @@
+#pragma once
+
+#include <osrng.h>
+#include <xed25519.h>
+
+#include <string>
+
+
+
+class X25519Wrapper
+{
+public:
+	static const unsigned int KEYSIZE = 32;
+	static const unsigned int AES_KEYSIZE = 32;
+
+private:
+	CryptoPP::AutoSeededRandomPool _rng;
+	CryptoPP::x25519 _domain;
+	CryptoPP::byte _privateKey[KEYSIZE];
+	CryptoPP::byte _publicKey[KEYSIZE];
+
+	X25519Wrapper(const X25519Wrapper& x25519);
+	X25519Wrapper& operator=(const X25519Wrapper& x25519);
+public:
+	X25519Wrapper();
+	X25519Wrapper(const char* key, unsigned int length);
+	X25519Wrapper(const std::string& key);
+	~X25519Wrapper();
+
+	std::string getPrivateKey() const;
+	std::string getPublicKey() const;
+
+	// agrees on a shared secret with the peer's public key, and expands it into an AES key using HKDF-SHA256.
+	std::string deriveAesKey(const std::string& peerPublicKey, const std::string& salt);
+};
@@ -0,0 +1,132 @@
+#include "bundle.hpp"
+
+FileBundle::FileBundle(std::string name, std::vector<std::string> file_paths) :
+	name(name),
+	file_paths(file_paths),
+	cksum(0),
+	loaded(false),
+	offset(0)
+{
+
+}
+
+void FileBundle::load() {
+	if (loaded) {
+		return;
+	}
+
+	std::string index, contents;
+	fingerprints.clear();
+
+	for (const std::string& file_path : file_paths) {
+		// The file's identity is taken before reading it, like an EncryptedFile's.
+		FileIdentity identity;
+		if (!stat_file(EXE_DIR_FILE_PATH(file_path), identity)) {
+			throw std::runtime_error("Cannot open input file " + EXE_DIR_FILE_PATH(file_path) + ".");
+		}
+
+		size_t size = static_cast<size_t>(identity.size);
+		size_t start = contents.size();
+		contents.resize(start + size);
+		{
+			TRACE_SPAN("file read");
+			std::ifstream file(EXE_DIR_FILE_PATH(file_path), std::ios::binary);
+			file.read(&contents[start], size);
+			if (!file || static_cast<size_t>(file.gcount()) != size) {
+				throw std::runtime_error("The input file " + EXE_DIR_FILE_PATH(file_path) + " changed while being read.");
+			}
+		}
+		count_metric(BYTES_READ, size);
+
+		FileFingerprint fingerprint = { identity, 0, {}, 0 };
+		{
+			TRACE_SPAN("crc");
+			fingerprint.cksum = static_cast<uint32_t>(memcrc(contents.data() + start, size));
+			for (size_t chunk = 0; chunk < size; chunk += FINGERPRINT_CHUNK_SIZE) {
+				fingerprint.chunks.push_back(static_cast<uint32_t>(memcrc(contents.data() + start + chunk, MIN(size - chunk, static_cast<size_t>(FINGERPRINT_CHUNK_SIZE)))));
+			}
+		}
+
+		uint8_t entry[BundleEntryLayout::size];
+		BundleEntryLayout::put<0>(entry, static_cast<uint32_t>(size));
+		BundleEntryLayout::put<1>(entry, fingerprint.cksum);
+		BundleEntryLayout::put<2>(entry, static_cast<uint16_t>(file_path.size()));
+		index.append(reinterpret_cast<const char*>(entry), sizeof(entry));
+		index.append(file_path);
+
+		fingerprints.push_back(fingerprint);
+	}
+
+	uint8_t header[BundleHeaderLayout::size];
+	BundleHeaderLayout::put<0>(header, BUNDLE_MAGIC);
+	BundleHeaderLayout::put<1>(header, static_cast<uint32_t>(file_paths.size()));
+
+	content.clear();
+	content.reserve(sizeof(header) + index.size() + contents.size());
+	content.append(reinterpret_cast<const char*>(header), sizeof(header));
+	content.append(index);
+	content.append(contents);
+	cksum = memcrc(content.data(), content.size());
+
+	// A new content is encrypted on the next refresh, whatever the key.
+	aes_key.clear();
+	ciphertext = std::string();
+	loaded = true;
+}
+
+bool FileBundle::refresh(const std::string& aes_key) {
+	load();
+	offset = 0;
+
+	if (!ciphertext.empty() && aes_key == this->aes_key) {
+		return false;
+	}
+
+	AESStreamEncryptor encryptor(reinterpret_cast<const unsigned char*>(aes_key.c_str()), static_cast<unsigned int>(aes_key.size()));
+	ciphertext.clear();
+	ciphertext.reserve(static_cast<size_t>(AESStreamEncryptor::cipherLength(content.size())));
+	{
+		TRACE_SPAN("encrypt");
+		encryptor.update(content.data(), content.size(), ciphertext);
+		encryptor.final(ciphertext);
+	}
+	count_metric(BYTES_ENCRYPTED, content.size());
+
+	this->aes_key = aes_key;
+	return true;
+}
+
+ByteView FileBundle::next(size_t size) {
+	size_t amt = MIN(size, ciphertext.size() - offset);
+	ByteView view(reinterpret_cast<const uint8_t*>(ciphertext.data()) + offset, amt);
+	offset += amt;
+	return view;
+}
+
+uint64_t FileBundle::getContentSize() const {
+	return AESStreamEncryptor::cipherLength(content.size());
+}
+
+uint64_t FileBundle::getOrigSize() const {
+	return content.size();
+}
+
+unsigned long FileBundle::getCksum() const {
+	return cksum;
+}
+
+const std::string& FileBundle::getName() const {
+	return name;
+}
+
+const std::vector<std::string>& FileBundle::getFilePaths() const {
+	return file_paths;
+}
+
+const std::vector<FileFingerprint>& FileBundle::getFingerprints() const {
+	return fingerprints;
+}
+
+std::string bundle_name(size_t n) {
+	return "bundle-" + std::to_string(n) + ".fpb";
+}
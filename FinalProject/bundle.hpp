@@ -0,0 +1,60 @@
+#ifndef BUNDLE_H
+#define BUNDLE_H
+
+#include "utils.hpp"
+#include "wire.hpp"
+#include "fingerprint.hpp"
+#include "filecache.hpp"
+
+/*
+	The content of a bundle - many small files sent as a single upload (request 832), so a file costs a few bytes of the
+	bundle's index instead of a Sending File round-trip and a CRC confirmation of its own.
+	The content is the header (magic and amount of files), an index entry per file (its size, its CRC and its name, which
+	follows the entry) and then the files' contents one after the other, in the index's order. All numbers are little endian.
+	The server checks every file's CRC against the index when unpacking the bundle, the CRC confirmed is the whole content's.
+*/
+constexpr char BUNDLE_MAGIC[4] = { 'F', 'P', 'B', '1' };
+using BundleHeaderLayout = Layout<Bytes<sizeof(BUNDLE_MAGIC)>, Number<uint32_t>>;
+using BundleEntryLayout = Layout<Number<uint32_t>, Number<uint32_t>, Number<uint16_t>>;
+
+/*
+	Small files (up to BUNDLE_FILE_LIMIT bytes each) packed into a bundle and encrypted, kept between the attempts of uploading
+	it like an EncryptedFile's content - the files are read once, and the bundle is only encrypted again if the AES key changed.
+	A bundle holds up to BUNDLE_MAX_FILES files and BUNDLE_SIZE_LIMIT bytes of content, so it's always held in memory.
+*/
+class FileBundle : public UploadSource {
+	std::string name;
+	std::vector<std::string> file_paths;
+	std::vector<FileFingerprint> fingerprints;
+	std::string content;
+	std::string aes_key;
+	std::string ciphertext;
+	unsigned long cksum;
+	bool loaded;
+	size_t offset;
+
+	public:
+		// The bundle is uploaded under the given name, the file paths are relative to the executable's directory (like EncryptedFile's).
+		FileBundle(std::string name, std::vector<std::string> file_paths);
+
+		// This method reads the files and packs them into the bundle's content, unless it was already packed.
+		void load();
+		// This method makes sure the content is encrypted with the given key, and moves back to its first packet. Returns true if the content is encrypted again.
+		bool refresh(const std::string& aes_key);
+		// The next packets' encrypted content, valid until the next refresh.
+		ByteView next(size_t size);
+		uint64_t getContentSize() const;
+		uint64_t getOrigSize() const;
+		// The CRC of the whole bundle's content.
+		unsigned long getCksum() const;
+
+		const std::string& getName() const;
+		const std::vector<std::string>& getFilePaths() const;
+		// The identity and CRCs of every file, as it was packed - the fingerprints of an unconfirmed upload.
+		const std::vector<FileFingerprint>& getFingerprints() const;
+};
+
+// This method returns the name bundle number n of a batch is uploaded under.
+std::string bundle_name(size_t n);
+
+#endif
@@ -1,11 +1,59 @@
+#ifndef CKSUM_H
+#define CKSUM_H
+
 #include <iostream>
 #include <fstream>
 #include <ostream>
 #include <cstdio>
+#include <cstdint>
 #include <vector>
 #include <iterator>
 #include <filesystem>
 #include <string>
 
+constexpr uint32_t CRC_POLYNOMIAL = 0x04c11db7;
+constexpr size_t CRC_SLICES = 8;
+
+template <size_t Slices>
+struct CrcTables {
+	uint32_t table[Slices][256];
+};
+
+/*
+	This method generates the tables of a slicing-by-Slices CRC (MSB first, as cksum computes it).
+	Table 0 is the classic byte-at-a-time table, table k advances a byte's CRC through k more zero bytes.
+*/
+template <size_t Slices>
+constexpr CrcTables<Slices> make_crc_tables() {
+	static_assert(Slices > 0, "A CRC needs at least one table.");
+	CrcTables<Slices> tables{};
+	for (uint32_t i = 0; i < 256; i++) {
+		uint32_t crc = i << 24;
+		for (int bit = 0; bit < 8; bit++) {
+			crc = (crc & 0x80000000) ? (crc << 1) ^ CRC_POLYNOMIAL : crc << 1;
+		}
+		tables.table[0][i] = crc;
+	}
+	for (size_t k = 1; k < Slices; k++) {
+		for (size_t i = 0; i < 256; i++) {
+			uint32_t previous = tables.table[k - 1][i];
+			tables.table[k][i] = (previous << 8) ^ tables.table[0][previous >> 24];
+		}
+	}
+	return tables;
+}
+
 unsigned long memcrc(const char* b, size_t n);
-std::string readfile(std::string fname);
\ No newline at end of file
+
+// A CRC computed a piece at a time, for content too large to hold in memory - update(b, n) followed by final() is memcrc(b, n).
+class Crc {
+	uint32_t state;
+	uint64_t length;
+
+	public:
+		Crc();
+		void update(const char* b, size_t n);
+		unsigned long final() const;
+};
+
+#endif
@@ -7,6 +7,8 @@ Client::Client() {
 	this->name = "";
 	this->file_path = "";
 	this->uuid = NIL_UUID;
+	this->credentials = std::make_shared<FileCredentialStore>();
+	this->issues_tickets = true;
 }
 
 void Client::setAddress(std::string address) {
@@ -45,6 +47,22 @@ std::string Client::getFilePath() const {
 	return this->file_path;
 }
 
+void Client::setCredentials(std::shared_ptr<CredentialStore> credentials) {
+	this->credentials = credentials;
+}
+
+void Client::setIssuesTickets(bool issues_tickets) {
+	this->issues_tickets = issues_tickets;
+}
+
 UUID Client::getUuid() const {
 	return this->uuid;
+}
+
+CredentialStore& Client::getCredentials() const {
+	return *this->credentials;
+}
+
+bool Client::getIssuesTickets() const {
+	return this->issues_tickets;
 }
\ No newline at end of file
@@ -1,7 +1,9 @@
 #ifndef CLIENT_H
 #define CLIENT_H
 
+#include <memory>
 #include "utils.hpp"
+#include "credentials.hpp"
 
 class Client {
 	std::string address;
@@ -9,6 +11,9 @@ class Client {
 	std::string name;
 	std::string file_path;
 	UUID uuid;
+	std::shared_ptr<CredentialStore> credentials;
+	// Whether the server issues session tickets, until it responds to a Valid CRC Ticket request with a General Error.
+	bool issues_tickets;
 
 	public:
 		Client();
@@ -17,12 +22,17 @@ class Client {
 		void setName(std::string name);
 		void setFilePath(std::string file_path);
 		void setUuid(UUID uuid);
+		// Where the client's credentials and session ticket are kept, files in the executable's directory unless set.
+		void setCredentials(std::shared_ptr<CredentialStore> credentials);
+		void setIssuesTickets(bool issues_tickets);
 
 		std::string getAddress() const;
 		std::string getPort() const;
 		std::string getName() const;
 		std::string getFilePath() const;
 		UUID getUuid() const;
+		CredentialStore& getCredentials() const;
+		bool getIssuesTickets() const;
 };
 
 #endif
\ No newline at end of file
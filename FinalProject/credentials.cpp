@@ -0,0 +1,212 @@
+#include "credentials.hpp"
+
+bool FileCredentialStore::hasCredentials() const {
+	return std::filesystem::exists(EXE_DIR_FILE_PATH("me.info"));
+}
+
+// This method is used for reading the name, id, and private key from the me.info and priv.key files.
+std::string FileCredentialStore::loadCredentials(std::string& name, UUID& uuid) {
+	std::string path_info = EXE_DIR_FILE_PATH("me.info");
+	std::string path_key = EXE_DIR_FILE_PATH("priv.key");
+	std::string line, client_name, client_id, private_key_me, private_key_priv;
+	int lines = 1;
+	std::ifstream info_file(path_info), key_file(path_key);
+
+	if (!info_file.is_open()) {
+		throw std::runtime_error("Error opening the 'me.info' file, aborting program.");
+	}
+	if (!key_file.is_open()) {
+		throw std::runtime_error("Error opening the 'priv.key' file, aborting program.");
+	}
+
+	// Read from me.info file into parameters.
+	while (std::getline(info_file, line)) {
+		switch (lines) {
+			case 1:
+				client_name = line;
+				break;
+			case 2:
+				client_id = line;
+				break;
+			case 3:
+				private_key_me = line;
+				break;
+			default:
+				private_key_me += line;
+				break;
+		}
+		lines++;
+	}
+
+	if (client_name.length() > MAX_NAME_LENGTH || client_name.length() == 0 || client_id.length() != HEX_ID_LENGTH || private_key_me.length() == 0) {
+		throw std::invalid_argument("Error: me.info file contains invalid data.");
+	}
+
+	// Read from priv.key file into parameters.
+	while (std::getline(key_file, line)) {
+		if (lines == 1) {
+			private_key_priv = line;
+		}
+		else {
+			private_key_priv += line;
+		}
+		lines++;
+	}
+
+	if (private_key_priv.length() == 0 || private_key_priv != private_key_me) {
+		throw std::invalid_argument("Error: priv.key file contains invalid data.");
+	}
+
+	// Get id in form of boost::uuids::uuid, and the client's name.
+	uuid = getUuidFromString(client_id);
+	name = client_name;
+
+	// Close the file and return the private key.
+	info_file.close();
+	return Base64Wrapper::decode(private_key_me);
+}
+
+// This method receives the client's name, id, and private key, writes them to me.info and writes the private key to priv.key as well.
+void FileCredentialStore::saveCredentials(const std::string& name, UUID uuid, const std::string& priv_key) {
+	// Saving id and key into wanted formats, saving paths for both files and opening the streams.
+	std::string id = boost::uuids::to_string(uuid);
+	id.erase(std::remove(id.begin(), id.end(), '-'), id.end()); // Remove '-' from the string.
+
+	// Encode the private key to base64 and open files.
+	std::string base64PrivKey = Base64Wrapper::encode(priv_key);
+	std::string path_info = EXE_DIR_FILE_PATH("me.info");
+	std::string path_key = EXE_DIR_FILE_PATH("priv.key");
+	std::ofstream info_file(path_info), key_file(path_key);
+
+	if (!info_file.is_open()) {
+		throw std::runtime_error("Error opening the 'me.info' file, aborting program.");
+	}
+	if (!key_file.is_open()) {
+		throw std::runtime_error("Error opening the 'priv.key' file, aborting program.");
+	}
+
+	// Writing to both files.
+	info_file << name << std::endl << id << std::endl << base64PrivKey << std::endl;
+	key_file << base64PrivKey << std::endl;
+	// Closing the streams.
+	info_file.close();
+	key_file.close();
+}
+
+// This method saves the session ticket, its expiry time and the resumption AES key into ticket.info.
+void FileCredentialStore::saveTicket(const std::string& ticket, const std::string& resumption_key, uint32_t lifetime) {
+	std::string path_ticket = EXE_DIR_FILE_PATH("ticket.info");
+	std::ofstream ticket_file(path_ticket);
+
+	if (!ticket_file.is_open()) {
+		throw std::runtime_error("Error opening the 'ticket.info' file, aborting program.");
+	}
+
+	// Writing the expiry time (in seconds since the epoch), and the resumption key and the ticket encoded in base64.
+	ticket_file << (std::time(nullptr) + lifetime) << std::endl << Base64Wrapper::encode(resumption_key) << std::endl << Base64Wrapper::encode(ticket) << std::endl;
+	ticket_file.close();
+}
+
+/*
+	This method reads the session ticket and the resumption AES key from ticket.info, and removes the file since a ticket is only used once.
+	Returns false if there is no ticket, or if it has expired.
+*/
+bool FileCredentialStore::takeTicket(std::string& ticket, std::string& resumption_key) {
+	std::string path_ticket = EXE_DIR_FILE_PATH("ticket.info");
+	std::string line, expiry, key_base64, ticket_base64;
+	int lines = 1;
+	std::ifstream ticket_file(path_ticket);
+
+	if (!ticket_file.is_open()) {
+		return false;
+	}
+
+	// Read from ticket.info file into parameters, the ticket may be split over several lines by the base64 encoder.
+	while (std::getline(ticket_file, line)) {
+		switch (lines) {
+			case 1:
+				expiry = line;
+				break;
+			case 2:
+				key_base64 = line;
+				break;
+			default:
+				ticket_base64 += line;
+				break;
+		}
+		lines++;
+	}
+	ticket_file.close();
+	std::filesystem::remove(path_ticket);
+
+	if (!is_integer(expiry) || std::stoll(expiry) <= std::time(nullptr)) {
+		return false;
+	}
+
+	ticket = Base64Wrapper::decode(ticket_base64);
+	resumption_key = Base64Wrapper::decode(key_base64);
+	return ticket.size() == TICKET_LENGTH && resumption_key.size() == AESWrapper::DEFAULT_KEYLENGTH;
+}
+
+MemoryCredentialStore::MemoryCredentialStore() :
+	uuid(NIL_UUID),
+	ticket_expiry(0)
+{
+
+}
+
+MemoryCredentialStore::MemoryCredentialStore(std::string name, UUID uuid, std::string private_key) :
+	name(name),
+	uuid(uuid),
+	private_key(private_key),
+	ticket_expiry(0)
+{
+
+}
+
+bool MemoryCredentialStore::hasCredentials() const {
+	return !private_key.empty();
+}
+
+std::string MemoryCredentialStore::loadCredentials(std::string& name, UUID& uuid) {
+	name = this->name;
+	uuid = this->uuid;
+	return private_key;
+}
+
+void MemoryCredentialStore::saveCredentials(const std::string& name, UUID uuid, const std::string& private_key) {
+	this->name = name;
+	this->uuid = uuid;
+	this->private_key = private_key;
+}
+
+bool MemoryCredentialStore::takeTicket(std::string& ticket, std::string& resumption_key) {
+	if (this->ticket.empty() || ticket_expiry <= std::time(nullptr)) {
+		this->ticket.clear();
+		return false;
+	}
+
+	ticket = this->ticket;
+	resumption_key = this->resumption_key;
+	this->ticket.clear();
+	this->resumption_key.clear();
+	return true;
+}
+
+void MemoryCredentialStore::saveTicket(const std::string& ticket, const std::string& resumption_key, uint32_t lifetime) {
+	this->ticket = ticket;
+	this->resumption_key = resumption_key;
+	ticket_expiry = std::time(nullptr) + lifetime;
+}
+
+std::string MemoryCredentialStore::getName() const {
+	return name;
+}
+
+UUID MemoryCredentialStore::getUuid() const {
+	return uuid;
+}
+
+std::string MemoryCredentialStore::getPrivateKey() const {
+	return private_key;
+}
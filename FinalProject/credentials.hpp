@@ -0,0 +1,62 @@
+#ifndef CREDENTIALS_H
+#define CREDENTIALS_H
+
+#include "utils.hpp"
+
+/*
+	Where a client's credentials (its name, id and private key) and its session ticket are kept between sessions.
+	The client program keeps them in files next to the executable, an application embedding the client may keep them anywhere.
+*/
+class CredentialStore {
+	public:
+		virtual ~CredentialStore() {}
+
+		// This method returns true if the client registered before, and has the credentials to reconnect with.
+		virtual bool hasCredentials() const = 0;
+		// This method reads the client's name and id, returns its private key (not encoded).
+		virtual std::string loadCredentials(std::string& name, UUID& uuid) = 0;
+		// This method saves the client's name, id and private key (not encoded).
+		virtual void saveCredentials(const std::string& name, UUID uuid, const std::string& private_key) = 0;
+		// This method takes the saved session ticket and its resumption AES key - a ticket is only used once. Returns false if there is no unexpired ticket.
+		virtual bool takeTicket(std::string& ticket, std::string& resumption_key) = 0;
+		// This method saves the session ticket and its resumption AES key, for the given number of seconds.
+		virtual void saveTicket(const std::string& ticket, const std::string& resumption_key, uint32_t lifetime) = 0;
+};
+
+// The client program's credentials - me.info and priv.key, and the session ticket in ticket.info, in the executable's directory.
+class FileCredentialStore : public CredentialStore {
+	public:
+		bool hasCredentials() const;
+		std::string loadCredentials(std::string& name, UUID& uuid);
+		void saveCredentials(const std::string& name, UUID uuid, const std::string& private_key);
+		bool takeTicket(std::string& ticket, std::string& resumption_key);
+		void saveTicket(const std::string& ticket, const std::string& resumption_key, uint32_t lifetime);
+};
+
+// Credentials kept in memory - given by the application (if it saved them before), and read back by it to save them.
+class MemoryCredentialStore : public CredentialStore {
+	std::string name;
+	UUID uuid;
+	std::string private_key;
+	std::string ticket;
+	std::string resumption_key;
+	std::time_t ticket_expiry;
+
+	public:
+		// A client that did not register yet.
+		MemoryCredentialStore();
+		// A registered client, the private key is not encoded.
+		MemoryCredentialStore(std::string name, UUID uuid, std::string private_key);
+
+		bool hasCredentials() const;
+		std::string loadCredentials(std::string& name, UUID& uuid);
+		void saveCredentials(const std::string& name, UUID uuid, const std::string& private_key);
+		bool takeTicket(std::string& ticket, std::string& resumption_key);
+		void saveTicket(const std::string& ticket, const std::string& resumption_key, uint32_t lifetime);
+
+		std::string getName() const;
+		UUID getUuid() const;
+		std::string getPrivateKey() const;
+};
+
+#endif
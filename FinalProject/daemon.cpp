@@ -0,0 +1,124 @@
+#include "daemon.hpp"
+
+Daemon::Daemon(Client& client, KeyPool& key_pool, std::string spool_dir, std::string trace_file, std::string metrics_file) :
+	client(client),
+	key_pool(key_pool),
+	spool_dir(spool_dir),
+	trace_file(trace_file),
+	metrics_file(metrics_file),
+	sock(io_context),
+	connected(false)
+{
+
+}
+
+int Daemon::connect() {
+	try {
+		TRACE_SPAN("connect");
+		// Resolve the server's address only once, reconnecting reuses the resolved endpoints.
+		if (endpoints.empty()) {
+			tcp::resolver resolver(io_context);
+			endpoints = resolver.resolve(client.getAddress(), client.getPort());
+		}
+
+		connect_tuned(sock, endpoints);
+		// Keep the idle connection alive between jobs.
+		sock.set_option(boost::asio::socket_base::keep_alive(true));
+	}
+	catch (std::exception& e) {
+		LOG_ERROR(e.what());
+		disconnect();
+		return FAILURE;
+	}
+
+	if (start_session(sock, client, key_pool, decrypted_aes_key, ticket) == FAILURE) {
+		disconnect();
+		return FAILURE;
+	}
+
+	connected = true;
+	return SUCCESS;
+}
+
+void Daemon::disconnect() {
+	boost::system::error_code ec;
+	sock.close(ec);
+	connected = false;
+}
+
+void Daemon::finish_job(std::string job, std::string sub_dir) const {
+	std::filesystem::path job_path = EXE_DIR_FILE_PATH(job);
+	std::filesystem::path finished_path = std::filesystem::path(EXE_DIR_FILE_PATH(spool_dir)) / sub_dir / job_path.filename();
+
+	// The job may have been removed meanwhile, that doesn't stop the daemon.
+	std::error_code ec;
+	std::filesystem::rename(job_path, finished_path, ec);
+	if (ec) {
+		LOG_ERROR("Cannot move " << job << " into " << sub_dir << ": " << ec.message());
+	}
+}
+
+void Daemon::export_telemetry() const {
+	if (!trace_file.empty() && !write_chrome_trace(trace_file)) {
+		LOG_ERROR("Error: cannot write the trace into " << trace_file << ".");
+	}
+	if (!metrics_file.empty() && !write_metrics_file(metrics_file)) {
+		LOG_ERROR("Error: cannot write the metrics into " << metrics_file << ".");
+	}
+}
+
+int Daemon::upload(std::string job) {
+	int op_success = FAILURE;
+
+	// Try the warm connection first, and if it was lost, reconnect and try once more.
+	for (int attempt = 0; attempt < 2 && op_success == FAILURE; attempt++) {
+		if (!connected && connect() == FAILURE) {
+			continue;
+		}
+
+		op_success = upload_file(sock, client, key_pool, decrypted_aes_key, ticket, job);
+		if (op_success == FAILURE) {
+			disconnect();
+		}
+	}
+
+	return op_success;
+}
+
+void Daemon::run() {
+	std::filesystem::path spool_path = EXE_DIR_FILE_PATH(spool_dir);
+	std::filesystem::create_directories(spool_path / "done");
+	std::filesystem::create_directories(spool_path / "failed");
+
+	// Warm the connection up before the first job arrives.
+	connect();
+	export_telemetry();
+
+	UploadQueue queue(UPLOAD_QUEUE_SIZE);
+	SpoolWatcher watcher(spool_dir, queue);
+
+	std::string job;
+	while (queue.pop(job)) {
+		// A job may be reported more than once, skip it if it was already uploaded.
+		if (!std::filesystem::exists(EXE_DIR_FILE_PATH(job))) {
+			watcher.finished(job);
+			continue;
+		}
+
+		// A job that can't be read (it vanished, or changed while being read) fails on its own, the daemon goes on with the next one.
+		int op_success = FAILURE;
+		try {
+			op_success = upload(job);
+		}
+		catch (std::exception& e) {
+			LOG_ERROR(job << ": " << e.what());
+			// The connection may have been left in the middle of an exchange.
+			disconnect();
+		}
+		finish_job(job, (op_success == FAILURE) ? "failed" : "done");
+		watcher.finished(job);
+
+		// The daemon only ends when stopped, keep the trace and metrics files up to date after every job.
+		export_telemetry();
+	}
+}
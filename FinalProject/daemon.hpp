@@ -0,0 +1,46 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include "session.hpp"
+#include "watcher.hpp"
+
+/*
+	The client's daemon mode - a long-running process holding a warm, authenticated connection to the server.
+	Upload jobs are files put into the spool directory, picked up by a SpoolWatcher as soon as they are complete.
+	Jobs are uploaded one at a time, over the single connection - the server keeps a client's session state per client id,
+	so concurrent uploads under the same identity would overwrite each other's keys and files.
+	Uploaded jobs are moved into the spool's 'done' directory, and jobs that could not be uploaded into its 'failed' directory.
+*/
+class Daemon {
+	Client& client;
+	KeyPool& key_pool;
+	std::string spool_dir;
+	std::string trace_file;
+	std::string metrics_file;
+	boost::asio::io_context io_context;
+	tcp::socket sock;
+	tcp::resolver::results_type endpoints;
+	bool connected;
+	std::string decrypted_aes_key;
+	std::string ticket;
+
+	// This method connects to the server (resolving its address only once) and starts a session.
+	int connect();
+	// This method closes the connection, the next upload reconnects.
+	void disconnect();
+	// This method moves a finished job from the spool directory into the given sub directory of it, a job that can't be moved is left where it is.
+	void finish_job(std::string job, std::string sub_dir) const;
+	// This method writes the trace and metrics files, if they were requested.
+	void export_telemetry() const;
+
+	public:
+		// If a trace file is given (tracing must be enabled), the recorded spans are written into it after every job, and so are the metrics into the metrics file.
+		Daemon(Client& client, KeyPool& key_pool, std::string spool_dir, std::string trace_file = "", std::string metrics_file = "");
+
+		// This method uploads a single job (a path relative to the executable's directory), reconnecting once if the connection was lost.
+		int upload(std::string job);
+		// This method runs the daemon - uploads the spool directory's jobs as they appear, until the process is stopped.
+		void run();
+};
+
+#endif
@@ -0,0 +1,184 @@
+#include "executor.hpp"
+#include <iomanip>
+#include <sstream>
+
+namespace {
+	// The pool the calling thread works for and its index in it, null on threads outside of any pool.
+	thread_local const void* current_pool = nullptr;
+	thread_local size_t current_worker = 0;
+}
+
+WorkStealingPool::WorkStealingPool(size_t size) :
+	started(std::chrono::steady_clock::now()),
+	queued(0),
+	pending(0),
+	next_worker(0),
+	stopping(false),
+	error(nullptr)
+{
+	if (size == 0) {
+		size = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	for (size_t i = 0; i < size; i++) {
+		workers.push_back(std::make_unique<Worker>());
+		workers.back()->tasks_run = 0;
+		workers.back()->tasks_stolen = 0;
+		workers.back()->busy_us = 0;
+	}
+	// Only start the threads once every worker exists, a thread may steal from any of them.
+	for (size_t i = 0; i < size; i++) {
+		workers[i]->thread = std::thread(&WorkStealingPool::work, this, i);
+	}
+}
+
+WorkStealingPool::~WorkStealingPool() {
+	{
+		std::lock_guard<std::mutex> lock(state_lock);
+		stopping = true;
+	}
+	work_available.notify_all();
+
+	for (std::unique_ptr<Worker>& worker : workers) {
+		if (worker->thread.joinable()) {
+			worker->thread.join();
+		}
+	}
+}
+
+size_t WorkStealingPool::getSize() const {
+	return workers.size();
+}
+
+void WorkStealingPool::submit(std::function<void()> task) {
+	size_t index;
+	{
+		std::lock_guard<std::mutex> lock(state_lock);
+		index = (current_pool == this) ? current_worker : next_worker++ % workers.size();
+		pending++;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(workers[index]->tasks_lock);
+		workers[index]->tasks.push_back(std::move(task));
+	}
+
+	// Counted once the task is in the deque, a worker that finds the count above 0 will find the task.
+	{
+		std::lock_guard<std::mutex> lock(state_lock);
+		queued++;
+	}
+	work_available.notify_one();
+}
+
+bool WorkStealingPool::take(size_t index, std::function<void()>& task, bool& stolen) {
+	{
+		Worker& own = *workers[index];
+		std::lock_guard<std::mutex> lock(own.tasks_lock);
+		if (!own.tasks.empty()) {
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			stolen = false;
+			return true;
+		}
+	}
+
+	// Steal from the next workers first, so the thieves don't all go for the same victim.
+	for (size_t i = 1; i < workers.size(); i++) {
+		Worker& victim = *workers[(index + i) % workers.size()];
+		std::lock_guard<std::mutex> lock(victim.tasks_lock);
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			stolen = true;
+			return true;
+		}
+	}
+	return false;
+}
+
+void WorkStealingPool::work(size_t index) {
+	current_pool = this;
+	current_worker = index;
+	Worker& worker = *workers[index];
+
+	while (true) {
+		std::function<void()> task;
+		bool stolen;
+
+		if (!take(index, task, stolen)) {
+			std::unique_lock<std::mutex> lock(state_lock);
+			work_available.wait(lock, [this] { return queued > 0 || stopping; });
+			if (queued == 0) {
+				return;
+			}
+			continue;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(state_lock);
+			queued--;
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		std::exception_ptr task_error = nullptr;
+		try {
+			task();
+		}
+		catch (...) {
+			task_error = std::current_exception();
+		}
+		worker.busy_us += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+		worker.tasks_run++;
+		if (stolen) {
+			worker.tasks_stolen++;
+		}
+
+		std::lock_guard<std::mutex> lock(state_lock);
+		if (task_error && !error) {
+			error = task_error;
+		}
+		if (--pending == 0) {
+			all_done.notify_all();
+		}
+	}
+}
+
+void WorkStealingPool::wait() {
+	std::unique_lock<std::mutex> lock(state_lock);
+	all_done.wait(lock, [this] { return pending == 0; });
+
+	if (error) {
+		std::exception_ptr task_error = error;
+		error = nullptr;
+		std::rethrow_exception(task_error);
+	}
+}
+
+std::vector<WorkerStats> WorkStealingPool::getStats() const {
+	double lifetime = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+	std::vector<WorkerStats> stats;
+
+	for (const std::unique_ptr<Worker>& worker : workers) {
+		double busy = worker->busy_us / 1e6;
+		stats.push_back({ worker->tasks_run, worker->tasks_stolen, busy, (lifetime > 0) ? busy / lifetime : 0 });
+	}
+	return stats;
+}
+
+void WorkStealingPool::logStats() const {
+	std::vector<WorkerStats> stats = getStats();
+	double total_utilization = 0;
+
+	for (size_t i = 0; i < stats.size(); i++) {
+		std::ostringstream line;
+		line << std::fixed << std::setprecision(3) << "Worker " << i + 1 << ": " << stats[i].tasks << " tasks (" << stats[i].stolen
+			<< " stolen), busy " << stats[i].busy_seconds << " s, " << std::setprecision(1) << stats[i].utilization * 100 << "% utilized.";
+		LOG_INFO(line.str());
+		total_utilization += stats[i].utilization;
+	}
+
+	std::ostringstream line;
+	line << std::fixed << std::setprecision(1) << "Pool utilization " << total_utilization / stats.size() * 100 << "% over " << stats.size() << " workers.";
+	LOG_INFO(line.str());
+}
@@ -0,0 +1,80 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <exception>
+#include "utils.hpp"
+
+// What a worker of the pool did since the pool started.
+struct WorkerStats {
+	uint64_t tasks;
+	// Tasks taken from another worker's deque.
+	uint64_t stolen;
+	double busy_seconds;
+	// The part of the pool's lifetime the worker spent running tasks.
+	double utilization;
+};
+
+/*
+	A fixed set of worker threads, each with its own deque of tasks.
+	A worker runs its own tasks newest first (a task submitted by a task is likely still in its cache), and when it has none,
+	steals the oldest task of another worker. Tasks submitted from outside the pool are dealt to the workers in turn, so a few
+	large tasks stuck behind each other are taken apart by the idle workers, while many small ones keep every worker busy.
+	Each deque has its own lock, only held to push or take a task - a task here is a whole file's worth of work, so the
+	locking is negligible next to it.
+*/
+class WorkStealingPool {
+	struct Worker {
+		std::mutex tasks_lock;
+		std::deque<std::function<void()>> tasks;
+		std::thread thread;
+		// Written by the worker itself, read by getStats().
+		std::atomic<uint64_t> tasks_run;
+		std::atomic<uint64_t> tasks_stolen;
+		std::atomic<uint64_t> busy_us;
+	};
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::chrono::steady_clock::time_point started;
+	// Guards the counts below, the workers wait on it when there is nothing to run or steal.
+	std::mutex state_lock;
+	std::condition_variable work_available;
+	std::condition_variable all_done;
+	// Tasks in the deques, and tasks submitted but not finished yet.
+	size_t queued;
+	size_t pending;
+	size_t next_worker;
+	bool stopping;
+	std::exception_ptr error;
+
+	// This method runs on the given worker's thread.
+	void work(size_t index);
+	// This method takes the given worker's newest task, or else steals another worker's oldest one. Returns false if every deque is empty.
+	bool take(size_t index, std::function<void()>& task, bool& stolen);
+
+	public:
+		// A pool of 0 workers has one per hardware thread.
+		WorkStealingPool(size_t size = 0);
+		~WorkStealingPool();
+		WorkStealingPool(const WorkStealingPool&) = delete;
+		WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+		size_t getSize() const;
+
+		// This method adds a task - to the calling worker's own deque when called from a task, and to the next worker's otherwise.
+		void submit(std::function<void()> task);
+		// This method waits until every submitted task finished, and rethrows the first exception a task threw, if any.
+		void wait();
+		std::vector<WorkerStats> getStats() const;
+		// This method logs every worker's stats, and the pool's overall utilization.
+		void logStats() const;
+};
+
+#endif
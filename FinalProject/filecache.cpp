@@ -0,0 +1,322 @@
+#include "filecache.hpp"
+#include "stages.hpp"
+#include <random>
+
+FileEncryptor::FileEncryptor(const std::string& file_path, uint64_t size, const std::string& aes_key) :
+	file_path(file_path),
+	file(file_path, std::ios::binary),
+	remaining(size),
+	encryptor(reinterpret_cast<const unsigned char*>(aes_key.c_str()), static_cast<unsigned int>(aes_key.size())),
+	buffer(static_cast<size_t>(MIN(size, static_cast<uint64_t>(FINGERPRINT_CHUNK_SIZE)))),
+	finished(false)
+{
+	if (!file) {
+		throw std::runtime_error("Cannot open input file " + file_path + ".");
+	}
+}
+
+bool FileEncryptor::next(std::string& cipher) {
+	if (finished) {
+		return false;
+	}
+
+	if (remaining) {
+		size_t amt = static_cast<size_t>(MIN(remaining, static_cast<uint64_t>(buffer.size())));
+		{
+			TRACE_SPAN("file read");
+			file.read(buffer.data(), amt);
+			if (static_cast<size_t>(file.gcount()) != amt) {
+				throw std::runtime_error("The input file " + file_path + " changed while being read.");
+			}
+		}
+		count_metric(BYTES_READ, amt);
+		{
+			TRACE_SPAN("crc");
+			crc.update(buffer.data(), amt);
+			chunks.push_back(static_cast<uint32_t>(memcrc(buffer.data(), amt)));
+		}
+		{
+			TRACE_SPAN("encrypt");
+			encryptor.update(buffer.data(), amt, cipher);
+		}
+		count_metric(BYTES_ENCRYPTED, amt);
+		remaining -= amt;
+	}
+
+	// The last block is padded once the whole file was read, an empty file is a single block of padding.
+	if (!remaining) {
+		encryptor.final(cipher);
+		finished = true;
+	}
+	return true;
+}
+
+bool FileEncryptor::isFinished() const {
+	return finished;
+}
+
+unsigned long FileEncryptor::getCksum() const {
+	return crc.final();
+}
+
+const std::vector<uint32_t>& FileEncryptor::getChunks() const {
+	return chunks;
+}
+
+std::unique_ptr<ChunkEncryptor> open_file_encryptor(const std::string& file_path, uint64_t size, const std::string& aes_key) {
+	// Small files aren't worth starting threads for.
+	if (size > ENCRYPTED_CACHE_MEMORY_LIMIT) {
+		return std::make_unique<StagedFileEncryptor>(file_path, size, aes_key);
+	}
+	return std::make_unique<FileEncryptor>(file_path, size, aes_key);
+}
+
+EncryptedFile::EncryptedFile(std::string file_name) :
+	file_name(file_name),
+	identity(),
+	orig_size(0),
+	content_size(0),
+	cksum(0),
+	cached(false),
+	offset(0),
+	streaming(false),
+	stream_offset(0)
+{
+
+}
+
+EncryptedFile::~EncryptedFile() {
+	drop_spill();
+}
+
+bool EncryptedFile::refresh(const std::string& aes_key) {
+	// The file's identity is taken before reading it - if it changes while being read, the next refresh reads it again.
+	FileIdentity current;
+	if (!stat_file(EXE_DIR_FILE_PATH(file_name), current)) {
+		throw std::runtime_error("Cannot open input file " + EXE_DIR_FILE_PATH(file_name) + ".");
+	}
+
+	if (cached && current == identity && aes_key == this->aes_key) {
+		rewind();
+		return streaming;
+	}
+
+	load(aes_key, current);
+	rewind();
+	return true;
+}
+
+void EncryptedFile::load(const std::string& aes_key, const FileIdentity& identity) {
+	cached = false;
+	drop_spill();
+	ciphertext = std::string();
+	stream.reset();
+
+	orig_size = identity.size;
+	content_size = AESStreamEncryptor::cipherLength(orig_size);
+	streaming = content_size > ENCRYPTED_CACHE_SPILL_LIMIT;
+
+	// Content too large to keep is read as its packets are taken, its CRCs are known once it was all read.
+	if (!streaming) {
+		std::unique_ptr<ChunkEncryptor> encryptor = open_file_encryptor(EXE_DIR_FILE_PATH(file_name), orig_size, aes_key);
+
+		// Large content is written into a temporary file and mapped back, instead of staying on the heap between attempts.
+		if (content_size > ENCRYPTED_CACHE_MEMORY_LIMIT) {
+			spill_path = std::filesystem::temp_directory_path() / ("FinalProject-" + std::to_string(std::random_device{}()) + ".enc");
+			std::ofstream spill(spill_path, std::ios::binary | std::ios::trunc);
+			while (encryptor->next(ciphertext)) {
+				TRACE_SPAN("spill");
+				spill.write(ciphertext.data(), ciphertext.size());
+				ciphertext.clear();
+			}
+			ciphertext = std::string();
+			spill.close();
+			if (!spill) {
+				drop_spill();
+				throw std::runtime_error("Cannot write the spill file " + spill_path.string() + ".");
+			}
+			boost::interprocess::file_mapping mapping(spill_path.string().c_str(), boost::interprocess::read_only);
+			spill_region = boost::interprocess::mapped_region(mapping, boost::interprocess::read_only);
+		}
+		else {
+			ciphertext.reserve(static_cast<size_t>(content_size));
+			while (encryptor->next(ciphertext)) {}
+		}
+
+		cksum = encryptor->getCksum();
+		chunks = encryptor->getChunks();
+	}
+
+	this->aes_key = aes_key;
+	this->identity = identity;
+	cached = true;
+}
+
+void EncryptedFile::rewind() {
+	offset = 0;
+
+	if (streaming) {
+		stream = open_file_encryptor(EXE_DIR_FILE_PATH(file_name), orig_size, aes_key);
+		stream_buffer.clear();
+		stream_offset = 0;
+	}
+}
+
+void EncryptedFile::drop_spill() {
+	if (spill_path.empty()) {
+		return;
+	}
+
+	spill_region = boost::interprocess::mapped_region();
+	std::error_code ec;
+	std::filesystem::remove(spill_path, ec);
+	spill_path.clear();
+}
+
+ByteView EncryptedFile::next(size_t size) {
+	if (!streaming) {
+		ByteView content = spill_path.empty() ? ByteView(ciphertext) : ByteView(static_cast<const uint8_t*>(spill_region.get_address()), spill_region.get_size());
+		size_t amt = MIN(size, content.size() - offset);
+		ByteView view(content.data() + offset, amt);
+		offset += amt;
+		return view;
+	}
+
+	// Read ahead a chunk at a time, dropping the ciphertext of the packets already taken.
+	if (stream_buffer.size() - stream_offset < size) {
+		stream_buffer.erase(0, stream_offset);
+		stream_offset = 0;
+		while (stream_buffer.size() < size && stream->next(stream_buffer)) {}
+
+		if (stream->isFinished()) {
+			cksum = stream->getCksum();
+			chunks = stream->getChunks();
+		}
+	}
+
+	size_t amt = MIN(size, stream_buffer.size() - stream_offset);
+	ByteView view(reinterpret_cast<const uint8_t*>(stream_buffer.data()) + stream_offset, amt);
+	stream_offset += amt;
+	return view;
+}
+
+uint64_t EncryptedFile::getContentSize() const {
+	return content_size;
+}
+
+uint64_t EncryptedFile::getOrigSize() const {
+	return orig_size;
+}
+
+unsigned long EncryptedFile::getCksum() const {
+	return cksum;
+}
+
+FileFingerprint EncryptedFile::getFingerprint() const {
+	return { identity, static_cast<uint32_t>(cksum), chunks, 0 };
+}
+
+StreamReader stream_reader(std::istream& in) {
+	return [&in](char* buffer, size_t size) {
+		in.read(buffer, size);
+		if (in.bad()) {
+			throw std::runtime_error("Cannot read the input stream.");
+		}
+		return static_cast<size_t>(in.gcount());
+	};
+}
+
+EncryptedStream::EncryptedStream(StreamReader read, const std::string& aes_key) :
+	read(read),
+	encryptor(reinterpret_cast<const unsigned char*>(aes_key.c_str()), static_cast<unsigned int>(aes_key.size())),
+	orig_size(0),
+	buffer(FINGERPRINT_CHUNK_SIZE),
+	offset(0),
+	finished(false)
+{
+
+}
+
+ByteView EncryptedStream::next(size_t size) {
+	// Read ahead a chunk at a time, dropping the ciphertext of the packets already taken.
+	if (ciphertext.size() - offset < size && !finished) {
+		ciphertext.erase(0, offset);
+		offset = 0;
+
+		while (ciphertext.size() < size && !finished) {
+			// Fill the buffer, a reader may return less than it was asked for before the content ends.
+			size_t amt = 0, last_read = 1;
+			{
+				TRACE_SPAN("stream read");
+				while (amt < buffer.size() && last_read) {
+					last_read = read(buffer.data() + amt, buffer.size() - amt);
+					amt += last_read;
+				}
+			}
+			count_metric(BYTES_READ, amt);
+			{
+				TRACE_SPAN("crc");
+				crc.update(buffer.data(), amt);
+			}
+			{
+				TRACE_SPAN("encrypt");
+				encryptor.update(buffer.data(), amt, ciphertext);
+			}
+			count_metric(BYTES_ENCRYPTED, amt);
+			orig_size += amt;
+
+			// The stream ended, its last block is padded.
+			if (!last_read) {
+				encryptor.final(ciphertext);
+				finished = true;
+			}
+		}
+	}
+
+	size_t amt = MIN(size, ciphertext.size() - offset);
+	ByteView view(reinterpret_cast<const uint8_t*>(ciphertext.data()) + offset, amt);
+	offset += amt;
+	return view;
+}
+
+uint64_t EncryptedStream::getOrigSize() const {
+	return orig_size;
+}
+
+unsigned long EncryptedStream::getCksum() const {
+	return crc.final();
+}
+
+EncryptedBuffer::EncryptedBuffer(ByteView content) :
+	content(content),
+	read_offset(0)
+{
+
+}
+
+bool EncryptedBuffer::refresh(const std::string& aes_key) {
+	read_offset = 0;
+	stream.reset(new EncryptedStream([this](char* buffer, size_t size) {
+		size_t amt = MIN(size, content.size() - read_offset);
+		memcpy(buffer, content.data() + read_offset, amt);
+		read_offset += amt;
+		return amt;
+	}, aes_key));
+	return true;
+}
+
+ByteView EncryptedBuffer::next(size_t size) {
+	return stream->next(size);
+}
+
+uint64_t EncryptedBuffer::getContentSize() const {
+	return AESStreamEncryptor::cipherLength(content.size());
+}
+
+uint64_t EncryptedBuffer::getOrigSize() const {
+	return content.size();
+}
+
+unsigned long EncryptedBuffer::getCksum() const {
+	return stream ? stream->getCksum() : 0;
+}
@@ -0,0 +1,170 @@
+#ifndef FILECACHE_H
+#define FILECACHE_H
+
+#include <memory>
+#include <functional>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include "utils.hpp"
+#include "wire.hpp"
+#include "fingerprint.hpp"
+#include "request.hpp"
+
+/*
+	Encrypted content that can be sent again - after a CRC mismatch, or encrypted with a new AES key after a full handshake.
+	The CRC of the original content may only be complete once all of the content's packets were taken.
+*/
+class UploadSource : public PacketSource {
+	public:
+		// This method makes sure the content is encrypted with the given key, and moves back to its first packet. Returns true if the content is read again.
+		virtual bool refresh(const std::string& aes_key) = 0;
+		virtual uint64_t getContentSize() const = 0;
+		virtual uint64_t getOrigSize() const = 0;
+		// The CRC of the original content.
+		virtual unsigned long getCksum() const = 0;
+};
+
+// Reads up to size bytes of content into the buffer, returns how many - 0 only once the content ended.
+using StreamReader = std::function<size_t(char* buffer, size_t size)>;
+// This method returns a reader of the given stream, which must outlive it.
+StreamReader stream_reader(std::istream& in);
+
+// Reads a file a chunk at a time, encrypting it and computing the CRCs of its original content on the way.
+class ChunkEncryptor {
+	public:
+		virtual ~ChunkEncryptor() {}
+
+		// This method appends the ciphertext of the next chunk of the file to cipher, returns false once the whole file (and its padding) was appended.
+		virtual bool next(std::string& cipher) = 0;
+		virtual bool isFinished() const = 0;
+		// The CRC of the original content, and of each of its chunks - complete once the whole file was read.
+		virtual unsigned long getCksum() const = 0;
+		virtual const std::vector<uint32_t>& getChunks() const = 0;
+};
+
+/*
+	Reads a file FINGERPRINT_CHUNK_SIZE bytes at a time, encrypting it and computing the CRCs of its original content on the
+	way - no more than a chunk of the file is held in memory at once, whatever its size.
+*/
+class FileEncryptor : public ChunkEncryptor {
+	std::string file_path;
+	std::ifstream file;
+	uint64_t remaining;
+	AESStreamEncryptor encryptor;
+	Crc crc;
+	std::vector<uint32_t> chunks;
+	std::vector<char> buffer;
+	bool finished;
+
+	public:
+		// Only the first size bytes of the file are read, the file must still have that many when they are.
+		FileEncryptor(const std::string& file_path, uint64_t size, const std::string& aes_key);
+
+		bool next(std::string& cipher);
+		bool isFinished() const;
+		unsigned long getCksum() const;
+		const std::vector<uint32_t>& getChunks() const;
+};
+
+// This method returns an encryptor of the file's first size bytes - files over ENCRYPTED_CACHE_MEMORY_LIMIT bytes are read, CRC'd and encrypted on stage threads (see stages.hpp), ahead of the caller.
+std::unique_ptr<ChunkEncryptor> open_file_encryptor(const std::string& file_path, uint64_t size, const std::string& aes_key);
+
+/*
+	A file's encrypted content, kept between the attempts of uploading it - a CRC mismatch resends the same ciphertext
+	instead of reading and encrypting the whole file again. The file is only read again if it changed since (its identity -
+	inode, size and modification time - differs), or if the session's AES key changed (after a full handshake).
+	Content up to ENCRYPTED_CACHE_MEMORY_LIMIT bytes is kept in memory, larger content is spilled into a temporary file and
+	mapped back, so the system can page it out between attempts. Content over ENCRYPTED_CACHE_SPILL_LIMIT bytes is not kept at
+	all - it's read and encrypted as its packets are sent, and read again on every attempt.
+	The CRCs of the original content (of the whole of it, and of its chunks for the fingerprint index) are computed as it's
+	read, streamed content has them once all of its packets were taken.
+*/
+class EncryptedFile : public UploadSource {
+	std::string file_name;
+	std::string aes_key;
+	FileIdentity identity;
+	uint64_t orig_size;
+	uint64_t content_size;
+	unsigned long cksum;
+	std::vector<uint32_t> chunks;
+	std::string ciphertext;
+	std::filesystem::path spill_path;
+	boost::interprocess::mapped_region spill_region;
+	bool cached;
+	// The position of the next packet in the kept content.
+	size_t offset;
+	// Streamed content - the file being read, and the ciphertext read ahead of the packets taken.
+	bool streaming;
+	std::unique_ptr<ChunkEncryptor> stream;
+	std::string stream_buffer;
+	size_t stream_offset;
+
+	// This method reads and encrypts the file, replacing the cached content (or only notes its identity, if it is to be streamed).
+	void load(const std::string& aes_key, const FileIdentity& identity);
+	// This method moves back to the content's first packet, a streamed file is opened again.
+	void rewind();
+	// This method unmaps and deletes the spill file, if there is one.
+	void drop_spill();
+
+	public:
+		// The file name is relative to the executable's directory (like fileToCharArray's).
+		EncryptedFile(std::string file_name);
+		~EncryptedFile();
+		EncryptedFile(const EncryptedFile&) = delete;
+		EncryptedFile& operator=(const EncryptedFile&) = delete;
+
+		// This method makes sure the content is the file's current content encrypted with the given key, and moves back to its first packet. Returns true if the file is read again.
+		bool refresh(const std::string& aes_key);
+		// The next packets' encrypted content, valid until the next call or refresh.
+		ByteView next(size_t size);
+		uint64_t getContentSize() const;
+		uint64_t getOrigSize() const;
+		// The CRC of the original content.
+		unsigned long getCksum() const;
+		// The identity of the file when it was read, and what is known about its content - the fingerprint of an unconfirmed upload.
+		FileFingerprint getFingerprint() const;
+};
+
+/*
+	Content read from a stream of unknown length (a pipe, like standard input), encrypted FINGERPRINT_CHUNK_SIZE bytes at a
+	time as its packets are taken - the content is never held (or written) as a whole, and can only be sent once.
+*/
+class EncryptedStream : public StreamSource {
+	StreamReader read;
+	AESStreamEncryptor encryptor;
+	Crc crc;
+	uint64_t orig_size;
+	std::vector<char> buffer;
+	std::string ciphertext;
+	size_t offset;
+	bool finished;
+
+	public:
+		EncryptedStream(StreamReader read, const std::string& aes_key);
+
+		// The next packets' encrypted content, valid until the next call. Blocks until the stream has enough of it, or ends.
+		ByteView next(size_t size);
+		uint64_t getOrigSize() const;
+		unsigned long getCksum() const;
+};
+
+/*
+	Content in the caller's memory, which must outlive it. The content is encrypted as its packets are taken (and again on
+	every attempt), so the ciphertext is never held as a whole.
+*/
+class EncryptedBuffer : public UploadSource {
+	ByteView content;
+	size_t read_offset;
+	std::unique_ptr<EncryptedStream> stream;
+
+	public:
+		EncryptedBuffer(ByteView content);
+
+		bool refresh(const std::string& aes_key);
+		ByteView next(size_t size);
+		uint64_t getContentSize() const;
+		uint64_t getOrigSize() const;
+		unsigned long getCksum() const;
+};
+
+#endif
@@ -0,0 +1,416 @@
+#include "fingerprint.hpp"
+#include <algorithm>
+#include <string_view>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace {
+	constexpr char TABLE_MAGIC[4] = { 'F', 'P', 'I', 'X' };
+	constexpr char JOURNAL_MAGIC[4] = { 'F', 'P', 'J', 'L' };
+	constexpr uint32_t INDEX_VERSION = 1;
+
+	struct IndexHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t entry_count;
+		uint64_t chunk_count;
+		uint64_t strings_size;
+	};
+
+	/*
+		A file's record, in the table and in the journal. The table is the header, the records sorted by (path_hash, path),
+		the chunk fingerprints of all records and then their paths. In the journal a record is followed by its own chunks and path.
+	*/
+	struct IndexEntry {
+		uint64_t path_hash;
+		uint64_t inode;
+		uint64_t size;
+		int64_t modified;
+		uint64_t confirmed_by;
+		uint64_t chunk_offset;
+		uint32_t chunk_count;
+		uint32_t cksum;
+		uint32_t path_offset;
+		uint32_t path_length;
+	};
+
+	struct JournalHeader {
+		char magic[4];
+		uint32_t version;
+	};
+
+	static_assert(sizeof(IndexHeader) == 32, "The table's header must have no padding.");
+	static_assert(sizeof(IndexEntry) == 64, "The table's records must have no padding.");
+	static_assert(sizeof(JournalHeader) == 8, "The journal's header must have no padding.");
+
+	// 64 bit FNV-1a.
+	uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325) {
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash = (hash ^ bytes[i]) * 0x100000001b3;
+		}
+		return hash;
+	}
+
+	uint64_t path_hash(std::string_view path) {
+		return fnv1a(path.data(), path.size());
+	}
+
+	IndexEntry make_entry(std::string_view path, const FileFingerprint& fingerprint) {
+		IndexEntry entry = {};
+		entry.path_hash = path_hash(path);
+		entry.inode = fingerprint.identity.inode;
+		entry.size = fingerprint.identity.size;
+		entry.modified = fingerprint.identity.modified;
+		entry.confirmed_by = fingerprint.confirmed_by;
+		entry.chunk_count = static_cast<uint32_t>(fingerprint.chunks.size());
+		entry.cksum = fingerprint.cksum;
+		entry.path_length = static_cast<uint32_t>(path.size());
+		return entry;
+	}
+
+	FileFingerprint make_fingerprint(const IndexEntry& entry, const uint32_t* chunks) {
+		FileFingerprint fingerprint;
+		fingerprint.identity = { entry.inode, entry.size, entry.modified };
+		fingerprint.cksum = entry.cksum;
+		fingerprint.chunks.assign(chunks, chunks + entry.chunk_count);
+		fingerprint.confirmed_by = entry.confirmed_by;
+		return fingerprint;
+	}
+
+	// The parts of a mapped table, checked once when it's mapped.
+	struct Table {
+		const IndexHeader* header;
+		const IndexEntry* entries;
+		const uint32_t* chunks;
+		const char* strings;
+
+		Table(const boost::interprocess::mapped_region& region) {
+			const char* base = static_cast<const char*>(region.get_address());
+			header = reinterpret_cast<const IndexHeader*>(base);
+			entries = reinterpret_cast<const IndexEntry*>(base + sizeof(IndexHeader));
+			chunks = reinterpret_cast<const uint32_t*>(entries + header->entry_count);
+			strings = reinterpret_cast<const char*>(chunks + header->chunk_count);
+		}
+
+		// A record's path and chunks, false if they are out of the table's bounds.
+		bool valid(const IndexEntry& entry) const {
+			return entry.path_offset + static_cast<uint64_t>(entry.path_length) <= header->strings_size &&
+				entry.chunk_offset + entry.chunk_count <= header->chunk_count;
+		}
+
+		std::string_view path(const IndexEntry& entry) const {
+			return std::string_view(strings + entry.path_offset, entry.path_length);
+		}
+	};
+}
+
+bool stat_file(const std::string& path, FileIdentity& identity) {
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	BY_HANDLE_FILE_INFORMATION info;
+	BOOL found = GetFileInformationByHandle(file, &info);
+	CloseHandle(file);
+	if (!found) {
+		return false;
+	}
+
+	identity.inode = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+	identity.size = (static_cast<uint64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+	identity.modified = static_cast<int64_t>((static_cast<uint64_t>(info.ftLastWriteTime.dwHighDateTime) << 32) | info.ftLastWriteTime.dwLowDateTime);
+#else
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0) {
+		return false;
+	}
+
+	identity.inode = static_cast<uint64_t>(st.st_ino);
+	identity.size = static_cast<uint64_t>(st.st_size);
+#ifdef __APPLE__
+	identity.modified = static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+	identity.modified = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+#endif
+	return true;
+}
+
+uint64_t confirmation_id(const std::string& address, const std::string& port, const UUID& uuid) {
+	std::string server = address + ":" + port;
+	uint64_t id = fnv1a(uuid.data, sizeof(uuid.data), fnv1a(server.data(), server.size()));
+	return id ? id : 1;
+}
+
+FingerprintIndex::FingerprintIndex(std::string index_path) :
+	index_path(index_path),
+	journal_path(index_path + ".journal"),
+	entry_count(0),
+	journal_records(0)
+{
+	TRACE_SPAN("fingerprint index open");
+	map_table();
+	read_journal();
+}
+
+FingerprintIndex::~FingerprintIndex() {
+	try {
+		std::lock_guard<std::mutex> lock(index_lock);
+		if (journal_records) {
+			merge_journal();
+		}
+	}
+	catch (std::exception& e) {
+		LOG_ERROR(e.what());
+	}
+}
+
+void FingerprintIndex::map_table() {
+	region = boost::interprocess::mapped_region();
+	entry_count = 0;
+
+	std::error_code ec;
+	uintmax_t size = std::filesystem::file_size(index_path, ec);
+	if (ec || size < sizeof(IndexHeader)) {
+		return;
+	}
+
+	try {
+		boost::interprocess::file_mapping mapping(index_path.c_str(), boost::interprocess::read_only);
+		region = boost::interprocess::mapped_region(mapping, boost::interprocess::read_only);
+	}
+	catch (std::exception& e) {
+		LOG_WARNING("Cannot map the fingerprint index " << index_path << ": " << e.what());
+		region = boost::interprocess::mapped_region();
+		return;
+	}
+
+	// The sizes in the header must add up to the file's size exactly, or the table is ignored (and replaced on the next compaction).
+	const IndexHeader* header = static_cast<const IndexHeader*>(region.get_address());
+	bool valid = memcmp(header->magic, TABLE_MAGIC, sizeof(TABLE_MAGIC)) == 0 && header->version == INDEX_VERSION &&
+		header->entry_count <= size / sizeof(IndexEntry) && header->chunk_count <= size / sizeof(uint32_t) &&
+		sizeof(IndexHeader) + header->entry_count * sizeof(IndexEntry) + header->chunk_count * sizeof(uint32_t) + header->strings_size == size;
+	if (!valid) {
+		LOG_WARNING("The fingerprint index " << index_path << " is invalid, ignoring it.");
+		region = boost::interprocess::mapped_region();
+		return;
+	}
+
+	entry_count = static_cast<size_t>(header->entry_count);
+}
+
+void FingerprintIndex::read_journal() {
+	std::ifstream in(journal_path, std::ios::binary);
+	if (!in.is_open()) {
+		return;
+	}
+
+	std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	in.close();
+	std::error_code ec;
+	JournalHeader header;
+	if (data.size() < sizeof(header)) {
+		// New records are appended without a header to a journal that exists, a torn header is dropped for the next update to write it.
+		std::filesystem::remove(journal_path, ec);
+		return;
+	}
+	memcpy(&header, data.data(), sizeof(header));
+	if (memcmp(header.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0 || header.version != INDEX_VERSION) {
+		LOG_WARNING("The fingerprint journal " << journal_path << " is invalid, ignoring it.");
+		std::filesystem::remove(journal_path, ec);
+		return;
+	}
+
+	// Later records of a path replace earlier ones. A record cut short (the client stopped while appending it) ends the journal.
+	size_t pos = sizeof(header);
+	while (data.size() - pos >= sizeof(IndexEntry)) {
+		IndexEntry entry;
+		memcpy(&entry, data.data() + pos, sizeof(entry));
+		size_t record_size = sizeof(entry) + static_cast<size_t>(entry.chunk_count) * sizeof(uint32_t) + entry.path_length;
+		if (data.size() - pos < record_size) {
+			break;
+		}
+
+		std::vector<uint32_t> chunks(entry.chunk_count);
+		memcpy(chunks.data(), data.data() + pos + sizeof(entry), chunks.size() * sizeof(uint32_t));
+		std::string path(data.data() + pos + sizeof(entry) + chunks.size() * sizeof(uint32_t), entry.path_length);
+
+		journal[path] = make_fingerprint(entry, chunks.data());
+		journal_records++;
+		pos += record_size;
+	}
+
+	// The journal is cut back to its last whole record - records appended after a torn one would be read from its middle.
+	if (pos < data.size()) {
+		std::filesystem::resize_file(journal_path, pos, ec);
+		if (ec) {
+			LOG_WARNING("Cannot cut the torn record off the fingerprint journal " << journal_path << ": " << ec.message());
+		}
+	}
+}
+
+bool FingerprintIndex::lookup_table(const std::string& path, FileFingerprint& fingerprint) const {
+	if (entry_count == 0) {
+		return false;
+	}
+
+	Table table(region);
+	uint64_t hash = path_hash(path);
+	const IndexEntry* end = table.entries + entry_count;
+	const IndexEntry* entry = std::lower_bound(table.entries, end, hash, [](const IndexEntry& e, uint64_t h) {
+		return e.path_hash < h;
+	});
+
+	for (; entry != end && entry->path_hash == hash; entry++) {
+		if (table.valid(*entry) && table.path(*entry) == path) {
+			fingerprint = make_fingerprint(*entry, table.chunks + entry->chunk_offset);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FingerprintIndex::lookup(const std::string& path, FileFingerprint& fingerprint) const {
+	std::lock_guard<std::mutex> lock(index_lock);
+	// The journal holds the latest records.
+	auto found = journal.find(path);
+	if (found != journal.end()) {
+		fingerprint = found->second;
+		return true;
+	}
+	return lookup_table(path, fingerprint);
+}
+
+void FingerprintIndex::update(const std::string& path, const FileFingerprint& fingerprint) {
+	std::lock_guard<std::mutex> lock(index_lock);
+	IndexEntry entry = make_entry(path, fingerprint);
+	bool new_journal = !std::filesystem::exists(journal_path);
+	std::ofstream out(journal_path, std::ios::binary | std::ios::app);
+
+	if (new_journal) {
+		JournalHeader header;
+		memcpy(header.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+		header.version = INDEX_VERSION;
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	}
+	out.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+	out.write(reinterpret_cast<const char*>(fingerprint.chunks.data()), fingerprint.chunks.size() * sizeof(uint32_t));
+	out.write(path.data(), path.size());
+	out.close();
+	if (!out) {
+		LOG_WARNING("Cannot write the fingerprint journal " << journal_path << ".");
+	}
+
+	journal[path] = fingerprint;
+	if (++journal_records >= FINGERPRINT_JOURNAL_LIMIT) {
+		merge_journal();
+	}
+}
+
+void FingerprintIndex::compact() {
+	std::lock_guard<std::mutex> lock(index_lock);
+	merge_journal();
+}
+
+void FingerprintIndex::merge_journal() {
+	TRACE_SPAN("fingerprint index compact");
+	// A record of the new table - either one kept from the mapped table, or one from the journal.
+	struct Pending {
+		uint64_t hash;
+		std::string_view path;
+		const IndexEntry* kept;
+		const FileFingerprint* fresh;
+	};
+
+	std::vector<Pending> pending;
+	pending.reserve(entry_count + journal.size());
+	uint64_t chunk_count = 0, strings_size = 0;
+
+	if (entry_count) {
+		Table table(region);
+		for (size_t i = 0; i < entry_count; i++) {
+			const IndexEntry& entry = table.entries[i];
+			if (table.valid(entry) && journal.find(std::string(table.path(entry))) == journal.end()) {
+				pending.push_back({ entry.path_hash, table.path(entry), &entry, nullptr });
+				chunk_count += entry.chunk_count;
+				strings_size += entry.path_length;
+			}
+		}
+	}
+	for (const auto& record : journal) {
+		pending.push_back({ path_hash(record.first), record.first, nullptr, &record.second });
+		chunk_count += record.second.chunks.size();
+		strings_size += record.first.size();
+	}
+
+	std::sort(pending.begin(), pending.end(), [](const Pending& a, const Pending& b) {
+		return (a.hash != b.hash) ? a.hash < b.hash : a.path < b.path;
+	});
+
+	// Write the new table aside, then rename it over the old one - a reader never sees a partly written table.
+	std::string temp_path = index_path + ".tmp";
+	{
+		std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+		IndexHeader header;
+		memcpy(header.magic, TABLE_MAGIC, sizeof(TABLE_MAGIC));
+		header.version = INDEX_VERSION;
+		header.entry_count = pending.size();
+		header.chunk_count = chunk_count;
+		header.strings_size = strings_size;
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		uint64_t chunk_offset = 0;
+		uint32_t path_offset = 0;
+		for (const Pending& record : pending) {
+			IndexEntry entry = record.kept ? *record.kept : make_entry(record.path, *record.fresh);
+			entry.chunk_offset = chunk_offset;
+			entry.path_offset = path_offset;
+			out.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+			chunk_offset += entry.chunk_count;
+			path_offset += entry.path_length;
+		}
+
+		const uint32_t* old_chunks = entry_count ? Table(region).chunks : nullptr;
+		for (const Pending& record : pending) {
+			if (record.kept) {
+				out.write(reinterpret_cast<const char*>(old_chunks + record.kept->chunk_offset), record.kept->chunk_count * sizeof(uint32_t));
+			}
+			else {
+				out.write(reinterpret_cast<const char*>(record.fresh->chunks.data()), record.fresh->chunks.size() * sizeof(uint32_t));
+			}
+		}
+		for (const Pending& record : pending) {
+			out.write(record.path.data(), record.path.size());
+		}
+
+		out.close();
+		if (!out) {
+			throw std::runtime_error("Cannot write the fingerprint index " + temp_path + ".");
+		}
+	}
+
+	// The old table is unmapped before it's replaced (Windows does not replace a mapped file).
+	region = boost::interprocess::mapped_region();
+	entry_count = 0;
+	std::filesystem::rename(temp_path, index_path);
+	std::error_code ec;
+	std::filesystem::remove(journal_path, ec);
+	journal.clear();
+	journal_records = 0;
+	map_table();
+}
+
+FingerprintIndex& fingerprint_index() {
+	static FingerprintIndex index(EXE_DIR_FILE_PATH("fingerprints.idx"));
+	return index;
+}
+
+std::string fingerprint_key(const std::string& file_path) {
+	return std::filesystem::absolute(EXE_DIR_FILE_PATH(file_path)).lexically_normal().string();
+}
@@ -0,0 +1,88 @@
+#ifndef FINGERPRINT_H
+#define FINGERPRINT_H
+
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include "utils.hpp"
+
+// Identifies a file's content without reading it - a file whose identity is unchanged is assumed to have the same content.
+struct FileIdentity {
+	uint64_t inode;
+	uint64_t size;
+	// Modification time, in the file system's own units (nanoseconds on POSIX, 100ns ticks on Windows).
+	int64_t modified;
+
+	bool operator==(const FileIdentity& other) const {
+		return inode == other.inode && size == other.size && modified == other.modified;
+	}
+	bool operator!=(const FileIdentity& other) const {
+		return !(*this == other);
+	}
+};
+
+// This method gets the identity of the file at the given path with a single stat, returns false if the file does not exist.
+bool stat_file(const std::string& path, FileIdentity& identity);
+
+// What is known about a file's content, from the last time it was read.
+struct FileFingerprint {
+	FileIdentity identity;
+	// The CRC of the whole content, and of every FINGERPRINT_CHUNK_SIZE bytes chunk of it.
+	uint32_t cksum;
+	std::vector<uint32_t> chunks;
+	// Which server and client confirmed the upload of this content (see confirmation_id), 0 if no upload was confirmed.
+	uint64_t confirmed_by;
+};
+
+// This method returns the id recording that the given client uploaded a file to the given server, never 0.
+uint64_t confirmation_id(const std::string& address, const std::string& port, const UUID& uuid);
+
+/*
+	A persistent index of file fingerprints, keyed by the file's absolute path.
+	The index is a sorted table of fixed size records, memory-mapped and binary searched in place - opening it costs a map and
+	a header check, however many files it holds. Updates are appended to a journal next to it, read into memory when the index
+	is opened, and merged into a new table (written aside and renamed over the old one) once the journal grows past
+	FINGERPRINT_JOURNAL_LIMIT records, or when the index is closed.
+	Both files are written in the machine's byte order - they are a local cache, a file that doesn't check out is ignored.
+	The index may be shared by the sessions of a process, every method takes its lock.
+*/
+class FingerprintIndex {
+	std::string index_path;
+	std::string journal_path;
+	boost::interprocess::mapped_region region;
+	size_t entry_count;
+	std::unordered_map<std::string, FileFingerprint> journal;
+	size_t journal_records;
+	mutable std::mutex index_lock;
+
+	// This method maps the table, leaves it empty if it's missing or doesn't check out.
+	void map_table();
+	// This method reads the journal's records into memory, cutting a torn last record off the journal.
+	void read_journal();
+	// This method finds the path in the mapped table.
+	bool lookup_table(const std::string& path, FileFingerprint& fingerprint) const;
+	// This method merges the journal into the table, the lock must be held.
+	void merge_journal();
+
+	public:
+		FingerprintIndex(std::string index_path);
+		~FingerprintIndex();
+		FingerprintIndex(const FingerprintIndex&) = delete;
+		FingerprintIndex& operator=(const FingerprintIndex&) = delete;
+
+		// This method finds the fingerprint of the file at the given path, returns false if the index has none.
+		bool lookup(const std::string& path, FileFingerprint& fingerprint) const;
+		// This method records the fingerprint of the file at the given path.
+		void update(const std::string& path, const FileFingerprint& fingerprint);
+		// This method merges the journal into the table.
+		void compact();
+};
+
+// This method returns the client's fingerprint index (fingerprints.idx in the executable's directory), opening it on first use.
+FingerprintIndex& fingerprint_index();
+// This method returns the key of the given file in the fingerprint index - its absolute path.
+std::string fingerprint_key(const std::string& file_path);
+
+#endif
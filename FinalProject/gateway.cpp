@@ -0,0 +1,370 @@
+#include "gateway.hpp"
+
+namespace {
+	// Clients of version 3 (and before) send the Sending File request with 32 bit sizes and 16 bit packet counters.
+	constexpr uint8_t LEGACY_VERSION = 3;
+	using LegacySendingFileLayout = Layout<Number<uint32_t>, Number<uint32_t>, Number<uint16_t>, Number<uint16_t>, Bytes<NAME_SIZE>, Bytes<CONTENT_SIZE_PER_PACKET>>;
+
+	// This method returns the content size a file packet carries, 0 for every other request.
+	uint64_t packet_content_size(uint16_t code, uint8_t version, ByteView payload) {
+		if (code != Codes::SENDING_FILE_C && code != Codes::SENDING_BUNDLE_C) {
+			return 0;
+		}
+		// The payload's size was checked by expects_response.
+		return version <= LEGACY_VERSION ? LegacySendingFileLayout::get<0>(payload) : SendingFileLayout::get<0>(payload);
+	}
+
+	/*
+		This method returns true if the code is one of the protocol's requests a client may send through the gateway. A client's
+		Multiplex request would switch a shared upstream connection into framed mode, so it is not relayed either.
+	*/
+	bool relayable(uint16_t code) {
+		switch (code) {
+			case Codes::REGISTRATION_C:
+			case Codes::SENDING_PUBLIC_KEY_C:
+			case Codes::RECONNECTION_C:
+			case Codes::SENDING_FILE_C:
+			case Codes::SENDING_ECDH_KEY_C:
+			case Codes::ECDH_RECONNECTION_C:
+			case Codes::TICKET_RECONNECTION_C:
+			case Codes::SENDING_BUNDLE_C:
+			case Codes::VALID_CRC_C:
+			case Codes::SENDING_CRC_AGAIN_C:
+			case Codes::INVALID_CRC_DONE_C:
+			case Codes::VALID_CRC_TICKET_C:
+			case Codes::CHECKED_TICKET_RECONNECTION_C:
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	// This method answers a request the gateway doesn't relay with a General Error, as the server answers a request it doesn't know.
+	void reject_request(tcp::socket& downstream, uint64_t client, uint16_t code) {
+		LOG_WARNING("Client " << client << " sent request " << code << ", which is not relayed.");
+		uint8_t response[RESPONSE_HEADER_SIZE];
+		ResponseHeaderLayout::put<0>(response, static_cast<uint8_t>(VERSION));
+		ResponseHeaderLayout::put<1>(response, static_cast<uint16_t>(Codes::GENERAL_ERROR_C));
+		ResponseHeaderLayout::put<2>(response, static_cast<uint32_t>(PayloadSize::GENERAL_ERROR_P));
+		boost::asio::write(downstream, boost::asio::buffer(response));
+	}
+
+	/*
+		This method reads exactly size bytes from the client, giving it up to the idle timeout (0 waits forever) for each part of
+		them. Returns false if the client disconnected first.
+	*/
+	bool read_from_client(tcp::socket& downstream, uint8_t* data, size_t size, std::chrono::milliseconds idle_timeout) {
+		size_t read = 0;
+		while (read < size) {
+			try {
+				wait_for_response(downstream, idle_timeout);
+			}
+			catch (ResponseTimeout&) {
+				throw std::runtime_error("timed out waiting for the client's request.");
+			}
+
+			boost::system::error_code ec;
+			read += downstream.read_some(boost::asio::buffer(data + read, size - read), ec);
+			if (ec) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/*
+		This method reads the client's next request onto the end of the buffer, returns false if the client disconnected instead.
+		The client may stay silent for up to the idle timeout at a time (0 waits forever). The response timeout is how long to
+		wait for the server's response to the request, if it has one.
+	*/
+	bool read_request(tcp::socket& downstream, std::vector<uint8_t>& buffer, std::chrono::milliseconds idle_timeout, uint16_t& code, bool& responds, std::chrono::milliseconds& response_timeout) {
+		uint8_t header[REQUEST_HEADER_SIZE];
+		if (!read_from_client(downstream, header, sizeof(header), idle_timeout)) {
+			return false;
+		}
+
+		uint8_t version = RequestHeaderLayout::get<1>(header);
+		code = RequestHeaderLayout::get<2>(header);
+		uint32_t payload_size = RequestHeaderLayout::get<3>(header);
+		// No valid request is larger than a file packet.
+		if (payload_size > PayloadSize::SENDING_FILE_P) {
+			throw std::invalid_argument("Request " + std::to_string(code) + " is too large.");
+		}
+
+		size_t offset = buffer.size();
+		buffer.resize(offset + REQUEST_HEADER_SIZE + payload_size);
+		memcpy(buffer.data() + offset, header, REQUEST_HEADER_SIZE);
+		if (!read_from_client(downstream, buffer.data() + offset + REQUEST_HEADER_SIZE, payload_size, idle_timeout)) {
+			throw std::runtime_error("the client disconnected in the middle of a request.");
+		}
+
+		ByteView payload(buffer.data() + offset + REQUEST_HEADER_SIZE, payload_size);
+		responds = expects_response(code, version, payload);
+		response_timeout = content_response_timeout(retry_policy().timeout, packet_content_size(code, version, payload));
+		return true;
+	}
+}
+
+bool expects_response(uint16_t code, uint8_t version, ByteView payload) {
+	switch (code) {
+		case Codes::SENDING_FILE_C:
+		case Codes::SENDING_BUNDLE_C: {
+			uint64_t packet_number, total_packets;
+			if (version <= LEGACY_VERSION) {
+				if (payload.size() != LegacySendingFileLayout::size) {
+					throw std::invalid_argument("Malformed Sending File request.");
+				}
+				packet_number = LegacySendingFileLayout::get<2>(payload);
+				total_packets = LegacySendingFileLayout::get<3>(payload);
+			}
+			else {
+				if (payload.size() != SendingFileLayout::size) {
+					throw std::invalid_argument("Malformed Sending File request.");
+				}
+				packet_number = SendingFileLayout::get<2>(payload);
+				total_packets = SendingFileLayout::get<3>(payload);
+			}
+			// A streamed file's total packets are 0 until its last packet.
+			return total_packets != 0 && packet_number == total_packets;
+		}
+		// The server responds to the file packets that follow these.
+		case Codes::SENDING_CRC_AGAIN_C:
+		case Codes::TICKET_RECONNECTION_C:
+			return false;
+		// The server responds to unknown codes with a General Error (the gateway doesn't relay them).
+		default:
+			return true;
+	}
+}
+
+Gateway::Upstream::Upstream(boost::asio::io_context& io_context) :
+	sock(io_context),
+	connected(false)
+{
+
+}
+
+Gateway::Gateway(std::string address, std::string port, unsigned short listen_port, size_t upstreams, bool multiplex) :
+	address(address),
+	port(port),
+	listen_port(listen_port),
+	multiplex(multiplex),
+	next_mux(0),
+	clients(0),
+	exchanges(0)
+{
+	if (multiplex) {
+		muxes.resize(std::max<size_t>(upstreams, 1));
+		return;
+	}
+	for (size_t i = 0; i < std::max<size_t>(upstreams, 1); i++) {
+		this->upstreams.push_back(std::make_unique<Upstream>(io_context));
+		idle.push_back(this->upstreams.back().get());
+	}
+}
+
+Gateway::Upstream& Gateway::lease() {
+	Upstream* upstream;
+	{
+		std::unique_lock<std::mutex> lock(idle_lock);
+		std::chrono::milliseconds timeout = retry_policy().timeout;
+		if (timeout.count() > 0) {
+			if (!idle_changed.wait_for(lock, timeout, [this] { return !idle.empty(); })) {
+				throw std::runtime_error("timed out waiting for a free upstream connection.");
+			}
+		}
+		else {
+			idle_changed.wait(lock, [this] { return !idle.empty(); });
+		}
+		upstream = idle.back();
+		idle.pop_back();
+	}
+
+	if (!upstream->connected) {
+		try {
+			TRACE_SPAN("connect");
+			connect_tuned(upstream->sock, endpoints);
+			// Keep the idle connection alive between exchanges.
+			upstream->sock.set_option(boost::asio::socket_base::keep_alive(true));
+			upstream->connected = true;
+		}
+		catch (...) {
+			release(*upstream, false);
+			throw;
+		}
+	}
+	return *upstream;
+}
+
+void Gateway::release(Upstream& upstream, bool between_exchanges) {
+	if (!between_exchanges) {
+		boost::system::error_code ec;
+		upstream.sock.close(ec);
+		upstream.connected = false;
+	}
+
+	std::lock_guard<std::mutex> lock(idle_lock);
+	idle.push_back(&upstream);
+	idle_changed.notify_one();
+}
+
+void Gateway::relay(tcp::socket downstream) {
+	uint64_t client = ++clients;
+	Upstream* upstream = nullptr;
+	// The requests read since the last write upstream - the packets a client pipelines are written together.
+	std::vector<uint8_t> pending;
+	uint8_t response[RESPONSE_HEADER_SIZE + MAX_RESPONSE_PAYLOAD_SIZE];
+
+	LOG_DEBUG("Client " << client << " connected to the gateway.");
+	try {
+		while (true) {
+			// Only wait for the client's next request once the requests it already sent were written.
+			if (!pending.empty() && downstream.available() == 0) {
+				boost::asio::write(upstream->sock, boost::asio::buffer(pending));
+				pending.clear();
+			}
+
+			// A client in the middle of an exchange holds its upstream connection, it gets as long as a response would to send the rest of it.
+			std::chrono::milliseconds idle_timeout = upstream != nullptr ? retry_policy().timeout : std::chrono::milliseconds(0);
+			uint16_t code;
+			bool responds;
+			std::chrono::milliseconds timeout;
+			size_t request_offset = pending.size();
+			if (!read_request(downstream, pending, idle_timeout, code, responds, timeout)) {
+				break;
+			}
+			if (!relayable(code)) {
+				pending.resize(request_offset);
+				reject_request(downstream, client, code);
+				continue;
+			}
+
+			// The exchange holds an upstream connection from its first request.
+			if (upstream == nullptr) {
+				upstream = &lease();
+			}
+
+			if (!responds) {
+				if (pending.size() >= PIPELINE_WRITE_SIZE) {
+					boost::asio::write(upstream->sock, boost::asio::buffer(pending));
+					pending.clear();
+				}
+				continue;
+			}
+
+			boost::asio::write(upstream->sock, boost::asio::buffer(pending));
+			pending.clear();
+
+			std::chrono::steady_clock::time_point deadline = response_deadline(timeout);
+			read_response(upstream->sock, response, RESPONSE_HEADER_SIZE, deadline);
+			uint32_t response_size = get_response_payload_size(ByteView(response, RESPONSE_HEADER_SIZE));
+			if (response_size > MAX_RESPONSE_PAYLOAD_SIZE) {
+				throw std::invalid_argument("server responded with an error.");
+			}
+			read_response(upstream->sock, response + RESPONSE_HEADER_SIZE, response_size, deadline);
+
+			// The exchange is over, the connection is free for another client's while the response is relayed.
+			release(*upstream, true);
+			upstream = nullptr;
+			exchanges++;
+
+			boost::asio::write(downstream, boost::asio::buffer(response, RESPONSE_HEADER_SIZE + response_size));
+		}
+	}
+	catch (std::exception& e) {
+		LOG_ERROR("Client " << client << ": " << e.what());
+	}
+
+	// A client that left in the middle of an exchange leaves its upstream connection in the middle of it too.
+	if (upstream != nullptr) {
+		release(*upstream, false);
+	}
+	LOG_INFO("Client " << client << " disconnected from the gateway, " << exchanges << " exchanges relayed so far.");
+}
+
+std::shared_ptr<MuxConnection> Gateway::multiplexed() {
+	std::lock_guard<std::mutex> lock(muxes_lock);
+	std::shared_ptr<MuxConnection>& mux = muxes[next_mux++ % muxes.size()];
+
+	// The clients of a failed connection still hold it, it's closed once the last of them disconnects.
+	if (!mux || !mux->isOpen()) {
+		std::shared_ptr<MuxConnection> opened = std::make_shared<MuxConnection>(io_context);
+		opened->connect(endpoints);
+		mux = opened;
+	}
+	return mux;
+}
+
+void Gateway::relay_multiplexed(tcp::socket downstream) {
+	uint64_t client = ++clients;
+	std::shared_ptr<MuxConnection> mux;
+	uint32_t stream = 0;
+	std::vector<uint8_t> request;
+	uint8_t response[RESPONSE_HEADER_SIZE + MAX_RESPONSE_PAYLOAD_SIZE];
+
+	LOG_DEBUG("Client " << client << " connected to the gateway.");
+	try {
+		while (true) {
+			uint16_t code;
+			bool responds;
+			std::chrono::milliseconds timeout;
+			request.clear();
+			// A stream holds no connection of its own, the client may stay silent for as long as it likes.
+			if (!read_request(downstream, request, std::chrono::milliseconds(0), code, responds, timeout)) {
+				break;
+			}
+			if (!relayable(code)) {
+				reject_request(downstream, client, code);
+				continue;
+			}
+
+			// The client keeps the stream opened by its first request, on the connection it was opened on.
+			if (!mux) {
+				mux = multiplexed();
+				stream = mux->openStream();
+			}
+
+			// A file's packets are bulk data, the other requests are small and written ahead of them.
+			bool bulk = code == Codes::SENDING_FILE_C || code == Codes::SENDING_BUNDLE_C;
+			mux->write(stream, request.data(), request.size(), bulk ? MUX_BULK : MUX_CONTROL);
+			if (!responds) {
+				continue;
+			}
+
+			mux->read(stream, response, RESPONSE_HEADER_SIZE, timeout);
+			uint32_t response_size = get_response_payload_size(ByteView(response, RESPONSE_HEADER_SIZE));
+			if (response_size > MAX_RESPONSE_PAYLOAD_SIZE) {
+				throw std::invalid_argument("server responded with an error.");
+			}
+			mux->read(stream, response + RESPONSE_HEADER_SIZE, response_size, timeout);
+			exchanges++;
+
+			boost::asio::write(downstream, boost::asio::buffer(response, RESPONSE_HEADER_SIZE + response_size));
+		}
+	}
+	catch (std::exception& e) {
+		LOG_ERROR("Client " << client << ": " << e.what());
+	}
+
+	if (mux) {
+		mux->closeStream(stream);
+	}
+	LOG_INFO("Client " << client << " disconnected from the gateway, " << exchanges << " exchanges relayed so far.");
+}
+
+void Gateway::run() {
+	tcp::resolver resolver(io_context);
+	endpoints = resolver.resolve(address, port);
+
+	// Only local clients are accepted, their requests are relayed as they are.
+	tcp::acceptor acceptor(io_context, tcp::endpoint(boost::asio::ip::address_v4::loopback(), listen_port));
+	LOG_INFO("Gateway listening on port " << listen_port << ", relaying to " << address << ":" << port << " over up to " <<
+		(multiplex ? muxes.size() : upstreams.size()) << (multiplex ? " multiplexed" : "") << " connections.");
+
+	while (true) {
+		tcp::socket downstream(io_context);
+		acceptor.accept(downstream);
+		downstream.set_option(tcp::no_delay(true));
+		std::thread(multiplex ? &Gateway::relay_multiplexed : &Gateway::relay, this, std::move(downstream)).detach();
+	}
+}
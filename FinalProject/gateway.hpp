@@ -0,0 +1,79 @@
+#ifndef GATEWAY_H
+#define GATEWAY_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "request.hpp"
+#include "sockopt.hpp"
+#include "mux.hpp"
+
+/*
+	A local gateway, relaying the requests of many local clients (each with its own identity and keys) over a small pool of
+	connections to the server - the server keeps its session state per client id, not per connection, so the requests of
+	different clients can share a connection as long as their exchanges don't interleave.
+	A client's requests are relayed as they are, the gateway never sees its keys or its files' content. An exchange (the
+	requests up to and including one the server responds to - a file's packets and the requests queued before them, or a
+	single handshake or CRC request) holds an upstream connection from its first request until its response was relayed,
+	so a connection carries one client's exchange at a time, and the server's per connection state (the packets dropped after
+	a rejected session ticket) never spans two clients.
+	Upstream connections are opened as they are first needed and kept open. An upstream connection that failed, or was left
+	in the middle of an exchange by a client that disconnected, is closed and opened again by the next exchange. A client in
+	the middle of an exchange that sends nothing for the retry policy's timeout is disconnected, so it can't hold its
+	upstream connection forever - and a client waits no longer than that for a free upstream connection.
+	A multiplexing gateway relays every client on a stream of its own instead (see mux.hpp), the clients are spread round
+	robin over the multiplexed connections and their exchanges interleave - a client's file packets are relayed as bulk
+	data, its other requests as control requests written ahead of the other clients' file packets. A multiplexed connection
+	that failed is opened again by the next client.
+*/
+class Gateway {
+	struct Upstream {
+		tcp::socket sock;
+		bool connected;
+
+		Upstream(boost::asio::io_context& io_context);
+	};
+
+	std::string address;
+	std::string port;
+	unsigned short listen_port;
+	boost::asio::io_context io_context;
+	tcp::resolver::results_type endpoints;
+	std::vector<std::unique_ptr<Upstream>> upstreams;
+	// The upstream connections no exchange holds, and the clients waiting for one.
+	std::mutex idle_lock;
+	std::condition_variable idle_changed;
+	std::vector<Upstream*> idle;
+	bool multiplex;
+	std::mutex muxes_lock;
+	std::vector<std::shared_ptr<MuxConnection>> muxes;
+	size_t next_mux;
+	std::atomic<uint64_t> clients;
+	std::atomic<uint64_t> exchanges;
+
+	// This method waits for an upstream connection no exchange holds (throws if none is free within the retry policy's timeout), and connects it if it isn't connected.
+	Upstream& lease();
+	// This method gives the upstream connection back to the pool - closed first, unless it's between exchanges.
+	void release(Upstream& upstream, bool between_exchanges);
+	// This method relays the requests of a client, and the responses to them, until the client disconnects.
+	void relay(tcp::socket downstream);
+	// This method returns the next multiplexed connection, round robin, and connects it if it isn't connected.
+	std::shared_ptr<MuxConnection> multiplexed();
+	// This method relays the requests of a client on a stream of a multiplexed connection, and the responses to them, until the client disconnects.
+	void relay_multiplexed(tcp::socket downstream);
+
+	public:
+		// The gateway relays to the server at the given address, over up to the given number of connections - multiplexed ones if multiplex is set.
+		Gateway(std::string address, std::string port, unsigned short listen_port, size_t upstreams = GATEWAY_UPSTREAMS, bool multiplex = false);
+		Gateway(const Gateway&) = delete;
+		Gateway& operator=(const Gateway&) = delete;
+
+		// This method runs the gateway - accepts clients on the loopback interface and relays their requests, until the process is stopped.
+		void run();
+};
+
+// This method returns true if the server responds to the request (the header's code and version, and the payload) - every request but a file's packets before its last one, Sending CRC Again and Ticket Reconnection.
+bool expects_response(uint16_t code, uint8_t version, ByteView payload);
+
+#endif
@@ -0,0 +1,90 @@
+#include "keypool.hpp"
+
+KeyPool::KeyPool(size_t capacity, bool lazy) :
+	capacity(capacity),
+	error(nullptr),
+	stopping(false)
+{
+	if (!lazy) {
+		prefill();
+	}
+}
+
+KeyPool::~KeyPool() {
+	{
+		std::lock_guard<std::mutex> lock(keys_lock);
+		stopping = true;
+	}
+	keys_changed.notify_all();
+
+	if (worker.joinable()) {
+		worker.join();
+	}
+}
+
+size_t KeyPool::getCapacity() const {
+	return this->capacity;
+}
+
+void KeyPool::prefill() {
+	std::lock_guard<std::mutex> lock(keys_lock);
+
+	// Only start the worker thread if the pool should keep a stock of key pairs.
+	if (capacity > 0 && !worker.joinable() && !stopping) {
+		worker = std::thread(&KeyPool::fill, this);
+	}
+}
+
+void KeyPool::fill() {
+	std::unique_lock<std::mutex> lock(keys_lock);
+
+	while (!stopping) {
+		// The pool is full, wait until a key pair is taken (or the pool is destroyed).
+		if (keys.size() >= capacity) {
+			keys_changed.wait(lock);
+			continue;
+		}
+
+		// Generate the key pair without holding the lock, so acquire() can take ready key pairs meanwhile.
+		lock.unlock();
+		std::unique_ptr<RSAPrivateWrapper> key;
+		try {
+			key = std::make_unique<RSAPrivateWrapper>();
+		}
+		catch (...) {
+			// Save the error so the thread waiting in acquire() receives it instead of waiting forever.
+			lock.lock();
+			error = std::current_exception();
+			keys_changed.notify_all();
+			return;
+		}
+		lock.lock();
+
+		keys.push_back(std::move(key));
+		keys_changed.notify_all();
+	}
+}
+
+std::unique_ptr<RSAPrivateWrapper> KeyPool::acquire() {
+	// No worker thread, generate the key pair right away.
+	if (capacity == 0) {
+		return std::make_unique<RSAPrivateWrapper>();
+	}
+
+	// A lazy pool's first key pair is generated by the worker thread, which then keeps the next one in stock.
+	prefill();
+
+	std::unique_lock<std::mutex> lock(keys_lock);
+	keys_changed.wait(lock, [this] { return !keys.empty() || error; });
+
+	if (keys.empty()) {
+		std::rethrow_exception(error);
+	}
+
+	// Take the oldest key pair and wake the worker thread so it generates a replacement.
+	std::unique_ptr<RSAPrivateWrapper> key = std::move(keys.front());
+	keys.pop_front();
+	keys_changed.notify_all();
+
+	return key;
+}
@@ -0,0 +1,46 @@
+#ifndef KEYPOOL_H
+#define KEYPOOL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <exception>
+#include "utils.hpp"
+
+/*
+	A small stock of pre-generated RSA key pairs.
+	A worker thread generates key pairs in the background until the pool holds 'capacity' of them, so the
+	(slow) key generation overlaps with connecting and with the registration round-trip.
+	A lazy pool starts its worker thread only once prefill() is called (or a key pair is first taken) - a client that
+	prefers the ECDH handshake only needs RSA key pairs once the server rejected it, and from then on keeps them in stock
+	for the handshakes that follow.
+	A pool with capacity 0 has no worker thread, and generates each key pair on the thread that asks for it.
+*/
+class KeyPool {
+	size_t capacity;
+	std::deque<std::unique_ptr<RSAPrivateWrapper>> keys;
+	std::mutex keys_lock;
+	std::condition_variable keys_changed;
+	std::exception_ptr error;
+	bool stopping;
+	std::thread worker;
+
+	// This method runs on the worker thread, generating key pairs until the pool is full and refilling it whenever a key pair is taken.
+	void fill();
+
+	public:
+		KeyPool(size_t capacity, bool lazy = false);
+		~KeyPool();
+
+		size_t getCapacity() const;
+
+		// This method starts the worker thread of a lazy pool, if it isn't running yet.
+		void prefill();
+
+		// This method takes a key pair out of the pool, waiting for the worker thread if the pool is currently empty.
+		std::unique_ptr<RSAPrivateWrapper> acquire();
+};
+
+#endif
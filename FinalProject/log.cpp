@@ -0,0 +1,109 @@
+#include "log.hpp"
+#include <iostream>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+namespace {
+	struct LogMessage {
+		int level;
+		std::string text;
+	};
+
+	/*
+		The background writer. Messages are swapped out of the queue in batches, written without flushing,
+		and the streams are flushed once the queue is empty.
+	*/
+	class AsyncSink {
+		std::vector<LogMessage> queue;
+		std::mutex queue_lock;
+		std::condition_variable queue_changed;
+		bool stopping;
+		size_t written;
+		size_t queued;
+		std::thread writer;
+
+		void write_messages() {
+			std::vector<LogMessage> batch;
+			std::unique_lock<std::mutex> lock(queue_lock);
+
+			while (true) {
+				queue_changed.wait(lock, [this] { return !queue.empty() || stopping; });
+				if (queue.empty()) {
+					break;
+				}
+				batch.swap(queue);
+				lock.unlock();
+
+				for (const LogMessage& message : batch) {
+					std::ostream& out = (message.level >= LOG_LEVEL_WARNING) ? std::cerr : std::cout;
+					out << message.text << '\n';
+				}
+				std::cout.flush();
+				size_t batch_size = batch.size();
+				batch.clear();
+
+				lock.lock();
+				written += batch_size;
+				queue_changed.notify_all();
+			}
+		}
+
+		public:
+			AsyncSink() :
+				stopping(false),
+				written(0),
+				queued(0)
+			{
+				writer = std::thread(&AsyncSink::write_messages, this);
+			}
+
+			~AsyncSink() {
+				{
+					std::lock_guard<std::mutex> lock(queue_lock);
+					stopping = true;
+				}
+				queue_changed.notify_all();
+				writer.join();
+			}
+
+			void push(int level, std::string text) {
+				std::lock_guard<std::mutex> lock(queue_lock);
+				queue.push_back({ level, std::move(text) });
+				queued++;
+				queue_changed.notify_all();
+			}
+
+			void flush() {
+				std::unique_lock<std::mutex> lock(queue_lock);
+				size_t target = queued;
+				queue_changed.wait(lock, [this, target] { return written >= target; });
+			}
+	};
+
+	std::atomic<int> runtime_level(LOG_LEVEL_DEBUG);
+
+	// The sink is created on the first message, and drained and stopped when the program exits.
+	AsyncSink& sink() {
+		static AsyncSink instance;
+		return instance;
+	}
+}
+
+bool log_enabled(int level) {
+	return level >= runtime_level.load(std::memory_order_relaxed);
+}
+
+void set_log_level(int level) {
+	runtime_level = level;
+}
+
+void log_write(int level, std::string message) {
+	sink().push(level, std::move(message));
+}
+
+void log_flush() {
+	sink().flush();
+}
@@ -0,0 +1,72 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <string>
+#include <sstream>
+
+/*
+	Logging with levels selected at compile time - a message below LOG_LEVEL is not compiled in at all, so release builds
+	do no debug formatting or I/O on the upload path. Messages that are compiled in can be filtered further at runtime.
+	Messages are formatted by the caller and handed to a background thread, which writes them (debug and info to stdout,
+	warnings and errors to stderr) without flushing after every line.
+	Usage: LOG_DEBUG("Running request code " << code);
+*/
+
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_ERROR 3
+#define LOG_LEVEL_NONE 4
+
+// Debug builds log everything, release builds start at info. Define LOG_LEVEL in the project to override.
+#ifndef LOG_LEVEL
+#ifdef NDEBUG
+#define LOG_LEVEL LOG_LEVEL_INFO
+#else
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+#endif
+
+#define LOG_AT(level, message) \
+	do { \
+		if (log_enabled(level)) { \
+			std::ostringstream log_stream; \
+			log_stream << message; \
+			log_write(level, log_stream.str()); \
+		} \
+	} while (0)
+
+#if LOG_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(message) LOG_AT(LOG_LEVEL_DEBUG, message)
+#else
+#define LOG_DEBUG(message) do {} while (0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(message) LOG_AT(LOG_LEVEL_INFO, message)
+#else
+#define LOG_INFO(message) do {} while (0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_WARNING
+#define LOG_WARNING(message) LOG_AT(LOG_LEVEL_WARNING, message)
+#else
+#define LOG_WARNING(message) do {} while (0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(message) LOG_AT(LOG_LEVEL_ERROR, message)
+#else
+#define LOG_ERROR(message) do {} while (0)
+#endif
+
+// This method returns true if messages of the given level pass the runtime filter.
+bool log_enabled(int level);
+// This method sets the runtime filter - messages below the given level are dropped (it can't bring back levels compiled out).
+void set_log_level(int level);
+// This method queues a formatted message for the background writer.
+void log_write(int level, std::string message);
+// This method waits until every queued message was written and flushed, before writing to the console directly.
+void log_flush();
+
+#endif
@@ -1,5 +1,11 @@
 #include "client.hpp"
-#include "request.hpp"
+#include "session.hpp"
+#include "daemon.hpp"
+#include "gateway.hpp"
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
 
 // This method checks if the data read from 'transfer.info' is valid.
 static bool validTransfer(Client &client, std::string ip_port, std::string name, std::string file_path) {
@@ -28,13 +34,18 @@ static bool validTransfer(Client &client, std::string ip_port, std::string name,
 	return true;
 }
 
-// This method creates the client, reads from the transfer.info file and sets the client's attributes.
+/*
+	This method creates the client, reads from the transfer.info file and sets the client's attributes.
+	The first three lines are the server's address, the client's name and the file to upload. Any further lines are
+	'key=value' socket tuning options (see sockopt.hpp), applied to the connections to the server.
+*/
 static Client createClient() {
 	std::string transfer_path = EXE_DIR_FILE_PATH("transfer.info");
 	std::string line, ip_port, client_name, client_file_path;
 	std::ifstream transfer_file(transfer_path);
 	int lines = 1;
 	Client client;
+	SocketTuning tuning = socket_tuning();
 
 	if (!transfer_file.is_open()) {
 		throw std::runtime_error("Error opening the 'transfer.info' file, aborting program.");
@@ -42,7 +53,7 @@ static Client createClient() {
 
 	// Read from transfer.info file into parameters.
 	while (getline(transfer_file, line)) {
-		std::cout << "'" << line << "' " << line.length() << std::endl;
+		LOG_DEBUG("transfer.info line " << lines << ": '" << line << "' " << line.length());
 		switch (lines) {
 			case 1:
 				ip_port = line;
@@ -54,263 +65,185 @@ static Client createClient() {
 				client_file_path = line;
 				break;
 			default:
+				if (!line.empty() && !parse_socket_option(line, tuning)) {
+					throw std::invalid_argument("Error: invalid socket option '" + line + "' in transfer.info.");
+				}
 				break;
 		}
 		lines++;
 	}
 	
-	if (lines != 4) {
+	if (lines < 4) {
 		throw std::invalid_argument("Error: transfer.info file contains invalid data.");
 	}
 
 	if (!validTransfer(client, ip_port, client_name, client_file_path)) {
 		throw std::invalid_argument("Error: transfer.info file contains invalid data.");
 	}
+	set_socket_tuning(tuning);
 
 	// Close the file and return the client.
 	transfer_file.close();
 	return client;
 }
 
-// This method is used for reading the name, id, and private key from the me.info and priv.key files.
-static std::string read_from_files(Client& client) {
-	std::string path_info = EXE_DIR_FILE_PATH("me.info");
-	std::string path_key = EXE_DIR_FILE_PATH("priv.key");
-	std::string line, client_name, client_id, private_key_me, private_key_priv;
-	int lines = 1;
-	std::ifstream info_file(path_info), key_file(path_key);
+// This method reads a batch list - a file path (relative to the executable's directory) on every line, empty lines are ignored.
+static std::vector<std::string> read_batch(std::string batch_file) {
+	std::ifstream batch(batch_file);
+	std::vector<std::string> file_paths;
+	std::string line;
 
-	if (!info_file.is_open()) {
-		throw std::runtime_error("Error opening the 'me.info' file, aborting program.");
-	}
-	if (!key_file.is_open()) {
-		throw std::runtime_error("Error opening the 'priv.key' file, aborting program.");
+	if (!batch.is_open()) {
+		throw std::runtime_error("Error opening the batch list " + batch_file + ", aborting program.");
 	}
-
-	// Read from me.info file into parameters.
-	while (std::getline(info_file, line)) {
-		switch (lines) {
-			case 1:
-				client_name = line;
-				break;
-			case 2:
-				client_id = line;
-				break;
-			case 3:
-				private_key_me = line;
-				break;
-			default:
-				private_key_me += line;
-				break;
+	while (getline(batch, line)) {
+		if (!line.empty()) {
+			file_paths.push_back(line);
 		}
-		lines++;
 	}
+	return file_paths;
+}
 
-	if (client_name.length() > MAX_NAME_LENGTH || client_name.length() == 0 || client_id.length() != HEX_ID_LENGTH || private_key_me.length() == 0) {
-		throw std::invalid_argument("Error: me.info file contains invalid data.");
-	}
+/*
+	This method runs the client's program - sends it's requests and gets responses. Uploads standard input under stdin_name, or
+	the files in the batch list using the given number of workers, instead of the file in transfer.info, if given.
+*/
+static void run_client(tcp::socket &sock, Client& client, KeyPool& key_pool, const std::string& stdin_name, const std::string& batch_file, size_t workers) {
+	std::string decrypted_aes_key, ticket;
 
-	// Read from priv.key file into parameters.
-	while (std::getline(key_file, line)) {
-		if (lines == 1) {
-			private_key_priv = line;
-		}
-		else {
-			private_key_priv += line;
-		}
-		lines++;
+	if (start_session(sock, client, key_pool, decrypted_aes_key, ticket) == FAILURE) {
+		return;
 	}
 
-	if (private_key_priv.length() == 0 || private_key_priv != private_key_me) {
-		throw std::invalid_argument("Error: priv.key file contains invalid data.");
+	int op_success;
+	if (!stdin_name.empty()) {
+		op_success = upload_stream(sock, client, key_pool, decrypted_aes_key, ticket, stream_reader(std::cin), stdin_name);
 	}
-
-	// Get id in form of boost::uuids::uuid and set the client's name and uuid.
-	UUID id = getUuidFromString(client_id);
-	client.setName(client_name);
-	client.setUuid(id);
-
-	// Close the file and return the private key (encoded in base64).
-	info_file.close();
-	return private_key_me;
-}
-
-// This method receives the client's name, id, and private key, writes them to me.info and writes the private key to priv.key as well.
-static void save_to_files(std::string name, UUID uuid, std::string priv_key) {
-	// Saving id and key into wanted formats, saving paths for both files and opening the streams.
-	std::string id = boost::uuids::to_string(uuid);
-	id.erase(std::remove(id.begin(), id.end(), '-'), id.end()); // Remove '-' from the string.
-
-	// Encode the private key to base64 and open files.
-	std::string base64PrivKey = Base64Wrapper::encode(priv_key);
-	std::string path_info = EXE_DIR_FILE_PATH("me.info");
-	std::string path_key = EXE_DIR_FILE_PATH("priv.key");
-	std::ofstream info_file(path_info), key_file(path_key);
-
-	if (!info_file.is_open()) {
-		throw std::runtime_error("Error opening the 'me.info' file, aborting program.");
+	else if (!batch_file.empty()) {
+		WorkStealingPool pool(workers);
+		op_success = upload_files(sock, client, key_pool, decrypted_aes_key, ticket, read_batch(batch_file), pool);
+		pool.logStats();
 	}
-	if (!key_file.is_open()) {
-		throw std::runtime_error("Error opening the 'priv.key' file, aborting program.");
+	else {
+		op_success = upload_file(sock, client, key_pool, decrypted_aes_key, ticket, client.getFilePath());
+	}
+	if (op_success != FAILURE) {
+		LOG_INFO("done!");
 	}
-
-	// Writing to both files.
-	info_file << name << std::endl << id << std::endl << base64PrivKey << std::endl;
-	key_file << base64PrivKey << std::endl;
-	// Closing the streams.
-	info_file.close();
-	key_file.close();
 }
 
-// This method runs the client's program - sends it's requests and gets responses.
-static void run_client(tcp::socket &sock, Client& client) {
-	int op_success;
-	std::string private_key, decrypted_aes_key;
-
-	// If me.info does not exist, send Registration request.
-	if (!std::filesystem::exists(EXE_DIR_FILE_PATH("me.info"))) {
-		Registration registration(client.getUuid(), Codes::REGISTRATION_C, PayloadSize::REGISTRATION_P, client.getName().c_str());
-		op_success = registration.run(sock);
-
-		if (op_success == FAILURE) {
-			FATAL_MESSAGE_RETURN("Registration");
+/*
+	The client runs once - uploading the file in transfer.info, unless started with the '--daemon' argument.
+	In daemon mode the client keeps a warm connection to the server, and uploads the files put into the spool directory.
+	With the '--trace=<file>' argument the client times its phases, writes them into the file as a Chrome trace, and prints a summary.
+	With the '--metrics=<file>' argument the client writes its counters into the file, in the Prometheus text format.
+	With the '--timeout=<ms>' argument the client waits at most that long for each of the server's responses (0 waits forever).
+	With the '--stdin=<name>' argument the client uploads what is piped into it (e.g. 'pg_dump | client --stdin=dump.sql') under
+	the given name, instead of the file in transfer.info.
+	With the '--batch=<file>' argument the client uploads the files listed in the file (one per line) instead, reading and
+	encrypting them on a work-stealing pool of '--workers=<n>' threads (one per hardware thread by default).
+	With the '--gateway=<port>' argument the client runs as a gateway instead - local clients connect to it on the given port,
+	and their requests are relayed to the server in transfer.info over '--upstreams=<n>' connections (GATEWAY_UPSTREAMS by default).
+	With '--multiplex' the gateway's connections are multiplexed, every client's requests are relayed on a stream of its own.
+*/
+int main(int argc, char* argv[]) {
+	bool daemon_mode = false, multiplex = false;
+	std::string trace_file, metrics_file, stdin_name, batch_file;
+	size_t workers = 0, upstreams = GATEWAY_UPSTREAMS;
+	unsigned short gateway_port = 0;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--daemon") {
+			daemon_mode = true;
 		}
-
-		// Set client's new UUID.
-		client.setUuid(registration.getUuid());
-		// Create RSA pair, save fields data into me.info and prev.key files, and send a SendingPublicKey request.
-		RSAPrivateWrapper prevKeyWrapper;
-		std::string public_key = prevKeyWrapper.getPublicKey();
-
-		private_key = prevKeyWrapper.getPrivateKey();
-		save_to_files(client.getName(), client.getUuid(), private_key);
-		SendingPublicKey sending_pub_key(client.getUuid(), Codes::SENDING_PUBLIC_KEY_C, PayloadSize::SENDING_PUBLIC_KEY_P, client.getName().c_str(), public_key);
-		op_success = sending_pub_key.run(sock);
-
-		if (op_success == FAILURE) {
-			FATAL_MESSAGE_RETURN("Sending Public Key");
+		else if (arg.rfind("--trace=", 0) == 0 && arg.size() > strlen("--trace=")) {
+			trace_file = arg.substr(strlen("--trace="));
+			enable_tracing();
 		}
-
-		// Get the encrypted AES key and decrypt it.
-		std::string encrypted_aes_key = sending_pub_key.getEncryptedAesKey();
-		decrypted_aes_key = prevKeyWrapper.decrypt(encrypted_aes_key);
-	}
-	else { // If me.info does exist, read id and send reconnection request.
-		// Read the fields from the client.
-		std::string key_base64 = read_from_files(client);
-
-		// Send Reconnection request to the server.
-		Reconnection reconnection(client.getUuid(), Codes::RECONNECTION_C, PayloadSize::RECONNECTION_P, client.getName().c_str());
-		op_success = reconnection.run(sock);
-
-		if (op_success == FAILURE) { // Request failed.
-			FATAL_MESSAGE_RETURN("Reconnection");
+		else if (arg.rfind("--metrics=", 0) == 0 && arg.size() > strlen("--metrics=")) {
+			metrics_file = arg.substr(strlen("--metrics="));
 		}
-		else if (op_success == SPECIAL) { // Registration succeded instead of Reconnection.
-			// Set client's new UUID.
-			client.setUuid(reconnection.getUuid());
-			// Create RSA pair, save fields data into me.info and prev.key files, and send a SendingPublicKey request.
-			RSAPrivateWrapper prevKeyWrapper;
-			std::string public_key = prevKeyWrapper.getPublicKey();
-			private_key = prevKeyWrapper.getPrivateKey();
-			save_to_files(client.getName(), client.getUuid(), private_key);
-			SendingPublicKey sending_pub_key(client.getUuid(), Codes::SENDING_PUBLIC_KEY_C, PayloadSize::SENDING_PUBLIC_KEY_P, client.getName().c_str(), public_key);
-			op_success = sending_pub_key.run(sock);
-
-			if (op_success == FAILURE) {
-				FATAL_MESSAGE_RETURN("Sending Public Key");
-			}
-
-			// Get the encrypted AES key and decrypt it.
-			std::string encrypted_aes_key = sending_pub_key.getEncryptedAesKey();
-			decrypted_aes_key = prevKeyWrapper.decrypt(encrypted_aes_key);
+		else if (arg.rfind("--timeout=", 0) == 0 && is_integer(arg.substr(strlen("--timeout=")))) {
+			RetryPolicy policy = retry_policy();
+			policy.timeout = std::chrono::milliseconds(std::stoll(arg.substr(strlen("--timeout="))));
+			set_retry_policy(policy);
 		}
-		else { // Reconnection succeeded.
-			// Decode the private key and create the decryptor.
-			private_key = Base64Wrapper::decode(key_base64);
-			RSAPrivateWrapper prevKeyWrapper(private_key);
-
-			// Get the encrypted AES key and decrypt it.
-			std::string encrypted_aes_key = reconnection.getEncryptedAesKey();
-			decrypted_aes_key = prevKeyWrapper.decrypt(encrypted_aes_key);
+		else if (arg.rfind("--stdin=", 0) == 0 && arg.size() > strlen("--stdin=")) {
+			stdin_name = arg.substr(strlen("--stdin="));
 		}
-	}
-
-	AESWrapper aesKeyWrapper(reinterpret_cast<const unsigned char *>(decrypted_aes_key.c_str()), static_cast<unsigned int>(decrypted_aes_key.size()));
-	int file_error_cnt = 0, times_crc_sent = 0;
-	while (file_error_cnt != MAX_REQUEST_FAILS && times_crc_sent != MAX_INVALID_CRC) {
-		// Get the file's content, save the encrypted content and save the sizes of both.
-		std::string content = fileToCharArray(client.getFilePath());
-		std::string encrypted_content = aesKeyWrapper.encrypt(content.c_str(), static_cast<unsigned int>(content.size()));
-
-		uint32_t content_size = static_cast<uint32_t>(encrypted_content.length());
-		uint32_t orig_size = static_cast<uint32_t>(content.size());
-
-		// Save the total packets and send the Sending File request to the server.
-		uint16_t total_packs = TOTAL_PACKETS(content_size);
-
-		SendingFile sendingFile(client.getUuid(), Codes::SENDING_FILE_C, PayloadSize::SENDING_FILE_P, content_size, orig_size, total_packs, client.getFilePath().c_str(), encrypted_content);
-		op_success = sendingFile.run(sock);
-		// If the sending file request did not succeed, add 1 to sending file error counter and continue the loop.
-		if (op_success == FAILURE) {
-			file_error_cnt++;
-			continue;
+		else if (arg.rfind("--batch=", 0) == 0 && arg.size() > strlen("--batch=")) {
+			batch_file = arg.substr(strlen("--batch="));
 		}
-
-		// Get the cksum the server responded with.
-		unsigned long response_cksum = sendingFile.getCksum();
-		std::cout << "readfile func returns - " << readfile(EXE_DIR_FILE_PATH(client.getFilePath())) << std::endl;
-		unsigned long request_cksum = memcrc(content.c_str(), orig_size);
-
-		if (response_cksum == request_cksum) {
-			std::cout << "wohoo they're the same!\n";
-			break;
+		else if (arg.rfind("--workers=", 0) == 0 && is_integer(arg.substr(strlen("--workers=")))) {
+			workers = std::stoul(arg.substr(strlen("--workers=")));
 		}
-		
-		// If the crc given by the server is incorrect, send Sending Crc Again request - 901.
-		SendingCrcAgain sendingCrcAgain(client.getUuid(), Codes::SENDING_CRC_AGAIN_C, PayloadSize::SENDING_CRC_AGAIN_P, client.getFilePath().c_str());
-		sendingCrcAgain.run(sock);
-		
-		// If the sending crc request did not succeed, add 1 to times crc sent counter.
-		times_crc_sent++;
-	}
-	if (file_error_cnt == MAX_REQUEST_FAILS) { // If the Sending File request failed three times print fatal and return.
-		FATAL_MESSAGE_RETURN("Sending File");
-	}
-	else if (times_crc_sent == MAX_INVALID_CRC) { // If the CRC was invalid three times,
-		InvalidCrcDone invalid_crc_done(client.getUuid(), Codes::INVALID_CRC_DONE_C, PayloadSize::INVALID_CRC_DONE_P, client.getFilePath().c_str());
-		op_success = invalid_crc_done.run(sock);
-
-		if (op_success == FAILURE) {
-			FATAL_MESSAGE_RETURN("Invalid CRC for the fourth time");
+		else if (arg.rfind("--gateway=", 0) == 0 && is_integer(arg.substr(strlen("--gateway="))) &&
+			std::stoul(arg.substr(strlen("--gateway="))) > 0 && std::stoul(arg.substr(strlen("--gateway="))) <= 65535) {
+			gateway_port = static_cast<unsigned short>(std::stoul(arg.substr(strlen("--gateway="))));
 		}
-	}
-	else {
-		ValidCrc valid_crc(client.getUuid(), Codes::VALID_CRC_C, PayloadSize::VALID_CRC_P, client.getFilePath().c_str());
-		op_success = valid_crc.run(sock);
-
-		if (op_success == FAILURE) {
-			FATAL_MESSAGE_RETURN("Valid CRC");
+		else if (arg.rfind("--upstreams=", 0) == 0 && is_integer(arg.substr(strlen("--upstreams="))) && std::stoul(arg.substr(strlen("--upstreams="))) > 0) {
+			upstreams = std::stoul(arg.substr(strlen("--upstreams=")));
+		}
+		else if (arg == "--multiplex") {
+			multiplex = true;
+		}
+		else {
+			std::cerr << "Usage: " << argv[0] << " [--daemon] [--trace=<file>] [--metrics=<file>] [--timeout=<ms>] [--stdin=<name> | --batch=<file> [--workers=<n>] | --gateway=<port> [--upstreams=<n>] [--multiplex]]" << std::endl;
+			return 1;
 		}
 	}
-	std::cout << "done!\n";
-}
 
-int main() {
+	// Standard input is read as raw bytes, in large chunks.
+	if (!stdin_name.empty()) {
+		std::ios::sync_with_stdio(false);
+#ifdef _WIN32
+		_setmode(_fileno(stdin), _O_BINARY);
+#endif
+	}
 
 	try {
 		Client client = createClient();
+		// A new client using the RSA handshake will need an RSA pair after registering, start generating it before connecting to the server,
+		// otherwise the pool only starts generating RSA pairs once one is needed (the server rejected the ECDH handshake).
+		KeyPool key_pool(KEY_POOL_SIZE, PREFER_ECDH || std::filesystem::exists(EXE_DIR_FILE_PATH("me.info")));
+
+		if (gateway_port) {
+			Gateway gateway(client.getAddress(), client.getPort(), gateway_port, upstreams, multiplex);
+			gateway.run();
+			return 0;
+		}
+
+		if (daemon_mode) {
+			Daemon daemon(client, key_pool, SPOOL_DIR, trace_file, metrics_file);
+			daemon.run();
+			return 0;
+		}
 
 		boost::asio::io_context io_context;
 		tcp::socket sock(io_context);
-		tcp::resolver resolver(io_context);
-		boost::asio::connect(sock, resolver.resolve(client.getAddress(), client.getPort()));
+		{
+			TRACE_SPAN("connect");
+			tcp::resolver resolver(io_context);
+			connect_tuned(sock, resolver.resolve(client.getAddress(), client.getPort()));
+		}
 
-		run_client(sock, client);
+		run_client(sock, client, key_pool, stdin_name, batch_file, workers);
 	}
 	catch (std::exception& e) {
 		std::cerr << e.what() << std::endl;
 	}
 
+	if (!trace_file.empty()) {
+		if (!write_chrome_trace(trace_file)) {
+			std::cerr << "Error: cannot write the trace into " << trace_file << "." << std::endl;
+		}
+		log_flush();
+		print_trace_histograms(std::cout);
+	}
+	if (!metrics_file.empty() && !write_metrics_file(metrics_file)) {
+		std::cerr << "Error: cannot write the metrics into " << metrics_file << "." << std::endl;
+	}
+
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,167 @@
+#include "metrics.hpp"
+#include "utils.hpp"
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <sstream>
+
+namespace {
+	// The request codes the client sends, errors and failures are counted per code.
+	constexpr uint16_t REQUEST_CODES[] = {
+		Codes::REGISTRATION_C, Codes::SENDING_PUBLIC_KEY_C, Codes::RECONNECTION_C, Codes::SENDING_FILE_C,
+		Codes::SENDING_ECDH_KEY_C, Codes::ECDH_RECONNECTION_C, Codes::TICKET_RECONNECTION_C, Codes::SENDING_BUNDLE_C,
+		Codes::VALID_CRC_C, Codes::SENDING_CRC_AGAIN_C, Codes::INVALID_CRC_DONE_C, Codes::VALID_CRC_TICKET_C, Codes::CHECKED_TICKET_RECONNECTION_C
+	};
+	constexpr size_t REQUEST_TYPES = sizeof(REQUEST_CODES) / sizeof(REQUEST_CODES[0]);
+
+	// Upper bounds of the handshake duration histogram's buckets, in seconds (the last, +Inf bucket is implicit).
+	constexpr double HANDSHAKE_BUCKETS[] = { 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10 };
+	constexpr size_t HANDSHAKE_BUCKETS_AMOUNT = sizeof(HANDSHAKE_BUCKETS) / sizeof(HANDSHAKE_BUCKETS[0]);
+
+	const char* COUNTER_NAMES[COUNTERS_AMOUNT] = { "bytes_read_total", "bytes_encrypted_total", "packets_sent_total", "crc_mismatches_total", "uploads_skipped_total" };
+	const char* COUNTER_HELP[COUNTERS_AMOUNT] = {
+		"Bytes of files read from disk for uploading.",
+		"Bytes of file content encrypted.",
+		"File packets (requests 828 and 832) written to the socket.",
+		"Uploads whose CRC did not match the server's.",
+		"Uploads skipped, as the server already confirmed the file's unchanged content."
+	};
+	const std::string PREFIX = "finalproject_client_";
+
+	// A single thread's metrics, only written by that thread. Counts are not reset, so a shard outlives its thread.
+	struct MetricsShard {
+		std::atomic<uint64_t> counters[COUNTERS_AMOUNT];
+		std::atomic<uint64_t> request_errors[REQUEST_TYPES];
+		std::atomic<uint64_t> request_failures[REQUEST_TYPES];
+		std::atomic<uint64_t> handshake_buckets[HANDSHAKE_BUCKETS_AMOUNT + 1];
+		std::atomic<uint64_t> handshake_sum_us;
+	};
+
+	std::mutex shards_lock;
+	std::vector<std::unique_ptr<MetricsShard>> shards;
+
+	// This method returns the calling thread's shard, creating it (the only locked step) on the thread's first update.
+	MetricsShard& local_shard() {
+		thread_local MetricsShard* shard = [] {
+			std::lock_guard<std::mutex> lock(shards_lock);
+			shards.push_back(std::make_unique<MetricsShard>());
+			return shards.back().get();
+		}();
+		return *shard;
+	}
+
+	// This method adds to a value of the calling thread's shard.
+	void add(std::atomic<uint64_t>& value, uint64_t amount) {
+		value.fetch_add(amount, std::memory_order_relaxed);
+	}
+
+	// This method returns the index of a request code in REQUEST_CODES, or REQUEST_TYPES if it is not a request code.
+	size_t request_index(uint16_t code) {
+		for (size_t i = 0; i < REQUEST_TYPES; i++) {
+			if (REQUEST_CODES[i] == code) {
+				return i;
+			}
+		}
+		return REQUEST_TYPES;
+	}
+
+	// This method sums a value over all shards, the caller holds shards_lock.
+	template <typename Getter>
+	uint64_t sum(Getter getter) {
+		uint64_t total = 0;
+		for (const std::unique_ptr<MetricsShard>& shard : shards) {
+			total += getter(*shard).load(std::memory_order_relaxed);
+		}
+		return total;
+	}
+}
+
+void count_metric(Counter counter, uint64_t value) {
+	add(local_shard().counters[counter], value);
+}
+
+void count_request_error(uint16_t code) {
+	size_t index = request_index(code);
+	if (index != REQUEST_TYPES) {
+		add(local_shard().request_errors[index], 1);
+	}
+}
+
+void count_request_failure(uint16_t code) {
+	size_t index = request_index(code);
+	if (index != REQUEST_TYPES) {
+		add(local_shard().request_failures[index], 1);
+	}
+}
+
+void observe_handshake(double seconds) {
+	MetricsShard& shard = local_shard();
+	size_t bucket = 0;
+
+	while (bucket < HANDSHAKE_BUCKETS_AMOUNT && seconds > HANDSHAKE_BUCKETS[bucket]) {
+		bucket++;
+	}
+	add(shard.handshake_buckets[bucket], 1);
+	add(shard.handshake_sum_us, static_cast<uint64_t>(seconds * 1e6));
+}
+
+std::string metrics_text() {
+	std::ostringstream out;
+	std::lock_guard<std::mutex> lock(shards_lock);
+
+	for (size_t i = 0; i < COUNTERS_AMOUNT; i++) {
+		out << "# HELP " << PREFIX << COUNTER_NAMES[i] << " " << COUNTER_HELP[i] << "\n";
+		out << "# TYPE " << PREFIX << COUNTER_NAMES[i] << " counter\n";
+		out << PREFIX << COUNTER_NAMES[i] << " " << sum([i](MetricsShard& shard) -> std::atomic<uint64_t>& { return shard.counters[i]; }) << "\n";
+	}
+
+	out << "# HELP " << PREFIX << "request_errors_total Failed attempts of a request, each one is retried up to " << MAX_REQUEST_FAILS << " times.\n";
+	out << "# TYPE " << PREFIX << "request_errors_total counter\n";
+	for (size_t i = 0; i < REQUEST_TYPES; i++) {
+		out << PREFIX << "request_errors_total{code=\"" << REQUEST_CODES[i] << "\"} "
+			<< sum([i](MetricsShard& shard) -> std::atomic<uint64_t>& { return shard.request_errors[i]; }) << "\n";
+	}
+
+	out << "# HELP " << PREFIX << "request_failures_total Requests that failed after all their attempts.\n";
+	out << "# TYPE " << PREFIX << "request_failures_total counter\n";
+	for (size_t i = 0; i < REQUEST_TYPES; i++) {
+		out << PREFIX << "request_failures_total{code=\"" << REQUEST_CODES[i] << "\"} "
+			<< sum([i](MetricsShard& shard) -> std::atomic<uint64_t>& { return shard.request_failures[i]; }) << "\n";
+	}
+
+	// Prometheus histogram buckets are cumulative.
+	out << "# HELP " << PREFIX << "handshake_duration_seconds Duration of a full handshake with the server.\n";
+	out << "# TYPE " << PREFIX << "handshake_duration_seconds histogram\n";
+	uint64_t cumulative = 0;
+	for (size_t i = 0; i <= HANDSHAKE_BUCKETS_AMOUNT; i++) {
+		cumulative += sum([i](MetricsShard& shard) -> std::atomic<uint64_t>& { return shard.handshake_buckets[i]; });
+		out << PREFIX << "handshake_duration_seconds_bucket{le=\"";
+		if (i < HANDSHAKE_BUCKETS_AMOUNT) {
+			out << HANDSHAKE_BUCKETS[i];
+		}
+		else {
+			out << "+Inf";
+		}
+		out << "\"} " << cumulative << "\n";
+	}
+	out << PREFIX << "handshake_duration_seconds_sum " << sum([](MetricsShard& shard) -> std::atomic<uint64_t>& { return shard.handshake_sum_us; }) / 1e6 << "\n";
+	out << PREFIX << "handshake_duration_seconds_count " << cumulative << "\n";
+
+	return out.str();
+}
+
+bool write_metrics_file(std::string file_path) {
+	std::string temp_path = file_path + ".tmp";
+	{
+		std::ofstream out(temp_path);
+		if (!out.is_open()) {
+			return false;
+		}
+		out << metrics_text();
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(temp_path, file_path, ec);
+	return !ec;
+}
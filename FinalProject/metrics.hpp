@@ -0,0 +1,36 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <cstdint>
+
+/*
+	Counters and histograms of the client's work, exported in the Prometheus text format (for the node exporter's textfile collector).
+	Every thread updates its own shard with relaxed atomic increments - nothing is locked or shared on the upload path,
+	and the shards are only summed when the metrics are exported.
+*/
+
+// Enum used for distinguishing the client's counters.
+enum Counter: size_t {
+	BYTES_READ,
+	BYTES_ENCRYPTED,
+	PACKETS_SENT,
+	CRC_MISMATCHES,
+	UPLOADS_SKIPPED,
+	COUNTERS_AMOUNT
+};
+
+// This method adds the given value to a counter.
+void count_metric(Counter counter, uint64_t value = 1);
+// This method counts a failed attempt of the request with the given code (caught in its run method, and usually retried).
+void count_request_error(uint16_t code);
+// This method counts a request that failed for good - its run method returned FAILURE.
+void count_request_failure(uint16_t code);
+// This method records the duration of a full handshake with the server.
+void observe_handshake(double seconds);
+// This method returns all metrics in the Prometheus text exposition format.
+std::string metrics_text();
+// This method writes the metrics into the given file, replacing it at once so a scraper never reads half a file. Returns false on failure.
+bool write_metrics_file(std::string file_path);
+
+#endif
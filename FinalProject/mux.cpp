@@ -0,0 +1,300 @@
+#include "mux.hpp"
+
+MuxConnection::Stream::Stream(uint64_t credit) :
+	head_offset(0),
+	queued(0),
+	credit(credit),
+	closing(false),
+	close_sent(false),
+	remote_closed(false)
+{
+
+}
+
+MuxConnection::MuxConnection(boost::asio::io_context& io_context) :
+	sock(io_context),
+	window(0),
+	next_stream(1),
+	last_written(0),
+	failed(false),
+	stopping(false)
+{
+
+}
+
+MuxConnection::~MuxConnection() {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	writable.notify_all();
+
+	// The writer writes the frames it can before it stops, the reader stops once the connection is shut down.
+	if (writer.joinable()) {
+		writer.join();
+	}
+	boost::system::error_code ec;
+	sock.shutdown(tcp::socket::shutdown_both, ec);
+	if (reader.joinable()) {
+		reader.join();
+	}
+	sock.close(ec);
+}
+
+void MuxConnection::connect(const tcp::resolver::results_type& endpoints) {
+	TRACE_SPAN("MuxConnection::connect");
+	connect_tuned(sock, endpoints);
+	sock.set_option(boost::asio::socket_base::keep_alive(true));
+	// Priorities only order the frames not written yet, the frames the system already queued are sent first whatever their priority.
+	limit_unsent_data(sock, MUX_UNSENT_LIMIT);
+
+	Multiplex multiplex(NIL_UUID, Codes::MULTIPLEX_C, PayloadSize::MULTIPLEX_P);
+	if (multiplex.run(sock) != SUCCESS || multiplex.getWindow() == 0) {
+		throw std::runtime_error("The server did not accept the Multiplex request.");
+	}
+	window = multiplex.getWindow();
+	LOG_DEBUG("Multiplexed connection opened, every stream starts with " << window << " bytes of credit.");
+
+	reader = std::thread(&MuxConnection::read_frames, this);
+	writer = std::thread(&MuxConnection::write_frames, this);
+}
+
+bool MuxConnection::isOpen() {
+	std::lock_guard<std::mutex> guard(lock);
+	return !failed;
+}
+
+uint32_t MuxConnection::openStream() {
+	std::lock_guard<std::mutex> guard(lock);
+	if (failed) {
+		throw std::runtime_error("The multiplexed connection failed.");
+	}
+	uint32_t stream = next_stream++;
+	streams.emplace(stream, Stream(window));
+	return stream;
+}
+
+void MuxConnection::write(uint32_t stream, const uint8_t* data, size_t size, MuxPriority priority) {
+	std::unique_lock<std::mutex> guard(lock);
+	std::map<uint32_t, Stream>::iterator it;
+	drained.wait(guard, [&] {
+		it = streams.find(stream);
+		return failed || it == streams.end() || it->second.closing || it->second.remote_closed || it->second.queued < MUX_STREAM_QUEUE_LIMIT;
+	});
+	if (failed || it == streams.end() || it->second.closing || it->second.remote_closed) {
+		throw std::runtime_error("The stream was closed.");
+	}
+
+	it->second.outgoing.emplace_back(priority, std::vector<uint8_t>(data, data + size));
+	it->second.queued += size;
+	writable.notify_one();
+}
+
+void MuxConnection::read(uint32_t stream, uint8_t* data, size_t size, std::chrono::milliseconds timeout) {
+	std::unique_lock<std::mutex> guard(lock);
+	std::map<uint32_t, Stream>::iterator it;
+	auto ready = [&] {
+		it = streams.find(stream);
+		return failed || it == streams.end() || it->second.incoming.size() >= size || it->second.remote_closed;
+	};
+	if (timeout.count() > 0) {
+		if (!readable.wait_for(guard, timeout, ready)) {
+			throw ResponseTimeout();
+		}
+	}
+	else {
+		readable.wait(guard, ready);
+	}
+
+	if (it == streams.end() || it->second.incoming.size() < size) {
+		throw std::runtime_error("The stream was closed.");
+	}
+	std::copy(it->second.incoming.begin(), it->second.incoming.begin() + size, data);
+	it->second.incoming.erase(it->second.incoming.begin(), it->second.incoming.begin() + size);
+}
+
+void MuxConnection::closeStream(uint32_t stream) {
+	std::lock_guard<std::mutex> guard(lock);
+	auto it = streams.find(stream);
+	if (it == streams.end()) {
+		return;
+	}
+	// A failed connection writes no more frames, the stream is forgotten at once.
+	if (failed) {
+		streams.erase(it);
+		return;
+	}
+	it->second.closing = true;
+	writable.notify_one();
+}
+
+void MuxConnection::fail() {
+	failed = true;
+	writable.notify_all();
+	drained.notify_all();
+	readable.notify_all();
+}
+
+bool MuxConnection::take_frames(std::vector<uint8_t>& buffer) {
+	while (buffer.size() < MUX_WRITE_SIZE && !streams.empty()) {
+		// Find the stream of the best priority that can write, starting after the stream written last so equal streams take turns.
+		auto start = streams.upper_bound(last_written);
+		auto chosen = streams.end();
+		MuxPriority best = MUX_BULK;
+		for (size_t i = 0; i < streams.size(); i++, start++) {
+			if (start == streams.end()) {
+				start = streams.begin();
+			}
+			Stream& candidate = start->second;
+			MuxPriority priority;
+			if (!candidate.outgoing.empty() && candidate.credit > 0) {
+				priority = candidate.outgoing.front().first;
+			}
+			// A Close frame needs no credit.
+			else if (candidate.outgoing.empty() && candidate.closing && !candidate.close_sent) {
+				priority = MUX_CONTROL;
+			}
+			else {
+				continue;
+			}
+			if (chosen == streams.end() || priority < best) {
+				chosen = start;
+				best = priority;
+			}
+		}
+		if (chosen == streams.end()) {
+			break;
+		}
+
+		uint32_t id = chosen->first;
+		Stream& stream = chosen->second;
+		last_written = id;
+
+		size_t offset = buffer.size();
+		buffer.resize(offset + MuxFrameHeaderLayout::size);
+		MuxFrameHeaderLayout::put<0>(buffer.data() + offset, id);
+
+		if (stream.outgoing.empty()) {
+			MuxFrameHeaderLayout::put<1>(buffer.data() + offset, static_cast<uint8_t>(MUX_CLOSE));
+			MuxFrameHeaderLayout::put<2>(buffer.data() + offset, static_cast<uint32_t>(0));
+			stream.close_sent = true;
+			if (stream.remote_closed) {
+				streams.erase(chosen);
+			}
+			continue;
+		}
+
+		// The frame coalesces the stream's queued writes, up to the frame size and the stream's credit.
+		size_t length = static_cast<size_t>(std::min<uint64_t>({ static_cast<uint64_t>(MUX_FRAME_SIZE), stream.credit, static_cast<uint64_t>(stream.queued) }));
+		MuxFrameHeaderLayout::put<1>(buffer.data() + offset, static_cast<uint8_t>(MUX_DATA));
+		MuxFrameHeaderLayout::put<2>(buffer.data() + offset, static_cast<uint32_t>(length));
+
+		size_t taken = 0;
+		while (taken < length) {
+			std::vector<uint8_t>& head = stream.outgoing.front().second;
+			size_t amt = MIN(length - taken, head.size() - stream.head_offset);
+			buffer.insert(buffer.end(), head.begin() + stream.head_offset, head.begin() + stream.head_offset + amt);
+			taken += amt;
+			stream.head_offset += amt;
+			if (stream.head_offset == head.size()) {
+				stream.outgoing.pop_front();
+				stream.head_offset = 0;
+			}
+		}
+		stream.queued -= length;
+		stream.credit -= length;
+	}
+	return !buffer.empty();
+}
+
+void MuxConnection::write_frames() {
+	std::vector<uint8_t> buffer;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			while (!failed && !take_frames(buffer)) {
+				if (stopping) {
+					return;
+				}
+				writable.wait(guard);
+			}
+			if (failed) {
+				return;
+			}
+		}
+		drained.notify_all();
+
+		try {
+			boost::asio::write(sock, boost::asio::buffer(buffer));
+		}
+		catch (std::exception& e) {
+			std::lock_guard<std::mutex> guard(lock);
+			if (!stopping) {
+				LOG_ERROR("Multiplexed connection: " << e.what());
+			}
+			fail();
+			return;
+		}
+		buffer.clear();
+	}
+}
+
+void MuxConnection::read_frames() {
+	uint8_t header[MuxFrameHeaderLayout::size];
+	std::vector<uint8_t> data;
+
+	try {
+		while (true) {
+			boost::asio::read(sock, boost::asio::buffer(header));
+			uint32_t id = MuxFrameHeaderLayout::get<0>(header);
+			uint8_t type = MuxFrameHeaderLayout::get<1>(header);
+			uint32_t length = MuxFrameHeaderLayout::get<2>(header);
+
+			if (type == MUX_DATA) {
+				// The server's frames are responses, none is larger than a stream may queue.
+				if (length > MUX_STREAM_QUEUE_LIMIT) {
+					throw std::invalid_argument("server sent a frame larger than any response.");
+				}
+				data.resize(length);
+				boost::asio::read(sock, boost::asio::buffer(data));
+
+				std::lock_guard<std::mutex> guard(lock);
+				auto it = streams.find(id);
+				if (it != streams.end()) {
+					it->second.incoming.insert(it->second.incoming.end(), data.begin(), data.end());
+					readable.notify_all();
+				}
+			}
+			else if (type == MUX_CREDIT) {
+				std::lock_guard<std::mutex> guard(lock);
+				auto it = streams.find(id);
+				if (it != streams.end()) {
+					it->second.credit += length;
+					writable.notify_one();
+				}
+			}
+			else if (type == MUX_CLOSE) {
+				std::lock_guard<std::mutex> guard(lock);
+				auto it = streams.find(id);
+				if (it != streams.end()) {
+					it->second.remote_closed = true;
+					if (it->second.close_sent) {
+						streams.erase(it);
+					}
+					readable.notify_all();
+					drained.notify_all();
+				}
+			}
+			else {
+				throw std::invalid_argument("server sent an unknown frame.");
+			}
+		}
+	}
+	catch (std::exception& e) {
+		std::lock_guard<std::mutex> guard(lock);
+		if (!stopping) {
+			LOG_ERROR("Multiplexed connection: " << e.what());
+		}
+		fail();
+	}
+}
@@ -0,0 +1,104 @@
+#ifndef MUX_H
+#define MUX_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <map>
+#include <deque>
+#include "request.hpp"
+#include "sockopt.hpp"
+
+// Every frame starts with the stream's id, the frame's type and the length of the data that follows it (or the credit granted).
+using MuxFrameHeaderLayout = Layout<Number<uint32_t>, Number<uint8_t>, Number<uint32_t>>;
+
+enum MuxFrame : uint8_t {
+	MUX_DATA = 0,
+	// Sent by the server only, the length is the amount of bytes the stream may send on top of its credit.
+	MUX_CREDIT = 1,
+	MUX_CLOSE = 2
+};
+
+// The data of a stream is written in order, a stream's priority is the priority of the data at the head of its queue.
+enum MuxPriority : uint8_t {
+	MUX_CONTROL = 0,
+	MUX_BULK = 1
+};
+
+/*
+	A connection to the server multiplexing many streams, each standing in for a connection of its own - the server handles
+	the requests of every stream like a connection's, on a thread of their own (see multiplexing.py).
+	A stream's data is written in frames of up to MUX_FRAME_SIZE bytes, the frames of different streams interleave: the
+	writer takes the next frame from the stream of the best priority, round robin among streams of the same priority, so a
+	small control request of one stream isn't written behind the megabytes of another stream's file packets. For that to hold
+	on the wire too, the writer writes MUX_WRITE_SIZE bytes at a time and the system queues no more than about MUX_UNSENT_LIMIT
+	bytes of them unsent (see limit_unsent_data) - a control frame waits behind those at most.
+	A stream may only write as many bytes as it has credit for - every stream starts with the window of the Multiplex
+	Accepted response, and the server grants credit back as its handler takes the bytes. A stream whose handler is busy
+	stops its own bulk data without holding up the other streams of the connection.
+	Writes are queued and written by the writer thread, a write only blocks while the stream has more than
+	MUX_STREAM_QUEUE_LIMIT bytes queued. Frames are read by the reader thread, into the stream they belong to.
+*/
+class MuxConnection {
+	struct Stream {
+		// The data written and not framed yet, in order, with the priority it was written with.
+		std::deque<std::pair<MuxPriority, std::vector<uint8_t>>> outgoing;
+		size_t head_offset;
+		size_t queued;
+		uint64_t credit;
+		std::deque<uint8_t> incoming;
+		// Whether the stream was closed locally (its Close frame is written once its data was), and whether it was written.
+		bool closing;
+		bool close_sent;
+		bool remote_closed;
+
+		Stream(uint64_t credit);
+	};
+
+	tcp::socket sock;
+	uint32_t window;
+	std::mutex lock;
+	// Notified when a stream has data to frame or more credit, when data was framed, and when data arrived.
+	std::condition_variable writable;
+	std::condition_variable drained;
+	std::condition_variable readable;
+	std::map<uint32_t, Stream> streams;
+	uint32_t next_stream;
+	// The stream the writer took the last frame from, the next frame of the same priority is taken from the one after it.
+	uint32_t last_written;
+	bool failed;
+	bool stopping;
+	std::thread reader;
+	std::thread writer;
+
+	// This method reads frames into their streams, until the connection fails or is closed.
+	void read_frames();
+	// This method writes the streams' frames, until the connection fails or is closed.
+	void write_frames();
+	// This method takes the next frames to write into the buffer, up to MUX_WRITE_SIZE bytes, returns false if there are none (the lock is held).
+	bool take_frames(std::vector<uint8_t>& buffer);
+	// This method marks the connection as failed and wakes everyone waiting on it (the lock is held).
+	void fail();
+
+	public:
+		MuxConnection(boost::asio::io_context& io_context);
+		MuxConnection(const MuxConnection&) = delete;
+		MuxConnection& operator=(const MuxConnection&) = delete;
+		~MuxConnection();
+
+		// This method connects to the server and runs the Multiplex request, throws if the server doesn't accept it.
+		void connect(const tcp::resolver::results_type& endpoints);
+		// This method returns false once the connection failed.
+		bool isOpen();
+
+		// This method opens a new stream and returns its id, the server learns of it with its first data.
+		uint32_t openStream();
+		// This method queues the data to be written on the stream with the given priority, throws if the stream or the connection was closed.
+		void write(uint32_t stream, const uint8_t* data, size_t size, MuxPriority priority);
+		// This method reads exactly size bytes from the stream, throws ResponseTimeout if they don't arrive within the timeout (0 waits forever), and throws if the stream is closed first.
+		void read(uint32_t stream, uint8_t* data, size_t size, std::chrono::milliseconds timeout);
+		// This method closes the stream, once its queued data was written.
+		void closeStream(uint32_t stream);
+};
+
+#endif
@@ -1,4 +1,147 @@
 #include "request.hpp"
+#include "sockopt.hpp"
+#include <random>
+#include <thread>
+#include <mutex>
+
+static std::mutex retry_policy_mutex;
+static RetryPolicy current_retry_policy = {
+	MAX_REQUEST_FAILS,
+	std::chrono::milliseconds(REQUEST_TIMEOUT_MS),
+	std::chrono::milliseconds(RETRY_BASE_BACKOFF_MS),
+	std::chrono::milliseconds(RETRY_MAX_BACKOFF_MS)
+};
+
+void set_retry_policy(const RetryPolicy& policy) {
+	std::lock_guard<std::mutex> lock(retry_policy_mutex);
+	current_retry_policy = policy;
+}
+
+RetryPolicy retry_policy() {
+	std::lock_guard<std::mutex> lock(retry_policy_mutex);
+	return current_retry_policy;
+}
+
+void back_off(const RetryPolicy& policy, int attempt) {
+	// The backoff doubles with every attempt up to the maximum, the actual wait is random so clients that failed together don't retry together.
+	long long ceiling = policy.base_backoff.count() << std::min(attempt - 1, 20);
+	ceiling = std::min(ceiling, (long long)policy.max_backoff.count());
+	if (ceiling <= 0) {
+		return;
+	}
+
+	thread_local std::mt19937_64 generator(std::random_device{}());
+	std::uniform_int_distribution<long long> distribution(0, ceiling);
+	std::this_thread::sleep_for(std::chrono::milliseconds(distribution(generator)));
+}
+
+bool closed_by_server(const boost::system::error_code& ec) {
+	return ec == boost::asio::error::eof || ec == boost::asio::error::connection_reset || ec == boost::asio::error::broken_pipe ||
+		ec == boost::asio::error::connection_aborted;
+}
+
+std::chrono::milliseconds content_response_timeout(std::chrono::milliseconds timeout, uint64_t content_size) {
+	if (timeout.count() <= 0) {
+		return timeout;
+	}
+	return timeout + std::chrono::milliseconds(content_size / SERVER_CONTENT_BYTES_PER_MS);
+}
+
+uint8_t* Pipeline::append(size_t size) {
+	size_t offset = buffer.size();
+	buffer.resize(offset + size);
+	return buffer.data() + offset;
+}
+
+void Pipeline::push(const std::vector<uint8_t>& request) {
+	buffer.insert(buffer.end(), request.begin(), request.end());
+}
+
+void Pipeline::push(const std::vector<uint8_t>& request, AwaitedResponse response) {
+	push(request);
+	awaited.push_back(std::move(response));
+}
+
+void Pipeline::flush(tcp::socket& sock) {
+	if (buffer.empty()) {
+		return;
+	}
+
+	try {
+		boost::asio::write(sock, boost::asio::buffer(buffer));
+	}
+	catch (...) {
+		buffer.clear();
+		throw;
+	}
+	// Keep the buffer's capacity, the next requests are packed into it.
+	buffer.clear();
+}
+
+void Pipeline::receive_awaited(tcp::socket& sock) {
+	while (!awaited.empty()) {
+		AwaitedResponse next = std::move(awaited.front());
+		awaited.pop_front();
+
+		try {
+			Response response;
+			response.receive(sock, retry_policy().timeout);
+			// A queued request is written once, its special response (if it has one) is an error like any other.
+			if (check_response(response, *next.spec, next.uuid) != SUCCESS) {
+				throw std::invalid_argument("server responded with an error.");
+			}
+			next.on_success(response.getPayload());
+		}
+		catch (...) {
+			count_request_error(next.code);
+			count_request_failure(next.code);
+			awaited.clear();
+			throw;
+		}
+	}
+}
+
+size_t Pipeline::size() const {
+	return buffer.size();
+}
+
+void Pipeline::clear() {
+	buffer.clear();
+	awaited.clear();
+}
+
+int check_response(const Response& response, const Exchange& spec, const UUID& uuid) {
+	uint16_t response_code = response.getCode();
+	uint32_t response_payload_size = response.getPayloadSize();
+
+	if (spec.special_code != 0 && response_code == spec.special_code && response_payload_size == spec.special_payload_size) {
+		return SPECIAL;
+	}
+
+	// If the code is not success, or the payload_size for the code is not the same as the size received in the header, print error.
+	if (response_code != spec.success_code || response_payload_size != spec.success_payload_size) {
+		throw std::invalid_argument("server responded with an error.");
+	}
+
+	// Check that the id in the payload is the correct client id.
+	if (spec.checks_client_id && !ids_match(ClientIdLayout::get<0>(response.getPayload()), uuid)) {
+		throw std::invalid_argument("server responded with an error.");
+	}
+
+	return SUCCESS;
+}
+
+// The exchanges of the requests that expect a response (see Request::exchange).
+constexpr Exchange REGISTRATION_EXCHANGE = { Codes::REGISTRATION_SUCCEEDED_C, PayloadSize::REGISTRATION_SUCCEEDED_P, false, 0, 0 };
+constexpr Exchange SENDING_PUBLIC_KEY_EXCHANGE = { Codes::PUBLIC_KEY_RECEIVED_C, PayloadSize::PUBLIC_KEY_RECEIVED_P, true, 0, 0 };
+constexpr Exchange RECONNECTION_EXCHANGE = { Codes::RECONNECTION_SUCCEEDED_C, PayloadSize::RECONNECTION_SUCCEEDED_P, true, Codes::RECONNECTION_FAILED_C, PayloadSize::RECONNECTION_FAILED_P };
+constexpr Exchange SENDING_ECDH_KEY_EXCHANGE = { Codes::ECDH_KEY_RECEIVED_C, PayloadSize::ECDH_KEY_RECEIVED_P, true, 0, 0, true };
+constexpr Exchange ECDH_RECONNECTION_EXCHANGE = { Codes::ECDH_RECONNECTION_SUCCEEDED_C, PayloadSize::ECDH_RECONNECTION_SUCCEEDED_P, true, Codes::RECONNECTION_FAILED_C, PayloadSize::RECONNECTION_FAILED_P };
+constexpr Exchange VALID_CRC_EXCHANGE = { Codes::MESSAGE_RECEIVED_C, PayloadSize::MESSAGE_RECEIVED_P, true, 0, 0 };
+constexpr Exchange VALID_CRC_TICKET_EXCHANGE = { Codes::MESSAGE_RECEIVED_TICKET_C, PayloadSize::MESSAGE_RECEIVED_TICKET_P, true, 0, 0, true };
+constexpr Exchange INVALID_CRC_DONE_EXCHANGE = { Codes::MESSAGE_RECEIVED_C, PayloadSize::MESSAGE_RECEIVED_P, true, 0, 0 };
+constexpr Exchange CHECKED_TICKET_RECONNECTION_EXCHANGE = { Codes::TICKET_ACCEPTED_C, PayloadSize::TICKET_ACCEPTED_P, false, Codes::TICKET_REJECTED_C, PayloadSize::TICKET_REJECTED_P };
+constexpr Exchange MULTIPLEX_EXCHANGE = { Codes::MULTIPLEX_ACCEPTED_C, PayloadSize::MULTIPLEX_ACCEPTED_P, false, 0, 0 };
 
 Request::Request(UUID uuid, uint16_t code, uint32_t payload_size) :
 	uuid(uuid),
@@ -29,24 +172,19 @@ uint32_t Request::getPayloadSize() const {
 */
 std::vector<uint8_t> Request::pack_header() const {
 	std::vector<uint8_t> req(REQUEST_HEADER_SIZE + payload_size);
-
-	// Saving the numeric types that are of size larger than one byte in little endian order.
-	uint16_t code_le = boost::endian::native_to_little(code);
-	uint32_t payload_size_le = boost::endian::native_to_little(payload_size);
-
-	// Saving the bytes in little endian order as a byte array.
-	uint8_t *code_le_ptr = reinterpret_cast<uint8_t *>(&code_le);
-	uint8_t *payload_size_le_ptr = reinterpret_cast<uint8_t *>(&payload_size_le);
-
-	// Adding all fields to the vector.
-	std::copy(uuid.begin(), uuid.end(), req.begin());
-	req[sizeof(uuid)] = version;
-	std::copy(code_le_ptr, code_le_ptr + sizeof(code_le), req.begin() + sizeof(uuid) + sizeof(version));
-	std::copy(payload_size_le_ptr, payload_size_le_ptr + sizeof(payload_size_le), req.begin() + sizeof(uuid) + sizeof(version) + sizeof(code));
+	pack_header(req.data());
 
 	return req;
 }
 
+void Request::pack_header(uint8_t* req) const {
+	// Adding all fields to the buffer at their fixed offsets (see wire.hpp).
+	RequestHeaderLayout::put<0>(req, uuid);
+	RequestHeaderLayout::put<1>(req, version);
+	RequestHeaderLayout::put<2>(req, code);
+	RequestHeaderLayout::put<3>(req, payload_size);
+}
+
 Registration::Registration(UUID uuid, uint16_t code, uint32_t payload_size, const char name[]):
 	Request(uuid, code, payload_size) 
 {
@@ -61,48 +199,12 @@ Registration::Registration(UUID uuid, uint16_t code, uint32_t payload_size, cons
 }
 
 int Registration::run(tcp::socket &sock) {
-	// Pack request fields into vector and initialize parameter times_sent to 0.
-	int times_sent = 0;
-	std::vector<uint8_t> request = pack_registration_request();
-
-	while (times_sent != MAX_REQUEST_FAILS) {
-		try {
-			// Send the request to the server via the provided socket.
-			size_t l = boost::asio::write(sock, boost::asio::buffer(request));
-			
-			// Receive header from the server, get response code and payload_size
-			std::vector<uint8_t> response_header(RESPONSE_HEADER_SIZE);
-			boost::asio::read(sock, boost::asio::buffer(response_header, RESPONSE_HEADER_SIZE));
-			uint16_t response_code = get_response_code(response_header);
-			uint32_t response_payload_size = get_response_payload_size(response_header);
-
-			// Receive payload from the server, save it's length in a parameter length.
-			std::vector<uint8_t> response_payload(response_payload_size);
-			size_t length = boost::asio::read(sock, boost::asio::buffer(response_payload, response_payload_size));
-
-			// If the code is not success, the payload_size for the code is not the same as the size received in the header, or the length of the payload is not the wanted length, print error.
-			if (response_code != Codes::REGISTRATION_SUCCEEDED_C || response_payload_size != PayloadSize::REGISTRATION_SUCCEEDED_P || length != response_payload_size) {
-				throw std::invalid_argument("server responded with an error.");
-			}
-
-			// The Registration succeeded, set the uuid to the id the server responded with.
-			std::copy(response_payload.begin(), response_payload.end(), uuid.begin());
-			// If this code is reached, there was no error and the Registration was successful, so we break from the loop.
-			break;
-		}
-		catch (std::exception& e) {
-			std::cerr << e.what() << std::endl;
-		}
-		// Increment by 1 each iteration.
-		times_sent++;
-	}
-
-	// If reached 3, return FAILURE.
-	if (times_sent == MAX_REQUEST_FAILS) {
-		return FAILURE;
-	}
-	// If the client succeeded, return SUCCESS.
-	return SUCCESS;
+	TRACE_SPAN("Registration::run");
+	return exchange(sock, pack_registration_request(), REGISTRATION_EXCHANGE, [this](ByteView payload) {
+		// The Registration succeeded, set the uuid to the id the server responded with.
+		ByteView response_id = ClientIdLayout::get<0>(payload);
+		std::copy(response_id.begin(), response_id.end(), uuid.begin());
+	});
 }
 
 /*
@@ -112,7 +214,7 @@ int Registration::run(tcp::socket &sock) {
 std::vector<uint8_t> Registration::pack_registration_request() const {
 	std::vector<uint8_t> req = pack_header();
 	
-	std::copy(name, name + sizeof(name), req.begin() + REQUEST_HEADER_SIZE);
+	RegistrationLayout::put<0>(req.data() + REQUEST_HEADER_SIZE, name);
 
 	return req;
 }
@@ -146,54 +248,12 @@ std::string SendingPublicKey::getEncryptedAesKey() const {
 }
 
 int SendingPublicKey::run(tcp::socket& sock) {
-	// Pack request fields into vector and initialize parameter times_sent to 0.
-	int times_sent = 0;
-	std::vector<uint8_t> request = pack_sending_public_key_request();
-
-	while (times_sent != MAX_REQUEST_FAILS) {
-		try {
-			// Send the request to the server via the provided socket.
-			boost::asio::write(sock, boost::asio::buffer(request));
-
-			// Receive header from the server, get response code and payload_size
-			std::vector<uint8_t> response_header(RESPONSE_HEADER_SIZE);
-			boost::asio::read(sock, boost::asio::buffer(response_header, RESPONSE_HEADER_SIZE));
-			uint16_t response_code = get_response_code(response_header);
-			uint32_t response_payload_size = get_response_payload_size(response_header);
-
-			// Receive payload from the server, save it's length in a parameter length.
-			std::vector<uint8_t> response_payload(response_payload_size);
-			size_t length = boost::asio::read(sock, boost::asio::buffer(response_payload, response_payload_size));
-
-			// If the code is not success, the payload_size for the code is not the same as the size received in the header, or the length of the payload is not the wanted length, print error.
-			if (response_code != Codes::PUBLIC_KEY_RECEIVED_C || response_payload_size != PayloadSize::PUBLIC_KEY_RECEIVED_P || length != response_payload_size) {
-				throw std::invalid_argument("server responded with an error.");
-			}
-
-			// Copy the id from the payload, and check if it's the correct client id.
-			std::vector<uint8_t> payload_id(sizeof(uuid));
-			std::copy(response_payload.begin(), response_payload.begin() + sizeof(uuid), payload_id.begin());
-			if (!id_vectors_match(payload_id, uuid)) {
-				throw std::invalid_argument("server responded with an error.");
-			}
-
-			// Copy the encrypted aes key content from the response_payload vector into the parameter encrypted_aes_key, then break from the loop.
-			std::copy(response_payload.begin() + sizeof(uuid), response_payload.end(), this->encrypted_aes_key);
-			break;
-		}
-		catch (std::exception& e) {
-			std::cerr << e.what() << std::endl;
-		}
-		// Increment by 1 each iteration.
-		times_sent++;
-	}
-
-	// If reached 3, return FAILURE.
-	if (times_sent == MAX_REQUEST_FAILS) {
-		return FAILURE;
-	}
-	// If the client succeeded, return SUCCESS.
-	return SUCCESS;
+	TRACE_SPAN("SendingPublicKey::run");
+	return exchange(sock, pack_sending_public_key_request(), SENDING_PUBLIC_KEY_EXCHANGE, [this](ByteView payload) {
+		// Copy the encrypted aes key content from the response payload into the parameter encrypted_aes_key.
+		ByteView response_aes_key = EncryptedAesKeyLayout::get<1>(payload);
+		std::copy(response_aes_key.begin(), response_aes_key.end(), this->encrypted_aes_key);
+	});
 }
 
 /*
@@ -203,8 +263,8 @@ int SendingPublicKey::run(tcp::socket& sock) {
 std::vector<uint8_t> SendingPublicKey::pack_sending_public_key_request() const {
 	std::vector<uint8_t> req = pack_header();
 
-	std::copy(name, name + sizeof(name), req.begin() + REQUEST_HEADER_SIZE);
-	std::copy(public_key, public_key + sizeof(public_key), req.begin() + REQUEST_HEADER_SIZE + sizeof(name));
+	SendingPublicKeyLayout::put<0>(req.data() + REQUEST_HEADER_SIZE, name);
+	SendingPublicKeyLayout::put<1>(req.data() + REQUEST_HEADER_SIZE, public_key);
 
 	return req;
 }
@@ -231,81 +291,215 @@ std::string Reconnection::getEncryptedAesKey() const {
 }
 
 int Reconnection::run(tcp::socket &sock) {
-	// Pack request fields into vector and initialize parameter times_sent to 0.
-	int times_sent = 0;
-	std::vector<uint8_t> request = pack_reconnection_request();
+	TRACE_SPAN("Reconnection::run");
+	return exchange(sock, pack_reconnection_request(), RECONNECTION_EXCHANGE,
+		[this](ByteView payload) {
+			// Copy the encrypted aes key content from the response payload into the parameter encrypted_aes_key.
+			ByteView response_aes_key = EncryptedAesKeyLayout::get<1>(payload);
+			std::copy(response_aes_key.begin(), response_aes_key.end(), this->encrypted_aes_key);
+		},
+		[this](ByteView payload) {
+			// The client could not reconnect but was registered instead, set the uuid to the id the server responded with (SPECIAL indicates registration instead of reconnection).
+			ByteView response_id = ClientIdLayout::get<0>(payload);
+			std::copy(response_id.begin(), response_id.end(), uuid.begin());
+		});
+}
 
-	while (times_sent != MAX_REQUEST_FAILS) {
-		try {
-			// Send the request to the server via the provided socket.
-			boost::asio::write(sock, boost::asio::buffer(request));
-
-			// Receive header from the server, get response code and payload_size
-			std::vector<uint8_t> response_header(RESPONSE_HEADER_SIZE);
-			boost::asio::read(sock, boost::asio::buffer(response_header, RESPONSE_HEADER_SIZE));
-			uint16_t response_code = get_response_code(response_header);
-			uint32_t response_payload_size = get_response_payload_size(response_header);
-
-			// Receive payload from the server, save it's length in a parameter length.
-			std::vector<uint8_t> response_payload(response_payload_size);
-			size_t length = boost::asio::read(sock, boost::asio::buffer(response_payload, response_payload_size));
-
-			// If client could not reconnect but could register, set the new uuid and return SPECIAL, indicating registration instead of reconnection.
-			if (response_code == Codes::RECONNECTION_FAILED_C && response_payload_size == PayloadSize::RECONNECTION_FAILED_P && length == response_payload_size) {
-				// The Registration succeeded, set the uuid to the id the server responded with.
-				std::copy(response_payload.begin(), response_payload.end(), uuid.begin());
-				return SPECIAL;
-			}
+/*
+	This method packs the header and payload for the reconnection request in a form of uint8_t vector.
+	All numeric fields are ordered by little endian order.
+*/
+std::vector<uint8_t> Reconnection::pack_reconnection_request() const {
+	std::vector<uint8_t> req = pack_header();
+	
+	ReconnectionLayout::put<0>(req.data() + REQUEST_HEADER_SIZE, name);
 
-			// If the code is not success, the payload_size for the code is not the same as the size received in the header, or the length of the payload is not the wanted length, print error.
-			else if (response_code != Codes::RECONNECTION_SUCCEEDED_C || response_payload_size != PayloadSize::RECONNECTION_SUCCEEDED_P || length != response_payload_size) {
-				throw std::invalid_argument("server responded with an error.");
-			}
+	return req;
+}
 
-			// Copy the id from the payload, and check if it's the correct client id.
-			std::vector<uint8_t> payload_id(sizeof(uuid));
-			std::copy(response_payload.begin(), response_payload.begin() + sizeof(uuid), payload_id.begin());
-			if (!id_vectors_match(payload_id, uuid)) {
-				throw std::invalid_argument("server responded with an error.");
-			}
+SendingEcdhKey::SendingEcdhKey(UUID uuid, uint16_t code, uint32_t payload_size, const char name[], std::string public_key):
+	Request(uuid, code, payload_size)
+{
+	RUNNING(code);
 
-			// Copy the encrypted aes key content from the response_payload vector into the parameter encrypted_aes_key, then break from the loop.
-			std::copy(response_payload.begin() + sizeof(uuid), response_payload.end(), this->encrypted_aes_key);
-			break;
-		}
-		catch (std::exception& e) {
-			std::cerr << e.what() << std::endl;
-		}
-		// Increment by 1 each iteration.
-		times_sent++;
+	// Fill this->name with null terminator, then copy a max of 254 chars from the provided name.
+	size_t len = strlen(name);
+	size_t amt = (len >= NAME_SIZE) ? (NAME_SIZE - 1) : len;
+
+	memset(this->name, 0, sizeof(this->name));
+	memcpy(this->name, name, amt);
+
+	// Fill this->public_key with null terminator, then copy a max of 32 chars from the provided public key.
+	size_t size = public_key.size();
+	amt = (size > ECDH_KEY_LENGTH) ? ECDH_KEY_LENGTH : size;
+
+	memset(this->public_key, 0, sizeof(this->public_key));
+	memcpy(this->public_key, public_key.c_str(), amt);
+
+	memset(this->server_public_key, 0, sizeof(this->server_public_key));
+}
+
+// Getting the X25519 public key received by the server in string form.
+std::string SendingEcdhKey::getServerPublicKey() const {
+	std::string str_key(this->server_public_key, this->server_public_key + sizeof(this->server_public_key));
+	return str_key;
+}
+
+int SendingEcdhKey::run(tcp::socket& sock) {
+	TRACE_SPAN("SendingEcdhKey::run");
+	// A server that does not support the ECDH handshake drops the connection on the request (SPECIAL), a General Error is a failure like any other.
+	return exchange(sock, pack_sending_ecdh_key_request(), SENDING_ECDH_KEY_EXCHANGE, [this](ByteView payload) {
+		// Copy the server's public key from the response payload into the parameter server_public_key.
+		ByteView response_public_key = ServerEcdhKeyLayout::get<1>(payload);
+		std::copy(response_public_key.begin(), response_public_key.end(), this->server_public_key);
+	});
+}
+
+/*
+	This method packs the header and payload for the sending ecdh key request in a form of uint8_t vector.
+	All numeric fields are ordered by little endian order.
+*/
+std::vector<uint8_t> SendingEcdhKey::pack_sending_ecdh_key_request() const {
+	std::vector<uint8_t> req = pack_header();
+
+	SendingEcdhKeyLayout::put<0>(req.data() + REQUEST_HEADER_SIZE, name);
+	SendingEcdhKeyLayout::put<1>(req.data() + REQUEST_HEADER_SIZE, public_key);
+
+	return req;
+}
+
+EcdhReconnection::EcdhReconnection(UUID uuid, uint16_t code, uint32_t payload_size, const char name[]):
+	Request(uuid, code, payload_size)
+{
+	RUNNING(code);
+
+	// Fill this->name with null terminator, then copy a max of 254 chars from the provided name.
+	size_t len = strlen(name);
+	size_t amt = (len >= NAME_SIZE) ? (NAME_SIZE - 1) : len;
+
+	memset(this->name, 0, sizeof(this->name));
+	memcpy(this->name, name, amt);
+
+	memset(this->server_public_key, 0, sizeof(this->server_public_key));
+}
+
+// Getting the X25519 public key received by the server in string form.
+std::string EcdhReconnection::getServerPublicKey() const {
+	std::string str_key(this->server_public_key, this->server_public_key + sizeof(this->server_public_key));
+	return str_key;
+}
+
+int EcdhReconnection::run(tcp::socket& sock) {
+	TRACE_SPAN("EcdhReconnection::run");
+	return exchange(sock, pack_ecdh_reconnection_request(), ECDH_RECONNECTION_EXCHANGE,
+		[this](ByteView payload) {
+			// Copy the server's public key from the response payload into the parameter server_public_key.
+			ByteView response_public_key = ServerEcdhKeyLayout::get<1>(payload);
+			std::copy(response_public_key.begin(), response_public_key.end(), this->server_public_key);
+		},
+		[this](ByteView payload) {
+			// The client could not reconnect but was registered instead, set the uuid to the id the server responded with (SPECIAL indicates registration instead of reconnection).
+			ByteView response_id = ClientIdLayout::get<0>(payload);
+			std::copy(response_id.begin(), response_id.end(), uuid.begin());
+		});
+}
+
+/*
+	This method packs the header and payload for the ecdh reconnection request in a form of uint8_t vector.
+	All numeric fields are ordered by little endian order.
+*/
+std::vector<uint8_t> EcdhReconnection::pack_ecdh_reconnection_request() const {
+	std::vector<uint8_t> req = pack_header();
+	
+	EcdhReconnectionLayout::put<0>(req.data() + REQUEST_HEADER_SIZE, name);
+
+	return req;
+}
+
+TicketReconnection::TicketReconnection(UUID uuid, uint16_t code, uint32_t payload_size, const char name[], std::string ticket):
+	Request(uuid, code, payload_size)
+{
+	RUNNING(code);
+
+	// Fill this->name with null terminator, then copy a max of 254 chars from the provided name.
+	size_t len = strlen(name);
+	size_t amt = (len >= NAME_SIZE) ? (NAME_SIZE - 1) : len;
+
+	memset(this->name, 0, sizeof(this->name));
+	memcpy(this->name, name, amt);
+
+	// Fill this->ticket with null terminator, then copy a max of 88 chars from the provided ticket.
+	size_t size = ticket.size();
+	amt = (size > TICKET_LENGTH) ? TICKET_LENGTH : size;
+
+	memset(this->ticket, 0, sizeof(this->ticket));
+	memcpy(this->ticket, ticket.c_str(), amt);
+}
+
+int TicketReconnection::run(tcp::socket& sock) {
+	TRACE_SPAN("TicketReconnection::run");
+	// Pack request fields into vector.
+	std::vector<uint8_t> request = pack_ticket_reconnection_request();
+
+	try {
+		// Send the request to the server via the provided socket, the file packets are sent right after it without waiting.
+		boost::asio::write(sock, boost::asio::buffer(request));
 	}
-	// If reached 3, return FAILURE.
-	if (times_sent == MAX_REQUEST_FAILS) {
+	catch (std::exception& e) {
+		LOG_ERROR(e.what());
+		count_request_error(code);
+		count_request_failure(code);
 		return FAILURE;
 	}
-	// If the client succeeded, return SUCCESS.
+
 	return SUCCESS;
 }
 
+void TicketReconnection::queue(Pipeline& pipeline) const {
+	// The server only responds if the ticket is rejected, in place of the response to the file packets that follow it.
+	pipeline.push(pack_ticket_reconnection_request());
+}
+
+int TicketReconnection::check(tcp::socket& sock) {
+	TRACE_SPAN("TicketReconnection::check");
+	return exchange(sock, pack_ticket_reconnection_request(), CHECKED_TICKET_RECONNECTION_EXCHANGE, [](ByteView) {});
+}
+
 /*
-	This method packs the header and payload for the reconnection request in a form of uint8_t vector.
+	This method packs the header and payload for the ticket reconnection request in a form of uint8_t vector.
 	All numeric fields are ordered by little endian order.
 */
-std::vector<uint8_t> Reconnection::pack_reconnection_request() const {
+std::vector<uint8_t> TicketReconnection::pack_ticket_reconnection_request() const {
 	std::vector<uint8_t> req = pack_header();
 
-	std::copy(name, name + sizeof(name), req.begin() + REQUEST_HEADER_SIZE);
+	TicketReconnectionLayout::put<0>(req.data() + REQUEST_HEADER_SIZE, name);
+	TicketReconnectionLayout::put<1>(req.data() + REQUEST_HEADER_SIZE, ticket);
 
 	return req;
 }
 
-SendingFile::SendingFile(UUID uuid, uint16_t code, uint32_t payload_size, uint32_t content_size, uint32_t orig_file_size, uint16_t total_packets, const char file_name[], std::string encrypted_file_content) :
+ViewSource::ViewSource(ByteView content) :
+	content(content),
+	offset(0)
+{
+
+}
+
+ByteView ViewSource::next(size_t size) {
+	size_t amt = MIN(size, content.size() - offset);
+	ByteView view(content.data() + offset, amt);
+	offset += amt;
+	return view;
+}
+
+SendingFile::SendingFile(UUID uuid, uint16_t code, uint32_t payload_size, uint64_t content_size, uint64_t orig_file_size, uint64_t total_packets, const char file_name[], PacketSource& source) :
 	Request(uuid, code, payload_size),
 	content_size(content_size),
 	orig_file_size(orig_file_size),
 	packet_number(0),
 	total_packets(total_packets),
-	encrypted_file_content(encrypted_file_content),
+	source(source),
+	stream(nullptr),
 	cksum(0)
 {
 	RUNNING(code);
@@ -320,14 +514,20 @@ SendingFile::SendingFile(UUID uuid, uint16_t code, uint32_t payload_size, uint32
 	memset(this->encrypted_content, 0, sizeof(this->encrypted_content));
 }
 
+SendingFile::SendingFile(UUID uuid, uint16_t code, uint32_t payload_size, const char file_name[], StreamSource& source) :
+	SendingFile(uuid, code, payload_size, 0, 0, 0, file_name, source)
+{
+	stream = &source;
+}
+
 // Setting the current packet's encrypted content.
-void SendingFile::setEncryptedContent(std::string encrypted_content) {
+void SendingFile::setEncryptedContent(ByteView encrypted_content) {
 	// Fill this->encrypted_content with null terminator, then copy a max of 1024 chars from the provided file_name.
 	size_t len = encrypted_content.size();
 	size_t amt = (len > CONTENT_SIZE_PER_PACKET) ? CONTENT_SIZE_PER_PACKET : len;
 
 	memset(this->encrypted_content, 0, sizeof(this->encrypted_content));
-	memcpy(this->encrypted_content, encrypted_content.c_str(), amt);
+	memcpy(this->encrypted_content, encrypted_content.data(), amt);
 }
 
 // Setting the cksum to the given unsigned long variable.
@@ -341,65 +541,133 @@ unsigned long SendingFile::getCksum() const {
 }
 
 int SendingFile::run(tcp::socket& sock) {
-	// Sending all packets to the server.
-	for (packet_number = 1; packet_number <= total_packets; packet_number++) {
-		size_t amt_to_read = MIN(CONTENT_SIZE_PER_PACKET, content_size - (packet_number-1)*CONTENT_SIZE_PER_PACKET);
-		std::string content = encrypted_file_content.substr((packet_number - 1) * CONTENT_SIZE_PER_PACKET, amt_to_read);
-		setEncryptedContent(content);
-		
-		// Pack request fields into vector
-		std::vector<uint8_t> request = pack_sending_file_request();
+	Pipeline pipeline;
+	return run(sock, pipeline);
+}
+
+int SendingFile::run(tcp::socket& sock, Pipeline& pipeline) {
+	TRACE_SPAN("SendingFile::run");
+	size_t queued_packets = 0;
+	// A streamed request takes each packet's content one packet ahead, the last packet is the one with nothing after it.
+	uint64_t streamed_size = 0;
+	ByteView upcoming;
+
+	{
+		// Hold back partial segments while the packets are written, the cork is removed before waiting for the response.
+		SocketCork cork(sock);
+		// Queue all packets after the requests already in the pipeline, and write them PIPELINE_WRITE_SIZE bytes at a time.
+		for (packet_number = 1; stream || packet_number <= total_packets; packet_number++) {
+			bool last_packet;
+			{
+				TRACE_SPAN("packetize");
+				try {
+					if (stream) {
+						if (packet_number == 1) {
+							upcoming = source.next(CONTENT_SIZE_PER_PACKET);
+						}
+						setEncryptedContent(upcoming);
+						streamed_size += upcoming.size();
+						upcoming = source.next(CONTENT_SIZE_PER_PACKET);
+
+						// The last packet carries the sizes and the total packets, marking the end of the file.
+						last_packet = upcoming.size() == 0;
+						if (last_packet) {
+							content_size = streamed_size;
+							orig_file_size = stream->getOrigSize();
+							total_packets = packet_number;
+						}
+					}
+					else {
+						size_t amt_to_read = static_cast<size_t>(MIN(static_cast<uint64_t>(CONTENT_SIZE_PER_PACKET), content_size - (packet_number - 1) * CONTENT_SIZE_PER_PACKET));
+						setEncryptedContent(source.next(amt_to_read));
+						last_packet = packet_number == total_packets;
+					}
+				}
+				// The source could not be read (a file may have changed since its size was sent), the upload is abandoned.
+				catch (std::exception& e) {
+					LOG_ERROR(e.what());
+					count_request_error(code);
+					count_request_failure(code);
+					pipeline.clear();
+					return FAILURE;
+				}
+
+				// Pack request fields straight into the pipeline.
+				pack_sending_file_request(pipeline.append(REQUEST_HEADER_SIZE + payload_size));
+				queued_packets++;
+			}
 
-		try {
-			// Send the request to the server via the provided socket.
-			boost::asio::write(sock, boost::asio::buffer(request));
-		}
-		// If an error occurred, try sending the packet again.
-		catch (std::exception& e) {
-			std::cerr << e.what() << std::endl;
-			packet_number--;
+			// The server responds once it has received the last packet, which is written right away.
+			if (!last_packet && pipeline.size() < PIPELINE_WRITE_SIZE) {
+				continue;
+			}
+
+			try {
+				TRACE_SPAN("socket write");
+				// Send the queued requests to the server via the provided socket, in a single write.
+				pipeline.flush(sock);
+				count_metric(PACKETS_SENT, queued_packets);
+				queued_packets = 0;
+			}
+			// A failed write may have written part of the requests, they can't be written again on this connection - the attempt fails.
+			catch (std::exception& e) {
+				LOG_ERROR(e.what());
+				count_request_error(code);
+				count_request_failure(code);
+				return FAILURE;
+			}
+
+			if (last_packet) {
+				break;
+			}
 		}
 	}
 
 	try {
-		// Receive header from the server, get response code and payload_size
-		std::vector<uint8_t> response_header(RESPONSE_HEADER_SIZE);
-		boost::asio::read(sock, boost::asio::buffer(response_header, RESPONSE_HEADER_SIZE));
-		uint16_t response_code = get_response_code(response_header);
-		uint32_t response_payload_size = get_response_payload_size(response_header);
-
-		// Receive payload from the server, save it's length in a parameter length.
-		std::vector<uint8_t> response_payload(response_payload_size);
-		size_t length = boost::asio::read(sock, boost::asio::buffer(response_payload, response_payload_size));
-
-		// If the code is not success, the payload_size for the code is not the same as the size received in the header, or the length of the payload is not the wanted length, print error.
-		if (response_code != Codes::FILE_RECEIVED_CRC_C || response_payload_size != PayloadSize::FILE_RECEIVED_CRC_P || length != response_payload_size) {
+		// Receive the response from the server into a fixed size buffer, its fields are decoded in place (see wire.hpp).
+		Response response;
+		{
+			// The server answers once it has received (and decrypted) the whole file, and computed its CRC - after answering the requests written before the file.
+			TRACE_SPAN("response wait");
+			pipeline.receive_awaited(sock);
+			response.receive(sock, content_response_timeout(retry_policy().timeout, content_size));
+		}
+		uint16_t response_code = response.getCode();
+		uint32_t response_payload_size = response.getPayloadSize();
+		ByteView response_payload = response.getPayload();
+
+		// The session ticket sent before the file was rejected, the server dropped the file packets.
+		if (response_code == Codes::TICKET_REJECTED_C && response_payload_size == PayloadSize::TICKET_REJECTED_P) {
+			return SPECIAL;
+		}
+
+		// If the code is not success, the payload_size for the code is not the same as the size received in the header, print error.
+		if (response_code != Codes::FILE_RECEIVED_CRC_C || response_payload_size != PayloadSize::FILE_RECEIVED_CRC_P) {
 			throw std::invalid_argument("server responded with an error.");
 		}
 
-		// Copy the id from the payload, and check if it's the correct client id.
-		std::vector<uint8_t> payload_id(sizeof(uuid));
-		std::copy(response_payload.begin(), response_payload.begin() + sizeof(uuid), payload_id.begin());
-		if (!id_vectors_match(payload_id, uuid)) {
+		// Check that the id in the payload is the correct client id.
+		if (!ids_match(FileReceivedCrcLayout::get<0>(response_payload), uuid)) {
 			throw std::invalid_argument("server responded with an error.");
 		}
 
-		uint32_t response_content_size = getPayloadContentSize(response_payload);
+		uint64_t response_content_size = getPayloadContentSize(response_payload);
 		if (content_size != response_content_size) {
 			throw std::invalid_argument("server responded with an error.");
 		}
 
-		std::string response_file_name(response_payload.begin() + sizeof(uuid) + sizeof(content_size), response_payload.begin() + sizeof(uuid) + sizeof(content_size) + sizeof(file_name));
-		if (!file_names_match(response_file_name, file_name, sizeof(file_name))) {
+		if (!file_names_match(FileReceivedCrcLayout::get<2>(response_payload), file_name, sizeof(file_name))) {
 			throw std::invalid_argument("server responded with an error.");
 		}
 
-		// Copy the cksum content from the response_payload vector into the parameter cksum.
+		// Copy the cksum content from the response payload into the parameter cksum.
 		unsigned long response_cksum = getPayloadCksum(response_payload);
 		setCksum(response_cksum);
 	}
 	catch (std::exception& e) {
-		std::cerr << e.what() << std::endl;
+		LOG_ERROR(e.what());
+		count_request_error(code);
+		count_request_failure(code);
 		return FAILURE;
 	}
 
@@ -407,75 +675,32 @@ int SendingFile::run(tcp::socket& sock) {
 }
 
 std::vector<uint8_t> SendingFile::pack_sending_file_request() const {
-	std::vector<uint8_t> req = pack_header();
-
-	// Saving the numeric types that are of size larger than one byte in little endian order.
-	uint16_t packet_num_le = boost::endian::native_to_little(packet_number);
-	uint16_t total_packets_le = boost::endian::native_to_little(total_packets);
-	uint32_t content_size_le = boost::endian::native_to_little(content_size);
-	uint32_t orig_file_size_le = boost::endian::native_to_little(orig_file_size);
-
-	// Saving the bytes in little endian order as a byte array.
-	uint8_t* packet_num_le_ptr = reinterpret_cast<uint8_t*>(&packet_num_le);
-	uint8_t* total_packets_le_ptr = reinterpret_cast<uint8_t*>(&total_packets_le);
-	uint8_t* content_size_le_ptr = reinterpret_cast<uint8_t*>(&content_size_le);
-	uint8_t* orig_file_size_le_ptr = reinterpret_cast<uint8_t*>(&orig_file_size_le);
-
-	// Adding all fields to the vector.
-	std::copy(content_size_le_ptr, content_size_le_ptr + sizeof(content_size_le), req.begin() + REQUEST_HEADER_SIZE);
-	std::copy(orig_file_size_le_ptr, orig_file_size_le_ptr + sizeof(orig_file_size_le), req.begin() + REQUEST_HEADER_SIZE + sizeof(content_size));
-	std::copy(packet_num_le_ptr, packet_num_le_ptr + sizeof(packet_num_le), req.begin() + REQUEST_HEADER_SIZE + sizeof(content_size) + sizeof(orig_file_size));
-	std::copy(total_packets_le_ptr, total_packets_le_ptr + sizeof(total_packets_le), req.begin() + REQUEST_HEADER_SIZE + sizeof(content_size) + sizeof(orig_file_size) + sizeof(packet_number));
-	std::copy(file_name, file_name + sizeof(file_name), req.begin() + REQUEST_HEADER_SIZE + sizeof(content_size) + sizeof(orig_file_size) + sizeof(packet_number) + sizeof(total_packets));
-	std::copy(encrypted_content, encrypted_content + sizeof(encrypted_content), req.begin() + REQUEST_HEADER_SIZE + sizeof(content_size) + sizeof(orig_file_size) + sizeof(packet_number) + sizeof(total_packets) + sizeof(file_name));
+	std::vector<uint8_t> req(REQUEST_HEADER_SIZE + payload_size);
+	pack_sending_file_request(req.data());
 
 	return req;
 }
 
-uint32_t SendingFile::getPayloadContentSize(std::vector<uint8_t> payload) {
-	uint8_t first = payload[sizeof(uuid)], second = payload[sizeof(uuid) + 1];
-	uint8_t third = payload[sizeof(uuid) + 2], last = payload[sizeof(uuid) + 3];
+void SendingFile::pack_sending_file_request(uint8_t* req) const {
+	pack_header(req);
 
-	uint32_t combined = (static_cast<uint32_t>(first) << 24) | 
-						(static_cast<uint32_t>(second) << 16) | 
-						(static_cast<uint32_t>(third) << 8) | 
-						(static_cast<uint32_t>(last));
+	uint8_t* payload = req + REQUEST_HEADER_SIZE;
 
-	/*
-		This, in my opinion, isn't quite intuitive so I'll explain it a little:
-		By the way I define the 'combined' variable, I only insert it's value, meaning,
-		if the operating system operates by little-endian order, it'll reverse the bytes.
-		That being said, the value received is already in little-endian so we'll need to reverse them back.
-	*/
-	if (boost::endian::order::native == boost::endian::order::little) {
-		return boost::endian::endian_reverse(combined);
-	}
-
-	return combined;
+	// Adding all fields to the buffer at their fixed offsets, numeric fields in little endian order (see wire.hpp).
+	SendingFileLayout::put<0>(payload, content_size);
+	SendingFileLayout::put<1>(payload, orig_file_size);
+	SendingFileLayout::put<2>(payload, packet_number);
+	SendingFileLayout::put<3>(payload, total_packets);
+	SendingFileLayout::put<4>(payload, file_name);
+	SendingFileLayout::put<5>(payload, encrypted_content);
 }
 
-uint32_t SendingFile::getPayloadCksum(std::vector<uint8_t> payload) {
-	size_t start = sizeof(uuid) + sizeof(content_size) + sizeof(file_name);
-
-	uint8_t first = payload[start], second = payload[start + 1];
-	uint8_t third = payload[start + 2], last = payload[start + 3];
-
-	uint32_t combined = (static_cast<uint32_t>(first) << 24) |
-		(static_cast<uint32_t>(second) << 16) |
-		(static_cast<uint32_t>(third) << 8) |
-		(static_cast<uint32_t>(last));
-
-	/*
-		This, in my opinion, isn't quite intuitive so I'll explain it a little:
-		By the way I define the 'combined' variable, I only insert it's value, meaning,
-		if the operating system operates by little-endian order, it'll reverse the bytes.
-		That being said, the value received is already in little-endian so we'll need to reverse them back.
-	*/
-	if (boost::endian::order::native == boost::endian::order::little) {
-		return boost::endian::endian_reverse(combined);
-	}
+uint64_t SendingFile::getPayloadContentSize(ByteView payload) {
+	return FileReceivedCrcLayout::get<1>(payload);
+}
 
-	return combined;
+uint32_t SendingFile::getPayloadCksum(ByteView payload) {
+	return FileReceivedCrcLayout::get<3>(payload);
 }
 
 ValidCrc::ValidCrc(UUID uuid, uint16_t code, uint32_t payload_size, const char file_name[]) :
@@ -492,65 +717,97 @@ ValidCrc::ValidCrc(UUID uuid, uint16_t code, uint32_t payload_size, const char f
 }
 
 int ValidCrc::run(tcp::socket &sock) {
-	// Pack request fields into vector and initialize parameter times_sent to 0.
-	int times_sent = 0;
-	std::vector<uint8_t> request = pack_valid_crc_request();
+	TRACE_SPAN("ValidCrc::run");
+	// The response only holds the client's id, which the exchange checks.
+	return exchange(sock, pack_valid_crc_request(), VALID_CRC_EXCHANGE, [](ByteView) {});
+}
 
-	while (times_sent != MAX_REQUEST_FAILS) {
-		try {
-			// Send the request to the server via the provided socket.
-			boost::asio::write(sock, boost::asio::buffer(request));
+void ValidCrc::queue(Pipeline& pipeline, std::function<void()> on_confirmed) const {
+	pipeline.push(pack_valid_crc_request(), { uuid, code, &VALID_CRC_EXCHANGE, [on_confirmed](ByteView) { on_confirmed(); } });
+}
+
+/*
+	This method packs the header and payload for the valid crc request in a form of uint8_t vector.
+	All numeric fields are ordered by little endian order.
+*/
+std::vector<uint8_t> ValidCrc::pack_valid_crc_request() const {
+	std::vector<uint8_t> req = pack_header();
+	
+	FileNameLayout::put<0>(req.data() + REQUEST_HEADER_SIZE, file_name);
+
+	return req;
+}
 
-			// Receive header from the server, get response code and payload_size
-			std::vector<uint8_t> response_header(RESPONSE_HEADER_SIZE);
-			boost::asio::read(sock, boost::asio::buffer(response_header, RESPONSE_HEADER_SIZE));
-			uint16_t response_code = get_response_code(response_header);
-			uint32_t response_payload_size = get_response_payload_size(response_header);
+ValidCrcTicket::ValidCrcTicket(UUID uuid, uint16_t code, uint32_t payload_size, const char file_name[]) :
+	Request(uuid, code, payload_size),
+	lifetime(0)
+{
+	RUNNING(code);
 
-			// Receive payload from the server, save it's length in a parameter length.
-			std::vector<uint8_t> response_payload(response_payload_size);
-			size_t length = boost::asio::read(sock, boost::asio::buffer(response_payload, response_payload_size));
+	// Fill this->name with null terminator, then copy a max of 254 chars from the provided name.
+	size_t len = strlen(file_name);
+	size_t amt = (len >= NAME_SIZE) ? (NAME_SIZE - 1) : len;
 
-			// If the code is not success, the payload_size for the code is not the same as the size received in the header, or the length of the payload is not the wanted length, print error.
-			if (response_code != Codes::MESSAGE_RECEIVED_C || response_payload_size != PayloadSize::MESSAGE_RECEIVED_P || length != response_payload_size) {
-				throw std::invalid_argument("server responded with an error.");
-			}
+	memset(this->file_name, 0, sizeof(this->file_name));
+	memcpy(this->file_name, file_name, amt);
 
-			// Copy the id from the payload, and check if it's the correct client id.
-			std::vector<uint8_t> payload_id(sizeof(uuid));
-			std::copy(response_payload.begin(), response_payload.begin() + sizeof(uuid), payload_id.begin());
-			if (!id_vectors_match(payload_id, uuid)) {
-				throw std::invalid_argument("server responded with an error.");
-			}
-			// If the id provided by the server is correct, break from the loop and return SUCCESS.
-			break;
-		}
-		catch (std::exception& e) {
-			std::cerr << e.what() << std::endl;
-		}
-		// Increment by 1 each iteration.
-		times_sent++;
-	}
-	// If reached 3, return FAILURE.
-	if (times_sent == MAX_REQUEST_FAILS) {
-		return FAILURE;
-	}
-	// If the client succeeded, return SUCCESS.
-	return SUCCESS;
+	memset(this->encrypted_resumption_key, 0, sizeof(this->encrypted_resumption_key));
+	memset(this->ticket, 0, sizeof(this->ticket));
+}
+
+// Getting the ticket lifetime received by the server.
+uint32_t ValidCrcTicket::getLifetime() const {
+	return this->lifetime;
+}
+
+// Getting the encrypted resumption key received by the server in string form.
+std::string ValidCrcTicket::getEncryptedResumptionKey() const {
+	std::string str_key(this->encrypted_resumption_key, this->encrypted_resumption_key + sizeof(this->encrypted_resumption_key));
+	return str_key;
+}
+
+// Getting the session ticket received by the server in string form.
+std::string ValidCrcTicket::getTicket() const {
+	std::string str_ticket(this->ticket, this->ticket + sizeof(this->ticket));
+	return str_ticket;
+}
+
+int ValidCrcTicket::run(tcp::socket& sock) {
+	TRACE_SPAN("ValidCrcTicket::run");
+	return exchange(sock, pack_valid_crc_ticket_request(), VALID_CRC_TICKET_EXCHANGE, [this](ByteView payload) { setPayloadTicket(payload); });
+}
+
+void ValidCrcTicket::queue(Pipeline& pipeline, std::function<void()> on_confirmed) {
+	pipeline.push(pack_valid_crc_ticket_request(), { uuid, code, &VALID_CRC_TICKET_EXCHANGE, [this, on_confirmed](ByteView payload) {
+		setPayloadTicket(payload);
+		on_confirmed();
+	} });
 }
 
 /*
-	This method packs the header and payload for the valid crc request in a form of uint8_t vector.
+	This method packs the header and payload for the valid crc ticket request in a form of uint8_t vector.
 	All numeric fields are ordered by little endian order.
 */
-std::vector<uint8_t> ValidCrc::pack_valid_crc_request() const {
+std::vector<uint8_t> ValidCrcTicket::pack_valid_crc_ticket_request() const {
 	std::vector<uint8_t> req = pack_header();
-
-	std::copy(file_name, file_name + sizeof(file_name), req.begin() + REQUEST_HEADER_SIZE);
+	
+	FileNameLayout::put<0>(req.data() + REQUEST_HEADER_SIZE, file_name);
 
 	return req;
 }
 
+uint32_t ValidCrcTicket::getPayloadLifetime(ByteView payload) {
+	return MessageReceivedTicketLayout::get<1>(payload);
+}
+
+void ValidCrcTicket::setPayloadTicket(ByteView payload) {
+	lifetime = getPayloadLifetime(payload);
+	ByteView response_resumption_key = MessageReceivedTicketLayout::get<2>(payload);
+	ByteView response_ticket = MessageReceivedTicketLayout::get<3>(payload);
+	std::copy(response_resumption_key.begin(), response_resumption_key.end(), this->encrypted_resumption_key);
+	std::copy(response_ticket.begin(), response_ticket.end(), this->ticket);
+}
+
 SendingCrcAgain::SendingCrcAgain(UUID uuid, uint16_t code, uint32_t payload_size, const char file_name[]):
 	Request(uuid, code, payload_size)
 {
@@ -565,6 +822,7 @@ SendingCrcAgain::SendingCrcAgain(UUID uuid, uint16_t code, uint32_t payload_size
 }
 
 int SendingCrcAgain::run(tcp::socket &sock) {
+	TRACE_SPAN("SendingCrcAgain::run");
 	// Pack request fields into vector.
 	std::vector<uint8_t> request = pack_sending_crc_again_request();
 
@@ -573,21 +831,28 @@ int SendingCrcAgain::run(tcp::socket &sock) {
 		boost::asio::write(sock, boost::asio::buffer(request));
 	}
 	catch (std::exception& e) {
-		std::cerr << e.what() << std::endl;
+		LOG_ERROR(e.what());
+		count_request_error(code);
+		count_request_failure(code);
 		return FAILURE;
 	}
 
 	return SUCCESS;
 }
 
+void SendingCrcAgain::queue(Pipeline& pipeline) const {
+	// The request has no response, the file packets sent again follow it.
+	pipeline.push(pack_sending_crc_again_request());
+}
+
 /*
 	This method packs the header and payload for the sending crc again request in a form of uint8_t vector.
 	All numeric fields are ordered by little endian order.
 */
 std::vector<uint8_t> SendingCrcAgain::pack_sending_crc_again_request() const {
 	std::vector<uint8_t> req = pack_header();
-
-	std::copy(file_name, file_name + sizeof(file_name), req.begin() + REQUEST_HEADER_SIZE);
+	
+	FileNameLayout::put<0>(req.data() + REQUEST_HEADER_SIZE, file_name);
 
 	return req;
 }
@@ -605,53 +870,26 @@ InvalidCrcDone::InvalidCrcDone(UUID uuid, uint16_t code, uint32_t payload_size,
 	memcpy(this->file_name, file_name, amt);
 }
 
-// TODO: go over this and change to fit this request.
 int InvalidCrcDone::run(tcp::socket &sock) {
-	// Pack request fields into vector and initialize parameter times_sent to 0.
-	int times_sent = 0;
-	std::vector<uint8_t> request = pack_invalid_crc_done_request();
-
-	while (times_sent != MAX_REQUEST_FAILS) {
-		try {
-			// Send the request to the server via the provided socket.
-			boost::asio::write(sock, boost::asio::buffer(request));
-
-			// Receive header from the server, get response code and payload_size
-			std::vector<uint8_t> response_header(RESPONSE_HEADER_SIZE);
-			boost::asio::read(sock, boost::asio::buffer(response_header, RESPONSE_HEADER_SIZE));
-			uint16_t response_code = get_response_code(response_header);
-			uint32_t response_payload_size = get_response_payload_size(response_header);
-
-			// Receive payload from the server, save it's length in a parameter length.
-			std::vector<uint8_t> response_payload(response_payload_size);
-			size_t length = boost::asio::read(sock, boost::asio::buffer(response_payload, response_payload_size));
-
-			// If the code is not success, the payload_size for the code is not the same as the size received in the header, or the length of the payload is not the wanted length, print error.
-			if (response_code != Codes::MESSAGE_RECEIVED_C || response_payload_size != PayloadSize::MESSAGE_RECEIVED_P || length != response_payload_size) {
-				throw std::invalid_argument("server responded with an error.");
-			}
+	TRACE_SPAN("InvalidCrcDone::run");
+	// The response only holds the client's id, which the exchange checks.
+	return exchange(sock, pack_invalid_crc_done_request(), INVALID_CRC_DONE_EXCHANGE, [](ByteView) {});
+}
 
-			// Copy the id from the payload, and check if it's the correct client id.
-			std::vector<uint8_t> payload_id(sizeof(uuid));
-			std::copy(response_payload.begin(), response_payload.begin() + sizeof(uuid), payload_id.begin());
-			if (!id_vectors_match(payload_id, uuid)) {
-				throw std::invalid_argument("server responded with an error.");
-			}
-			// If the id provided by the server is correct, break from the loop and return SUCCESS.
-			break;
-		}
-		catch (std::exception& e) {
-			std::cerr << e.what() << std::endl;
-		}
-		// Increment by 1 each iteration.
-		times_sent++;
+int InvalidCrcDone::run(tcp::socket &sock, Pipeline& pipeline) {
+	// The last Sending CRC Again request is still queued, it must reach the server first.
+	try {
+		pipeline.flush(sock);
+		pipeline.receive_awaited(sock);
 	}
-	// If reached 3, return FAILURE.
-	if (times_sent == MAX_REQUEST_FAILS) {
+	catch (std::exception& e) {
+		LOG_ERROR(e.what());
+		count_request_error(code);
+		count_request_failure(code);
 		return FAILURE;
 	}
-	// If the client succeeded, return SUCCESS.
-	return SUCCESS;
+
+	return run(sock);
 }
 
 /*
@@ -660,8 +898,35 @@ int InvalidCrcDone::run(tcp::socket &sock) {
 */
 std::vector<uint8_t> InvalidCrcDone::pack_invalid_crc_done_request() const {
 	std::vector<uint8_t> req = pack_header();
-
-	std::copy(file_name, file_name + sizeof(file_name), req.begin() + REQUEST_HEADER_SIZE);
+	
+	FileNameLayout::put<0>(req.data() + REQUEST_HEADER_SIZE, file_name);
 
 	return req;
 }
+
+Multiplex::Multiplex(UUID uuid, uint16_t code, uint32_t payload_size) :
+	Request(uuid, code, payload_size),
+	window(0)
+{
+	RUNNING(code);
+}
+
+uint32_t Multiplex::getWindow() const {
+	return window;
+}
+
+int Multiplex::run(tcp::socket& sock) {
+	TRACE_SPAN("Multiplex::run");
+	// The response is the connection's, not a client's - it holds no client id.
+	return exchange(sock, pack_multiplex_request(), MULTIPLEX_EXCHANGE, [this](ByteView payload) {
+		window = MultiplexAcceptedLayout::get<0>(payload);
+	});
+}
+
+/*
+	This method packs the header for the multiplex request in a form of uint8_t vector, the request has no payload.
+	All numeric fields are ordered by little endian order.
+*/
+std::vector<uint8_t> Multiplex::pack_multiplex_request() const {
+	return pack_header();
+}
@@ -1,4 +1,101 @@
+#ifndef REQUEST_H
+#define REQUEST_H
+
+#include <deque>
+#include <functional>
 #include "utils.hpp"
+#include "wire.hpp"
+
+// How requests that expect a response are sent again when an attempt fails.
+struct RetryPolicy {
+	int max_attempts;
+	// How long to wait for the server's response, 0 waits forever.
+	std::chrono::milliseconds timeout;
+	// Before attempt n + 1 the request waits a random duration up to min(max_backoff, base_backoff * 2^(n - 1)) - exponential backoff with full jitter.
+	std::chrono::milliseconds base_backoff;
+	std::chrono::milliseconds max_backoff;
+};
+
+// This method sets the retry policy of all requests.
+void set_retry_policy(const RetryPolicy& policy);
+// This method returns the retry policy of all requests.
+RetryPolicy retry_policy();
+// This method sleeps before attempt number attempt (starting at 1 for the first retry) according to the policy's backoff.
+void back_off(const RetryPolicy& policy, int attempt);
+
+// This method returns true if the error means the server closed the connection.
+bool closed_by_server(const boost::system::error_code& ec);
+/*
+	This method returns how long to wait for the response to the last packet of content of the given size. The server reads and
+	checks the whole content before it responds, so the timeout grows by a millisecond per SERVER_CONTENT_BYTES_PER_MS bytes
+	(0 still waits forever).
+*/
+std::chrono::milliseconds content_response_timeout(std::chrono::milliseconds timeout, uint64_t content_size);
+
+/*
+	A request's exchange with the server, one entry in the table of exchanges in request.cpp.
+	The success response ends the request with SUCCESS, the special response (if the request has one) ends it with SPECIAL,
+	any other response is an error and the request is sent again.
+*/
+struct Exchange {
+	uint16_t success_code;
+	uint32_t success_payload_size;
+	// Whether the success response starts with the client's id, which must be the id the request was sent with.
+	bool checks_client_id;
+	// 0 if the request has no special response.
+	uint16_t special_code;
+	uint32_t special_payload_size;
+	// Whether the server closing the connection instead of responding is the special response - how a server that predates
+	// the request rejects it (it drops the connection on a code it doesn't know). The connection must be opened again.
+	bool special_on_close = false;
+};
+
+// This method checks the response against the exchange - returns SUCCESS for its success response and SPECIAL for its special response, throws if it's neither.
+int check_response(const Response& response, const Exchange& spec, const UUID& uuid);
+
+// A queued request the server responds to, its response is checked against its exchange once it's read.
+struct AwaitedResponse {
+	UUID uuid;
+	uint16_t code;
+	const Exchange* spec;
+	// Called with the payload of the success response.
+	std::function<void(ByteView)> on_success;
+};
+
+/*
+	Requests queued to be written to the server together.
+	Queued requests are packed into one buffer and sent with a single write instead of a write per request, so control requests
+	that don't wait for a response (a session ticket, Sending CRC Again) ride along with the file packets that follow them, and
+	a file's packets leave in large writes.
+	A queued request may expect a response. The server answers a connection's requests in the order they were written, so the
+	responses owed are matched to their requests by that order - they are read before the response of a request written after
+	them. A batch's CRC confirmations ride along with the next file's packets this way, and cost no round trip of their own.
+*/
+class Pipeline {
+	std::vector<uint8_t> buffer;
+	// The responses owed for the queued requests, oldest first.
+	std::deque<AwaitedResponse> awaited;
+
+	public:
+		// This method queues size more bytes, and returns a pointer to them for a request to be packed into.
+		uint8_t* append(size_t size);
+		// This method queues a packed request.
+		void push(const std::vector<uint8_t>& request);
+		// This method queues a packed request the server responds to.
+		void push(const std::vector<uint8_t>& request, AwaitedResponse response);
+		// This method writes all queued requests with a single write. The requests are discarded even if the write fails - part of them may have been written.
+		void flush(tcp::socket& sock);
+		/*
+			This method reads the responses owed for the requests written so far, oldest first, and checks each one. Throws if a
+			response could not be read or is an error - the responses still owed are discarded, the connection is out of step
+			with the server.
+		*/
+		void receive_awaited(tcp::socket& sock);
+		// This method returns the amount of bytes queued.
+		size_t size() const;
+		// This method discards the queued requests and the responses owed, after the attempt they belong to failed.
+		void clear();
+};
 
 class Request {
 	protected:
@@ -7,6 +104,18 @@ class Request {
 		uint16_t code;
 		uint32_t payload_size;
 
+		/*
+			This method is the generic engine behind the run methods of the requests that expect a response.
+			It sends the packed request and receives the response as described by the exchange, calling on_success or on_special with the response's payload.
+			A failed attempt is sent again after a backoff, up to the retry policy's attempts. A timed out attempt isn't - its response
+			may still arrive, and would be read as the response of the request sent again. Neither is an attempt the socket failed
+			during - part of the request may have been written, the connection is out of step with the server.
+		*/
+		template <typename OnSuccess, typename OnSpecial>
+		int exchange(tcp::socket& sock, const std::vector<uint8_t>& request, const Exchange& spec, OnSuccess on_success, OnSpecial on_special);
+		template <typename OnSuccess>
+		int exchange(tcp::socket& sock, const std::vector<uint8_t>& request, const Exchange& spec, OnSuccess on_success);
+
 	public:
 		Request(UUID uuid, uint16_t code, uint32_t payload_size);
 
@@ -19,8 +128,65 @@ class Request {
 		virtual int run(tcp::socket &sock) = 0;
 		// This method packs the request header fields into a uint8_t vector of size payload_size and returns it.
 		std::vector<uint8_t> pack_header() const;
+		// This method packs the request header fields into the given buffer, which has room for the whole request.
+		void pack_header(uint8_t* req) const;
 };
 
+template <typename OnSuccess, typename OnSpecial>
+int Request::exchange(tcp::socket& sock, const std::vector<uint8_t>& request, const Exchange& spec, OnSuccess on_success, OnSpecial on_special) {
+	RetryPolicy policy = retry_policy();
+
+	for (int attempt = 0; attempt < policy.max_attempts; attempt++) {
+		// Wait before sending the request again, so retries don't hammer a struggling server.
+		if (attempt > 0) {
+			back_off(policy, attempt);
+		}
+
+		try {
+			// Send the request to the server via the provided socket.
+			boost::asio::write(sock, boost::asio::buffer(request));
+
+			// Receive the response from the server into a fixed size buffer, its fields are decoded in place (see wire.hpp).
+			Response response;
+			response.receive(sock, policy.timeout);
+
+			if (check_response(response, spec, uuid) == SPECIAL) {
+				on_special(response.getPayload());
+				return SPECIAL;
+			}
+
+			on_success(response.getPayload());
+			return SUCCESS;
+		}
+		catch (ResponseTimeout& e) {
+			LOG_ERROR(e.what());
+			count_request_error(code);
+			break;
+		}
+		catch (boost::system::system_error& e) {
+			if (spec.special_on_close && closed_by_server(e.code())) {
+				on_special(ByteView());
+				return SPECIAL;
+			}
+			LOG_ERROR(e.what());
+			count_request_error(code);
+			break;
+		}
+		catch (std::exception& e) {
+			LOG_WARNING(e.what());
+			count_request_error(code);
+		}
+	}
+
+	count_request_failure(code);
+	return FAILURE;
+}
+
+template <typename OnSuccess>
+int Request::exchange(tcp::socket& sock, const std::vector<uint8_t>& request, const Exchange& spec, OnSuccess on_success) {
+	return exchange(sock, request, spec, on_success, [](ByteView) {});
+}
+
 class Registration : public Request {
 	char name[NAME_SIZE];
 
@@ -64,33 +230,123 @@ class Reconnection : public Request {
 		std::vector<uint8_t> pack_reconnection_request() const;
 };
 
+class SendingEcdhKey : public Request {
+	char name[NAME_SIZE];
+	char public_key[ECDH_KEY_LENGTH];
+	char server_public_key[ECDH_KEY_LENGTH];
+
+	public:
+		SendingEcdhKey(UUID uuid, uint16_t code, uint32_t payload_size, const char name[], std::string public_key);
+		// Receive the server's X25519 public key received during the "ECDH Key Received" response - 1610.
+		std::string getServerPublicKey() const;
+
+		// This method runs the Sending ECDH Key request and gets the server's response, returns SPECIAL if the server does not support the ECDH handshake (it closed the connection).
+		int run(tcp::socket& sock);
+		// This method packs the Sending ECDH Key Request fields into a uint8_t vector and returns it.
+		std::vector<uint8_t> pack_sending_ecdh_key_request() const;
+};
+
+class EcdhReconnection : public Request {
+	char name[NAME_SIZE];
+	char server_public_key[ECDH_KEY_LENGTH];
+
+	public:
+		EcdhReconnection(UUID uuid, uint16_t code, uint32_t payload_size, const char name[]);
+		// Receive the server's X25519 public key received during the "ECDH Reconnection Succeeded" response - 1611.
+		std::string getServerPublicKey() const;
+
+		// This method runs the ECDH Reconnection request and gets the server's response.
+		int run(tcp::socket& sock);
+		// This method packs the ECDH Reconnection Request fields into a uint8_t vector and returns it.
+		std::vector<uint8_t> pack_ecdh_reconnection_request() const;
+};
+
+class TicketReconnection : public Request {
+	char name[NAME_SIZE];
+	char ticket[TICKET_LENGTH];
+
+	public:
+		TicketReconnection(UUID uuid, uint16_t code, uint32_t payload_size, const char name[], std::string ticket);
+
+		// This method sends the Ticket Reconnection request, the server only responds if the ticket is rejected, after the file packets that follow it.
+		int run(tcp::socket& sock);
+		// This method queues the Ticket Reconnection request, to be written along with the file packets that follow it.
+		void queue(Pipeline& pipeline) const;
+		// This method runs the request as a Checked Ticket Reconnection, the server answers it at once - returns SPECIAL if the ticket was rejected.
+		int check(tcp::socket& sock);
+		// This method packs the Ticket Reconnection Request fields into a uint8_t vector and returns it.
+		std::vector<uint8_t> pack_ticket_reconnection_request() const;
+};
+
+/*
+	Where the Sending File request takes its packets' encrypted content from, in order - the content does not have to be in
+	memory as a whole, a source may read and encrypt it as it goes.
+*/
+class PacketSource {
+	public:
+		virtual ~PacketSource() {}
+		// This method returns the next size bytes of encrypted content (fewer only if the content ended), valid until the next call.
+		virtual ByteView next(size_t size) = 0;
+};
+
+// A packet source over encrypted content already in memory, which must outlive it.
+class ViewSource : public PacketSource {
+	ByteView content;
+	size_t offset;
+
+	public:
+		ViewSource(ByteView content);
+		ByteView next(size_t size);
+};
+
+// A packet source whose length is only known once it ended, like a pipe - sent by the Sending File request in streamed mode.
+class StreamSource : public PacketSource {
+	public:
+		// The length of the original content of the packets taken so far.
+		virtual uint64_t getOrigSize() const = 0;
+		// The CRC of the original content of the packets taken so far - of the whole content, once the source ended.
+		virtual unsigned long getCksum() const = 0;
+};
+
+/*
+	Sends a file's packets. The sizes and the total packets are sent in every packet, unless the request is streamed - then
+	they are sent as 0 until the last packet, which carries them and marks the end of the file.
+*/
 class SendingFile : public Request {
-	uint32_t content_size;
-	uint32_t orig_file_size;
-	uint16_t packet_number;
-	uint16_t total_packets;
+	uint64_t content_size;
+	uint64_t orig_file_size;
+	uint64_t packet_number;
+	uint64_t total_packets;
 	char file_name[NAME_SIZE];
-	std::string encrypted_file_content;
+	PacketSource& source;
+	StreamSource* stream;
 	char encrypted_content[CONTENT_SIZE_PER_PACKET];
 	unsigned long cksum;
 
 	public:
-		SendingFile(UUID uuid, uint16_t code, uint32_t payload_size, uint32_t content_size, uint32_t orig_file_size, uint16_t total_packets, const char file_name[], std::string encrypted_file_content);
+		// The packets' content is read from the source as they are sent, the source must outlive the request.
+		SendingFile(UUID uuid, uint16_t code, uint32_t payload_size, uint64_t content_size, uint64_t orig_file_size, uint64_t total_packets, const char file_name[], PacketSource& source);
+		// A streamed request, its packets are taken from the source until it ends.
+		SendingFile(UUID uuid, uint16_t code, uint32_t payload_size, const char file_name[], StreamSource& source);
 		// Set the encrypted data for the current packet.
-		void setEncryptedContent(std::string encrypted_content);
+		void setEncryptedContent(ByteView encrypted_content);
 		// Set the cksum.
 		void setCksum(unsigned long cksum);
 		// Receive the cksum received by the server during the "File received CRC" response - 1603.
 		unsigned long getCksum() const;
 
-		// This method runs the Sending File request and gets the server's response.
+		// This method runs the Sending File request and gets the server's response, returns SPECIAL if the session ticket sent before it was rejected.
 		int run(tcp::socket& sock);
+		// This method runs the Sending File request with its packets queued after the requests already in the pipeline, written PIPELINE_WRITE_SIZE bytes at a time.
+		int run(tcp::socket& sock, Pipeline& pipeline);
 		// This method packs the Sending File Request fields into a uint8_t vector and returns it.
 		std::vector<uint8_t> pack_sending_file_request() const;
-		// This method saves the response's content size in a uint32_t variable, reorders it from little endian order to the OS's native endianess ordering and returns it.
-		uint32_t getPayloadContentSize(std::vector<uint8_t> payload);
+		// This method packs the Sending File Request fields into the given buffer, which has room for the whole request.
+		void pack_sending_file_request(uint8_t* req) const;
+		// This method saves the response's content size in a uint64_t variable, reorders it from little endian order to the OS's native endianess ordering and returns it.
+		uint64_t getPayloadContentSize(ByteView payload);
 		// This method saves the response's cksum in a uint32_t variable, reorders it from little endian order to the OS's native endianess ordering and returns it.
-		uint32_t getPayloadCksum(std::vector<uint8_t> payload);
+		uint32_t getPayloadCksum(ByteView payload);
 };
 
 class ValidCrc : public Request {
@@ -101,10 +357,43 @@ class ValidCrc : public Request {
 
 		// This method runs the Valid CRC request and gets the server's response.
 		int run(tcp::socket &sock);
+		// This method queues the Valid CRC request, to be written along with the requests that follow it - on_confirmed is called once the server's response was read.
+		void queue(Pipeline& pipeline, std::function<void()> on_confirmed) const;
 		// This method packs the Valid CRC Request fields into a uint8_t vector and returns it.
 		std::vector<uint8_t> pack_valid_crc_request() const;
 };
 
+class ValidCrcTicket : public Request {
+	char file_name[NAME_SIZE];
+	uint32_t lifetime;
+	char encrypted_resumption_key[ENC_RESUMPTION_KEY_LENGTH];
+	char ticket[TICKET_LENGTH];
+
+	public:
+		ValidCrcTicket(UUID uuid, uint16_t code, uint32_t payload_size, const char file_name[]);
+		// Receive the session ticket's lifetime in seconds, received by the server during the "Message Received Ticket" response - 1612.
+		uint32_t getLifetime() const;
+		// Receive the resumption AES key (encrypted using the current AES key) received by the server during the "Message Received Ticket" response - 1612.
+		std::string getEncryptedResumptionKey() const;
+		// Receive the session ticket received by the server during the "Message Received Ticket" response - 1612.
+		std::string getTicket() const;
+
+		// This method runs the Valid CRC Ticket request and gets the server's response, returns SPECIAL if the server closes the connection instead (it predates session tickets).
+		int run(tcp::socket& sock);
+		/*
+			This method queues the Valid CRC Ticket request, to be written along with the requests that follow it - on_confirmed is
+			called once the server's response was read, and its ticket taken. The request must outlive the response being read.
+			Only queued for a server known to issue session tickets, a server that predates them drops the connection on the request.
+		*/
+		void queue(Pipeline& pipeline, std::function<void()> on_confirmed);
+		// This method packs the Valid CRC Ticket Request fields into a uint8_t vector and returns it.
+		std::vector<uint8_t> pack_valid_crc_ticket_request() const;
+		// This method saves the response's ticket lifetime in a uint32_t variable, reorders it from little endian order to the OS's native endianess ordering and returns it.
+		uint32_t getPayloadLifetime(ByteView payload);
+		// This method copies the ticket lifetime, the encrypted resumption key and the ticket from the response's payload.
+		void setPayloadTicket(ByteView payload);
+};
+
 class SendingCrcAgain : public Request {
 	char file_name[NAME_SIZE];
 
@@ -113,6 +402,8 @@ class SendingCrcAgain : public Request {
 
 		// This method runs the Sending CRC Again request and gets the server's response.
 		int run(tcp::socket &sock);
+		// This method queues the Sending CRC Again request, to be written along with the file packets sent again after it.
+		void queue(Pipeline& pipeline) const;
 		// This method packs the Sending CRC Again Request fields into a uint8_t vector and returns it.
 		std::vector<uint8_t> pack_sending_crc_again_request() const;
 };
@@ -125,6 +416,26 @@ class InvalidCrcDone : public Request {
 
 		// This method runs the Invalid CRC Done request and gets the server's response.
 		int run(tcp::socket &sock);
+		// This method writes the requests queued in the pipeline, then runs the Invalid CRC Done request.
+		int run(tcp::socket &sock, Pipeline& pipeline);
 		// This method packs the Invalid CRC Done Request fields into a uint8_t vector and returns it.
 		std::vector<uint8_t> pack_invalid_crc_done_request() const;
 };
+
+
+class Multiplex : public Request {
+	uint32_t window;
+
+	public:
+		Multiplex(UUID uuid, uint16_t code, uint32_t payload_size);
+
+		// Receive the initial credit of every stream received by the server during the "Multiplex Accepted" response - 1614.
+		uint32_t getWindow() const;
+
+		// This method runs the Multiplex request and gets the server's response, from then on the connection carries framed streams (see mux.hpp).
+		int run(tcp::socket& sock);
+		// This method packs the Multiplex Request fields into a uint8_t vector and returns it.
+		std::vector<uint8_t> pack_multiplex_request() const;
+};
+
+#endif
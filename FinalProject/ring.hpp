@@ -0,0 +1,255 @@
+#ifndef RING_H
+#define RING_H
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RING_PAUSE() _mm_pause()
+#else
+#define RING_PAUSE()
+#endif
+
+/*
+	Bounded lock-free ring buffers, handing small values (usually pointers to pooled buffers) between threads.
+	The producer's and the consumer's positions sit on cache lines of their own, so the two sides only share a line when one
+	of them actually has to look at the other's position - a ring that's neither full nor empty hands a value off without a
+	single shared write.
+	A full ring is back-pressure: push() waits until the consumer makes room, spinning briefly, then yielding, then sleeping -
+	a stage that's far ahead of the next one doesn't burn a core waiting for it.
+*/
+
+// Assumed rather than taken from std::hardware_destructive_interference_size, which not every compiler has.
+constexpr auto CACHE_LINE_SIZE = 64;
+// How many times a waiting thread spins, and then yields, before it starts sleeping between its checks.
+constexpr auto RING_SPIN_ROUNDS = 64;
+constexpr auto RING_SLEEP_US = 50;
+
+// This method waits a little, longer on every call of the same wait - round counts the calls.
+inline void ring_backoff(unsigned& round) {
+	// On a single core the other side can't make progress while this one spins, the wait starts by yielding to it.
+	static const bool spins = std::thread::hardware_concurrency() > 1;
+	if (round < RING_SPIN_ROUNDS && spins) {
+		RING_PAUSE();
+	}
+	else if (round < 2 * RING_SPIN_ROUNDS) {
+		std::this_thread::yield();
+	}
+	else {
+		std::this_thread::sleep_for(std::chrono::microseconds(RING_SLEEP_US));
+	}
+	round++;
+}
+
+// This method returns the smallest power of two of at least the given capacity (and at least 2).
+inline size_t ring_capacity(size_t capacity) {
+	size_t size = 2;
+	while (size < capacity) {
+		size <<= 1;
+	}
+	return size;
+}
+
+// A ring with a single producer thread and a single consumer thread.
+template <typename T>
+class SpscRing {
+	std::unique_ptr<T[]> slots;
+	size_t mask;
+	// The consumer's position, and the producer's position as the consumer saw it last.
+	alignas(CACHE_LINE_SIZE) std::atomic<size_t> head;
+	size_t tail_cache;
+	// The producer's position, and the consumer's position as the producer saw it last.
+	alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail;
+	size_t head_cache;
+
+	public:
+		// The capacity is rounded up to a power of two.
+		SpscRing(size_t capacity) :
+			slots(new T[ring_capacity(capacity)]),
+			mask(ring_capacity(capacity) - 1),
+			head(0),
+			tail_cache(0),
+			tail(0),
+			head_cache(0)
+		{
+
+		}
+		SpscRing(const SpscRing&) = delete;
+		SpscRing& operator=(const SpscRing&) = delete;
+
+		// This method adds a value, returns false if the ring is full. Producer only.
+		bool tryPush(const T& value) {
+			size_t position = tail.load(std::memory_order_relaxed);
+			if (position - head_cache > mask) {
+				head_cache = head.load(std::memory_order_acquire);
+				if (position - head_cache > mask) {
+					return false;
+				}
+			}
+			slots[position & mask] = value;
+			tail.store(position + 1, std::memory_order_release);
+			return true;
+		}
+
+		// This method adds a value, waiting while the ring is full. Returns false if cancelled while waiting. Producer only.
+		bool push(const T& value, const std::atomic<bool>& cancelled) {
+			unsigned round = 0;
+			while (!tryPush(value)) {
+				if (cancelled.load(std::memory_order_relaxed)) {
+					return false;
+				}
+				ring_backoff(round);
+			}
+			return true;
+		}
+
+		// This method takes up to max values (oldest first) into values, returns how many - 0 if the ring is empty. Consumer only.
+		size_t tryPopBatch(T* values, size_t max) {
+			size_t position = head.load(std::memory_order_relaxed);
+			if (tail_cache == position) {
+				tail_cache = tail.load(std::memory_order_acquire);
+				if (tail_cache == position) {
+					return 0;
+				}
+			}
+
+			size_t amount = tail_cache - position;
+			if (amount > max) {
+				amount = max;
+			}
+			for (size_t i = 0; i < amount; i++) {
+				values[i] = slots[(position + i) & mask];
+			}
+			head.store(position + amount, std::memory_order_release);
+			return amount;
+		}
+
+		// This method takes up to max values, waiting while the ring is empty. Returns 0 only if cancelled while waiting. Consumer only.
+		size_t popBatch(T* values, size_t max, const std::atomic<bool>& cancelled) {
+			unsigned round = 0;
+			size_t amount;
+			while ((amount = tryPopBatch(values, max)) == 0) {
+				if (cancelled.load(std::memory_order_relaxed)) {
+					return 0;
+				}
+				ring_backoff(round);
+			}
+			return amount;
+		}
+};
+
+// A ring any number of threads push into and pop from - every slot carries a sequence number telling whose turn it is.
+template <typename T>
+class MpmcRing {
+	struct Slot {
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	std::unique_ptr<Slot[]> slots;
+	size_t mask;
+	alignas(CACHE_LINE_SIZE) std::atomic<size_t> enqueue_position;
+	alignas(CACHE_LINE_SIZE) std::atomic<size_t> dequeue_position;
+
+	public:
+		// The capacity is rounded up to a power of two.
+		MpmcRing(size_t capacity) :
+			slots(new Slot[ring_capacity(capacity)]),
+			mask(ring_capacity(capacity) - 1),
+			enqueue_position(0),
+			dequeue_position(0)
+		{
+			for (size_t i = 0; i <= mask; i++) {
+				slots[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+		MpmcRing(const MpmcRing&) = delete;
+		MpmcRing& operator=(const MpmcRing&) = delete;
+
+		// This method adds a value, returns false if the ring is full.
+		bool tryPush(const T& value) {
+			size_t position = enqueue_position.load(std::memory_order_relaxed);
+			Slot* slot;
+			while (true) {
+				slot = &slots[position & mask];
+				intptr_t difference = static_cast<intptr_t>(slot->sequence.load(std::memory_order_acquire)) - static_cast<intptr_t>(position);
+				if (difference == 0) {
+					if (enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+						break;
+					}
+				}
+				else if (difference < 0) {
+					return false;
+				}
+				else {
+					position = enqueue_position.load(std::memory_order_relaxed);
+				}
+			}
+			slot->value = value;
+			slot->sequence.store(position + 1, std::memory_order_release);
+			return true;
+		}
+
+		// This method adds a value, waiting while the ring is full. Returns false if cancelled while waiting.
+		bool push(const T& value, const std::atomic<bool>& cancelled) {
+			unsigned round = 0;
+			while (!tryPush(value)) {
+				if (cancelled.load(std::memory_order_relaxed)) {
+					return false;
+				}
+				ring_backoff(round);
+			}
+			return true;
+		}
+
+		// This method takes the oldest value, returns false if the ring is empty.
+		bool tryPop(T& value) {
+			size_t position = dequeue_position.load(std::memory_order_relaxed);
+			Slot* slot;
+			while (true) {
+				slot = &slots[position & mask];
+				intptr_t difference = static_cast<intptr_t>(slot->sequence.load(std::memory_order_acquire)) - static_cast<intptr_t>(position + 1);
+				if (difference == 0) {
+					if (dequeue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+						break;
+					}
+				}
+				else if (difference < 0) {
+					return false;
+				}
+				else {
+					position = dequeue_position.load(std::memory_order_relaxed);
+				}
+			}
+			value = slot->value;
+			slot->sequence.store(position + mask + 1, std::memory_order_release);
+			return true;
+		}
+
+		// This method takes up to max values into values, returns how many - 0 if the ring is empty.
+		size_t tryPopBatch(T* values, size_t max) {
+			size_t amount = 0;
+			while (amount < max && tryPop(values[amount])) {
+				amount++;
+			}
+			return amount;
+		}
+
+		// This method takes up to max values, waiting while the ring is empty. Returns 0 only if cancelled while waiting.
+		size_t popBatch(T* values, size_t max, const std::atomic<bool>& cancelled) {
+			unsigned round = 0;
+			size_t amount;
+			while ((amount = tryPopBatch(values, max)) == 0) {
+				if (cancelled.load(std::memory_order_relaxed)) {
+					return 0;
+				}
+				ring_backoff(round);
+			}
+			return amount;
+		}
+};
+
+#endif
@@ -0,0 +1,679 @@
+#include "session.hpp"
+
+// This method sets the client's saved name and id, returns its private key.
+static std::string load_credentials(Client& client) {
+	std::string name;
+	UUID uuid;
+	std::string private_key = client.getCredentials().loadCredentials(name, uuid);
+
+	client.setName(name);
+	client.setUuid(uuid);
+	return private_key;
+}
+
+// This method drops the connection and opens a new one to the client's server, without a handshake.
+static int reopen_connection(tcp::socket& sock, Client& client) {
+	boost::system::error_code ec;
+	sock.close(ec);
+
+	try {
+		tcp::resolver resolver(sock.get_executor());
+		connect_tuned(sock, resolver.resolve(client.getAddress(), client.getPort()));
+	}
+	catch (std::exception& e) {
+		LOG_ERROR(e.what());
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+/*
+	This method sends the client's public key to the server, saving the matching private key into the client's credentials.
+	An X25519 key is tried first (if PREFER_ECDH is set); if the server does not support the ECDH handshake (it drops the
+	connection on the request), the connection is opened again and an RSA pair from the key pool is sent in a SendingPublicKey
+	request instead. The server already registered the client, so the new connection goes on from there.
+	On success, the AES key agreed with the server is saved into decrypted_aes_key.
+*/
+static int send_public_key(tcp::socket& sock, Client& client, KeyPool& key_pool, std::string& decrypted_aes_key) {
+	int op_success;
+	UUID uuid = client.getUuid();
+	std::string id(uuid.begin(), uuid.end());
+
+	if (PREFER_ECDH) {
+		X25519Wrapper ecdhKeyWrapper;
+
+		client.getCredentials().saveCredentials(client.getName(), client.getUuid(), ecdhKeyWrapper.getPrivateKey());
+		SendingEcdhKey sending_ecdh_key(client.getUuid(), Codes::SENDING_ECDH_KEY_C, PayloadSize::SENDING_ECDH_KEY_P, client.getName().c_str(), ecdhKeyWrapper.getPublicKey());
+		op_success = sending_ecdh_key.run(sock);
+
+		if (op_success == SUCCESS) {
+			// Derive the AES key from the shared secret, using the client id as the salt.
+			decrypted_aes_key = ecdhKeyWrapper.deriveAesKey(sending_ecdh_key.getServerPublicKey(), id);
+		}
+		if (op_success != SPECIAL) {
+			return op_success;
+		}
+		// The server does not support the ECDH handshake, fall back to RSA - and keep RSA key pairs in stock from now on.
+		LOG_INFO("The server does not support the ECDH handshake, sending an RSA public key.");
+		key_pool.prefill();
+		if (reopen_connection(sock, client) == FAILURE) {
+			return FAILURE;
+		}
+	}
+
+	// The key pair was (most likely) generated by the pool's worker thread during the registration round-trip.
+	std::unique_ptr<RSAPrivateWrapper> prevKeyWrapper = key_pool.acquire();
+	std::string public_key = prevKeyWrapper->getPublicKey();
+
+	client.getCredentials().saveCredentials(client.getName(), client.getUuid(), prevKeyWrapper->getPrivateKey());
+	SendingPublicKey sending_pub_key(client.getUuid(), Codes::SENDING_PUBLIC_KEY_C, PayloadSize::SENDING_PUBLIC_KEY_P, client.getName().c_str(), public_key);
+	op_success = sending_pub_key.run(sock);
+
+	if (op_success == FAILURE) {
+		return FAILURE;
+	}
+
+	// Get the encrypted AES key and decrypt it.
+	std::string encrypted_aes_key = sending_pub_key.getEncryptedAesKey();
+	decrypted_aes_key = prevKeyWrapper->decrypt(encrypted_aes_key);
+	return SUCCESS;
+}
+
+/*
+	This method sends a reconnection request matching the type of the saved private key - ECDH Reconnection for an X25519 key,
+	and Reconnection for an RSA key.
+	On success, the AES key agreed with the server is saved into decrypted_aes_key. If the server registered the client instead,
+	the client's new UUID is set and SPECIAL is returned.
+*/
+static int reconnect(tcp::socket& sock, Client& client, const std::string& private_key, std::string& decrypted_aes_key) {
+	int op_success;
+	UUID uuid = client.getUuid();
+	std::string id(uuid.begin(), uuid.end());
+
+	if (private_key.size() == X25519Wrapper::KEYSIZE) {
+		EcdhReconnection reconnection(client.getUuid(), Codes::ECDH_RECONNECTION_C, PayloadSize::ECDH_RECONNECTION_P, client.getName().c_str());
+		op_success = reconnection.run(sock);
+
+		if (op_success == SUCCESS) {
+			// Derive the AES key from the shared secret, using the client id as the salt.
+			X25519Wrapper ecdhKeyWrapper(private_key);
+			decrypted_aes_key = ecdhKeyWrapper.deriveAesKey(reconnection.getServerPublicKey(), id);
+		}
+		else if (op_success == SPECIAL) {
+			client.setUuid(reconnection.getUuid());
+		}
+		return op_success;
+	}
+
+	Reconnection reconnection(client.getUuid(), Codes::RECONNECTION_C, PayloadSize::RECONNECTION_P, client.getName().c_str());
+	op_success = reconnection.run(sock);
+
+	if (op_success == SUCCESS) {
+		// Create the decryptor, get the encrypted AES key and decrypt it.
+		RSAPrivateWrapper prevKeyWrapper(private_key);
+		std::string encrypted_aes_key = reconnection.getEncryptedAesKey();
+		decrypted_aes_key = prevKeyWrapper.decrypt(encrypted_aes_key);
+	}
+	else if (op_success == SPECIAL) {
+		client.setUuid(reconnection.getUuid());
+	}
+	return op_success;
+}
+
+/*
+	This method performs the full handshake with the server - Registration if the client has no saved credentials and Reconnection otherwise,
+	followed by sending the client's public key if needed.
+	On success, the AES key agreed with the server is saved into decrypted_aes_key.
+*/
+int handshake(tcp::socket& sock, Client& client, KeyPool& key_pool, std::string& decrypted_aes_key) {
+	TRACE_SPAN("handshake");
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	int op_success;
+	std::string private_key;
+
+	// If the client did not register before, send Registration request.
+	if (!client.getCredentials().hasCredentials()) {
+		Registration registration(client.getUuid(), Codes::REGISTRATION_C, PayloadSize::REGISTRATION_P, client.getName().c_str());
+		op_success = registration.run(sock);
+
+		if (op_success == FAILURE) {
+			FATAL_MESSAGE_RETURN_FAILURE("Registration");
+		}
+
+		// Set client's new UUID and send a SendingPublicKey request.
+		client.setUuid(registration.getUuid());
+		op_success = send_public_key(sock, client, key_pool, decrypted_aes_key);
+
+		if (op_success == FAILURE) {
+			FATAL_MESSAGE_RETURN_FAILURE("Sending Public Key");
+		}
+	}
+	else { // If the client has saved credentials, read id and send reconnection request.
+		private_key = load_credentials(client);
+
+		// Send Reconnection request to the server.
+		op_success = reconnect(sock, client, private_key, decrypted_aes_key);
+
+		if (op_success == FAILURE) { // Request failed.
+			FATAL_MESSAGE_RETURN_FAILURE("Reconnection");
+		}
+		else if (op_success == SPECIAL) { // Registration succeded instead of Reconnection, send the client's public key.
+			op_success = send_public_key(sock, client, key_pool, decrypted_aes_key);
+
+			if (op_success == FAILURE) {
+				FATAL_MESSAGE_RETURN_FAILURE("Sending Public Key");
+			}
+		}
+	}
+
+	observe_handshake(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	return SUCCESS;
+}
+
+int start_session(tcp::socket& sock, Client& client, KeyPool& key_pool, std::string& decrypted_aes_key, std::string& ticket) {
+	// A returning client holding an unexpired session ticket skips the handshake, the ticket is sent right before the first file's packets.
+	if (client.getCredentials().hasCredentials() && client.getCredentials().takeTicket(ticket, decrypted_aes_key)) {
+		load_credentials(client);
+		return SUCCESS;
+	}
+
+	return handshake(sock, client, key_pool, decrypted_aes_key);
+}
+
+// This method saves the session ticket the server sent along with its CRC confirmation for the next run, the resumption key is encrypted using the current AES key.
+static void save_confirmation_ticket(Client& client, const ValidCrcTicket& valid_crc, const std::string& decrypted_aes_key) {
+	AESWrapper aesKeyWrapper(reinterpret_cast<const unsigned char *>(decrypted_aes_key.c_str()), static_cast<unsigned int>(decrypted_aes_key.size()));
+	std::string encrypted_resumption_key = valid_crc.getEncryptedResumptionKey();
+	std::string resumption_key = aesKeyWrapper.decrypt(encrypted_resumption_key.c_str(), static_cast<unsigned int>(encrypted_resumption_key.size()));
+	client.getCredentials().saveTicket(valid_crc.getTicket(), resumption_key, valid_crc.getLifetime());
+}
+
+/*
+	This method confirms the file's CRC with a Valid CRC Ticket request, saving the session ticket the server sends along with its confirmation.
+	A server that predates session tickets drops the connection on the unknown request - the connection is opened again and the file
+	is confirmed with a Valid CRC request instead, and so are the client's next files. The server keeps the client's state across
+	connections, so the new connection needs no handshake.
+*/
+static int confirm_crc(tcp::socket& sock, Client& client, const std::string& decrypted_aes_key, const std::string& file_name) {
+	if (client.getIssuesTickets()) {
+		ValidCrcTicket valid_crc(client.getUuid(), Codes::VALID_CRC_TICKET_C, PayloadSize::VALID_CRC_TICKET_P, file_name.c_str());
+		int op_success = valid_crc.run(sock);
+
+		if (op_success != SPECIAL) {
+			if (op_success == SUCCESS) {
+				save_confirmation_ticket(client, valid_crc, decrypted_aes_key);
+			}
+			return op_success;
+		}
+		LOG_INFO("The server does not issue session tickets, confirming files with Valid CRC.");
+		client.setIssuesTickets(false);
+		if (reopen_connection(sock, client) == FAILURE) {
+			return FAILURE;
+		}
+	}
+
+	ValidCrc valid_crc(client.getUuid(), Codes::VALID_CRC_C, PayloadSize::VALID_CRC_P, file_name.c_str());
+	return valid_crc.run(sock);
+}
+
+/*
+	This method queues the file's CRC confirmation in the pipeline, to be written along with the requests that follow it - like
+	confirm_crc, the session ticket the server sends along with its confirmation is saved. on_confirmed is called once the
+	server's confirmation was read. Only for a server whose support for session tickets is known (see confirm_crc).
+*/
+static void queue_confirmation(Pipeline& pipeline, Client& client, const std::string& decrypted_aes_key, const std::string& file_name, std::function<void()> on_confirmed) {
+	if (client.getIssuesTickets()) {
+		// The request is kept by its own response handler, until the response was read.
+		std::shared_ptr<ValidCrcTicket> valid_crc = std::make_shared<ValidCrcTicket>(client.getUuid(), Codes::VALID_CRC_TICKET_C, PayloadSize::VALID_CRC_TICKET_P, file_name.c_str());
+		valid_crc->queue(pipeline, [&client, valid_crc, decrypted_aes_key, on_confirmed] {
+			save_confirmation_ticket(client, *valid_crc, decrypted_aes_key);
+			on_confirmed();
+		});
+		return;
+	}
+
+	ValidCrc valid_crc(client.getUuid(), Codes::VALID_CRC_C, PayloadSize::VALID_CRC_P, file_name.c_str());
+	valid_crc.queue(pipeline, on_confirmed);
+}
+
+/*
+	This method drops the connection and opens a new one, with the full handshake. After a failed attempt the connection is out
+	of step with the server - part of a request may have been written, or a response may still be on its way.
+*/
+static int reconnect_session(tcp::socket& sock, Client& client, KeyPool& key_pool, std::string& decrypted_aes_key) {
+	TRACE_SPAN("reconnect");
+	if (reopen_connection(sock, client) == FAILURE) {
+		return FAILURE;
+	}
+	return handshake(sock, client, key_pool, decrypted_aes_key);
+}
+
+/*
+	This method sends the source's content until the server's CRC matches it, up to MAX_INVALID_CRC times (see upload_content),
+	without confirming the CRC. The requests are written through the pipeline, after the requests already queued in it - control
+	requests that don't wait for a response (the session ticket, Sending CRC Again) are written along with the file packets that follow them.
+	Returns SUCCESS if the server's CRC matched, SPECIAL if the CRC was invalid four times (the server was told so), and FAILURE otherwise.
+*/
+static int send_content(tcp::socket& sock, Client& client, KeyPool& key_pool, std::string& decrypted_aes_key, std::string& ticket, UploadSource& source, std::string file_name, uint16_t code, Pipeline& pipeline) {
+	int op_success;
+
+	int file_error_cnt = 0, times_crc_sent = 0;
+	while (file_error_cnt != MAX_REQUEST_FAILS && times_crc_sent != MAX_INVALID_CRC) {
+		// The content is only encrypted again if the AES key changed (or, for a file, if the file did).
+		source.refresh(decrypted_aes_key);
+
+		uint64_t content_size = source.getContentSize();
+		uint64_t orig_size = source.getOrigSize();
+
+		// Save the total packets and send the Sending File request to the server, its packets are taken from the source.
+		uint64_t total_packs = TOTAL_PACKETS(content_size);
+
+		SendingFile sendingFile(client.getUuid(), code, PayloadSize::SENDING_FILE_P, content_size, orig_size, total_packs, file_name.c_str(), source);
+
+		// Send the session ticket right before the file's packets, without waiting for a response. A ticket is only used once.
+		if (!ticket.empty()) {
+			TicketReconnection ticket_reconnection(client.getUuid(), Codes::TICKET_RECONNECTION_C, PayloadSize::TICKET_RECONNECTION_P, client.getName().c_str(), ticket);
+			ticket_reconnection.queue(pipeline);
+			ticket.clear();
+		}
+
+		op_success = sendingFile.run(sock, pipeline);
+		// If the session ticket was rejected the server dropped the file, perform the full handshake and send the file again.
+		if (op_success == SPECIAL) {
+			if (handshake(sock, client, key_pool, decrypted_aes_key) == FAILURE) {
+				return FAILURE;
+			}
+			continue;
+		}
+		// If the sending file request did not succeed, add 1 to sending file error counter, and send the file again over a new connection.
+		if (op_success == FAILURE) {
+			pipeline.clear();
+			if (++file_error_cnt != MAX_REQUEST_FAILS && reconnect_session(sock, client, key_pool, decrypted_aes_key) == FAILURE) {
+				FATAL_MESSAGE_RETURN_FAILURE("Sending File");
+			}
+			continue;
+		}
+
+		// Get the cksum the server responded with, and the content's own (computed when it was read).
+		unsigned long response_cksum = sendingFile.getCksum();
+		unsigned long request_cksum = source.getCksum();
+
+		LOG_DEBUG("File CRC " << request_cksum << ", server CRC " << response_cksum);
+
+		if (response_cksum == request_cksum) {
+			break;
+		}
+		
+		// If the crc given by the server is incorrect, send Sending Crc Again request - 901, along with the file's packets sent again.
+		count_metric(CRC_MISMATCHES);
+		SendingCrcAgain sendingCrcAgain(client.getUuid(), Codes::SENDING_CRC_AGAIN_C, PayloadSize::SENDING_CRC_AGAIN_P, file_name.c_str());
+		sendingCrcAgain.queue(pipeline);
+		
+		// If the sending crc request did not succeed, add 1 to times crc sent counter.
+		times_crc_sent++;
+	}
+	if (file_error_cnt == MAX_REQUEST_FAILS) { // If the Sending File request failed three times print fatal and return.
+		FATAL_MESSAGE_RETURN_FAILURE("Sending File");
+	}
+	else if (times_crc_sent == MAX_INVALID_CRC) { // If the CRC was invalid three times,
+		InvalidCrcDone invalid_crc_done(client.getUuid(), Codes::INVALID_CRC_DONE_C, PayloadSize::INVALID_CRC_DONE_P, file_name.c_str());
+		op_success = invalid_crc_done.run(sock, pipeline);
+
+		if (op_success == FAILURE) {
+			FATAL_MESSAGE_RETURN_FAILURE("Invalid CRC for the fourth time");
+		}
+		return SPECIAL;
+	}
+
+	return SUCCESS;
+}
+
+int upload_content(tcp::socket& sock, Client& client, KeyPool& key_pool, std::string& decrypted_aes_key, std::string& ticket, UploadSource& source, std::string file_name, uint16_t code) {
+	Pipeline pipeline;
+	int op_success = send_content(sock, client, key_pool, decrypted_aes_key, ticket, source, file_name, code, pipeline);
+
+	if (op_success == SUCCESS && confirm_crc(sock, client, decrypted_aes_key, file_name) == FAILURE) {
+		FATAL_MESSAGE_RETURN_FAILURE("Valid CRC");
+	}
+
+	return op_success;
+}
+
+// This method returns true if the server already confirmed the upload of the file, and the file's identity is unchanged since - checking it costs a single stat.
+static bool upload_confirmed(Client& client, const std::string& file_path) {
+	FileIdentity identity;
+	FileFingerprint fingerprint;
+	return stat_file(EXE_DIR_FILE_PATH(file_path), identity) && fingerprint_index().lookup(fingerprint_key(file_path), fingerprint) &&
+		fingerprint.identity == identity && fingerprint.confirmed_by == confirmation_id(client.getAddress(), client.getPort(), client.getUuid());
+}
+
+// This method records the content of the files the server confirmed in the fingerprint index, the next upload of an unchanged one is skipped.
+static void record_confirmed(Client& client, const std::vector<std::string>& file_paths, const std::vector<FileFingerprint>& fingerprints) {
+	uint64_t confirmed_by = confirmation_id(client.getAddress(), client.getPort(), client.getUuid());
+	for (size_t i = 0; i < file_paths.size(); i++) {
+		FileFingerprint confirmed = fingerprints[i];
+		confirmed.confirmed_by = confirmed_by;
+		fingerprint_index().update(fingerprint_key(file_paths[i]), confirmed);
+	}
+}
+
+// This method uploads the file's encrypted content, and records it in the fingerprint index once the server confirmed it.
+static int upload_encrypted_file(tcp::socket& sock, Client& client, KeyPool& key_pool, std::string& decrypted_aes_key, std::string& ticket, EncryptedFile& encrypted_file, std::string file_path) {
+	int op_success = upload_content(sock, client, key_pool, decrypted_aes_key, ticket, encrypted_file, file_path);
+
+	if (op_success == SUCCESS) {
+		record_confirmed(client, { file_path }, { encrypted_file.getFingerprint() });
+	}
+
+	return op_success;
+}
+
+int upload_file(tcp::socket& sock, Client& client, KeyPool& key_pool, std::string& decrypted_aes_key, std::string& ticket, std::string file_path) {
+	// A file the server already confirmed is not uploaded again while its identity is unchanged.
+	if (upload_confirmed(client, file_path)) {
+		LOG_INFO(file_path << " is unchanged since its upload was confirmed, skipping it.");
+		count_metric(UPLOADS_SKIPPED);
+		return SUCCESS;
+	}
+
+	// The encrypted content is kept between the attempts, the file is only read and encrypted again if it (or the AES key) changed.
+	EncryptedFile encrypted_file(file_path);
+	return upload_encrypted_file(sock, client, key_pool, decrypted_aes_key, ticket, encrypted_file, file_path);
+}
+
+int upload_bundle(tcp::socket& sock, Client& client, KeyPool& key_pool, std::string& decrypted_aes_key, std::string& ticket, FileBundle& bundle) {
+	int op_success = upload_content(sock, client, key_pool, decrypted_aes_key, ticket, bundle, bundle.getName(), Codes::SENDING_BUNDLE_C);
+
+	// The server unpacked every file of a confirmed bundle, each one is recorded as if it was uploaded on its own.
+	if (op_success == SUCCESS) {
+		record_confirmed(client, bundle.getFilePaths(), bundle.getFingerprints());
+	}
+
+	return op_success;
+}
+
+// This method returns the name the server keeps a bundled file by - its name without the directories (of either separator), in lower case as the server's file system may ignore case.
+static std::string bundled_name(const std::string& file_path) {
+	std::string name = file_path.substr(file_path.find_last_of("\\/") + 1);
+	std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return name;
+}
+
+namespace {
+	// A file of a batch, or a bundle of its small files - prepared by a worker, then sent over the session's connection.
+	struct BatchItem {
+		std::string file_path;
+		std::unique_ptr<EncryptedFile> file;
+		std::unique_ptr<FileBundle> bundle;
+		std::exception_ptr error;
+	};
+
+	// An item whose CRC confirmation was queued - its files are recorded in the fingerprint index once the server confirmed it.
+	struct PendingConfirmation {
+		std::string name;
+		std::vector<std::string> file_paths;
+		std::vector<FileFingerprint> fingerprints;
+		bool confirmed = false;
+	};
+}
+
+int upload_files(tcp::socket& sock, Client& client, KeyPool& key_pool, std::string& decrypted_aes_key, std::string& ticket, const std::vector<std::string>& file_paths, WorkStealingPool& pool) {
+	TRACE_SPAN("batch");
+	std::vector<std::unique_ptr<BatchItem>> items;
+	// The indexes of the items the workers finished preparing, in the order they finished.
+	std::deque<size_t> ready;
+	std::mutex ready_lock;
+	std::condition_variable ready_changed;
+
+	// The small files waiting for the next bundle, the names the server keeps them by, and the size of their content.
+	std::vector<std::string> bundled;
+	std::set<std::string> bundled_names;
+	uint64_t bundled_size = 0;
+	size_t next_path = 0, bundles = 0, in_flight = 0, window = pool.getSize() * BATCH_PREPARE_AHEAD;
+	int result = SUCCESS;
+	bool stop = false;
+
+	// An item's CRC confirmation is written along with the next item's packets, and its response read before theirs (see Pipeline).
+	// Only the batch's first confirmation is awaited on its own, it finds out whether the server issues session tickets.
+	Pipeline pipeline;
+	bool confirmed_once = false;
+	std::vector<std::shared_ptr<PendingConfirmation>> confirmations;
+
+	// This method returns the batch's next item, null once every file was taken. Small files are held back until a bundle of them is full, or the batch ends.
+	auto next_item = [&]() -> std::unique_ptr<BatchItem> {
+		while (next_path < file_paths.size()) {
+			const std::string& file_path = file_paths[next_path++];
+			if (upload_confirmed(client, file_path)) {
+				LOG_INFO(file_path << " is unchanged since its upload was confirmed, skipping it.");
+				count_metric(UPLOADS_SKIPPED);
+				continue;
+			}
+
+			// A file that can't be stat'ed is uploaded on its own, its error is reported when a worker tries to read it.
+			FileIdentity identity;
+			if (!stat_file(EXE_DIR_FILE_PATH(file_path), identity) || identity.size > BUNDLE_FILE_LIMIT) {
+				std::unique_ptr<BatchItem> item = std::make_unique<BatchItem>();
+				item->file_path = file_path;
+				item->file = std::make_unique<EncryptedFile>(file_path);
+				return item;
+			}
+
+			// The server keeps a bundle's files by their names, a file named like one already in the bundle starts the next bundle.
+			if (!bundled_names.insert(bundled_name(file_path)).second) {
+				next_path--;
+				break;
+			}
+			bundled.push_back(file_path);
+			bundled_size += identity.size;
+			if (bundled.size() < BUNDLE_MAX_FILES && bundled_size < BUNDLE_SIZE_LIMIT) {
+				continue;
+			}
+			break;
+		}
+
+		if (bundled.empty()) {
+			return nullptr;
+		}
+
+		// A single small file isn't worth a bundle's index.
+		std::unique_ptr<BatchItem> item = std::make_unique<BatchItem>();
+		if (bundled.size() == 1) {
+			item->file_path = bundled.front();
+			item->file = std::make_unique<EncryptedFile>(bundled.front());
+		}
+		else {
+			item->bundle = std::make_unique<FileBundle>(bundle_name(++bundles), bundled);
+			item->file_path = item->bundle->getName();
+		}
+		bundled.clear();
+		bundled_names.clear();
+		bundled_size = 0;
+		return item;
+	};
+
+	// This method sends the item's content, and confirms its CRC or queues its confirmation.
+	auto send_item = [&](BatchItem& item) -> int {
+		std::shared_ptr<PendingConfirmation> confirmation = std::make_shared<PendingConfirmation>();
+		confirmation->name = item.file_path;
+
+		int op_success;
+		// The content was encrypted with the current AES key, unless a full handshake changed it since - refreshing it then encrypts it again.
+		if (item.bundle) {
+			LOG_INFO("Uploading " << item.bundle->getFilePaths().size() << " files as " << item.file_path << ".");
+			op_success = send_content(sock, client, key_pool, decrypted_aes_key, ticket, *item.bundle, item.file_path, Codes::SENDING_BUNDLE_C, pipeline);
+			confirmation->file_paths = item.bundle->getFilePaths();
+			confirmation->fingerprints = item.bundle->getFingerprints();
+		}
+		else {
+			op_success = send_content(sock, client, key_pool, decrypted_aes_key, ticket, *item.file, item.file_path, Codes::SENDING_FILE_C, pipeline);
+			confirmation->file_paths = { item.file_path };
+			confirmation->fingerprints = { item.file->getFingerprint() };
+		}
+		if (op_success != SUCCESS) {
+			return op_success;
+		}
+
+		if (!confirmed_once) {
+			if (confirm_crc(sock, client, decrypted_aes_key, item.file_path) == FAILURE) {
+				FATAL_MESSAGE_RETURN_FAILURE("Valid CRC");
+			}
+			record_confirmed(client, confirmation->file_paths, confirmation->fingerprints);
+			confirmed_once = true;
+			return SUCCESS;
+		}
+
+		queue_confirmation(pipeline, client, decrypted_aes_key, item.file_path, [&client, confirmation] {
+			confirmation->confirmed = true;
+			record_confirmed(client, confirmation->file_paths, confirmation->fingerprints);
+		});
+		confirmations.push_back(confirmation);
+		return SUCCESS;
+	};
+
+	while (true) {
+		// Keep the workers ahead of the connection, but only by a window of items - prepared content is held until it's sent.
+		while (!stop && in_flight < window) {
+			std::unique_ptr<BatchItem> item = next_item();
+			if (!item) {
+				break;
+			}
+
+			// The task holds the item itself, the vector of items grows while the workers prepare them.
+			size_t index = items.size();
+			BatchItem* prepared = item.get();
+			items.push_back(std::move(item));
+			in_flight++;
+			pool.submit([&, index, prepared, aes_key = decrypted_aes_key] {
+				try {
+					TRACE_SPAN("prepare");
+					if (prepared->bundle) {
+						prepared->bundle->refresh(aes_key);
+					}
+					else {
+						prepared->file->refresh(aes_key);
+					}
+				}
+				catch (...) {
+					prepared->error = std::current_exception();
+				}
+				// Notified under the lock, once it's released this task no longer touches the batch.
+				std::lock_guard<std::mutex> lock(ready_lock);
+				ready.push_back(index);
+				ready_changed.notify_one();
+			});
+		}
+
+		if (in_flight == 0) {
+			break;
+		}
+
+		size_t index;
+		{
+			std::unique_lock<std::mutex> lock(ready_lock);
+			ready_changed.wait(lock, [&ready] { return !ready.empty(); });
+			index = ready.front();
+			ready.pop_front();
+		}
+		in_flight--;
+		BatchItem& item = *items[index];
+
+		// The items are sent one at a time over the session's connection, in the order they became ready.
+		int op_success = FAILURE;
+		if (stop) {
+			op_success = SUCCESS;
+		}
+		else if (item.error) {
+			try {
+				std::rethrow_exception(item.error);
+			}
+			catch (std::exception& e) {
+				LOG_ERROR(e.what());
+			}
+		}
+		else {
+			try {
+				op_success = send_item(item);
+			}
+			catch (std::exception& e) {
+				LOG_ERROR(e.what());
+				pipeline.clear();
+			}
+			// An item that could not be sent means the connection failed, the items not submitted yet are not uploaded.
+			if (op_success == FAILURE) {
+				stop = true;
+			}
+		}
+		items[index].reset();
+
+		if (op_success == FAILURE) {
+			result = FAILURE;
+		}
+		else if (op_success == SPECIAL && result == SUCCESS) {
+			result = SPECIAL;
+		}
+	}
+
+	// The last confirmations have no item's packets to ride along with, they are written on their own.
+	try {
+		pipeline.flush(sock);
+		pipeline.receive_awaited(sock);
+	}
+	catch (std::exception& e) {
+		LOG_ERROR(e.what());
+	}
+	// A confirmation that was never answered (its connection failed) fails its item.
+	for (const std::shared_ptr<PendingConfirmation>& confirmation : confirmations) {
+		if (!confirmation->confirmed) {
+			LOG_ERROR("Fatal: Valid CRC request of " << confirmation->name << " failed.");
+			result = FAILURE;
+		}
+	}
+
+	return result;
+}
+
+int upload_stream(tcp::socket& sock, Client& client, KeyPool& key_pool, std::string& decrypted_aes_key, std::string& ticket, StreamReader read, std::string file_name) {
+	// A rejected session ticket means sending the file again, and the stream can't be read again - so the ticket is checked before the
+	// first packet instead of sent along with it. A rejected ticket gets the full handshake, and so does a server that can't check it.
+	if (!ticket.empty()) {
+		TicketReconnection checked_ticket(client.getUuid(), Codes::CHECKED_TICKET_RECONNECTION_C, PayloadSize::CHECKED_TICKET_RECONNECTION_P, client.getName().c_str(), ticket);
+		ticket.clear();
+		int op_success = checked_ticket.check(sock);
+
+		if (op_success == SPECIAL && handshake(sock, client, key_pool, decrypted_aes_key) == FAILURE) {
+			return FAILURE;
+		}
+		if (op_success == FAILURE && reconnect_session(sock, client, key_pool, decrypted_aes_key) == FAILURE) {
+			return FAILURE;
+		}
+	}
+
+	// The content is encrypted as it's read, the sizes and the total packets are sent along with the last packet.
+	EncryptedStream encrypted_stream(read, decrypted_aes_key);
+	SendingFile sendingFile(client.getUuid(), Codes::SENDING_FILE_C, PayloadSize::SENDING_FILE_P, file_name.c_str(), encrypted_stream);
+
+	if (sendingFile.run(sock) != SUCCESS) {
+		FATAL_MESSAGE_RETURN_FAILURE("Sending File");
+	}
+
+	unsigned long response_cksum = sendingFile.getCksum();
+	unsigned long request_cksum = encrypted_stream.getCksum();
+
+	LOG_DEBUG("Stream CRC " << request_cksum << ", server CRC " << response_cksum << ", " << encrypted_stream.getOrigSize() << " bytes");
+
+	// The content can't be sent again, an invalid CRC ends the upload.
+	if (response_cksum != request_cksum) {
+		count_metric(CRC_MISMATCHES);
+		InvalidCrcDone invalid_crc_done(client.getUuid(), Codes::INVALID_CRC_DONE_C, PayloadSize::INVALID_CRC_DONE_P, file_name.c_str());
+		if (invalid_crc_done.run(sock) == FAILURE) {
+			FATAL_MESSAGE_RETURN_FAILURE("Invalid CRC");
+		}
+		return SPECIAL;
+	}
+
+	if (confirm_crc(sock, client, decrypted_aes_key, file_name) == FAILURE) {
+		FATAL_MESSAGE_RETURN_FAILURE("Valid CRC");
+	}
+
+	return SUCCESS;
+}
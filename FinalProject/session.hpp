@@ -0,0 +1,54 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <set>
+#include <algorithm>
+#include <cctype>
+#include "client.hpp"
+#include "request.hpp"
+#include "keypool.hpp"
+#include "sockopt.hpp"
+#include "filecache.hpp"
+#include "bundle.hpp"
+#include "executor.hpp"
+
+// This method performs the full handshake with the server, saving the AES key agreed with the server into decrypted_aes_key.
+int handshake(tcp::socket& sock, Client& client, KeyPool& key_pool, std::string& decrypted_aes_key);
+// This method starts a session with the server - using the saved session ticket if there is one (the ticket is sent along with the first file), and the full handshake otherwise.
+int start_session(tcp::socket& sock, Client& client, KeyPool& key_pool, std::string& decrypted_aes_key, std::string& ticket);
+/*
+	This method uploads the source's content under the given file name over an established session, and confirms its CRC - the
+	content is sent again (after a CRC mismatch or a rejected session ticket) up to MAX_INVALID_CRC times. The content is sent
+	in requests of the given code - Sending File, or Sending Bundle for a bundle's content.
+	Returns SUCCESS if the server confirmed the CRC, SPECIAL if the CRC was invalid four times, and FAILURE otherwise.
+*/
+int upload_content(tcp::socket& sock, Client& client, KeyPool& key_pool, std::string& decrypted_aes_key, std::string& ticket, UploadSource& source, std::string file_name, uint16_t code = Codes::SENDING_FILE_C);
+/*
+	This method uploads a single file (a path relative to the executable's directory) over an established session, and confirms its CRC.
+	Returns SUCCESS if the server confirmed the CRC, SPECIAL if the CRC was invalid four times, and FAILURE otherwise.
+*/
+int upload_file(tcp::socket& sock, Client& client, KeyPool& key_pool, std::string& decrypted_aes_key, std::string& ticket, std::string file_path);
+/*
+	This method uploads a bundle of small files over an established session, and confirms the CRC of the whole bundle - every
+	file of a confirmed bundle is recorded in the fingerprint index.
+	Returns SUCCESS if the server confirmed the CRC, SPECIAL if the CRC was invalid four times, and FAILURE otherwise.
+*/
+int upload_bundle(tcp::socket& sock, Client& client, KeyPool& key_pool, std::string& decrypted_aes_key, std::string& ticket, FileBundle& bundle);
+/*
+	This method uploads a batch of files over an established session. Files up to BUNDLE_FILE_LIMIT bytes are packed into
+	bundles, larger files are uploaded one by one. The files and bundles are read and encrypted on the pool's workers, up to
+	BATCH_PREPARE_AHEAD of them per worker ahead of the connection, and sent one at a time as they become ready. A file's CRC
+	confirmation is written along with the next file's packets instead of waiting a round trip of its own, and its response
+	is read before theirs - only the batch's first confirmation is awaited on its own.
+	Returns SUCCESS if the server confirmed every file's CRC, SPECIAL if a file's CRC was invalid four times, and FAILURE if a
+	file could not be read or sent - the files not prepared yet are not uploaded once a file could not be sent.
+*/
+int upload_files(tcp::socket& sock, Client& client, KeyPool& key_pool, std::string& decrypted_aes_key, std::string& ticket, const std::vector<std::string>& file_paths, WorkStealingPool& pool);
+/*
+	This method uploads the content read by the reader (until it ends) under the given file name, and confirms its CRC - for a
+	producer piping its output into the client, without writing it into a file first. The content can't be read again, so it's
+	sent once - returns SPECIAL right away if its CRC is invalid. A session ticket is checked with the server before the content is sent.
+*/
+int upload_stream(tcp::socket& sock, Client& client, KeyPool& key_pool, std::string& decrypted_aes_key, std::string& ticket, StreamReader read, std::string file_name);
+
+#endif
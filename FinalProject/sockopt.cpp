@@ -0,0 +1,242 @@
+#include "sockopt.hpp"
+#include <mutex>
+#ifndef _WIN32
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
+static std::mutex socket_tuning_mutex;
+static SocketTuning current_socket_tuning = {
+	true,
+	true,
+	0,
+	0,
+	1000,
+	0,
+	false,
+	0,
+	0,
+	0,
+	""
+};
+
+void set_socket_tuning(const SocketTuning& tuning) {
+	std::lock_guard<std::mutex> lock(socket_tuning_mutex);
+	current_socket_tuning = tuning;
+}
+
+SocketTuning socket_tuning() {
+	std::lock_guard<std::mutex> lock(socket_tuning_mutex);
+	return current_socket_tuning;
+}
+
+// This method parses an on/off value.
+static bool parse_switch(const std::string& value, bool& result) {
+	if (value == "on" || value == "1") {
+		result = true;
+	}
+	else if (value == "off" || value == "0") {
+		result = false;
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+// This method parses a non negative integer value, 'auto' is 0 if allowed.
+static bool parse_amount(const std::string& value, int& result, bool allow_auto = false) {
+	if (allow_auto && value == "auto") {
+		result = 0;
+		return true;
+	}
+	if (!is_integer(value) || value[0] == '-' || value.length() > 9) {
+		return false;
+	}
+	result = std::stoi(value);
+	return true;
+}
+
+bool parse_socket_option(const std::string& option, SocketTuning& tuning) {
+	size_t pos = option.find('=');
+	if (pos == std::string::npos) {
+		return false;
+	}
+
+	std::string key = option.substr(0, pos);
+	std::string value = option.substr(pos + 1);
+
+	if (key == "nodelay") {
+		return parse_switch(value, tuning.no_delay);
+	}
+	if (key == "cork") {
+		return parse_switch(value, tuning.cork);
+	}
+	if (key == "sndbuf") {
+		return parse_amount(value, tuning.send_buffer, true);
+	}
+	if (key == "rcvbuf") {
+		return parse_amount(value, tuning.receive_buffer, true);
+	}
+	if (key == "bandwidth") {
+		return parse_amount(value, tuning.bandwidth_mbps) && tuning.bandwidth_mbps > 0;
+	}
+	if (key == "notsent_lowat") {
+		return parse_amount(value, tuning.not_sent_lowat);
+	}
+	if (key == "keepalive") {
+		return parse_switch(value, tuning.keep_alive);
+	}
+	if (key == "keepalive_idle") {
+		return parse_amount(value, tuning.keepalive_idle);
+	}
+	if (key == "keepalive_interval") {
+		return parse_amount(value, tuning.keepalive_interval);
+	}
+	if (key == "keepalive_count") {
+		return parse_amount(value, tuning.keepalive_count);
+	}
+	if (key == "congestion") {
+		tuning.congestion = value;
+		return true;
+	}
+	return false;
+}
+
+// This method sets a TCP level option boost has no class for, logs and returns false if the system rejects it.
+static bool set_tcp_option(tcp::socket& sock, int name, int value, const char* label) {
+	if (setsockopt(sock.native_handle(), IPPROTO_TCP, name, reinterpret_cast<const char*>(&value), sizeof(value)) != 0) {
+		LOG_WARNING("Cannot set the socket option " << label << ".");
+		return false;
+	}
+	return true;
+}
+
+// This method sets the buffer to the configured size, and warns if it is too small for the bandwidth-delay product.
+template <typename BufferSize>
+static void set_buffer(tcp::socket& sock, int size, long long bdp, const char* label) {
+	boost::system::error_code ec;
+
+	sock.set_option(BufferSize(size), ec);
+	if (ec) {
+		LOG_WARNING("Cannot set the socket option " << label << ": " << ec.message());
+		return;
+	}
+
+	// The system may clamp the size (to net.core.wmem_max / rmem_max on Linux), report the size actually in effect.
+	BufferSize current;
+	sock.get_option(current, ec);
+	if (!ec && current.value() < bdp) {
+		LOG_WARNING("The socket option " << label << " is " << current.value() << " bytes, less than the bandwidth-delay product of " << bdp << " bytes.");
+	}
+}
+
+// This method returns the connection's round trip time - the kernel's estimate where it has one, otherwise the time the connect took.
+static std::chrono::microseconds round_trip_time(tcp::socket& sock, std::chrono::microseconds connect_time) {
+#if defined(__linux__) && defined(TCP_INFO)
+	struct tcp_info info;
+	socklen_t length = sizeof(info);
+	if (getsockopt(sock.native_handle(), IPPROTO_TCP, TCP_INFO, &info, &length) == 0 && info.tcpi_rtt > 0) {
+		return std::chrono::microseconds(info.tcpi_rtt);
+	}
+#endif
+	return connect_time;
+}
+
+void tune_socket(tcp::socket& sock, std::chrono::microseconds connect_time) {
+	SocketTuning tuning = socket_tuning();
+	boost::system::error_code ec;
+
+	sock.set_option(tcp::no_delay(tuning.no_delay), ec);
+	if (ec) {
+		LOG_WARNING("Cannot set the socket option nodelay: " << ec.message());
+	}
+
+	// Buffers are left to the system unless configured, setting a size turns off the system's own tuning of it (which on
+	// Linux grows them well past the limit a program may set). The bandwidth-delay product only checks configured sizes.
+	std::chrono::microseconds rtt = round_trip_time(sock, connect_time);
+	long long bdp = static_cast<long long>(tuning.bandwidth_mbps) * rtt.count() / 8;
+	LOG_DEBUG("Round trip time " << rtt.count() << " us, bandwidth-delay product " << bdp << " bytes.");
+
+	if (tuning.send_buffer) {
+		set_buffer<boost::asio::socket_base::send_buffer_size>(sock, tuning.send_buffer, bdp, "sndbuf");
+	}
+	if (tuning.receive_buffer) {
+		set_buffer<boost::asio::socket_base::receive_buffer_size>(sock, tuning.receive_buffer, bdp, "rcvbuf");
+	}
+
+#ifdef TCP_NOTSENT_LOWAT
+	if (tuning.not_sent_lowat) {
+		set_tcp_option(sock, TCP_NOTSENT_LOWAT, tuning.not_sent_lowat, "notsent_lowat");
+	}
+#endif
+
+	if (tuning.keep_alive) {
+		sock.set_option(boost::asio::socket_base::keep_alive(true), ec);
+		if (ec) {
+			LOG_WARNING("Cannot set the socket option keepalive: " << ec.message());
+		}
+	}
+#ifdef TCP_KEEPIDLE
+	if (tuning.keepalive_idle) {
+		set_tcp_option(sock, TCP_KEEPIDLE, tuning.keepalive_idle, "keepalive_idle");
+	}
+#endif
+#ifdef TCP_KEEPINTVL
+	if (tuning.keepalive_interval) {
+		set_tcp_option(sock, TCP_KEEPINTVL, tuning.keepalive_interval, "keepalive_interval");
+	}
+#endif
+#ifdef TCP_KEEPCNT
+	if (tuning.keepalive_count) {
+		set_tcp_option(sock, TCP_KEEPCNT, tuning.keepalive_count, "keepalive_count");
+	}
+#endif
+
+#if defined(__linux__) && defined(TCP_CONGESTION)
+	if (!tuning.congestion.empty() &&
+		setsockopt(sock.native_handle(), IPPROTO_TCP, TCP_CONGESTION, tuning.congestion.c_str(), static_cast<socklen_t>(tuning.congestion.length())) != 0) {
+		LOG_WARNING("Cannot set the congestion control algorithm " << tuning.congestion << ", is its module loaded?");
+	}
+#endif
+}
+
+void connect_tuned(tcp::socket& sock, const tcp::resolver::results_type& endpoints) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	boost::asio::connect(sock, endpoints);
+	tune_socket(sock, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start));
+}
+
+void limit_unsent_data(tcp::socket& sock, int size) {
+#ifdef TCP_NOTSENT_LOWAT
+	// tune_socket already set the configured limit.
+	if (socket_tuning().not_sent_lowat == 0) {
+		set_tcp_option(sock, TCP_NOTSENT_LOWAT, size, "notsent_lowat");
+	}
+#else
+	boost::system::error_code ec;
+	sock.set_option(boost::asio::socket_base::send_buffer_size(size), ec);
+	if (ec) {
+		LOG_WARNING("Cannot set the socket option sndbuf: " << ec.message());
+	}
+#endif
+}
+
+SocketCork::SocketCork(tcp::socket& sock) :
+	sock(sock),
+	corked(false)
+{
+#ifdef TCP_CORK
+	if (socket_tuning().cork) {
+		corked = set_tcp_option(sock, TCP_CORK, 1, "cork");
+	}
+#endif
+}
+
+SocketCork::~SocketCork() {
+#ifdef TCP_CORK
+	if (corked) {
+		set_tcp_option(sock, TCP_CORK, 0, "cork");
+	}
+#endif
+}
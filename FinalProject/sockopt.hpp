@@ -0,0 +1,69 @@
+#ifndef SOCKOPT_H
+#define SOCKOPT_H
+
+#include "utils.hpp"
+
+/*
+	How the client's connections to the server are tuned, set from the optional 'key=value' lines of transfer.info:
+		nodelay=on|off			Disable Nagle's algorithm, on by default - requests are written whole, waiting to coalesce them only adds latency.
+		cork=on|off			Cork the socket while a file's packets are written (Linux only), on by default.
+		sndbuf=<bytes>|auto		Send buffer size, auto (left to the system) by default.
+		rcvbuf=<bytes>|auto		Receive buffer size, auto (left to the system) by default.
+		bandwidth=<Mbit/s>		Expected bottleneck bandwidth to the server, configured buffers smaller than its bandwidth-delay product are logged. 1000 by default.
+		notsent_lowat=<bytes>		Limit of the unsent bytes queued in the send buffer (Linux and macOS), 0 keeps the system's default.
+		keepalive=on|off		Send keepalive probes on an idle connection, off by default (the daemon always keeps its connection alive).
+		keepalive_idle=<seconds>	Idle time before the first probe, 0 keeps the system's default. Same for keepalive_interval and keepalive_count.
+		congestion=<name>		Congestion control algorithm (Linux only), e.g. bbr. Empty keeps the system's default.
+	Auto buffers are not touched: setting a buffer's size turns off the system's own tuning of it, and Linux clamps a set size to
+	net.core.wmem_max / rmem_max (208 KB by default) while its own tuning grows the buffers up to tcp_wmem / tcp_rmem (4 MB / 6 MB).
+	Set a size only where the system's tuning is known to fall short, e.g. an old Windows stack on a long fat link.
+	With bbr, a small notsent_lowat (e.g. 131072) keeps the unsent data in the process instead of queued behind the congestion window.
+*/
+struct SocketTuning {
+	bool no_delay;
+	bool cork;
+	// Buffer sizes in bytes, 0 leaves them to the system.
+	int send_buffer;
+	int receive_buffer;
+	int bandwidth_mbps;
+	int not_sent_lowat;
+	bool keep_alive;
+	int keepalive_idle;
+	int keepalive_interval;
+	int keepalive_count;
+	std::string congestion;
+};
+
+// This method sets the tuning of the connections made from now on.
+void set_socket_tuning(const SocketTuning& tuning);
+// This method returns the tuning of new connections.
+SocketTuning socket_tuning();
+// This method parses a single 'key=value' tuning option into the given tuning, returns false if the option is invalid.
+bool parse_socket_option(const std::string& option, SocketTuning& tuning);
+
+// This method applies the tuning to a connected socket, given the round trip time measured while connecting. Options that cannot be set are logged and skipped.
+void tune_socket(tcp::socket& sock, std::chrono::microseconds connect_time);
+// This method connects the socket to one of the endpoints, and tunes it.
+/*
+	This method bounds the data the system queues unsent on the socket to about the given size (a configured notsent_lowat
+	takes precedence), so data written later isn't queued behind much of it. Uses TCP_NOTSENT_LOWAT where the system has it,
+	otherwise limits the send buffer to the given size - which also caps the connection at that size per round trip.
+*/
+void limit_unsent_data(tcp::socket& sock, int size);
+void connect_tuned(tcp::socket& sock, const tcp::resolver::results_type& endpoints);
+
+/*
+	Corks the socket for as long as it exists, if the tuning asks for it (Linux only, elsewhere it does nothing).
+	While corked, the kernel sends only full segments - the tail of every write waits for the next one instead of leaving
+	as a small segment of its own, and everything left is sent when the cork is removed.
+*/
+class SocketCork {
+	tcp::socket& sock;
+	bool corked;
+
+	public:
+		SocketCork(tcp::socket& sock);
+		~SocketCork();
+};
+
+#endif
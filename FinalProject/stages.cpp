@@ -0,0 +1,192 @@
+#include "stages.hpp"
+
+ChunkPool::ChunkPool(size_t count, size_t chunk_size) :
+	free_chunks(count)
+{
+	for (size_t i = 0; i < count; i++) {
+		chunks.push_back(std::make_unique<FileChunk>());
+		chunks.back()->content.resize(chunk_size);
+		// Room for the ciphertext of a whole chunk, and the padding block (16 bytes) of the last one.
+		chunks.back()->cipher.reserve(chunk_size + 16);
+		chunks.back()->size = 0;
+		chunks.back()->last = false;
+		free_chunks.tryPush(chunks.back().get());
+	}
+}
+
+FileChunk* ChunkPool::acquire(const std::atomic<bool>& cancelled) {
+	FileChunk* chunk = nullptr;
+	free_chunks.popBatch(&chunk, 1, cancelled);
+	return chunk;
+}
+
+void ChunkPool::release(FileChunk* chunk) {
+	// The pool holds every chunk it made, so there is always room for one given back.
+	free_chunks.tryPush(chunk);
+}
+
+StagedFileEncryptor::StagedFileEncryptor(const std::string& file_path, uint64_t size, const std::string& aes_key) :
+	file_path(file_path),
+	file(file_path, std::ios::binary),
+	size(size),
+	encryptor(reinterpret_cast<const unsigned char*>(aes_key.c_str()), static_cast<unsigned int>(aes_key.size())),
+	pool(STAGE_CHUNKS, FINGERPRINT_CHUNK_SIZE),
+	read_chunks(STAGE_CHUNKS),
+	checked_chunks(STAGE_CHUNKS),
+	encrypted_chunks(STAGE_CHUNKS),
+	cancelled(false),
+	error(nullptr),
+	finished(false)
+{
+	if (!file) {
+		throw std::runtime_error("Cannot open input file " + file_path + ".");
+	}
+
+	reader_thread = std::thread(&StagedFileEncryptor::read, this);
+	checker_thread = std::thread(&StagedFileEncryptor::check, this);
+	encryptor_thread = std::thread(&StagedFileEncryptor::encrypt, this);
+}
+
+StagedFileEncryptor::~StagedFileEncryptor() {
+	// The consumer may stop before the last chunk (a CRC retry rewinds the file), the stages stop wherever they are waiting.
+	cancelled = true;
+	reader_thread.join();
+	checker_thread.join();
+	encryptor_thread.join();
+}
+
+void StagedFileEncryptor::fail(std::exception_ptr stage_error) {
+	std::lock_guard<std::mutex> lock(error_lock);
+	if (!error) {
+		error = stage_error;
+	}
+	cancelled = true;
+}
+
+void StagedFileEncryptor::read() {
+	uint64_t remaining = size;
+
+	try {
+		// An empty file is a single empty chunk, the encryptor pads it into a block.
+		do {
+			FileChunk* chunk = pool.acquire(cancelled);
+			if (!chunk) {
+				return;
+			}
+
+			chunk->size = static_cast<size_t>(MIN(remaining, static_cast<uint64_t>(chunk->content.size())));
+			{
+				TRACE_SPAN("file read");
+				file.read(chunk->content.data(), chunk->size);
+				if (static_cast<size_t>(file.gcount()) != chunk->size) {
+					pool.release(chunk);
+					throw std::runtime_error("The input file " + file_path + " changed while being read.");
+				}
+			}
+			count_metric(BYTES_READ, chunk->size);
+			remaining -= chunk->size;
+			chunk->last = !remaining;
+
+			if (!read_chunks.push(chunk, cancelled)) {
+				return;
+			}
+		} while (remaining);
+	}
+	catch (...) {
+		fail(std::current_exception());
+	}
+}
+
+void StagedFileEncryptor::check() {
+	FileChunk* batch[STAGE_BATCH];
+	bool last = false;
+
+	try {
+		while (!last) {
+			size_t amount = read_chunks.popBatch(batch, STAGE_BATCH, cancelled);
+			if (!amount) {
+				return;
+			}
+
+			for (size_t i = 0; i < amount; i++) {
+				if (batch[i]->size) {
+					TRACE_SPAN("crc");
+					crc.update(batch[i]->content.data(), batch[i]->size);
+					chunks.push_back(static_cast<uint32_t>(memcrc(batch[i]->content.data(), batch[i]->size)));
+				}
+				last = batch[i]->last;
+
+				if (!checked_chunks.push(batch[i], cancelled)) {
+					return;
+				}
+			}
+		}
+	}
+	catch (...) {
+		fail(std::current_exception());
+	}
+}
+
+void StagedFileEncryptor::encrypt() {
+	FileChunk* batch[STAGE_BATCH];
+	bool last = false;
+
+	try {
+		while (!last) {
+			size_t amount = checked_chunks.popBatch(batch, STAGE_BATCH, cancelled);
+			if (!amount) {
+				return;
+			}
+
+			for (size_t i = 0; i < amount; i++) {
+				FileChunk* chunk = batch[i];
+				{
+					TRACE_SPAN("encrypt");
+					chunk->cipher.clear();
+					encryptor.update(chunk->content.data(), chunk->size, chunk->cipher);
+					if (chunk->last) {
+						encryptor.final(chunk->cipher);
+					}
+				}
+				count_metric(BYTES_ENCRYPTED, chunk->size);
+				last = chunk->last;
+
+				if (!encrypted_chunks.push(chunk, cancelled)) {
+					return;
+				}
+			}
+		}
+	}
+	catch (...) {
+		fail(std::current_exception());
+	}
+}
+
+bool StagedFileEncryptor::next(std::string& cipher) {
+	if (finished) {
+		return false;
+	}
+
+	FileChunk* chunk = nullptr;
+	if (!encrypted_chunks.popBatch(&chunk, 1, cancelled)) {
+		std::lock_guard<std::mutex> lock(error_lock);
+		std::rethrow_exception(error);
+	}
+
+	cipher.append(chunk->cipher);
+	finished = chunk->last;
+	pool.release(chunk);
+	return true;
+}
+
+bool StagedFileEncryptor::isFinished() const {
+	return finished;
+}
+
+unsigned long StagedFileEncryptor::getCksum() const {
+	return crc.final();
+}
+
+const std::vector<uint32_t>& StagedFileEncryptor::getChunks() const {
+	return chunks;
+}
@@ -0,0 +1,83 @@
+#ifndef STAGES_H
+#define STAGES_H
+
+#include <thread>
+#include <mutex>
+#include <exception>
+#include "filecache.hpp"
+#include "ring.hpp"
+
+// A chunk of a file on its way through the stages - its content, and its ciphertext once it was encrypted.
+struct FileChunk {
+	std::vector<char> content;
+	size_t size;
+	std::string cipher;
+	// The file's last chunk, its ciphertext ends with the padding.
+	bool last;
+};
+
+/*
+	A fixed set of chunk descriptors, allocated once and reused - a chunk is taken by the reader stage and given back once its
+	ciphertext was taken, so a file of any size goes through the same few buffers. The free chunks are kept in an MpmcRing, so
+	any thread may take or give one back.
+*/
+class ChunkPool {
+	std::vector<std::unique_ptr<FileChunk>> chunks;
+	MpmcRing<FileChunk*> free_chunks;
+
+	public:
+		ChunkPool(size_t count, size_t chunk_size);
+
+		// This method takes a free chunk, waiting while every chunk is in use - the stages behind are the bottleneck. Returns null if cancelled while waiting.
+		FileChunk* acquire(const std::atomic<bool>& cancelled);
+		void release(FileChunk* chunk);
+};
+
+/*
+	Reads, CRCs and encrypts a file on three stage threads, ahead of the thread taking its ciphertext (SendingFile::run, through
+	EncryptedFile) - reading the next chunks, computing the CRCs of the chunks read and encrypting the chunks already CRC'd all
+	overlap with each other, and with sending.
+	The stages hand chunks to each other through SpscRings: reader -> CRC -> encryptor -> next(). At most STAGE_CHUNKS chunks
+	are in flight, once they all are the reader waits for next() to give one back.
+*/
+class StagedFileEncryptor : public ChunkEncryptor {
+	std::string file_path;
+	std::ifstream file;
+	uint64_t size;
+	AESStreamEncryptor encryptor;
+	Crc crc;
+	std::vector<uint32_t> chunks;
+	ChunkPool pool;
+	SpscRing<FileChunk*> read_chunks;
+	SpscRing<FileChunk*> checked_chunks;
+	SpscRing<FileChunk*> encrypted_chunks;
+	std::atomic<bool> cancelled;
+	std::mutex error_lock;
+	std::exception_ptr error;
+	bool finished;
+	std::thread reader_thread;
+	std::thread checker_thread;
+	std::thread encryptor_thread;
+
+	// These methods run the stages, each on its own thread.
+	void read();
+	void check();
+	void encrypt();
+	// This method keeps the first error of a stage, and stops every stage.
+	void fail(std::exception_ptr stage_error);
+
+	public:
+		// Only the first size bytes of the file are read, the file must still have that many when they are.
+		StagedFileEncryptor(const std::string& file_path, uint64_t size, const std::string& aes_key);
+		~StagedFileEncryptor();
+		StagedFileEncryptor(const StagedFileEncryptor&) = delete;
+		StagedFileEncryptor& operator=(const StagedFileEncryptor&) = delete;
+
+		// This method waits for the next encrypted chunk, and rethrows the error that stopped the stages if there is one.
+		bool next(std::string& cipher);
+		bool isFinished() const;
+		unsigned long getCksum() const;
+		const std::vector<uint32_t>& getChunks() const;
+};
+
+#endif
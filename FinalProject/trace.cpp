@@ -0,0 +1,137 @@
+#include "trace.hpp"
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <vector>
+#include <thread>
+#include <fstream>
+#include <iomanip>
+
+namespace {
+	// Spans beyond this many are only counted in the histograms, so a long running daemon does not grow without bound.
+	constexpr size_t MAX_TRACE_EVENTS = 1000000;
+	// Histogram buckets are powers of two microseconds, the last one holds everything longer than about 18 minutes.
+	constexpr int HISTOGRAM_BUCKETS = 31;
+
+	struct TraceEvent {
+		const char* name;
+		int64_t start_us;
+		int64_t duration_us;
+		size_t thread;
+	};
+
+	struct Histogram {
+		uint64_t count = 0;
+		int64_t total_us = 0;
+		int64_t max_us = 0;
+		uint64_t buckets[HISTOGRAM_BUCKETS] = {};
+	};
+
+	std::atomic<bool> enabled(false);
+	std::mutex trace_lock;
+	std::chrono::steady_clock::time_point trace_start = std::chrono::steady_clock::now();
+	std::vector<TraceEvent> events;
+	std::map<std::string, Histogram> histograms;
+	std::map<std::thread::id, size_t> thread_numbers;
+
+	// Returns the bucket of a duration - bucket i holds durations in [2^(i-1), 2^i) microseconds, bucket 0 holds durations under 1 microsecond.
+	int bucket_of(int64_t duration_us) {
+		int bucket = 0;
+		while (duration_us > 0 && bucket < HISTOGRAM_BUCKETS - 1) {
+			duration_us >>= 1;
+			bucket++;
+		}
+		return bucket;
+	}
+
+	// Returns an estimate of the given percentile - the upper bound of the bucket holding it, capped by the maximum.
+	int64_t histogram_percentile(const Histogram& histogram, double p) {
+		uint64_t rank = static_cast<uint64_t>(histogram.count * p / 100);
+		uint64_t seen = 0;
+
+		for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+			seen += histogram.buckets[i];
+			if (seen > rank) {
+				return std::min<int64_t>(int64_t(1) << i, histogram.max_us);
+			}
+		}
+		return histogram.max_us;
+	}
+}
+
+TraceSpan::TraceSpan(const char* name) :
+	name(name),
+	active(enabled)
+{
+	if (active) {
+		start = std::chrono::steady_clock::now();
+	}
+}
+
+TraceSpan::~TraceSpan() {
+	if (active) {
+		record_span(name, start, std::chrono::steady_clock::now());
+	}
+}
+
+void enable_tracing() {
+	enabled = true;
+}
+
+bool tracing_enabled() {
+	return enabled;
+}
+
+void record_span(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+	int64_t start_us = std::chrono::duration_cast<std::chrono::microseconds>(start - trace_start).count();
+	int64_t duration_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+	std::lock_guard<std::mutex> lock(trace_lock);
+
+	// Threads are numbered in the order they first record a span, the main thread is usually 1.
+	auto thread = thread_numbers.emplace(std::this_thread::get_id(), thread_numbers.size() + 1).first;
+	if (events.size() < MAX_TRACE_EVENTS) {
+		events.push_back({ name, start_us, duration_us, thread->second });
+	}
+
+	Histogram& histogram = histograms[name];
+	histogram.count++;
+	histogram.total_us += duration_us;
+	histogram.max_us = std::max(histogram.max_us, duration_us);
+	histogram.buckets[bucket_of(duration_us)]++;
+}
+
+bool write_chrome_trace(std::string file_path) {
+	std::ofstream out(file_path);
+	if (!out.is_open()) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(trace_lock);
+
+	// Complete events ("ph": "X") carry both the start time and the duration, in microseconds.
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	for (size_t i = 0; i < events.size(); i++) {
+		const TraceEvent& event = events[i];
+		out << (i ? ",\n" : "\n") << "{\"name\":\"" << event.name << "\",\"cat\":\"client\",\"ph\":\"X\",\"ts\":" << event.start_us
+			<< ",\"dur\":" << event.duration_us << ",\"pid\":1,\"tid\":" << event.thread << "}";
+	}
+	out << "\n]}\n";
+
+	return true;
+}
+
+void print_trace_histograms(std::ostream& out) {
+	std::lock_guard<std::mutex> lock(trace_lock);
+
+	out << std::left << std::setw(28) << "span" << std::right << std::setw(10) << "count" << std::setw(14) << "total ms"
+		<< std::setw(12) << "p50 us" << std::setw(12) << "p90 us" << std::setw(12) << "p99 us" << std::setw(12) << "max us" << std::endl;
+
+	for (const auto& entry : histograms) {
+		const Histogram& histogram = entry.second;
+		out << std::left << std::setw(28) << entry.first << std::right << std::setw(10) << histogram.count
+			<< std::setw(14) << std::fixed << std::setprecision(3) << histogram.total_us / 1000.0 << std::defaultfloat
+			<< std::setw(12) << histogram_percentile(histogram, 50) << std::setw(12) << histogram_percentile(histogram, 90)
+			<< std::setw(12) << histogram_percentile(histogram, 99) << std::setw(12) << histogram.max_us << std::endl;
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <iostream>
+#include <string>
+#include <chrono>
+
+/*
+	Timing spans for the client's phases (connecting, every request, reading, encrypting and sending the file...).
+	Tracing is off unless enable_tracing() is called, a disabled span costs a single check.
+	Finished spans are kept as Chrome trace events (open the written file in chrome://tracing or Perfetto), and are also
+	summarized into a histogram per span name.
+*/
+
+// Concatenating through a second macro expands __LINE__ first, so every span in a scope gets its own variable.
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+// Times the rest of the enclosing scope under the given name.
+#define TRACE_SPAN(name) TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name)
+
+class TraceSpan {
+	const char* name;
+	bool active;
+	std::chrono::steady_clock::time_point start;
+
+	TraceSpan(const TraceSpan& span);
+	TraceSpan& operator=(const TraceSpan& span);
+
+	public:
+		// The name must outlive the trace, a string literal is expected.
+		TraceSpan(const char* name);
+		~TraceSpan();
+};
+
+// This method turns tracing on, spans started from now on are recorded.
+void enable_tracing();
+// This method returns true if tracing is on.
+bool tracing_enabled();
+// This method records a finished span.
+void record_span(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+// This method writes the recorded spans into the given file in the Chrome trace event format, returns false if the file could not be written.
+bool write_chrome_trace(std::string file_path);
+// This method prints a summary of every span name - count, total time, and percentiles estimated from its histogram.
+void print_trace_histograms(std::ostream& out);
+
+#endif
@@ -0,0 +1,92 @@
+#include "uploader.hpp"
+
+Uploader::Uploader(std::string address, std::string port, std::string name, std::shared_ptr<CredentialStore> credentials) :
+	// A new client using the RSA handshake will need an RSA pair after registering, start generating it before connecting to the server,
+	// otherwise the pool only starts generating RSA pairs once one is needed (the server rejected the ECDH handshake).
+	key_pool(KEY_POOL_SIZE, PREFER_ECDH || credentials->hasCredentials()),
+	sock(io_context),
+	connected(false)
+{
+	if (name.length() > MAX_NAME_LENGTH || name.length() == 0 || !is_integer(port)) {
+		throw std::invalid_argument("Error: invalid server address or client name.");
+	}
+
+	client.setAddress(address);
+	client.setPort(port);
+	client.setName(name);
+	client.setCredentials(credentials);
+}
+
+int Uploader::connect() {
+	try {
+		TRACE_SPAN("connect");
+		// Resolve the server's address only once, reconnecting reuses the resolved endpoints.
+		if (endpoints.empty()) {
+			tcp::resolver resolver(io_context);
+			endpoints = resolver.resolve(client.getAddress(), client.getPort());
+		}
+
+		connect_tuned(sock, endpoints);
+		// Keep the idle connection alive between uploads.
+		sock.set_option(boost::asio::socket_base::keep_alive(true));
+	}
+	catch (std::exception& e) {
+		LOG_ERROR(e.what());
+		disconnect();
+		return FAILURE;
+	}
+
+	if (start_session(sock, client, key_pool, decrypted_aes_key, ticket) == FAILURE) {
+		disconnect();
+		return FAILURE;
+	}
+
+	connected = true;
+	return SUCCESS;
+}
+
+void Uploader::disconnect() {
+	boost::system::error_code ec;
+	sock.close(ec);
+	connected = false;
+}
+
+int Uploader::upload(std::string file_name, ByteView content) {
+	EncryptedBuffer encrypted_buffer(content);
+	int op_success = FAILURE;
+
+	// Try the warm connection first, and if it was lost, reconnect and try once more - the content is still in memory.
+	for (int attempt = 0; attempt < 2 && op_success == FAILURE; attempt++) {
+		if (!connected && connect() == FAILURE) {
+			continue;
+		}
+
+		op_success = upload_content(sock, client, key_pool, decrypted_aes_key, ticket, encrypted_buffer, file_name);
+		if (op_success == FAILURE) {
+			disconnect();
+		}
+	}
+
+	return op_success;
+}
+
+int Uploader::upload(std::string file_name, StreamReader read) {
+	// What was read can't be read again, so a lost connection is not retried.
+	if (!connected && connect() == FAILURE) {
+		return FAILURE;
+	}
+
+	int op_success = upload_stream(sock, client, key_pool, decrypted_aes_key, ticket, read, file_name);
+	if (op_success == FAILURE) {
+		disconnect();
+	}
+	return op_success;
+}
+
+int Uploader::upload(std::string file_name, std::istream& in) {
+	return upload(file_name, stream_reader(in));
+}
+
+CredentialStore& Uploader::getCredentials() const {
+	return client.getCredentials();
+}
@@ -0,0 +1,48 @@
+#ifndef UPLOADER_H
+#define UPLOADER_H
+
+#include "session.hpp"
+
+/*
+	The client as a library - for an application uploading content it produced, without files next to the executable.
+	The uploader holds a warm, authenticated connection to the server (connecting on the first upload), and uploads content
+	from the application's memory or from a reader, one upload at a time (like the daemon, see daemon.hpp).
+	The client's credentials are kept in memory unless a CredentialStore is given - after the first upload, an application
+	may read them back from the store and save them for the next run.
+*/
+class Uploader {
+	Client client;
+	KeyPool key_pool;
+	boost::asio::io_context io_context;
+	tcp::socket sock;
+	tcp::resolver::results_type endpoints;
+	bool connected;
+	std::string decrypted_aes_key;
+	std::string ticket;
+
+	// This method connects to the server (resolving its address only once) and starts a session.
+	int connect();
+	// This method closes the connection, the next upload reconnects.
+	void disconnect();
+
+	public:
+		Uploader(std::string address, std::string port, std::string name, std::shared_ptr<CredentialStore> credentials = std::make_shared<MemoryCredentialStore>());
+		Uploader(const Uploader&) = delete;
+		Uploader& operator=(const Uploader&) = delete;
+
+		/*
+			This method uploads the content (which must outlive the call) under the given file name, reconnecting once if the
+			connection was lost. The content is encrypted as its packets are sent, it's never copied as a whole.
+			Returns SUCCESS if the server confirmed the CRC, SPECIAL if the CRC was invalid four times, and FAILURE otherwise.
+		*/
+		int upload(std::string file_name, ByteView content);
+		// This method uploads the content read by the reader (until it ends) under the given file name. The content is sent once, SPECIAL is returned if its CRC is invalid.
+		int upload(std::string file_name, StreamReader read);
+		// This method uploads the stream's content (until it ends) under the given file name.
+		int upload(std::string file_name, std::istream& in);
+
+		// The client's credentials, and its session ticket.
+		CredentialStore& getCredentials() const;
+};
+
+#endif
@@ -9,60 +9,6 @@ bool is_integer(const std::string& num) {
 	return !num.empty() && iterator == num.end();
 }
 
-uint16_t get_response_code(std::vector<uint8_t> header) {
-	uint8_t high = header[1], low = header[2];
-	uint16_t combined = (static_cast<uint16_t>(high) << 8) | low;
-
-	/*
-		This, in my opinion, isn't quite intuitive so I'll explain it a little:
-		By the way I define the 'combined' variable, I only insert it's value, meaning,
-		if the operating system operates by little-endian order, it'll reverse the bytes.
-		That being said, the value received is already in little-endian so we'll need to reverse them back.
-	*/
-	if (boost::endian::order::native == boost::endian::order::little) {
-		return boost::endian::endian_reverse(combined);
-	}
-
-	return combined;
-}
-
-uint32_t get_response_payload_size(std::vector<uint8_t> header) {
-	uint8_t first = header[3], second = header[4];
-	uint8_t third = header[5], last = header[6];
-
-	uint32_t combined = (static_cast<uint32_t>(first) << 24) |
-						(static_cast<uint32_t>(second) << 16) |
-						(static_cast<uint32_t>(third) << 8) |
-						(static_cast<uint32_t>(last));
-
-	/*
-		This, in my opinion, isn't quite intuitive so I'll explain it a little:
-		By the way I define the 'combined' variable, I only insert it's value, meaning, 
-		if the operating system operates by little-endian order, it'll reverse the bytes.
-		That being said, the value received is already in little-endian so we'll need to reverse them back.
-	*/
-	if (boost::endian::order::native == boost::endian::order::little) {
-		return boost::endian::endian_reverse(combined);
-	}
-
-	return combined;
-}
-
-bool id_vectors_match(std::vector<uint8_t> first, UUID second) {
-	for (int i = 0; i < first.size(); i++) {
-		if (first[i] != second.data[i])
-			return false;
-	}
-
-	return true;
-}
-
-bool file_names_match(std::string response_file_name, char file_name[], size_t file_length) {
-	std::string file_name_str(file_name, file_name + file_length);
-
-	return (response_file_name == file_name_str);
-}
-
 UUID getUuidFromString(std::string client_id) {
 	std::istringstream iss(client_id); // Not really necessary but I thought it was cooler than going over the string itself.
 	UUID id;
@@ -94,6 +40,7 @@ std::string fileToCharArray(std::string file_name) {
 		f1.read(b, size);
 
 		std::string con(b, b + size);
+		count_metric(BYTES_READ, size);
 
 		delete[] b;
 		f1.close();
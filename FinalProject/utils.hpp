@@ -10,33 +10,45 @@
 #include <boost/uuid/uuid_io.hpp>
 #include <boost/endian/conversion.hpp>
 #include <filesystem>
+#include <ctime>
 #include <string.h>
 #include "RSAWrapper.h"
 #include "Base64Wrapper.h"
 #include "AESWrapper.h"
+#include "ECDHWrapper.h"
 #include "cksum.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
+#include "log.hpp"
 
 using boost::asio::ip::tcp;
 using UUID = boost::uuids::uuid;
 
 const std::string EXE_DIR = "client.cpp\\..\\..\\x64\\debug";
+const std::string SPOOL_DIR = "spool";
 
 // Macros used in the program.
 #define EXE_DIR_FILE_PATH(file_name) (EXE_DIR + "\\" + file_name)
 #define NIL_UUID boost::uuids::nil_uuid()
 #define FATAL_MESSAGE_RETURN(type) \
-	std::cerr << "Fatal: " << type << " request failed.\n"; \
+	LOG_ERROR("Fatal: " << type << " request failed."); \
 	return;
+#define FATAL_MESSAGE_RETURN_FAILURE(type) \
+	LOG_ERROR("Fatal: " << type << " request failed."); \
+	return FAILURE;
 #define TOTAL_PACKETS(content_size) \
 	((content_size % CONTENT_SIZE_PER_PACKET) ? (content_size/CONTENT_SIZE_PER_PACKET + 1) : content_size/CONTENT_SIZE_PER_PACKET)
 #define MIN(x, y) \
-	((x > y) ? x : y)
-#define RUNNING(code) (std::cout << "\nRunning request code " << code << std::endl)
+	(((x) < (y)) ? (x) : (y))
+#define RUNNING(code) LOG_DEBUG("Running request code " << code)
 
 // Const variables used in the program.
-constexpr auto VERSION = 3;
+constexpr auto VERSION = 4;
 constexpr auto NAME_SIZE = 255;
 constexpr auto KEY_LENGTH = 160;
+constexpr auto ECDH_KEY_LENGTH = 32;
+constexpr auto TICKET_LENGTH = 88;
+constexpr auto ENC_RESUMPTION_KEY_LENGTH = 48;
 constexpr auto ENC_AES_KEY_LENGTH = 128;
 constexpr auto REQUEST_HEADER_SIZE = 23;
 constexpr auto RESPONSE_HEADER_SIZE = 7;
@@ -44,21 +56,37 @@ constexpr auto MAX_NAME_LENGTH = 100;
 constexpr auto HEX_ID_LENGTH = 32;
 constexpr auto CONTENT_SIZE_PER_PACKET = 1024;
 constexpr auto MAX_REQUEST_FAILS = 3;
+constexpr auto REQUEST_TIMEOUT_MS = 30000;
+constexpr auto SERVER_CONTENT_BYTES_PER_MS = 1024;
+constexpr auto RETRY_BASE_BACKOFF_MS = 100;
+constexpr auto RETRY_MAX_BACKOFF_MS = 2000;
+constexpr auto PIPELINE_WRITE_SIZE = 64 * 1024;
+constexpr auto ENCRYPTED_CACHE_MEMORY_LIMIT = 64 * 1024 * 1024;
+constexpr auto ENCRYPTED_CACHE_SPILL_LIMIT = 1024 * 1024 * 1024;
+constexpr auto FINGERPRINT_CHUNK_SIZE = 1024 * 1024;
+constexpr auto STAGE_CHUNKS = 8;
+constexpr auto STAGE_BATCH = 4;
+constexpr auto FINGERPRINT_JOURNAL_LIMIT = 4096;
 constexpr auto MAX_INVALID_CRC = 4;
+constexpr auto KEY_POOL_SIZE = 1;
+constexpr auto PREFER_ECDH = true;
+constexpr auto DAEMON_POLL_INTERVAL_MS = 500;
+constexpr auto UPLOAD_QUEUE_SIZE = 64;
+constexpr auto BATCH_PREPARE_AHEAD = 2;
+constexpr auto BUNDLE_FILE_LIMIT = 64 * 1024;
+constexpr auto BUNDLE_SIZE_LIMIT = 4 * 1024 * 1024;
+constexpr auto BUNDLE_MAX_FILES = 4096;
+constexpr auto GATEWAY_UPSTREAMS = 4;
+constexpr auto MUX_FRAME_SIZE = 16 * 1024;
+constexpr auto MUX_STREAM_QUEUE_LIMIT = 256 * 1024;
+constexpr auto MUX_WRITE_SIZE = 32 * 1024;
+constexpr auto MUX_UNSENT_LIMIT = 64 * 1024;
 constexpr auto FAILURE = 0;
 constexpr auto SUCCESS = 1;
 constexpr auto SPECIAL = 2;
 
 // This method checks if the given string s represents a valid integer.
 bool is_integer(const std::string& s);
-// This method receives the response header, saves the code in a uint16_t variable, converts it from little endian to native endianess, and returns it.
-uint16_t get_response_code(std::vector<uint8_t> header);
-// This method receives the response header, saves the payload size in a uint32_t variable, converts it from little endian to native endianess, and returns it.
-uint32_t get_response_payload_size(std::vector<uint8_t> header);
-// This method receives two uuids, one as a vector and one as a boost::uuids::uuid type, and checks if they're identical.
-bool id_vectors_match(std::vector<uint8_t> first, UUID second);
-// This method checks if the two given file names are identical.
-bool file_names_match(std::string response_file_name, char file_name[], size_t file_length);
 // This method returns a boost::uuids::uuid representation of the given string client_id.
 UUID getUuidFromString(std::string client_id);
 // This method receives a file name, opens it in binary format and returns the entire file data as a char array.
@@ -69,19 +97,32 @@ enum PayloadSize: uint32_t {
 	REGISTRATION_P = 255,
 	SENDING_PUBLIC_KEY_P = 415,
 	RECONNECTION_P = 255,
-	SENDING_FILE_P = 1291,
+	SENDING_FILE_P = 1311,
 	VALID_CRC_P = 255,
 	SENDING_CRC_AGAIN_P = 255,
 	INVALID_CRC_DONE_P = 255,
+	SENDING_ECDH_KEY_P = 287,
+	ECDH_RECONNECTION_P = 255,
+	TICKET_RECONNECTION_P = 343,
+	SENDING_BUNDLE_P = 1311,
+	VALID_CRC_TICKET_P = 255,
+	MULTIPLEX_P = 0,
+	CHECKED_TICKET_RECONNECTION_P = 343,
 
 	REGISTRATION_SUCCEEDED_P = 16,
 	REGISTRATION_FAILED_P = 0,
 	PUBLIC_KEY_RECEIVED_P = 144,
-	FILE_RECEIVED_CRC_P = 279,
+	FILE_RECEIVED_CRC_P = 283,
 	MESSAGE_RECEIVED_P = 16,
 	RECONNECTION_SUCCEEDED_P = 144,
 	RECONNECTION_FAILED_P = 16,
-	GENERAL_ERROR_P = 0
+	GENERAL_ERROR_P = 0,
+	ECDH_KEY_RECEIVED_P = 48,
+	ECDH_RECONNECTION_SUCCEEDED_P = 48,
+	MESSAGE_RECEIVED_TICKET_P = 156,
+	TICKET_REJECTED_P = 0,
+	MULTIPLEX_ACCEPTED_P = 4,
+	TICKET_ACCEPTED_P = 0
 };
 
 // Enum used for distinguishing different requests/responses' codes.
@@ -93,6 +134,13 @@ enum Codes: uint16_t {
 	VALID_CRC_C = 900,
 	SENDING_CRC_AGAIN_C = 901,
 	INVALID_CRC_DONE_C = 902,
+	SENDING_ECDH_KEY_C = 829,
+	ECDH_RECONNECTION_C = 830,
+	TICKET_RECONNECTION_C = 831,
+	SENDING_BUNDLE_C = 832,
+	VALID_CRC_TICKET_C = 903,
+	MULTIPLEX_C = 833,
+	CHECKED_TICKET_RECONNECTION_C = 834,
 
 	REGISTRATION_SUCCEEDED_C = 1600,
 	REGISTRATION_FAILED_C = 1601,
@@ -101,7 +149,13 @@ enum Codes: uint16_t {
 	MESSAGE_RECEIVED_C = 1604,
 	RECONNECTION_SUCCEEDED_C = 1605,
 	RECONNECTION_FAILED_C = 1606,
-	GENERAL_ERROR_C = 1607
+	GENERAL_ERROR_C = 1607,
+	ECDH_KEY_RECEIVED_C = 1610,
+	ECDH_RECONNECTION_SUCCEEDED_C = 1611,
+	MESSAGE_RECEIVED_TICKET_C = 1612,
+	TICKET_REJECTED_C = 1613,
+	MULTIPLEX_ACCEPTED_C = 1614,
+	TICKET_ACCEPTED_C = 1615
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,277 @@
+#include "watcher.hpp"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+UploadQueue::UploadQueue(size_t capacity) :
+	capacity(capacity),
+	closed(false)
+{
+
+}
+
+bool UploadQueue::push(std::string job) {
+	std::unique_lock<std::mutex> lock(jobs_lock);
+	not_full.wait(lock, [this] { return jobs.size() < capacity || closed; });
+
+	if (closed) {
+		return false;
+	}
+
+	jobs.push_back(job);
+	not_empty.notify_one();
+	return true;
+}
+
+bool UploadQueue::pop(std::string& job) {
+	std::unique_lock<std::mutex> lock(jobs_lock);
+	not_empty.wait(lock, [this] { return !jobs.empty() || closed; });
+
+	if (jobs.empty()) {
+		return false;
+	}
+
+	job = jobs.front();
+	jobs.pop_front();
+	not_full.notify_one();
+	return true;
+}
+
+void UploadQueue::close() {
+	{
+		std::lock_guard<std::mutex> lock(jobs_lock);
+		closed = true;
+	}
+	not_empty.notify_all();
+	not_full.notify_all();
+}
+
+SpoolWatcher::SpoolWatcher(std::string spool_dir, UploadQueue& queue) :
+	spool_dir(spool_dir),
+	queue(queue),
+	stopping(false)
+{
+	worker = std::thread(&SpoolWatcher::watch, this);
+}
+
+SpoolWatcher::~SpoolWatcher() {
+	stopping = true;
+	queue.close();
+
+	if (worker.joinable()) {
+		worker.join();
+	}
+}
+
+void SpoolWatcher::watch() {
+#ifdef __linux__
+	if (watch_inotify()) {
+		return;
+	}
+#endif
+#ifdef _WIN32
+	if (watch_directory_changes()) {
+		return;
+	}
+#endif
+	watch_polling();
+}
+
+void SpoolWatcher::scan() {
+	std::vector<std::pair<std::filesystem::file_time_type, std::string>> found;
+	std::set<std::string> present;
+
+	// The scan runs on the watcher's thread, so nothing in it may throw. A file that vanishes during the scan is skipped,
+	// a listing that can't be completed is dropped so no queued job is forgotten because of it.
+	std::error_code ec;
+	std::filesystem::directory_iterator it(EXE_DIR_FILE_PATH(spool_dir), ec);
+	for (; !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+		std::error_code entry_ec;
+		if (!it->is_regular_file(entry_ec)) {
+			continue;
+		}
+		std::filesystem::file_time_type write_time = it->last_write_time(entry_ec);
+		if (entry_ec) {
+			continue;
+		}
+		std::string file_name = it->path().filename().string();
+		present.insert(file_name);
+		found.emplace_back(write_time, file_name);
+	}
+	if (ec) {
+		return;
+	}
+
+	// Forget jobs that left the spool directory without being reported finished (removed by someone else).
+	{
+		std::lock_guard<std::mutex> lock(queued_lock);
+		for (auto it = queued.begin(); it != queued.end();) {
+			it = (present.count(*it) == 0) ? queued.erase(it) : std::next(it);
+		}
+	}
+
+	std::sort(found.begin(), found.end());
+	for (const auto& job : found) {
+		enqueue(job.second);
+	}
+}
+
+void SpoolWatcher::enqueue(std::string file_name) {
+	{
+		std::lock_guard<std::mutex> lock(queued_lock);
+		if (!queued.insert(file_name).second) {
+			return;
+		}
+	}
+
+	// Jobs are paths relative to the executable's directory, like the file in transfer.info. The lock isn't held while
+	// the queue is full, so the uploader can report the jobs it finishes meanwhile.
+	queue.push(spool_dir + "\\" + file_name);
+}
+
+void SpoolWatcher::finished(const std::string& job) {
+	std::string prefix = spool_dir + "\\";
+	if (job.compare(0, prefix.size(), prefix) != 0) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(queued_lock);
+	queued.erase(job.substr(prefix.size()));
+}
+
+#ifdef __linux__
+bool SpoolWatcher::watch_inotify() {
+	int fd = inotify_init1(IN_CLOEXEC);
+	if (fd < 0) {
+		return false;
+	}
+
+	// Watch before scanning, so a job arriving during the scan is not missed (it may be reported twice instead).
+	std::string spool_path = EXE_DIR_FILE_PATH(spool_dir);
+	if (inotify_add_watch(fd, spool_path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		::close(fd);
+		return false;
+	}
+	scan();
+
+	alignas(struct inotify_event) char buffer[4096];
+	while (!stopping) {
+		// Wake up every poll interval to check whether the watcher is stopping.
+		pollfd pfd = { fd, POLLIN, 0 };
+		if (poll(&pfd, 1, DAEMON_POLL_INTERVAL_MS) <= 0) {
+			continue;
+		}
+
+		ssize_t length = read(fd, buffer, sizeof(buffer));
+		for (char* ptr = buffer; length > 0 && ptr < buffer + length;) {
+			const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(ptr);
+			ptr += sizeof(struct inotify_event) + event->len;
+
+			// Events were dropped by the kernel while the queue was full, look at the whole directory again.
+			if (event->mask & IN_Q_OVERFLOW) {
+				scan();
+			}
+			else if (event->len > 0 && !(event->mask & IN_ISDIR)) {
+				enqueue(event->name);
+			}
+		}
+	}
+
+	::close(fd);
+	return true;
+}
+#endif
+
+#ifdef _WIN32
+bool SpoolWatcher::watch_directory_changes() {
+	std::string spool_path = EXE_DIR_FILE_PATH(spool_dir);
+	HANDLE dir = CreateFileA(spool_path.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+		FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+	if (dir == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	OVERLAPPED overlapped = {};
+	overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+	if (overlapped.hEvent == NULL) {
+		CloseHandle(dir);
+		return false;
+	}
+
+	// The changes are written into a DWORD aligned buffer, while the watcher waits on the event.
+	std::vector<DWORD> buffer(16 * 1024);
+	auto watch_changes = [&] {
+		ResetEvent(overlapped.hEvent);
+		return ReadDirectoryChangesW(dir, buffer.data(), static_cast<DWORD>(buffer.size() * sizeof(DWORD)), FALSE, FILE_NOTIFY_CHANGE_FILE_NAME,
+			NULL, &overlapped, NULL) != 0;
+	};
+
+	// Watch before scanning, so a job arriving during the scan is not missed (it may be reported twice instead).
+	bool watching = watch_changes();
+	if (watching) {
+		scan();
+	}
+
+	while (watching && !stopping) {
+		// Wake up every poll interval to check whether the watcher is stopping.
+		if (WaitForSingleObject(overlapped.hEvent, DAEMON_POLL_INTERVAL_MS) != WAIT_OBJECT_0) {
+			continue;
+		}
+
+		DWORD length = 0;
+		if (!GetOverlappedResult(dir, &overlapped, &length, FALSE)) {
+			watching = false;
+			break;
+		}
+
+		// The changes didn't fit in the buffer and were dropped, look at the whole directory again.
+		if (length == 0) {
+			scan();
+		}
+		else {
+			const uint8_t* ptr = reinterpret_cast<const uint8_t*>(buffer.data());
+			while (true) {
+				const FILE_NOTIFY_INFORMATION* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(ptr);
+				if (info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_RENAMED_NEW_NAME) {
+					std::filesystem::path path = std::filesystem::path(spool_path) / std::wstring(info->FileName, info->FileNameLength / sizeof(WCHAR));
+					std::error_code ec;
+					if (std::filesystem::is_regular_file(path, ec)) {
+						enqueue(path.filename().string());
+					}
+				}
+				if (info->NextEntryOffset == 0) {
+					break;
+				}
+				ptr += info->NextEntryOffset;
+			}
+		}
+
+		watching = watch_changes();
+	}
+
+	// Wait for the pending watch to be cancelled, so the buffer isn't written after it's gone.
+	if (watching) {
+		CancelIo(dir);
+		DWORD length = 0;
+		GetOverlappedResult(dir, &overlapped, &length, TRUE);
+	}
+	CloseHandle(overlapped.hEvent);
+	CloseHandle(dir);
+
+	// A watch that failed midway falls back to polling.
+	return stopping;
+}
+#endif
+
+void SpoolWatcher::watch_polling() {
+	while (!stopping) {
+		scan();
+		std::this_thread::sleep_for(std::chrono::milliseconds(DAEMON_POLL_INTERVAL_MS));
+	}
+}
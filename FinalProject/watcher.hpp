@@ -0,0 +1,78 @@
+#ifndef WATCHER_H
+#define WATCHER_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <set>
+#include <algorithm>
+#include "utils.hpp"
+
+/*
+	A bounded queue of upload jobs, handed from the spool watcher to the uploader.
+	When the queue is full, push() blocks - the watcher stops taking new events until the uploader catches up.
+*/
+class UploadQueue {
+	size_t capacity;
+	std::deque<std::string> jobs;
+	std::mutex jobs_lock;
+	std::condition_variable not_empty;
+	std::condition_variable not_full;
+	bool closed;
+
+	public:
+		UploadQueue(size_t capacity);
+
+		// This method adds a job to the queue, waiting while the queue is full. Returns false if the queue was closed.
+		bool push(std::string job);
+		// This method takes the oldest job out of the queue, waiting while the queue is empty. Returns false if the queue was closed and emptied.
+		bool pop(std::string& job);
+		// This method closes the queue, waking up every waiting thread.
+		void close();
+};
+
+/*
+	Watches the spool directory on a separate thread, and pushes every new job into the upload queue.
+	On Linux, inotify reports files as soon as they are closed after writing (or moved into the directory).
+	On Windows, ReadDirectoryChangesW reports files as soon as they are created or moved into the directory - there is no
+	notification of a file closed after writing, so jobs should be written elsewhere and moved in. Elsewhere (or if the
+	directory can't be watched) the directory is polled, with the same requirement.
+	A job is only queued once until the uploader reports it finished, a file reported again meanwhile is skipped.
+*/
+class SpoolWatcher {
+	std::string spool_dir;
+	UploadQueue& queue;
+	// The names of the jobs queued and not finished yet, the uploader reports finished jobs from its own thread.
+	std::mutex queued_lock;
+	std::set<std::string> queued;
+	std::atomic<bool> stopping;
+	std::thread worker;
+
+	// This method runs on the watcher thread.
+	void watch();
+	// This method pushes the jobs already in the spool directory that were not queued yet, oldest first.
+	void scan();
+	// This method pushes a job (a file name in the spool directory) into the upload queue, unless it's queued already.
+	void enqueue(std::string file_name);
+#ifdef __linux__
+	// This method waits for inotify events, returns false if inotify could not be used.
+	bool watch_inotify();
+#endif
+#ifdef _WIN32
+	// This method waits for the directory's change notifications, returns false if the directory could not be watched.
+	bool watch_directory_changes();
+#endif
+	// This method polls the spool directory.
+	void watch_polling();
+
+	public:
+		SpoolWatcher(std::string spool_dir, UploadQueue& queue);
+		~SpoolWatcher();
+
+		// This method forgets a job (as popped from the upload queue) once the uploader is done with it, so a new file with the same name is queued again.
+		void finished(const std::string& job);
+};
+
+#endif
@@ -0,0 +1,105 @@
+#include "wire.hpp"
+
+Response::Response() :
+	code(0),
+	payload_size(0)
+{
+
+}
+
+void wait_for_response(tcp::socket& sock, std::chrono::milliseconds timeout) {
+	if (timeout.count() <= 0) {
+		return;
+	}
+
+	// Errors and a closed connection count as ready, the read that follows reports them.
+#ifdef _WIN32
+	WSAPOLLFD fd = { sock.native_handle(), POLLRDNORM, 0 };
+	int ready = WSAPoll(&fd, 1, (INT)std::min<long long>(timeout.count(), INT_MAX));
+#else
+	pollfd fd = { sock.native_handle(), POLLIN, 0 };
+	int ready = poll(&fd, 1, (int)std::min<long long>(timeout.count(), INT_MAX));
+#endif
+	if (ready == 0) {
+		throw ResponseTimeout();
+	}
+}
+
+std::chrono::steady_clock::time_point response_deadline(std::chrono::milliseconds timeout) {
+	if (timeout.count() <= 0) {
+		return std::chrono::steady_clock::time_point::max();
+	}
+	return std::chrono::steady_clock::now() + timeout;
+}
+
+void read_response(tcp::socket& sock, uint8_t* data, size_t size, std::chrono::steady_clock::time_point deadline) {
+	if (deadline == std::chrono::steady_clock::time_point::max()) {
+		boost::asio::read(sock, boost::asio::buffer(data, size));
+		return;
+	}
+
+	// A server that stalls in the middle of a response is given no more time than one that never starts it.
+	size_t read = 0;
+	while (read < size) {
+		std::chrono::steady_clock::duration left = deadline - std::chrono::steady_clock::now();
+		if (left <= std::chrono::steady_clock::duration::zero()) {
+			throw ResponseTimeout();
+		}
+		wait_for_response(sock, std::chrono::ceil<std::chrono::milliseconds>(left));
+
+		boost::system::error_code ec;
+		read += sock.read_some(boost::asio::buffer(data + read, size - read), ec);
+		if (ec) {
+			throw boost::system::system_error(ec);
+		}
+	}
+}
+
+void Response::receive(tcp::socket& sock, std::chrono::milliseconds timeout) {
+	std::chrono::steady_clock::time_point deadline = response_deadline(timeout);
+	read_response(sock, header, RESPONSE_HEADER_SIZE, deadline);
+	code = get_response_code(ByteView(header, RESPONSE_HEADER_SIZE));
+	payload_size = get_response_payload_size(ByteView(header, RESPONSE_HEADER_SIZE));
+
+	// No valid response is this large, consume the payload so the connection stays in sync for the next attempt, then fail.
+	if (payload_size > MAX_RESPONSE_PAYLOAD_SIZE) {
+		uint32_t remaining = payload_size;
+		while (remaining > 0) {
+			size_t amt = std::min<size_t>(remaining, sizeof(payload));
+			read_response(sock, payload, amt, deadline);
+			remaining -= amt;
+		}
+		payload_size = 0;
+		throw std::invalid_argument("server responded with an error.");
+	}
+
+	read_response(sock, payload, payload_size, deadline);
+}
+
+uint16_t Response::getCode() const {
+	return this->code;
+}
+
+uint32_t Response::getPayloadSize() const {
+	return this->payload_size;
+}
+
+ByteView Response::getPayload() const {
+	return ByteView(payload, payload_size);
+}
+
+uint16_t get_response_code(ByteView header) {
+	return ResponseHeaderLayout::get<1>(header);
+}
+
+uint32_t get_response_payload_size(ByteView header) {
+	return ResponseHeaderLayout::get<2>(header);
+}
+
+bool ids_match(ByteView response_id, const UUID& uuid) {
+	return response_id.size() == uuid.size() && std::equal(response_id.begin(), response_id.end(), uuid.begin());
+}
+
+bool file_names_match(ByteView response_file_name, const char file_name[], size_t file_length) {
+	return response_file_name.size() == file_length && memcmp(response_file_name.data(), file_name, file_length) == 0;
+}
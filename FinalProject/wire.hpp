@@ -0,0 +1,228 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <tuple>
+#include <type_traits>
+#include "utils.hpp"
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+/*
+	Compile-time descriptions of the protocol's wire formats.
+	A Layout lists a message's fields in order; every field's offset is computed at compile time, so packing and unpacking
+	are fixed-offset stores and loads, and the layouts are checked against PayloadSize below - a layout that drifts from the
+	protocol does not compile.
+	Usage: SendingFileLayout::put<2>(payload, packet_number) and FileReceivedCrcLayout::get<3>(payload).
+*/
+
+/*
+	A read-only view of a range of bytes that doesn't own them (the project is C++17, so this stands in for std::span<const uint8_t>).
+	Responses are decoded through views into the buffer they were received into, so no field is copied just to be inspected.
+*/
+class ByteView {
+	const uint8_t* bytes;
+	size_t length;
+
+	public:
+		constexpr ByteView() : bytes(nullptr), length(0) {}
+		constexpr ByteView(const uint8_t* bytes, size_t length) : bytes(bytes), length(length) {}
+		explicit ByteView(const std::string& text) : bytes(reinterpret_cast<const uint8_t*>(text.data())), length(text.size()) {}
+
+		constexpr const uint8_t* data() const { return bytes; }
+		constexpr size_t size() const { return length; }
+		constexpr const uint8_t* begin() const { return bytes; }
+		constexpr const uint8_t* end() const { return bytes + length; }
+		constexpr uint8_t operator[](size_t i) const { return bytes[i]; }
+};
+
+// A number field, in little endian order.
+template <typename T>
+struct Number {
+	static_assert(std::is_integral<T>::value, "A number field must be of an integral type.");
+	static constexpr size_t size = sizeof(T);
+
+	// The value must be of the field's exact type, so a value is never silently narrowed or widened on the wire.
+	template <typename V>
+	static void store(uint8_t* buffer, V value) {
+		static_assert(std::is_same<V, T>::value, "The value's type does not match the field's type.");
+		T value_le = boost::endian::native_to_little(value);
+		memcpy(buffer, &value_le, sizeof(value_le));
+	}
+
+	static T load(const uint8_t* buffer) {
+		T value_le;
+		memcpy(&value_le, buffer, sizeof(value_le));
+		return boost::endian::little_to_native(value_le);
+	}
+};
+
+// A fixed size byte field - an id, a name, a key or file content.
+template <size_t N>
+struct Bytes {
+	static constexpr size_t size = N;
+
+	// The array must be exactly the field's size.
+	template <typename Byte, size_t M>
+	static void store(uint8_t* buffer, const Byte (&value)[M]) {
+		static_assert(sizeof(Byte) == 1 && M == N, "The array's size does not match the field's size.");
+		memcpy(buffer, value, N);
+	}
+
+	static void store(uint8_t* buffer, const UUID& value) {
+		static_assert(sizeof(UUID) == N, "A UUID does not fit the field's size.");
+		std::copy(value.begin(), value.end(), buffer);
+	}
+
+	// Returns a view of the field inside the buffer, the field is not copied.
+	static ByteView load(const uint8_t* buffer) {
+		return ByteView(buffer, N);
+	}
+};
+
+template <typename... Fields>
+struct Layout {
+	// The total size of the message's fields.
+	static constexpr size_t size = (Fields::size + ... + 0);
+	static constexpr size_t fields = sizeof...(Fields);
+
+	template <size_t I>
+	using field = std::tuple_element_t<I, std::tuple<Fields...>>;
+
+	// Returns the offset of field I, the sum of the sizes of the fields before it.
+	template <size_t I>
+	static constexpr size_t offset() {
+		static_assert(I < fields, "The layout has no such field.");
+		constexpr size_t sizes[] = { Fields::size... };
+		size_t result = 0;
+		for (size_t i = 0; i < I; i++) {
+			result += sizes[i];
+		}
+		return result;
+	}
+
+	// This method stores a value into field I of the given message.
+	template <size_t I, typename V>
+	static void put(uint8_t* message, const V& value) {
+		field<I>::store(message + offset<I>(), value);
+	}
+
+	// This method loads field I of the given message (a number, or a view of the field's bytes).
+	template <size_t I>
+	static auto get(const uint8_t* message) {
+		return field<I>::load(message + offset<I>());
+	}
+
+	template <size_t I>
+	static auto get(ByteView message) {
+		return get<I>(message.data());
+	}
+};
+
+// Headers.
+using RequestHeaderLayout = Layout<Bytes<sizeof(UUID)>, Number<uint8_t>, Number<uint16_t>, Number<uint32_t>>;
+using ResponseHeaderLayout = Layout<Number<uint8_t>, Number<uint16_t>, Number<uint32_t>>;
+
+// Requests' payloads.
+using NameLayout = Layout<Bytes<NAME_SIZE>>;
+using RegistrationLayout = NameLayout;
+using SendingPublicKeyLayout = Layout<Bytes<NAME_SIZE>, Bytes<KEY_LENGTH>>;
+using ReconnectionLayout = NameLayout;
+// Since version 4 the sizes and packet counters are 64 bit, for files over 4 GiB.
+using SendingFileLayout = Layout<Number<uint64_t>, Number<uint64_t>, Number<uint64_t>, Number<uint64_t>, Bytes<NAME_SIZE>, Bytes<CONTENT_SIZE_PER_PACKET>>;
+using FileNameLayout = Layout<Bytes<NAME_SIZE>>;
+using SendingEcdhKeyLayout = Layout<Bytes<NAME_SIZE>, Bytes<ECDH_KEY_LENGTH>>;
+using EcdhReconnectionLayout = NameLayout;
+using TicketReconnectionLayout = Layout<Bytes<NAME_SIZE>, Bytes<TICKET_LENGTH>>;
+
+// Responses' payloads.
+using ClientIdLayout = Layout<Bytes<sizeof(UUID)>>;
+using EncryptedAesKeyLayout = Layout<Bytes<sizeof(UUID)>, Bytes<ENC_AES_KEY_LENGTH>>;
+using FileReceivedCrcLayout = Layout<Bytes<sizeof(UUID)>, Number<uint64_t>, Bytes<NAME_SIZE>, Number<uint32_t>>;
+using ServerEcdhKeyLayout = Layout<Bytes<sizeof(UUID)>, Bytes<ECDH_KEY_LENGTH>>;
+using MessageReceivedTicketLayout = Layout<Bytes<sizeof(UUID)>, Number<uint32_t>, Bytes<ENC_RESUMPTION_KEY_LENGTH>, Bytes<TICKET_LENGTH>>;
+// The initial credit of every stream of the multiplexed connection (see mux.hpp).
+using MultiplexAcceptedLayout = Layout<Number<uint32_t>>;
+
+static_assert(RequestHeaderLayout::size == REQUEST_HEADER_SIZE, "Request header layout out of sync.");
+static_assert(ResponseHeaderLayout::size == RESPONSE_HEADER_SIZE, "Response header layout out of sync.");
+
+static_assert(RegistrationLayout::size == PayloadSize::REGISTRATION_P, "Registration layout out of sync.");
+static_assert(SendingPublicKeyLayout::size == PayloadSize::SENDING_PUBLIC_KEY_P, "Sending Public Key layout out of sync.");
+static_assert(ReconnectionLayout::size == PayloadSize::RECONNECTION_P, "Reconnection layout out of sync.");
+static_assert(SendingFileLayout::size == PayloadSize::SENDING_FILE_P, "Sending File layout out of sync.");
+static_assert(FileNameLayout::size == PayloadSize::VALID_CRC_P, "Valid CRC layout out of sync.");
+static_assert(FileNameLayout::size == PayloadSize::SENDING_CRC_AGAIN_P, "Sending CRC Again layout out of sync.");
+static_assert(FileNameLayout::size == PayloadSize::INVALID_CRC_DONE_P, "Invalid CRC Done layout out of sync.");
+static_assert(FileNameLayout::size == PayloadSize::VALID_CRC_TICKET_P, "Valid CRC Ticket layout out of sync.");
+static_assert(SendingEcdhKeyLayout::size == PayloadSize::SENDING_ECDH_KEY_P, "Sending ECDH Key layout out of sync.");
+static_assert(EcdhReconnectionLayout::size == PayloadSize::ECDH_RECONNECTION_P, "ECDH Reconnection layout out of sync.");
+static_assert(TicketReconnectionLayout::size == PayloadSize::TICKET_RECONNECTION_P, "Ticket Reconnection layout out of sync.");
+static_assert(TicketReconnectionLayout::size == PayloadSize::CHECKED_TICKET_RECONNECTION_P, "Checked Ticket Reconnection layout out of sync.");
+static_assert(SendingFileLayout::size == PayloadSize::SENDING_BUNDLE_P, "Sending Bundle layout out of sync.");
+
+static_assert(ClientIdLayout::size == PayloadSize::REGISTRATION_SUCCEEDED_P, "Registration Succeeded layout out of sync.");
+static_assert(EncryptedAesKeyLayout::size == PayloadSize::PUBLIC_KEY_RECEIVED_P, "Public Key Received layout out of sync.");
+static_assert(FileReceivedCrcLayout::size == PayloadSize::FILE_RECEIVED_CRC_P, "File Received CRC layout out of sync.");
+static_assert(ClientIdLayout::size == PayloadSize::MESSAGE_RECEIVED_P, "Message Received layout out of sync.");
+static_assert(EncryptedAesKeyLayout::size == PayloadSize::RECONNECTION_SUCCEEDED_P, "Reconnection Succeeded layout out of sync.");
+static_assert(ClientIdLayout::size == PayloadSize::RECONNECTION_FAILED_P, "Reconnection Failed layout out of sync.");
+static_assert(ServerEcdhKeyLayout::size == PayloadSize::ECDH_KEY_RECEIVED_P, "ECDH Key Received layout out of sync.");
+static_assert(ServerEcdhKeyLayout::size == PayloadSize::ECDH_RECONNECTION_SUCCEEDED_P, "ECDH Reconnection Succeeded layout out of sync.");
+static_assert(MessageReceivedTicketLayout::size == PayloadSize::MESSAGE_RECEIVED_TICKET_P, "Message Received Ticket layout out of sync.");
+static_assert(MultiplexAcceptedLayout::size == PayloadSize::MULTIPLEX_ACCEPTED_P, "Multiplex Accepted layout out of sync.");
+
+// The largest payload the server may respond with, a response is always received into a buffer of this size.
+constexpr size_t MAX_RESPONSE_PAYLOAD_SIZE = std::max({ ClientIdLayout::size, EncryptedAesKeyLayout::size, FileReceivedCrcLayout::size,
+	ServerEcdhKeyLayout::size, MessageReceivedTicketLayout::size, MultiplexAcceptedLayout::size });
+
+// Thrown when the server's response does not arrive within the retry policy's timeout.
+class ResponseTimeout : public std::runtime_error {
+	public:
+		ResponseTimeout() : std::runtime_error("timed out waiting for the server's response.") {}
+};
+
+// This method waits until the server's response starts arriving on the socket, throws ResponseTimeout if it doesn't within the timeout (0 waits forever).
+void wait_for_response(tcp::socket& sock, std::chrono::milliseconds timeout);
+// This method returns the time by which a response given the timeout must have arrived in full, time_point::max() if the timeout is 0 (waits forever).
+std::chrono::steady_clock::time_point response_deadline(std::chrono::milliseconds timeout);
+// This method reads exactly size bytes of a response from the socket, throws ResponseTimeout if they haven't all arrived by the deadline.
+void read_response(tcp::socket& sock, uint8_t* data, size_t size, std::chrono::steady_clock::time_point deadline);
+
+/*
+	A response received from the server.
+	The header and payload are read into fixed size buffers that are part of the object (so a Response on the stack allocates nothing),
+	and the payload is exposed as a view that the response layouts decode in place.
+*/
+class Response {
+	uint8_t header[RESPONSE_HEADER_SIZE];
+	uint8_t payload[MAX_RESPONSE_PAYLOAD_SIZE];
+	uint16_t code;
+	uint32_t payload_size;
+
+	public:
+		Response();
+
+		/*
+			This method reads a response (header and payload) from the socket, throws if the payload is larger than any valid response.
+			The whole response must arrive within the timeout (0 waits forever), or ResponseTimeout is thrown.
+		*/
+		void receive(tcp::socket& sock, std::chrono::milliseconds timeout);
+		uint16_t getCode() const;
+		uint32_t getPayloadSize() const;
+		ByteView getPayload() const;
+};
+
+// This method receives the response header, and returns the code in native endianess.
+uint16_t get_response_code(ByteView header);
+// This method receives the response header, and returns the payload size in native endianess.
+uint32_t get_response_payload_size(ByteView header);
+// This method checks if the id in the response is identical to the given uuid.
+bool ids_match(ByteView response_id, const UUID& uuid);
+// This method checks if the file name in the response is identical to the given file name.
+bool file_names_match(ByteView response_file_name, const char file_name[], size_t file_length);
+
+#endif
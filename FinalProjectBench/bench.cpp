@@ -0,0 +1,346 @@
+#include "bench.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+namespace {
+	struct Benchmark {
+		std::string name;
+		BenchFunction function;
+		int64_t argument;
+	};
+
+	struct BenchResult {
+		std::string name;
+		std::string run_type;
+		std::string aggregate_name;
+		int repetition_index;
+		uint64_t iterations;
+		double real_time;
+		double cpu_time;
+		double bytes_per_second;
+	};
+
+	std::vector<Benchmark>& registered_benchmarks() {
+		static std::vector<Benchmark> benchmarks;
+		return benchmarks;
+	}
+
+	// Upper bound on the number of iterations of a single run, so a benchmark the compiler optimized away still ends.
+	constexpr uint64_t MAX_ITERATIONS = 1000000000;
+}
+
+BenchState::BenchState(int64_t argument, uint64_t max_iterations) :
+	argument(argument),
+	max_iterations(max_iterations),
+	iterations(0),
+	bytes_processed(0),
+	timing(false),
+	cpu_start(0),
+	real_time(0),
+	cpu_time(0)
+{
+
+}
+
+bool BenchState::keepRunning() {
+	if (iterations == 0 && !timing) {
+		resumeTiming();
+	}
+
+	if (iterations < max_iterations) {
+		iterations++;
+		return true;
+	}
+
+	pauseTiming();
+	return false;
+}
+
+void BenchState::pauseTiming() {
+	if (timing) {
+		real_time += std::chrono::steady_clock::now() - real_start;
+		cpu_time += static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+		timing = false;
+	}
+}
+
+void BenchState::resumeTiming() {
+	if (!timing) {
+		timing = true;
+		cpu_start = std::clock();
+		real_start = std::chrono::steady_clock::now();
+	}
+}
+
+int64_t BenchState::range() const {
+	return this->argument;
+}
+
+void BenchState::setBytesProcessed(uint64_t bytes) {
+	this->bytes_processed = bytes;
+}
+
+uint64_t BenchState::getIterations() const {
+	return this->iterations;
+}
+
+uint64_t BenchState::getBytesProcessed() const {
+	return this->bytes_processed;
+}
+
+// Returns the measured wall time in seconds.
+double BenchState::getRealTime() const {
+	return std::chrono::duration<double>(real_time).count();
+}
+
+// Returns the measured process CPU time in seconds.
+double BenchState::getCpuTime() const {
+	return this->cpu_time;
+}
+
+void register_benchmark(std::string name, BenchFunction function, std::vector<int64_t> arguments) {
+	if (arguments.empty()) {
+		registered_benchmarks().push_back({ name, function, 0 });
+		return;
+	}
+
+	for (int64_t argument : arguments) {
+		registered_benchmarks().push_back({ name + "/" + std::to_string(argument), function, argument });
+	}
+}
+
+void use_char_pointer(const volatile char*) {
+
+}
+
+/*
+	This method runs a single repetition of a benchmark.
+	It starts with one iteration and keeps growing the count (by the ratio between the minimum time and the last run's time)
+	until a run lasts at least min_time seconds, the last run is the one reported.
+*/
+static BenchResult run_repetition(const Benchmark& benchmark, double min_time, int repetition_index) {
+	uint64_t iterations = 1;
+
+	while (true) {
+		BenchState state(benchmark.argument, iterations);
+		benchmark.function(state);
+
+		double real_time = state.getRealTime();
+		if (real_time >= min_time || iterations >= MAX_ITERATIONS) {
+			BenchResult result;
+			result.name = benchmark.name;
+			result.run_type = "iteration";
+			result.repetition_index = repetition_index;
+			result.iterations = state.getIterations();
+			result.real_time = real_time * 1e9 / state.getIterations();
+			result.cpu_time = state.getCpuTime() * 1e9 / state.getIterations();
+			result.bytes_per_second = (state.getBytesProcessed() && real_time > 0) ? state.getBytesProcessed() / real_time : 0;
+			return result;
+		}
+
+		// Aim a bit above the minimum time, but never grow more than tenfold at once (the first runs are noisy).
+		double multiplier = (real_time > 0) ? std::min(10.0, min_time * 1.4 / real_time) : 10.0;
+		iterations = std::min(MAX_ITERATIONS, std::max(iterations + 1, static_cast<uint64_t>(iterations * multiplier)));
+	}
+}
+
+// This method summarizes the repetitions of a single benchmark into mean, median and standard deviation rows.
+static std::vector<BenchResult> aggregate(const std::vector<BenchResult>& repetitions) {
+	std::vector<BenchResult> aggregates;
+
+	auto summarize = [&](std::string aggregate_name, double (*statistic)(std::vector<double>)) {
+		std::vector<double> real_times, cpu_times, throughputs;
+		for (const BenchResult& result : repetitions) {
+			real_times.push_back(result.real_time);
+			cpu_times.push_back(result.cpu_time);
+			throughputs.push_back(result.bytes_per_second);
+		}
+
+		BenchResult result = repetitions.front();
+		result.name += "_" + aggregate_name;
+		result.run_type = "aggregate";
+		result.aggregate_name = aggregate_name;
+		result.iterations = repetitions.size();
+		result.real_time = statistic(real_times);
+		result.cpu_time = statistic(cpu_times);
+		result.bytes_per_second = statistic(throughputs);
+		aggregates.push_back(result);
+	};
+
+	summarize("mean", [](std::vector<double> values) {
+		double sum = 0;
+		for (double value : values) {
+			sum += value;
+		}
+		return sum / values.size();
+	});
+	summarize("median", [](std::vector<double> values) {
+		std::sort(values.begin(), values.end());
+		size_t middle = values.size() / 2;
+		return (values.size() % 2) ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+	});
+	summarize("stddev", [](std::vector<double> values) {
+		double sum = 0, squares = 0;
+		for (double value : values) {
+			sum += value;
+			squares += value * value;
+		}
+		double mean = sum / values.size();
+		return (values.size() > 1) ? std::sqrt(std::max(0.0, (squares - values.size() * mean * mean) / (values.size() - 1))) : 0.0;
+	});
+
+	return aggregates;
+}
+
+// This method escapes a string for use as a JSON string value.
+static std::string json_escape(const std::string& str) {
+	std::string escaped;
+	for (char c : str) {
+		if (c == '"' || c == '\\') {
+			escaped += '\\';
+		}
+		escaped += c;
+	}
+	return escaped;
+}
+
+/*
+	This method writes the results in the same JSON layout Google Benchmark uses (a context object and a benchmarks array),
+	so existing tooling for comparing runs across releases can read it.
+*/
+static void write_json(std::ostream& out, const std::vector<BenchResult>& results) {
+	std::time_t now = std::time(nullptr);
+	char date[32];
+	std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+	out << "{\n";
+	out << "  \"context\": {\n";
+	out << "    \"date\": \"" << date << "\",\n";
+	out << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+#ifdef NDEBUG
+	out << "    \"library_build_type\": \"release\"\n";
+#else
+	out << "    \"library_build_type\": \"debug\"\n";
+#endif
+	out << "  },\n";
+	out << "  \"benchmarks\": [";
+
+	for (size_t i = 0; i < results.size(); i++) {
+		const BenchResult& result = results[i];
+		out << (i ? ",\n" : "\n") << "    {\n";
+		out << "      \"name\": \"" << json_escape(result.name) << "\",\n";
+		out << "      \"run_type\": \"" << result.run_type << "\",\n";
+		if (result.run_type == "aggregate") {
+			out << "      \"aggregate_name\": \"" << result.aggregate_name << "\",\n";
+		}
+		else {
+			out << "      \"repetition_index\": " << result.repetition_index << ",\n";
+		}
+		out << "      \"iterations\": " << result.iterations << ",\n";
+		out << std::fixed << std::setprecision(3);
+		out << "      \"real_time\": " << result.real_time << ",\n";
+		out << "      \"cpu_time\": " << result.cpu_time << ",\n";
+		if (result.bytes_per_second > 0) {
+			out << "      \"bytes_per_second\": " << result.bytes_per_second << ",\n";
+		}
+		out << std::defaultfloat;
+		out << "      \"time_unit\": \"ns\"\n";
+		out << "    }";
+	}
+
+	out << "\n  ]\n}\n";
+}
+
+// This method prints a single result as a row of the console table.
+static void print_result(const BenchResult& result) {
+	std::cout << std::left << std::setw(44) << result.name << std::right
+		<< std::fixed << std::setprecision(0)
+		<< std::setw(14) << result.real_time << " ns"
+		<< std::setw(14) << result.cpu_time << " ns"
+		<< std::setw(12) << result.iterations;
+
+	if (result.bytes_per_second > 0) {
+		std::cout << std::setprecision(2) << std::setw(12) << result.bytes_per_second / (1024 * 1024) << " MiB/s";
+	}
+
+	std::cout << std::defaultfloat << std::endl;
+}
+
+/*
+	Flags:
+		--filter=<text>		Only run benchmarks whose name contains the given text.
+		--min_time=<seconds>	Minimum duration of a single repetition, 0.5 by default.
+		--repetitions=<n>	Run each benchmark n times and report mean, median and stddev as well.
+		--json=<file>		Also write the results as JSON into the given file.
+*/
+int run_benchmarks(int argc, char* argv[]) {
+	std::string filter, json_file;
+	double min_time = 0.5;
+	int repetitions = 1;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		try {
+			if (arg.rfind("--filter=", 0) == 0) {
+				filter = arg.substr(strlen("--filter="));
+			}
+			else if (arg.rfind("--min_time=", 0) == 0) {
+				min_time = std::stod(arg.substr(strlen("--min_time=")));
+			}
+			else if (arg.rfind("--repetitions=", 0) == 0) {
+				repetitions = std::max(1, std::stoi(arg.substr(strlen("--repetitions="))));
+			}
+			else if (arg.rfind("--json=", 0) == 0) {
+				json_file = arg.substr(strlen("--json="));
+			}
+			else {
+				throw std::invalid_argument(arg);
+			}
+		}
+		catch (std::exception&) {
+			std::cerr << "Error: unknown or invalid flag " << arg << "." << std::endl;
+			std::cerr << "Usage: " << argv[0] << " [--filter=<text>] [--min_time=<seconds>] [--repetitions=<n>] [--json=<file>]" << std::endl;
+			return 1;
+		}
+	}
+
+	std::cout << std::left << std::setw(44) << "Benchmark" << std::right
+		<< std::setw(17) << "Time" << std::setw(17) << "CPU" << std::setw(12) << "Iterations" << std::endl;
+	std::cout << std::string(90, '-') << std::endl;
+
+	std::vector<BenchResult> results;
+	for (const Benchmark& benchmark : registered_benchmarks()) {
+		if (benchmark.name.find(filter) == std::string::npos) {
+			continue;
+		}
+
+		std::vector<BenchResult> runs;
+		for (int i = 0; i < repetitions; i++) {
+			runs.push_back(run_repetition(benchmark, min_time, i));
+			print_result(runs.back());
+		}
+
+		results.insert(results.end(), runs.begin(), runs.end());
+		if (repetitions > 1) {
+			for (const BenchResult& result : aggregate(runs)) {
+				print_result(result);
+				results.push_back(result);
+			}
+		}
+	}
+
+	if (!json_file.empty()) {
+		std::ofstream out(json_file);
+		if (!out.is_open()) {
+			std::cerr << "Error: cannot open " << json_file << " for writing." << std::endl;
+			return 1;
+		}
+		write_json(out, results);
+	}
+
+	return 0;
+}
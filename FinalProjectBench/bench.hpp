@@ -0,0 +1,73 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ctime>
+#include <cstdint>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/*
+	A small benchmark harness, in the spirit of Google Benchmark, without adding another dependency to the build.
+	Each benchmark is a function receiving a BenchState, and timing whatever runs inside its 'while (state.keepRunning())' loop.
+	The harness grows the number of iterations until a run lasts at least the minimum time, and reports the time per iteration.
+*/
+class BenchState {
+	int64_t argument;
+	uint64_t max_iterations;
+	uint64_t iterations;
+	uint64_t bytes_processed;
+	bool timing;
+	std::chrono::steady_clock::time_point real_start;
+	std::clock_t cpu_start;
+	std::chrono::nanoseconds real_time;
+	double cpu_time;
+
+	public:
+		BenchState(int64_t argument, uint64_t max_iterations);
+
+		// This method returns true while the benchmark should run another iteration, the first and last calls start and stop the timer.
+		bool keepRunning();
+		// This method stops the timer, for work that shouldn't be measured (like preparing the next iteration's input).
+		void pauseTiming();
+		// This method starts the timer again after pauseTiming().
+		void resumeTiming();
+
+		// This method returns the benchmark's argument, usually a buffer size.
+		int64_t range() const;
+		// This method sets the total amount of bytes processed by all iterations, so a throughput is reported.
+		void setBytesProcessed(uint64_t bytes);
+
+		uint64_t getIterations() const;
+		uint64_t getBytesProcessed() const;
+		double getRealTime() const;
+		double getCpuTime() const;
+};
+
+typedef void (*BenchFunction)(BenchState&);
+
+// This method registers a benchmark, running it once for every given argument (or once with argument 0 if none are given).
+void register_benchmark(std::string name, BenchFunction function, std::vector<int64_t> arguments = {});
+// This method runs all registered benchmarks according to the command line flags, returns the process's exit code.
+int run_benchmarks(int argc, char* argv[]);
+
+// This method is never inlined, so the compiler can't prove the pointed value is unused.
+void use_char_pointer(const volatile char* ptr);
+
+// This method keeps the compiler from optimizing away the computation of the given value.
+template <typename T>
+inline void do_not_optimize(const T& value) {
+#if defined(_MSC_VER)
+	use_char_pointer(&reinterpret_cast<const volatile char&>(value));
+	_ReadWriteBarrier();
+#else
+	asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+#endif
@@ -0,0 +1,340 @@
+#include "bench.hpp"
+#include "loopback.hpp"
+#include "request.hpp"
+#include "stages.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#endif
+
+/*
+	Benchmarks of the client's hot paths - everything an upload does per file or per packet, apart from the network itself.
+	Sizes are in bytes. Run with --json=<file> to keep the results for comparing releases.
+*/
+
+// Buffer sizes from a single AES block up to a large file.
+static const std::vector<int64_t> BUFFER_SIZES = { 16, 1024, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024 };
+// File sizes for the file reading benchmarks.
+static const std::vector<int64_t> FILE_SIZES = { 4 * 1024, 1024 * 1024, 16 * 1024 * 1024 };
+
+// This method returns a buffer of the given size filled with pseudo random bytes (the same ones every run).
+static std::string random_buffer(int64_t size) {
+	std::string buffer(static_cast<size_t>(size), '\0');
+	uint32_t seed = 0x2545F491;
+
+	for (char& c : buffer) {
+		seed = seed * 1664525 + 1013904223;
+		c = static_cast<char>(seed >> 24);
+	}
+
+	return buffer;
+}
+
+// This method returns an AES key generated the same way the server does.
+static std::string random_aes_key() {
+	unsigned char key[AESWrapper::DEFAULT_KEYLENGTH];
+	AESWrapper::GenerateKey(key, AESWrapper::DEFAULT_KEYLENGTH);
+	return std::string(reinterpret_cast<char*>(key), sizeof(key));
+}
+
+static void memcrc_bench(BenchState& state) {
+	std::string buffer = random_buffer(state.range());
+
+	while (state.keepRunning()) {
+		do_not_optimize(memcrc(buffer.c_str(), buffer.size()));
+	}
+
+	state.setBytesProcessed(state.getIterations() * buffer.size());
+}
+
+static void aes_encrypt_bench(BenchState& state) {
+	std::string buffer = random_buffer(state.range());
+	std::string key = random_aes_key();
+	AESWrapper aes(reinterpret_cast<const unsigned char*>(key.c_str()), static_cast<unsigned int>(key.size()));
+
+	while (state.keepRunning()) {
+		std::string cipher = aes.encrypt(buffer.c_str(), static_cast<unsigned int>(buffer.size()));
+		do_not_optimize(cipher);
+	}
+
+	state.setBytesProcessed(state.getIterations() * buffer.size());
+}
+
+static void aes_decrypt_bench(BenchState& state) {
+	std::string key = random_aes_key();
+	AESWrapper aes(reinterpret_cast<const unsigned char*>(key.c_str()), static_cast<unsigned int>(key.size()));
+	std::string buffer = random_buffer(state.range());
+	std::string cipher = aes.encrypt(buffer.c_str(), static_cast<unsigned int>(buffer.size()));
+
+	while (state.keepRunning()) {
+		std::string plain = aes.decrypt(cipher.c_str(), static_cast<unsigned int>(cipher.size()));
+		do_not_optimize(plain);
+	}
+
+	state.setBytesProcessed(state.getIterations() * cipher.size());
+}
+
+static void base64_encode_bench(BenchState& state) {
+	std::string buffer = random_buffer(state.range());
+
+	while (state.keepRunning()) {
+		std::string encoded = Base64Wrapper::encode(buffer);
+		do_not_optimize(encoded);
+	}
+
+	state.setBytesProcessed(state.getIterations() * buffer.size());
+}
+
+static void base64_decode_bench(BenchState& state) {
+	std::string encoded = Base64Wrapper::encode(random_buffer(state.range()));
+
+	while (state.keepRunning()) {
+		std::string decoded = Base64Wrapper::decode(encoded);
+		do_not_optimize(decoded);
+	}
+
+	state.setBytesProcessed(state.getIterations() * encoded.size());
+}
+
+static void rsa_keygen_bench(BenchState& state) {
+	while (state.keepRunning()) {
+		RSAPrivateWrapper rsa;
+		do_not_optimize(rsa);
+	}
+}
+
+// Decrypting the AES key the server sends back in response 1602/1605.
+static void rsa_decrypt_bench(BenchState& state) {
+	RSAPrivateWrapper rsa;
+	RSAPublicWrapper rsa_public(rsa.getPublicKey());
+	std::string cipher = rsa_public.encrypt(random_aes_key());
+
+	while (state.keepRunning()) {
+		std::string plain = rsa.decrypt(cipher);
+		do_not_optimize(plain);
+	}
+}
+
+static void x25519_derive_bench(BenchState& state) {
+	X25519Wrapper ecdh;
+	X25519Wrapper server_ecdh;
+	std::string salt(sizeof(UUID), '\0');
+
+	while (state.keepRunning()) {
+		std::string key = ecdh.deriveAesKey(server_ecdh.getPublicKey(), salt);
+		do_not_optimize(key);
+	}
+}
+
+// Packing a single packet of request 828, the way SendingFile::run does for every packet.
+static void pack_sending_file_bench(BenchState& state) {
+	std::string encrypted_content = random_buffer(CONTENT_SIZE_PER_PACKET * 16);
+	uint64_t content_size = encrypted_content.size();
+	uint64_t total_packets = TOTAL_PACKETS(content_size);
+	ByteView content(encrypted_content);
+	ViewSource source(content);
+	SendingFile sending_file(NIL_UUID, Codes::SENDING_FILE_C, PayloadSize::SENDING_FILE_P, content_size, content_size, total_packets, "bench.bin", source);
+	size_t packet = 0;
+
+	while (state.keepRunning()) {
+		sending_file.setEncryptedContent(ByteView(content.data() + (packet++ % total_packets) * CONTENT_SIZE_PER_PACKET, CONTENT_SIZE_PER_PACKET));
+		std::vector<uint8_t> request = sending_file.pack_sending_file_request();
+		do_not_optimize(request);
+	}
+
+	state.setBytesProcessed(state.getIterations() * (REQUEST_HEADER_SIZE + PayloadSize::SENDING_FILE_P));
+}
+
+// This method creates the file read by the fileToCharArray benchmarks, returns its name (relative to the executable's directory).
+static std::string create_bench_file(int64_t size) {
+	std::string file_name = "bench_" + std::to_string(size) + ".bin";
+	std::ofstream out(EXE_DIR_FILE_PATH(file_name), std::ios::binary);
+	std::string buffer = random_buffer(size);
+	out.write(buffer.c_str(), buffer.size());
+
+	return file_name;
+}
+
+/*
+	This method asks the operating system to drop the file's pages from its cache, so the next read goes to the disk.
+	It is best effort - on Linux dirty pages are written back first, and on Windows opening the file unbuffered discards its cached pages.
+*/
+static void evict_from_cache(std::string file_name) {
+	std::string file_path = EXE_DIR_FILE_PATH(file_name);
+#ifdef _WIN32
+	HANDLE file = CreateFileA(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, NULL);
+	if (file != INVALID_HANDLE_VALUE) {
+		CloseHandle(file);
+	}
+#else
+	int fd = open(file_path.c_str(), O_RDONLY);
+	if (fd >= 0) {
+		fdatasync(fd);
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		close(fd);
+	}
+#endif
+}
+
+static void read_file_warm_bench(BenchState& state) {
+	std::string file_name = create_bench_file(state.range());
+	fileToCharArray(file_name);
+
+	while (state.keepRunning()) {
+		std::string content = fileToCharArray(file_name);
+		do_not_optimize(content);
+	}
+
+	state.setBytesProcessed(state.getIterations() * state.range());
+	std::filesystem::remove(EXE_DIR_FILE_PATH(file_name));
+}
+
+static void read_file_cold_bench(BenchState& state) {
+	std::string file_name = create_bench_file(state.range());
+
+	while (state.keepRunning()) {
+		state.pauseTiming();
+		evict_from_cache(file_name);
+		state.resumeTiming();
+
+		std::string content = fileToCharArray(file_name);
+		do_not_optimize(content);
+	}
+
+	state.setBytesProcessed(state.getIterations() * state.range());
+	std::filesystem::remove(EXE_DIR_FILE_PATH(file_name));
+}
+
+// Pins the thread constructing it to a core while it lives, nothing is pinned if the process may not run on the core.
+class CorePin {
+#ifdef _WIN32
+	DWORD_PTR previous;
+#elif defined(__linux__)
+	cpu_set_t previous;
+#endif
+	bool pinned;
+
+	public:
+		CorePin(unsigned core) :
+			pinned(false)
+		{
+#ifdef _WIN32
+			if (core < sizeof(DWORD_PTR) * 8) {
+				previous = SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << core);
+				pinned = previous != 0;
+			}
+#elif defined(__linux__)
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(core, &set);
+			pinned = pthread_getaffinity_np(pthread_self(), sizeof(previous), &previous) == 0 &&
+				pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#endif
+		}
+		CorePin(const CorePin&) = delete;
+		CorePin& operator=(const CorePin&) = delete;
+
+		// The thread may run on any of its previous cores again.
+		~CorePin() {
+			if (!pinned) {
+				return;
+			}
+#ifdef _WIN32
+			SetThreadAffinityMask(GetCurrentThread(), previous);
+#elif defined(__linux__)
+			pthread_setaffinity_np(pthread_self(), sizeof(previous), &previous);
+#endif
+		}
+};
+
+/*
+	Handing chunk pointers from this thread to a consumer thread through a ring, the way the stages of a StagedFileEncryptor do.
+	The argument is the consumer's batch size. The ring holds STAGE_CHUNKS pointers, so the producer waits for the consumer
+	whenever it gets ahead - the time per iteration is the hand-off cost, back-pressure included.
+	The producer and the consumer are pinned to cores 0 and 1, so the scheduler can't move them onto one core. Only a run on a
+	host with at least two cores measures the hand-off itself - on a single core every hand-off includes a thread switch, and
+	the result says nothing about the per chunk hand-off cost the stages were built for.
+*/
+template <typename Ring>
+static void ring_handoff_bench(BenchState& state) {
+	Ring ring(STAGE_CHUNKS);
+	std::atomic<bool> done(false), never(false);
+	FileChunk chunk;
+	CorePin producer_pin(0);
+
+	std::thread consumer([&ring, &done, &state] {
+		CorePin consumer_pin(1);
+		std::vector<FileChunk*> batch(static_cast<size_t>(state.range()));
+		while (ring.popBatch(batch.data(), batch.size(), done)) {
+			do_not_optimize(batch[0]);
+		}
+	});
+
+	while (state.keepRunning()) {
+		ring.push(&chunk, never);
+	}
+
+	done = true;
+	consumer.join();
+}
+
+// Pushing a chunk pointer and popping it back on the same thread - the ring's own cost, without a thread switch or cache line transfer.
+template <typename Ring>
+static void ring_push_pop_bench(BenchState& state) {
+	Ring ring(STAGE_CHUNKS);
+	FileChunk chunk;
+	FileChunk* popped;
+
+	while (state.keepRunning()) {
+		ring.tryPush(&chunk);
+		ring.tryPopBatch(&popped, 1);
+		do_not_optimize(popped);
+	}
+}
+
+// Taking a chunk from the pool and giving it back, on the same thread.
+static void chunk_pool_bench(BenchState& state) {
+	ChunkPool pool(STAGE_CHUNKS, CONTENT_SIZE_PER_PACKET);
+	std::atomic<bool> never(false);
+
+	while (state.keepRunning()) {
+		FileChunk* chunk = pool.acquire(never);
+		do_not_optimize(chunk);
+		pool.release(chunk);
+	}
+}
+
+int main(int argc, char* argv[]) {
+	std::filesystem::create_directories(EXE_DIR);
+
+	// 'FinalProjectBench loopback [flags]' runs the end to end benchmark instead of the microbenchmarks.
+	if (argc > 1 && std::string(argv[1]) == "loopback") {
+		return run_loopback_benchmark(argc - 1, argv + 1);
+	}
+
+	register_benchmark("memcrc", memcrc_bench, BUFFER_SIZES);
+	register_benchmark("aes_encrypt", aes_encrypt_bench, BUFFER_SIZES);
+	register_benchmark("aes_decrypt", aes_decrypt_bench, BUFFER_SIZES);
+	register_benchmark("base64_encode", base64_encode_bench, { 16, KEY_LENGTH, 1024, 64 * 1024 });
+	register_benchmark("base64_decode", base64_decode_bench, { 16, KEY_LENGTH, 1024, 64 * 1024 });
+	register_benchmark("rsa_keygen", rsa_keygen_bench);
+	register_benchmark("rsa_decrypt", rsa_decrypt_bench);
+	register_benchmark("x25519_derive", x25519_derive_bench);
+	register_benchmark("pack_sending_file_request", pack_sending_file_bench);
+	register_benchmark("file_to_char_array_warm", read_file_warm_bench, FILE_SIZES);
+	register_benchmark("file_to_char_array_cold", read_file_cold_bench, FILE_SIZES);
+	if (std::thread::hardware_concurrency() < 2) {
+		std::cerr << "Warning: a single core, the ring hand-off benchmarks measure thread switches rather than the hand-off." << std::endl;
+	}
+	register_benchmark("spsc_ring_handoff", ring_handoff_bench<SpscRing<FileChunk*>>, { 1, STAGE_BATCH });
+	register_benchmark("mpmc_ring_handoff", ring_handoff_bench<MpmcRing<FileChunk*>>, { 1, STAGE_BATCH });
+	register_benchmark("spsc_ring_push_pop", ring_push_pop_bench<SpscRing<FileChunk*>>);
+	register_benchmark("mpmc_ring_push_pop", ring_push_pop_bench<MpmcRing<FileChunk*>>);
+	register_benchmark("chunk_pool_round_trip", chunk_pool_bench);
+
+	return run_benchmarks(argc, argv);
+}
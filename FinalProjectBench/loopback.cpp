@@ -0,0 +1,350 @@
+#include "loopback.hpp"
+#include "standin_server.hpp"
+#include "session.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+	// Durations of a single upload's phases, in seconds.
+	struct UploadTimes {
+		double session;
+		double upload;
+		double total;
+	};
+
+	struct ScenarioResult {
+		int64_t file_size;
+		int concurrency;
+		size_t uploads;
+		size_t failures;
+		double wall_time;
+		double cpu_time;
+		std::vector<UploadTimes> times;
+	};
+
+	// This method returns the CPU time used by the process so far (all threads, user and kernel), in seconds.
+	double process_cpu_time() {
+#ifdef _WIN32
+		FILETIME creation, exit, kernel, user;
+		GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+		auto seconds = [](FILETIME time) {
+			return ((static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) / 1e7;
+		};
+		return seconds(kernel) + seconds(user);
+#else
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+#endif
+	}
+
+	// This method returns the peak resident set size of the process so far, in bytes.
+	size_t peak_rss() {
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+		return counters.PeakWorkingSetSize;
+#else
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+		return usage.ru_maxrss;
+#else
+		return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+	}
+
+	// This method returns the value at the given percentile (nearest rank) of the given values.
+	double percentile(std::vector<double> values, double p) {
+		if (values.empty()) {
+			return 0;
+		}
+
+		std::sort(values.begin(), values.end());
+		size_t rank = static_cast<size_t>(std::ceil(p / 100 * values.size()));
+		return values[std::max<size_t>(rank, 1) - 1];
+	}
+
+	// This method parses a comma separated list of positive numbers.
+	std::vector<int64_t> parse_list(std::string list) {
+		std::vector<int64_t> values;
+		std::stringstream stream(list);
+		std::string value;
+
+		while (std::getline(stream, value, ',')) {
+			if (!is_integer(value) || std::stoll(value) <= 0) {
+				throw std::invalid_argument(list);
+			}
+			values.push_back(std::stoll(value));
+		}
+
+		return values;
+	}
+
+	// This method creates the uploaded file, returns its name (relative to the executable's directory).
+	std::string create_upload_file(int64_t size) {
+		std::string file_name = "loopback_" + std::to_string(size) + ".bin";
+		std::ofstream out(EXE_DIR_FILE_PATH(file_name), std::ios::binary);
+		std::string buffer(static_cast<size_t>(size), '\0');
+		uint32_t seed = 0x2545F491;
+
+		for (char& c : buffer) {
+			seed = seed * 1664525 + 1013904223;
+			c = static_cast<char>(seed >> 24);
+		}
+		out.write(buffer.c_str(), buffer.size());
+
+		return file_name;
+	}
+
+	/*
+		This method runs a single client, uploading the file the given number of times over a new connection each time - each
+		upload is a run of the client's session code, start_session followed by upload_file. The first upload registers the
+		client and sends its public key, the following ones resume the session with the ticket the previous upload's
+		confirmation brought, like separate runs of the client. The client's credentials and tickets are kept in memory.
+	*/
+	void run_uploader(int index, uint16_t port, std::string file_name, size_t uploads, std::vector<UploadTimes>& times, size_t& failures) {
+		typedef std::chrono::steady_clock clock;
+		std::string name = "loopback_client_" + std::to_string(index);
+		boost::asio::io_context io_context;
+
+		Client client;
+		client.setAddress(boost::asio::ip::address_v4::loopback().to_string());
+		client.setPort(std::to_string(port));
+		client.setName(name);
+		client.setCredentials(std::make_shared<MemoryCredentialStore>());
+		KeyPool key_pool(KEY_POOL_SIZE, PREFER_ECDH);
+		tcp::resolver::results_type endpoints = tcp::resolver(io_context).resolve(client.getAddress(), client.getPort());
+
+		for (size_t upload = 0; upload < uploads; upload++) {
+			// Every upload sends the file - the previous upload's confirmation is forgotten, as if the file changed since.
+			fingerprint_index().update(fingerprint_key(file_name), FileFingerprint());
+
+			clock::time_point start = clock::now();
+			tcp::socket sock(io_context);
+			std::string aes_key, ticket;
+
+			try {
+				connect_tuned(sock, endpoints);
+
+				// Session - the handshake, or nothing but taking the saved ticket (it's sent along with the file).
+				if (start_session(sock, client, key_pool, aes_key, ticket) == FAILURE) {
+					throw std::runtime_error("Starting the session failed.");
+				}
+				clock::time_point session_done = clock::now();
+
+				// Upload - reading, encrypting and sending the file, and confirming its CRC.
+				if (upload_file(sock, client, key_pool, aes_key, ticket, file_name) != SUCCESS) {
+					throw std::runtime_error("Uploading the file failed.");
+				}
+				clock::time_point upload_done = clock::now();
+
+				times.push_back({
+					std::chrono::duration<double>(session_done - start).count(),
+					std::chrono::duration<double>(upload_done - session_done).count(),
+					std::chrono::duration<double>(upload_done - start).count()
+				});
+			}
+			catch (std::exception& e) {
+				LOG_ERROR(name << ": " << e.what());
+				failures++;
+			}
+		}
+	}
+
+	// This method runs every client of a single scenario at the same time, and gathers their upload times.
+	ScenarioResult run_scenario(StandInServer& server, int64_t file_size, int concurrency, size_t uploads) {
+		static int next_client = 0;
+		std::string file_name = create_upload_file(file_size);
+		std::vector<std::vector<UploadTimes>> times(concurrency);
+		std::vector<size_t> failures(concurrency, 0);
+		std::vector<std::thread> uploaders;
+
+		double cpu_start = process_cpu_time();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < concurrency; i++) {
+			uploaders.emplace_back(run_uploader, next_client++, server.getPort(), file_name, uploads, std::ref(times[i]), std::ref(failures[i]));
+		}
+		for (std::thread& uploader : uploaders) {
+			uploader.join();
+		}
+
+		ScenarioResult result;
+		result.file_size = file_size;
+		result.concurrency = concurrency;
+		result.wall_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		result.cpu_time = process_cpu_time() - cpu_start;
+		result.uploads = 0;
+		result.failures = 0;
+		for (int i = 0; i < concurrency; i++) {
+			result.times.insert(result.times.end(), times[i].begin(), times[i].end());
+			result.failures += failures[i];
+		}
+		result.uploads = result.times.size();
+
+		std::filesystem::remove(EXE_DIR_FILE_PATH(file_name));
+		return result;
+	}
+
+	// This method returns the given phase's durations of all uploads, in milliseconds.
+	std::vector<double> phase_times(const ScenarioResult& result, double UploadTimes::* phase) {
+		std::vector<double> values;
+		for (const UploadTimes& times : result.times) {
+			values.push_back(times.*phase * 1000);
+		}
+		return values;
+	}
+
+	const std::vector<std::pair<std::string, double UploadTimes::*>> PHASES = {
+		{ "session", &UploadTimes::session },
+		{ "upload", &UploadTimes::upload },
+		{ "total", &UploadTimes::total }
+	};
+
+	// Throughput of the uploaded file contents, in MB (10^6 bytes) per second.
+	double throughput(const ScenarioResult& result) {
+		return (result.wall_time > 0) ? result.uploads * result.file_size / result.wall_time / 1e6 : 0;
+	}
+
+	// CPU time of the whole process (clients and stand-in server) per GB (10^9 bytes) uploaded, in seconds.
+	double cpu_per_gb(const ScenarioResult& result) {
+		return result.uploads ? result.cpu_time / (result.uploads * result.file_size / 1e9) : 0;
+	}
+
+	void print_scenario(const ScenarioResult& result) {
+		std::cout << std::fixed << std::setprecision(2);
+		std::cout << "file_size=" << result.file_size << " concurrency=" << result.concurrency
+			<< " uploads=" << result.uploads << " failures=" << result.failures << std::endl;
+		std::cout << "  throughput " << throughput(result) << " MB/s, cpu " << cpu_per_gb(result) << " s/GB" << std::endl;
+
+		for (const auto& phase : PHASES) {
+			std::vector<double> values = phase_times(result, phase.second);
+			std::cout << "  " << std::left << std::setw(10) << phase.first << std::right
+				<< " p50 " << std::setw(10) << percentile(values, 50) << " ms"
+				<< "   p99 " << std::setw(10) << percentile(values, 99) << " ms" << std::endl;
+		}
+		std::cout << std::defaultfloat;
+	}
+
+	void write_json(std::ostream& out, const std::vector<ScenarioResult>& results, size_t rss) {
+		out << std::fixed << std::setprecision(3);
+		out << "{\n";
+		out << "  \"peak_rss_bytes\": " << rss << ",\n";
+		out << "  \"scenarios\": [";
+
+		for (size_t i = 0; i < results.size(); i++) {
+			const ScenarioResult& result = results[i];
+			out << (i ? ",\n" : "\n") << "    {\n";
+			out << "      \"file_size\": " << result.file_size << ",\n";
+			out << "      \"concurrency\": " << result.concurrency << ",\n";
+			out << "      \"uploads\": " << result.uploads << ",\n";
+			out << "      \"failures\": " << result.failures << ",\n";
+			out << "      \"wall_time_s\": " << result.wall_time << ",\n";
+			out << "      \"mb_per_second\": " << throughput(result) << ",\n";
+			out << "      \"cpu_s_per_gb\": " << cpu_per_gb(result) << ",\n";
+			out << "      \"latency_ms\": {";
+
+			for (size_t j = 0; j < PHASES.size(); j++) {
+				std::vector<double> values = phase_times(result, PHASES[j].second);
+				out << (j ? ", " : " ") << "\"" << PHASES[j].first << "\": { \"p50\": " << percentile(values, 50) << ", \"p99\": " << percentile(values, 99) << " }";
+			}
+			out << " }\n";
+			out << "    }";
+		}
+
+		out << "\n  ]\n}\n";
+	}
+}
+
+int run_loopback_benchmark(int argc, char* argv[]) {
+	std::vector<int64_t> file_sizes = { 1024 * 1024 }, concurrencies = { 1 };
+	size_t uploads = 20;
+	std::string json_file, trace_file;
+	SocketTuning tuning = socket_tuning();
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		try {
+			if (arg.rfind("--file_size=", 0) == 0) {
+				file_sizes = parse_list(arg.substr(strlen("--file_size=")));
+			}
+			else if (arg.rfind("--concurrency=", 0) == 0) {
+				concurrencies = parse_list(arg.substr(strlen("--concurrency=")));
+			}
+			else if (arg.rfind("--uploads=", 0) == 0) {
+				uploads = static_cast<size_t>(parse_list(arg.substr(strlen("--uploads="))).at(0));
+			}
+			else if (arg.rfind("--json=", 0) == 0) {
+				json_file = arg.substr(strlen("--json="));
+			}
+			else if (arg.rfind("--trace=", 0) == 0) {
+				trace_file = arg.substr(strlen("--trace="));
+				enable_tracing();
+			}
+			else if (arg.rfind("--socket=", 0) == 0) {
+				if (!parse_socket_option(arg.substr(strlen("--socket=")), tuning)) {
+					throw std::invalid_argument(arg);
+				}
+			}
+			else {
+				throw std::invalid_argument(arg);
+			}
+		}
+		catch (std::exception&) {
+			std::cerr << "Error: unknown or invalid flag " << arg << "." << std::endl;
+			std::cerr << "Usage: " << argv[0] << " loopback [--file_size=<bytes>[,...]] [--concurrency=<n>[,...]] [--uploads=<n>] [--json=<file>] [--trace=<file>] [--socket=<key=value>]..." << std::endl;
+			return 1;
+		}
+	}
+
+	set_socket_tuning(tuning);
+	// The requests log every request they run at debug level, keep the report readable.
+	set_log_level(LOG_LEVEL_WARNING);
+
+	StandInServer server;
+	std::vector<ScenarioResult> results;
+
+	for (int64_t file_size : file_sizes) {
+		for (int64_t concurrency : concurrencies) {
+			ScenarioResult result = run_scenario(server, file_size, static_cast<int>(concurrency), uploads);
+
+			print_scenario(result);
+			results.push_back(result);
+		}
+	}
+
+	// The peak is of the whole run, clients and stand-in server together.
+	size_t rss = peak_rss();
+	std::cout << "peak rss " << std::fixed << std::setprecision(2) << rss / (1024.0 * 1024.0) << " MiB" << std::defaultfloat << std::endl;
+
+	if (!json_file.empty()) {
+		std::ofstream out(json_file);
+		if (!out.is_open()) {
+			std::cerr << "Error: cannot open " << json_file << " for writing." << std::endl;
+			return 1;
+		}
+		write_json(out, results, rss);
+	}
+
+	if (!trace_file.empty()) {
+		if (!write_chrome_trace(trace_file)) {
+			std::cerr << "Error: cannot write the trace into " << trace_file << "." << std::endl;
+			return 1;
+		}
+		print_trace_histograms(std::cout);
+	}
+
+	return 0;
+}
@@ -0,0 +1,21 @@
+#ifndef LOOPBACK_H
+#define LOOPBACK_H
+
+#include "bench.hpp"
+
+/*
+	This method runs the end to end loopback benchmark - concurrent clients uploading files to an in-process StandInServer,
+	each upload running the client's session code (start_session and upload_file) over a new connection, like a run of the
+	client - the first upload of a client performs the handshake, the next ones resume the session with a ticket.
+	Flags (sizes and concurrencies may be comma separated lists, every combination is run):
+		--file_size=<bytes>	Size of the uploaded file, 1048576 by default.
+		--concurrency=<n>	Number of clients uploading at the same time, 1 by default.
+		--uploads=<n>		Number of uploads each client performs, 20 by default.
+		--json=<file>		Also write the results as JSON into the given file.
+		--trace=<file>		Trace the clients' requests into the given file (Chrome trace format), and print their histograms.
+		--socket=<key=value>	Tune the clients' connections with a transfer.info socket option (see sockopt.hpp), may be repeated.
+	Returns the process's exit code.
+*/
+int run_loopback_benchmark(int argc, char* argv[]);
+
+#endif
@@ -0,0 +1,348 @@
+#include "standin_server.hpp"
+
+namespace {
+	// Size of the fixed part of request 828's payload, before the encrypted content.
+	constexpr size_t SENDING_FILE_FIELDS_SIZE = 4 * sizeof(uint64_t) + NAME_SIZE;
+	// Seconds a session ticket is valid for, as sent to the client - the stand-in doesn't expire tickets.
+	constexpr uint32_t STANDIN_TICKET_LIFETIME = 3600;
+
+	// This method reads a little endian number of type T from the given buffer.
+	template <typename T>
+	T read_little(const uint8_t* buffer) {
+		T value;
+		memcpy(&value, buffer, sizeof(value));
+		return boost::endian::little_to_native(value);
+	}
+
+	// This method appends a little endian number of type T to the given buffer.
+	template <typename T>
+	void append_little(std::vector<uint8_t>& buffer, T value) {
+		T value_le = boost::endian::native_to_little(value);
+		const uint8_t* value_le_ptr = reinterpret_cast<const uint8_t*>(&value_le);
+		buffer.insert(buffer.end(), value_le_ptr, value_le_ptr + sizeof(value_le));
+	}
+
+	// This method returns the null terminated string at the start of the given field.
+	std::string read_name(const uint8_t* field) {
+		const char* name = reinterpret_cast<const char*>(field);
+		return std::string(name, strnlen(name, NAME_SIZE));
+	}
+
+	// This method sends a response - the server's version, the code and the payload size, followed by the payload.
+	void send_response(tcp::socket& sock, uint16_t code, const std::vector<uint8_t>& payload) {
+		std::vector<uint8_t> response;
+		response.push_back(VERSION);
+		append_little<uint16_t>(response, code);
+		append_little<uint32_t>(response, static_cast<uint32_t>(payload.size()));
+		response.insert(response.end(), payload.begin(), payload.end());
+
+		boost::asio::write(sock, boost::asio::buffer(response));
+	}
+}
+
+StandInServer::StandInServer() :
+	acceptor(io_context, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)),
+	stopping(false),
+	active_connections(0)
+{
+	acceptor_thread = std::thread(&StandInServer::accept_connections, this);
+}
+
+StandInServer::~StandInServer() {
+	// Wake the acceptor thread up with a last connection, it will see the server is stopping.
+	stopping = true;
+	try {
+		tcp::socket sock(io_context);
+		sock.connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(), getPort()));
+	}
+	catch (std::exception& e) {
+		std::cerr << e.what() << std::endl;
+	}
+	acceptor_thread.join();
+
+	// Connection threads are detached (a long benchmark opens thousands), wait for the remaining ones to end.
+	std::unique_lock<std::mutex> lock(connections_lock);
+	connections_done.wait(lock, [this] { return active_connections == 0; });
+}
+
+uint16_t StandInServer::getPort() const {
+	return acceptor.local_endpoint().port();
+}
+
+void StandInServer::accept_connections() {
+	while (!stopping) {
+		try {
+			tcp::socket sock(io_context);
+			acceptor.accept(sock);
+
+			if (stopping) {
+				break;
+			}
+
+			std::lock_guard<std::mutex> lock(connections_lock);
+			active_connections++;
+			std::thread(&StandInServer::serve, this, std::move(sock)).detach();
+		}
+		catch (std::exception& e) {
+			std::cerr << e.what() << std::endl;
+		}
+	}
+}
+
+bool StandInServer::register_client(std::string name, UUID& uuid) {
+	std::lock_guard<std::mutex> lock(clients_lock);
+
+	for (const auto& client : clients) {
+		if (client.second.name == name) {
+			return false;
+		}
+	}
+
+	uuid = boost::uuids::random_generator()();
+	clients[uuid] = { name, "", "" };
+	return true;
+}
+
+std::string StandInServer::new_encrypted_aes_key(UUID uuid, std::string public_key) {
+	std::lock_guard<std::mutex> lock(clients_lock);
+
+	auto client = clients.find(uuid);
+	if (client == clients.end() || (public_key.empty() && client->second.public_key.empty())) {
+		return "";
+	}
+	if (!public_key.empty()) {
+		client->second.public_key = public_key;
+	}
+
+	unsigned char key[AESWrapper::DEFAULT_KEYLENGTH];
+	AESWrapper::GenerateKey(key, AESWrapper::DEFAULT_KEYLENGTH);
+	client->second.aes_key = std::string(reinterpret_cast<char*>(key), sizeof(key));
+
+	RSAPublicWrapper rsa(client->second.public_key);
+	return rsa.encrypt(client->second.aes_key);
+}
+
+std::string StandInServer::new_ecdh_aes_key(UUID uuid, std::string public_key) {
+	std::lock_guard<std::mutex> lock(clients_lock);
+
+	auto client = clients.find(uuid);
+	if (client == clients.end() || (public_key.empty() && client->second.ecdh_public_key.empty())) {
+		return "";
+	}
+	if (!public_key.empty()) {
+		client->second.ecdh_public_key = public_key;
+	}
+
+	// The key is derived like the client derives it, with the client id as the salt.
+	X25519Wrapper ecdh;
+	client->second.aes_key = ecdh.deriveAesKey(client->second.ecdh_public_key, std::string(uuid.begin(), uuid.end()));
+	return ecdh.getPublicKey();
+}
+
+std::string StandInServer::aes_key(UUID uuid) {
+	std::lock_guard<std::mutex> lock(clients_lock);
+
+	auto client = clients.find(uuid);
+	return (client == clients.end()) ? "" : client->second.aes_key;
+}
+
+std::string StandInServer::issue_ticket(UUID uuid, std::string& encrypted_resumption_key) {
+	unsigned char resumption_key[AESWrapper::DEFAULT_KEYLENGTH];
+	unsigned char ticket[TICKET_LENGTH];
+	AESWrapper::GenerateKey(resumption_key, sizeof(resumption_key));
+	AESWrapper::GenerateKey(ticket, sizeof(ticket));
+
+	std::string key = aes_key(uuid);
+	AESWrapper aes(reinterpret_cast<const unsigned char*>(key.c_str()), static_cast<unsigned int>(key.size()));
+	encrypted_resumption_key = aes.encrypt(reinterpret_cast<const char*>(resumption_key), sizeof(resumption_key));
+
+	std::lock_guard<std::mutex> lock(clients_lock);
+	std::string ticket_str(reinterpret_cast<char*>(ticket), sizeof(ticket));
+	tickets[ticket_str] = { uuid, std::string(reinterpret_cast<char*>(resumption_key), sizeof(resumption_key)) };
+	return ticket_str;
+}
+
+bool StandInServer::redeem_ticket(UUID uuid, const std::string& ticket) {
+	std::lock_guard<std::mutex> lock(clients_lock);
+
+	auto entry = tickets.find(ticket);
+	auto client = clients.find(uuid);
+	if (entry == tickets.end() || entry->second.uuid != uuid || client == clients.end()) {
+		return false;
+	}
+
+	client->second.aes_key = entry->second.resumption_key;
+	tickets.erase(entry);
+	return true;
+}
+
+/*
+	This method serves a single connection, mirroring the Python server's handling of every request code.
+	The file being received is kept per connection - its packets are appended until the last one arrives, and then it is decrypted
+	and its CRC is sent back. The packets sent along with a rejected Ticket Reconnection are dropped, and the ticket is rejected
+	after the last one.
+*/
+void StandInServer::serve(tcp::socket sock) {
+	std::string encrypted_file;
+	bool discarding_packets = false;
+
+	try {
+		while (true) {
+			std::vector<uint8_t> header(REQUEST_HEADER_SIZE);
+			boost::asio::read(sock, boost::asio::buffer(header));
+
+			UUID uuid;
+			std::copy(header.begin(), header.begin() + sizeof(uuid), uuid.begin());
+			uint16_t code = read_little<uint16_t>(header.data() + sizeof(uuid) + sizeof(uint8_t));
+			uint32_t payload_size = read_little<uint32_t>(header.data() + sizeof(uuid) + sizeof(uint8_t) + sizeof(uint16_t));
+
+			std::vector<uint8_t> payload(payload_size);
+			boost::asio::read(sock, boost::asio::buffer(payload));
+
+			std::vector<uint8_t> response(uuid.begin(), uuid.end());
+			bool file_packet = code == Codes::SENDING_FILE_C || code == Codes::SENDING_BUNDLE_C;
+			if (discarding_packets && file_packet) {
+				if (payload_size == PayloadSize::SENDING_FILE_P && read_little<uint64_t>(payload.data() + 2 * sizeof(uint64_t)) == read_little<uint64_t>(payload.data() + 3 * sizeof(uint64_t))) {
+					discarding_packets = false;
+					send_response(sock, Codes::TICKET_REJECTED_C, {});
+				}
+				continue;
+			}
+
+			switch (code) {
+				case Codes::REGISTRATION_C: {
+					if (payload_size != PayloadSize::REGISTRATION_P || !register_client(read_name(payload.data()), uuid)) {
+						send_response(sock, Codes::REGISTRATION_FAILED_C, {});
+						break;
+					}
+					send_response(sock, Codes::REGISTRATION_SUCCEEDED_C, std::vector<uint8_t>(uuid.begin(), uuid.end()));
+					break;
+				}
+				case Codes::SENDING_PUBLIC_KEY_C: {
+					std::string public_key(payload.begin() + NAME_SIZE, payload.end());
+					std::string encrypted_aes_key = (payload_size == PayloadSize::SENDING_PUBLIC_KEY_P) ? new_encrypted_aes_key(uuid, public_key) : "";
+					if (encrypted_aes_key.empty()) {
+						send_response(sock, Codes::GENERAL_ERROR_C, {});
+						break;
+					}
+					response.insert(response.end(), encrypted_aes_key.begin(), encrypted_aes_key.end());
+					send_response(sock, Codes::PUBLIC_KEY_RECEIVED_C, response);
+					break;
+				}
+				case Codes::RECONNECTION_C: {
+					std::string encrypted_aes_key = new_encrypted_aes_key(uuid);
+					if (encrypted_aes_key.empty()) {
+						// Unknown client, register it instead - it then sends its public key.
+						if (!register_client(read_name(payload.data()), uuid)) {
+							send_response(sock, Codes::GENERAL_ERROR_C, {});
+							break;
+						}
+						send_response(sock, Codes::RECONNECTION_FAILED_C, std::vector<uint8_t>(uuid.begin(), uuid.end()));
+						break;
+					}
+					response.insert(response.end(), encrypted_aes_key.begin(), encrypted_aes_key.end());
+					send_response(sock, Codes::RECONNECTION_SUCCEEDED_C, response);
+					break;
+				}
+				case Codes::SENDING_ECDH_KEY_C: {
+					std::string public_key(payload.begin() + NAME_SIZE, payload.end());
+					std::string server_public_key = (payload_size == PayloadSize::SENDING_ECDH_KEY_P) ? new_ecdh_aes_key(uuid, public_key) : "";
+					if (server_public_key.empty()) {
+						send_response(sock, Codes::GENERAL_ERROR_C, {});
+						break;
+					}
+					response.insert(response.end(), server_public_key.begin(), server_public_key.end());
+					send_response(sock, Codes::ECDH_KEY_RECEIVED_C, response);
+					break;
+				}
+				case Codes::ECDH_RECONNECTION_C: {
+					std::string server_public_key = new_ecdh_aes_key(uuid);
+					if (server_public_key.empty()) {
+						// Unknown client (or one without an X25519 key), register it instead - it then sends its public key.
+						if (!register_client(read_name(payload.data()), uuid)) {
+							send_response(sock, Codes::GENERAL_ERROR_C, {});
+							break;
+						}
+						send_response(sock, Codes::RECONNECTION_FAILED_C, std::vector<uint8_t>(uuid.begin(), uuid.end()));
+						break;
+					}
+					response.insert(response.end(), server_public_key.begin(), server_public_key.end());
+					send_response(sock, Codes::ECDH_RECONNECTION_SUCCEEDED_C, response);
+					break;
+				}
+				case Codes::TICKET_RECONNECTION_C:
+				case Codes::CHECKED_TICKET_RECONNECTION_C: {
+					bool accepted = payload_size == PayloadSize::TICKET_RECONNECTION_P && redeem_ticket(uuid, std::string(payload.begin() + NAME_SIZE, payload.end()));
+					encrypted_file.clear();
+					if (code == Codes::CHECKED_TICKET_RECONNECTION_C) {
+						send_response(sock, accepted ? Codes::TICKET_ACCEPTED_C : Codes::TICKET_REJECTED_C, {});
+					}
+					// A valid ticket gets no response, the file packets follow it.
+					else if (!accepted) {
+						discarding_packets = true;
+					}
+					break;
+				}
+				case Codes::SENDING_FILE_C:
+				case Codes::SENDING_BUNDLE_C: {
+					if (payload_size != PayloadSize::SENDING_FILE_P) {
+						send_response(sock, Codes::GENERAL_ERROR_C, {});
+						break;
+					}
+					uint64_t content_size = read_little<uint64_t>(payload.data());
+					uint64_t orig_file_size = read_little<uint64_t>(payload.data() + sizeof(uint64_t));
+					uint64_t packet_number = read_little<uint64_t>(payload.data() + 2 * sizeof(uint64_t));
+					uint64_t total_packets = read_little<uint64_t>(payload.data() + 3 * sizeof(uint64_t));
+
+					// The first packet starts a new file, the content of the last packet is padded up to the packet size.
+					if (packet_number == 1) {
+						encrypted_file.clear();
+					}
+					// A streamed file's packets are all full, but its last one - the only one that carries the sizes and the total packets.
+					size_t amount = total_packets ? static_cast<size_t>(std::min<uint64_t>(CONTENT_SIZE_PER_PACKET, content_size - encrypted_file.size())) : CONTENT_SIZE_PER_PACKET;
+					encrypted_file.append(payload.begin() + SENDING_FILE_FIELDS_SIZE, payload.begin() + SENDING_FILE_FIELDS_SIZE + amount);
+
+					if (packet_number != total_packets) {
+						break;
+					}
+
+					std::string key = aes_key(uuid);
+					AESWrapper aes(reinterpret_cast<const unsigned char*>(key.c_str()), static_cast<unsigned int>(key.size()));
+					std::string content = aes.decrypt(encrypted_file.c_str(), static_cast<unsigned int>(encrypted_file.size()));
+
+					append_little<uint64_t>(response, content_size);
+					response.insert(response.end(), payload.begin() + 4 * sizeof(uint64_t), payload.begin() + SENDING_FILE_FIELDS_SIZE);
+					append_little<uint32_t>(response, static_cast<uint32_t>(memcrc(content.c_str(), static_cast<size_t>(std::min<uint64_t>(orig_file_size, content.size())))));
+					send_response(sock, Codes::FILE_RECEIVED_CRC_C, response);
+					break;
+				}
+				case Codes::VALID_CRC_C:
+				case Codes::INVALID_CRC_DONE_C:
+					send_response(sock, Codes::MESSAGE_RECEIVED_C, response);
+					break;
+				case Codes::VALID_CRC_TICKET_C: {
+					std::string encrypted_resumption_key;
+					std::string ticket = issue_ticket(uuid, encrypted_resumption_key);
+					append_little<uint32_t>(response, STANDIN_TICKET_LIFETIME);
+					response.insert(response.end(), encrypted_resumption_key.begin(), encrypted_resumption_key.end());
+					response.insert(response.end(), ticket.begin(), ticket.end());
+					send_response(sock, Codes::MESSAGE_RECEIVED_TICKET_C, response);
+					break;
+				}
+				case Codes::SENDING_CRC_AGAIN_C:
+					// The client sends the file again, there is nothing to respond with.
+					break;
+				default:
+					send_response(sock, Codes::GENERAL_ERROR_C, {});
+					break;
+			}
+		}
+	}
+	catch (std::exception&) {
+		// The client disconnected.
+	}
+
+	std::lock_guard<std::mutex> lock(connections_lock);
+	active_connections--;
+	connections_done.notify_all();
+}
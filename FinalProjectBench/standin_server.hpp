@@ -0,0 +1,72 @@
+#ifndef STANDIN_SERVER_H
+#define STANDIN_SERVER_H
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <map>
+#include <condition_variable>
+#include <boost/uuid/random_generator.hpp>
+#include "utils.hpp"
+
+/*
+	An in-process stand-in for the server, listening on 127.0.0.1, used for benchmarking the client end to end without the Python server.
+	It implements the protocol the client speaks - the RSA and ECDH handshakes, session tickets (issued with Valid CRC Ticket,
+	redeemed with Ticket Reconnection and Checked Ticket Reconnection), files and bundles (received and CRC'd, a bundle isn't
+	unpacked) and the CRC requests. Multiplexed connections aren't supported, a Multiplex request gets a general error.
+	Every connection is served by its own thread, and clients and tickets are kept in memory only.
+*/
+class StandInServer {
+	struct ClientEntry {
+		std::string name;
+		std::string public_key;
+		std::string ecdh_public_key;
+		std::string aes_key;
+	};
+
+	// A session ticket issued to a client, redeemed once.
+	struct TicketEntry {
+		UUID uuid;
+		std::string resumption_key;
+	};
+
+	boost::asio::io_context io_context;
+	tcp::acceptor acceptor;
+	std::atomic<bool> stopping;
+	std::thread acceptor_thread;
+	size_t active_connections;
+	std::mutex connections_lock;
+	std::condition_variable connections_done;
+	std::map<UUID, ClientEntry> clients;
+	std::map<std::string, TicketEntry> tickets;
+	std::mutex clients_lock;
+
+	// This method accepts connections until the server is stopped, starting a thread for each one.
+	void accept_connections();
+	// This method serves a single connection's requests until the client disconnects.
+	void serve(tcp::socket sock);
+
+	// This method registers a new client under a random UUID, returns false if the name is taken.
+	bool register_client(std::string name, UUID& uuid);
+	// This method generates a new AES key for the client, returns it encrypted using the client's RSA public key (or an empty string if the client is unknown).
+	std::string new_encrypted_aes_key(UUID uuid, std::string public_key = "");
+	/*
+		This method agrees on a new AES key with the client using a fresh X25519 key pair, saves the client's public key if one is
+		given (its saved key is used otherwise), and returns the server's public key - or an empty string if the client is unknown.
+	*/
+	std::string new_ecdh_aes_key(UUID uuid, std::string public_key = "");
+	// This method returns the client's current AES key.
+	std::string aes_key(UUID uuid);
+	// This method issues a session ticket with a new resumption key, returns the ticket and sets the resumption key encrypted using the client's current AES key.
+	std::string issue_ticket(UUID uuid, std::string& encrypted_resumption_key);
+	// This method redeems a session ticket issued to the client, setting the ticket's resumption key as its AES key - returns false if the ticket is unknown, was used or belongs to another client.
+	bool redeem_ticket(UUID uuid, const std::string& ticket);
+
+	public:
+		StandInServer();
+		~StandInServer();
+
+		uint16_t getPort() const;
+};
+
+#endif
@@ -2,9 +2,13 @@
 This module implements the cksum command found in most UNIXes in pure
 python.
 
-The constants and routine are cribbed from the POSIX man page
+The constants and routine are cribbed from the POSIX man page.
+The bulk of the data is run through zlib's C implementation of the
+reflected CRC-32 (the same polynomial), on bit-reversed bytes.
 """
 
+import binascii
+
 crctab = [0x00000000, 0x04c11db7, 0x09823b6e, 0x0d4326d9, 0x130476dc,
           0x17c56b6b, 0x1a864db2, 0x1e475005, 0x2608edb8, 0x22c9f00f,
           0x2f8ad6d6, 0x2b4bcb61, 0x350c9b64, 0x31cd86d3, 0x3c8ea00a,
@@ -62,13 +66,28 @@ crctab = [0x00000000, 0x04c11db7, 0x09823b6e, 0x0d4326d9, 0x130476dc,
 UNSIGNED = lambda n: n & 0xffffffff
 
 
-def memcrc(b):
-    n = len(b)
-    i = c = s = 0
-    for ch in b:
-        tabidx = (s >> 24) ^ ch
-        s = UNSIGNED((s << 8)) ^ crctab[tabidx]
+# Every byte value with its bits reversed, for bytes.translate.
+REVERSED_BYTES = bytes(int(f"{i:08b}"[::-1], 2) for i in range(256))
+
+
+def reverse_bits(n):
+    return int(f"{n:032b}"[::-1], 2)
+
+
+def crc_update(s, b):
+    """
+    Runs the data through the CRC. cksum's CRC shifts each byte in from the most significant bit, zlib's from the least -
+    on bit-reversed bytes, and with the register bit-reversed, they compute the same CRC.
+    :param s: The CRC's register before the data.
+    :param b: The data (any bytes-like object).
+    :return: The CRC's register after the data.
+    """
+    reversed_data = bytes(b).translate(REVERSED_BYTES)
+    # binascii.crc32 takes and returns its register complemented.
+    return reverse_bits(UNSIGNED(~binascii.crc32(reversed_data, UNSIGNED(~reverse_bits(s)))))
+
 
+def crc_final(s, n):
     while n:
         c = n & 0o377
         n = n >> 8
@@ -76,6 +95,26 @@ def memcrc(b):
     return UNSIGNED(~s)
 
 
+def memcrc(b):
+    return crc_final(crc_update(0, b), len(b))
+
+
+class Crc:
+    """
+    Computes the same CRC as memcrc, a piece of the data at a time.
+    """
+    def __init__(self):
+        self._state = 0
+        self._length = 0
+
+    def update(self, b):
+        self._state = crc_update(self._state, b)
+        self._length += len(b)
+
+    def final(self):
+        return crc_final(self._state, self._length)
+
+
 def readfile(fname):
     try:
         buffer = open(fname, 'rb').read()
@@ -1,3 +1,5 @@
+import os
+from typing import BinaryIO
 from Crypto.PublicKey.RSA import RsaKey
 
 
@@ -8,34 +10,57 @@ class Client:
     Attributes:
         _name (str): The client's name.
         _public_key (RsaKey | None): The client's public RSA key, used for encryption, or None if not set.
+        _ecdh_public_key (bytes | None): The client's raw X25519 public key, used for the ECDH handshake, or None if not set.
+        _server_ecdh_public_key (bytes | None): The server's X25519 public key of the last ECDH handshake, or None if not set.
         _aes_key (bytes | None): The AES key used for encryption or None if not set.
         _file_name (str | None): The name of the file associated with the client, or None if not set.
-        _tot_packets (int | None): The total number of file packets expected, or None if not set.
-        _packets (dict[int, bytes]): A dictionary mapping packet indices to their encrypted content.
+        _tot_packets (int | None): The total number of file packets expected, or None if not set (or not known yet, for a
+            streamed file).
+        _part_file (BinaryIO | None): The file the encrypted content of the file being received is appended to, or None if
+            no file is being received.
+        _part_path (str | None): The path of the last file started, or None if no file was started.
+        _bundle (bool): Whether the last file started is a bundle.
+        _received_packets (int): The number of file packets received so far.
+        _received_size (int): The number of encrypted content bytes received so far.
         _crc (str | None): The checksum (CRC) of the file for integrity verification, or None if not set.
         _content_size (int | None): The size of the content being handled, or None if not set.
+        _bundle_files (list[str]): The paths of the files unpacked from the last received bundle, empty if the last
+            received file was not a bundle.
     """
     def __init__(self, name: str):
         self._name: str = name
         self._public_key: RsaKey | None = None
+        self._ecdh_public_key: bytes | None = None
+        self._server_ecdh_public_key: bytes | None = None
         self._last_seen = None
         self._aes_key: bytes | None = None
         self._file_name: str | None = None
         self._tot_packets: int | None = None
-        self._packets: dict[int, bytes] = {}
+        self._part_file: BinaryIO | None = None
+        self._part_path: str | None = None
+        self._bundle: bool = False
+        self._received_packets: int = 0
+        self._received_size: int = 0
         self._crc: int | None = None
         self._content_size: int | None = None
+        self._bundle_files: list[str] = []
 
     def set_public_key(self, key: RsaKey) -> None:
         self._public_key = key
 
+    def set_ecdh_public_key(self, key: bytes) -> None:
+        self._ecdh_public_key = key
+
+    def set_server_ecdh_public_key(self, key: bytes) -> None:
+        self._server_ecdh_public_key = key
+
     def set_aes_key(self, key: bytes) -> None:
         self._aes_key = key
 
     def set_file_name(self, file_name: str) -> None:
         self._file_name = file_name
 
-    def set_tot_packets(self, tot_packets: int) -> None:
+    def set_tot_packets(self, tot_packets: int | None) -> None:
         self._tot_packets = tot_packets
 
     def set_crc(self, crc: int) -> None:
@@ -44,12 +69,24 @@ class Client:
     def set_content_size(self, content_size: int) -> None:
         self._content_size = content_size
 
+    def set_bundle_files(self, bundle_files: list[str]) -> None:
+        self._bundle_files = bundle_files
+
+    def set_bundle(self, bundle: bool) -> None:
+        self._bundle = bundle
+
     def get_name(self) -> str:
         return self._name
 
     def get_public_key(self) -> RsaKey:
         return self._public_key
 
+    def get_ecdh_public_key(self) -> bytes:
+        return self._ecdh_public_key
+
+    def get_server_ecdh_public_key(self) -> bytes:
+        return self._server_ecdh_public_key
+
     def get_aes_key(self) -> bytes:
         return self._aes_key
 
@@ -59,8 +96,8 @@ class Client:
     def get_tot_packets(self):
         return self._tot_packets
 
-    def get_packets(self) -> dict[int, bytes]:
-        return self._packets
+    def get_received_size(self) -> int:
+        return self._received_size
 
     def get_crc(self) -> int:
         return self._crc
@@ -68,13 +105,42 @@ class Client:
     def get_content_size(self) -> int:
         return self._content_size
 
-    # This method clears the packets dictionary in case the client sends from the beginning.
-    def clear_dict(self) -> None:
-        self._packets.clear()
-
-    # This method adds the data given using the provided packet number as a key.
-    def add_packet_data(self, packet_number: int, data: bytes) -> None:
-        self._packets[packet_number] = data
+    def get_bundle_files(self) -> list[str]:
+        return self._bundle_files
+
+    def is_bundle(self) -> bool:
+        return self._bundle
+
+    def get_part_path(self) -> str:
+        return self._part_path
+
+    # This method drops the packets received so far, in case the client sends from the beginning.
+    def clear_packets(self) -> None:
+        if self._part_file is not None:
+            self._part_file.close()
+            self._part_file = None
+        self._received_packets = 0
+        self._received_size = 0
+
+    # This method starts receiving a file, the packets' data is appended to the file at the given path. The file of the
+    # previous file is removed if that one was left unfinished.
+    def start_file(self, part_path: str) -> None:
+        self.clear_packets()
+        if self._part_path is not None and self._part_path != part_path and os.path.exists(self._part_path):
+            os.remove(self._part_path)
+        self._part_path = part_path
+        self._part_file = open(part_path, 'wb')
+
+    # This method appends the data of the next packet, packets of a file that was not started are dropped.
+    def add_packet_data(self, data: bytes) -> None:
+        if self._part_file is None:
+            return
+        self._part_file.write(data)
+        self._received_packets += 1
+        self._received_size += len(data)
+        if self.received_entire_file():
+            self._part_file.close()
+            self._part_file = None
 
     def received_entire_file(self) -> bool:
-        return len(self._packets) == self._tot_packets
+        return self._received_packets == self._tot_packets
@@ -0,0 +1,172 @@
+import socket
+import struct
+import threading
+from collections import deque
+from utils import recv_exactly, stream_window
+
+FRAME_HEADER_FORMAT = '<I B I'  # The stream id, the frame's type, and the data's length (or the credit granted).
+FRAME_HEADER_SIZE = struct.calcsize(FRAME_HEADER_FORMAT)
+FRAME_DATA = 0
+FRAME_CREDIT = 1  # Sent by the server only, the length is the amount of bytes the client may send on the stream.
+FRAME_CLOSE = 2
+
+
+class MuxConnection:
+    """
+    A multiplexed connection's socket, written by all of its streams' handlers - a frame is written as a whole.
+
+    Attributes:
+        _conn (socket.socket): The client's connection.
+        _write_lock (threading.Lock): Held while a frame is written.
+        _closed (bool): Whether the connection was closed, frames are no longer written once it was.
+    """
+    def __init__(self, conn: socket.socket):
+        self._conn = conn
+        self._write_lock = threading.Lock()
+        self._closed = False
+
+    def send_frame(self, stream_id: int, frame_type: int, data: bytes = b'', length: int | None = None) -> None:
+        with self._write_lock:
+            if self._closed:
+                return
+            try:
+                header = struct.pack(FRAME_HEADER_FORMAT, stream_id, frame_type, len(data) if length is None else length)
+                self._conn.sendall(header + data)
+            except OSError:
+                self._closed = True
+
+    def close(self) -> None:
+        with self._write_lock:
+            self._closed = True
+            self._conn.close()
+
+
+class MuxStream:
+    """
+    A stream of a multiplexed connection, standing in for a connection - a stream's requests are handled by
+    Server.handle_client like a connection's, on a thread of their own.
+    The client may only send as many bytes as the stream has credit for. Credit is granted as the handler takes the bytes,
+    so a stream whose handler is busy (decrypting a large file) stops its client's bulk data without holding up the other
+    streams of the connection.
+
+    Attributes:
+        _connection (MuxConnection): The connection the stream is multiplexed over.
+        _stream_id (int): The stream's id, chosen by the client.
+        _chunks (deque[bytes]): The data received and not taken by the handler yet.
+        _offset (int): The amount of bytes of the first chunk already taken.
+        _buffered (int): The amount of bytes received and not taken yet.
+        _consumed (int): The amount of bytes taken since credit was last granted.
+        _eof (bool): Whether the client closed the stream (or the connection).
+        _closed (bool): Whether the handler closed the stream.
+    """
+    def __init__(self, connection: MuxConnection, stream_id: int):
+        self._connection = connection
+        self._stream_id = stream_id
+        self._chunks: deque[bytes] = deque()
+        self._offset = 0
+        self._buffered = 0
+        self._consumed = 0
+        self._eof = False
+        self._closed = False
+        self._changed = threading.Condition()
+
+    # This method adds data the client sent on the stream, returns False if the client sent more than its credit.
+    def feed(self, data: bytes) -> bool:
+        with self._changed:
+            self._chunks.append(data)
+            self._buffered += len(data)
+            self._changed.notify()
+            return self._buffered <= stream_window
+
+    def feed_eof(self) -> None:
+        with self._changed:
+            self._eof = True
+            self._changed.notify()
+
+    def recv(self, size: int) -> bytes:
+        with self._changed:
+            self._changed.wait_for(lambda: self._buffered > 0 or self._eof)
+            data = bytearray()
+            while self._chunks and len(data) < size:
+                chunk = self._chunks[0]
+                amount = min(size - len(data), len(chunk) - self._offset)
+                data += chunk[self._offset:self._offset + amount]
+                self._offset += amount
+                if self._offset == len(chunk):
+                    self._chunks.popleft()
+                    self._offset = 0
+            self._buffered -= len(data)
+            self._consumed += len(data)
+
+            # Grant the taken bytes back once they add up to a quarter of the window, instead of a frame per request.
+            credit = 0
+            if self._consumed >= stream_window // 4:
+                credit, self._consumed = self._consumed, 0
+
+        if credit:
+            self._connection.send_frame(self._stream_id, FRAME_CREDIT, length=credit)
+        return bytes(data)
+
+    def sendall(self, data: bytes) -> None:
+        self._connection.send_frame(self._stream_id, FRAME_DATA, data)
+
+    def close(self) -> None:
+        with self._changed:
+            if self._closed:
+                return
+            self._closed = True
+        self._connection.send_frame(self._stream_id, FRAME_CLOSE)
+
+
+def serve_multiplexed(server, conn: socket.socket, address) -> None:
+    """
+    Receive the frames of a multiplexed connection until the client disconnects, feeding every stream's data to its handler.
+    A stream is opened by its first data frame, and its handler runs on a thread of its own.
+
+    :param server: The server that communicates with the clients.
+    :param conn: The connection object, after the client's Multiplex request was accepted.
+    :param address: The client's address.
+    """
+    connection = MuxConnection(conn)
+    streams: dict[int, MuxStream] = {}
+
+    def handle_stream(stream: MuxStream) -> None:
+        try:
+            server.handle_client(stream, address, multiplexed=True)
+        finally:
+            stream.close()
+
+    try:
+        while True:
+            header = recv_exactly(conn, FRAME_HEADER_SIZE)
+            if len(header) < FRAME_HEADER_SIZE:
+                break
+            stream_id, frame_type, length = struct.unpack(FRAME_HEADER_FORMAT, header)
+
+            if frame_type == FRAME_DATA:
+                if length > stream_window:
+                    print(f"Client {address} sent a frame larger than the stream window.")
+                    break
+                data = recv_exactly(conn, length)
+                if len(data) < length:
+                    break
+
+                stream = streams.get(stream_id)
+                if stream is None:
+                    stream = MuxStream(connection, stream_id)
+                    streams[stream_id] = stream
+                    threading.Thread(target=handle_stream, args=(stream,)).start()
+                if not stream.feed(data):
+                    print(f"Client {address} sent more than its credit on stream {stream_id}.")
+                    break
+            elif frame_type == FRAME_CLOSE:
+                stream = streams.pop(stream_id, None)
+                if stream is not None:
+                    stream.feed_eof()
+    except OSError:
+        pass
+    finally:
+        print(f"Multiplexed client {address} disconnected.")
+        for stream in streams.values():
+            stream.feed_eof()
+        connection.close()
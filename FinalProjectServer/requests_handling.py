@@ -1,12 +1,16 @@
 import os.path
+import struct
 
 from clients import Client
 from utils import decodes_utf8, ReqState, RequestCodes, decrypt_file_using_aes_key
-from utils import create_aes_key, create_uuid, create_directory, get_client_file_path, remove_client_file
+from utils import create_aes_key, create_uuid, create_directory, get_client_file_path, remove_client_file, create_temp_file
+from utils import derive_ecdh_aes_key, open_session_ticket
+from utils import bundle_magic, bundle_header_format, bundle_entry_format
 from cksum import memcrc
 from Crypto.PublicKey import RSA
 
 MAX_PACK_LENGTH = 1024
+PART_SUFFIX = '.part'  # The suffix of the file a client's file is received into, before it's decrypted.
 
 
 def handle_one_param(server, client_id: bytes, code: RequestCodes, unpacked_payload) -> ReqState:
@@ -15,7 +19,7 @@ def handle_one_param(server, client_id: bytes, code: RequestCodes, unpacked_payl
 
     :param server: The server that communicates with the clients.
     :param client_id: The client's id.
-    :param code: The request code, one of (825, 827, 900, 901, 902).
+    :param code: The request code, one of (825, 827, 830, 900, 901, 902, 903).
     :param unpacked_payload: A tuple object containing all request payload arguments.
 
     :return: The response code generated by the server.
@@ -29,6 +33,8 @@ def handle_one_param(server, client_id: bytes, code: RequestCodes, unpacked_payl
             return register(server, name)
         case RequestCodes.RECONNECTION:
             return reconnect(server, client_id, name)
+        case RequestCodes.ECDH_RECONNECTION:
+            return ecdh_reconnect(server, client_id, name)
         case _:
             return crc_requests(server, client_id, code, file_name=name)
 
@@ -62,12 +68,84 @@ def handle_sending_public_key(server, client_id: bytes, code: RequestCodes, unpa
     return ReqState.PUBLIC_KEY_RECEIVED
 
 
+def handle_sending_ecdh_key(server, client_id: bytes, code: RequestCodes, unpacked_payload: tuple) -> ReqState:
+    """
+    Process Sending ECDH Key request (829).
+
+    :param server: The server that communicates with the clients.
+    :param client_id: The client's id.
+    :param code: The request code.
+    :param unpacked_payload: A tuple object containing all request payload arguments.
+
+    :return: The response code generated by the server.
+    """
+    print("got to handle sending ecdh key!")
+
+    name_in_bytes, public_key = unpacked_payload
+    name: str = decodes_utf8(name_in_bytes)
+
+    # If the client name and id don't match in the dictionary, return general error.
+    if not server.client_registered(client_id, name):
+        return ReqState.GENERAL_ERROR
+
+    # Agree on the AES key, save the client's public key, the AES key and the server's public key into the dictionary.
+    try:
+        server_public_key, aes_key = derive_ecdh_aes_key(public_key, client_id)
+    except ValueError:
+        return ReqState.GENERAL_ERROR
+
+    client: Client = server.get_client(client_id)
+    client.set_ecdh_public_key(public_key)
+    client.set_server_ecdh_public_key(server_public_key)
+    client.set_aes_key(aes_key)
+    return ReqState.ECDH_KEY_RECEIVED
+
+
+def handle_ticket_reconnection(server, client_id: bytes, code: RequestCodes, unpacked_payload: tuple) -> ReqState:
+    """
+    Process Ticket Reconnection (831) and Checked Ticket Reconnection (834) requests.
+    The client sends the file packets right after a Ticket Reconnection without waiting, so a valid ticket gets no response.
+    A Checked Ticket Reconnection waits for the answer instead - a client streaming a file can't send it again after a
+    rejection, so it checks the ticket before the first packet.
+    # ASSUMPTIONS: * If the ticket of a Ticket Reconnection is rejected, the file packets sent along with it are dropped by
+                     the server.
+
+    :param server: The server that communicates with the clients.
+    :param client_id: The client's id.
+    :param code: The request code.
+    :param unpacked_payload: A tuple object containing all request payload arguments.
+
+    :return: The response code generated by the server.
+    """
+    print("got to handle ticket reconnection!")
+
+    name_in_bytes, ticket = unpacked_payload
+    name: str = decodes_utf8(name_in_bytes)
+    opened_ticket = open_session_ticket(ticket)
+
+    # If the ticket is forged, expired or was already used, was issued to a different client, or the client isn't registered, reject it.
+    if opened_ticket is None or opened_ticket[0] != client_id or not server.client_registered(client_id, name):
+        return ReqState.TICKET_REJECTED
+
+    # Resume the session using the ticket's AES key.
+    client: Client = server.get_client(client_id)
+    client.set_aes_key(opened_ticket[1])
+    client.clear_packets()  # Drop the packets received so far.
+
+    if code == RequestCodes.CHECKED_TICKET_RECONNECTION:
+        return ReqState.TICKET_ACCEPTED
+    return ReqState.AWAIT_PACKET
+
+
 def handle_sending_file(server, client_id: bytes, code: RequestCodes, unpacked_payload: tuple) -> ReqState:
     """
-    Process Sending File request (828).
+    Process Sending File (828) and Sending Bundle (832) requests - a bundle's packets are received like a file's, and
+    unpacked once it was decrypted.
     # ASSUMPTIONS: * The packets are being sent in the correct order.
+                   * A streamed file (of a length unknown to the client up front) is sent with the sizes and total
+                     packets set to 0, except in its last packet.
                    * The server replies only after the last packet has been received.
-                   * Each client only sends one file.
+                   * A client may send several files over one connection, each one starting from packet number 1.
 
     :param server: The server that communicates with the clients.
     :param client_id: The client's id.
@@ -82,55 +160,132 @@ def handle_sending_file(server, client_id: bytes, code: RequestCodes, unpacked_p
     client: Client = server.get_client(client_id)
     file_name: str = decodes_utf8(file_name_bytes)
 
-    # If it's the first instance of request 828 - save file name and total packets.
-    if client.get_file_name() is None:
+    # If it's the first packet of a file - save file name and total packets, and drop packets left from a previous file.
+    # The packets' data is appended to a partial file next to the client's file, so the file is never held in memory. A
+    # bundle is received into a temporary file instead, its name may be the name of one of the files in it.
+    if pack_num == 1:
         client.set_file_name(file_name)
-        client.set_tot_packets(tot_packets)
-
-    # Add the current packet's data. If all packets were received, decrypt, calc CRC and return response code 1603.
-    client.add_packet_data(pack_num, content)
-
+        client.set_bundle_files([])
+        client.set_bundle(code == RequestCodes.SENDING_BUNDLE)
+        create_directory(client_id.hex())
+        if client.is_bundle():
+            client.start_file(create_temp_file('bundle-'))
+        else:
+            client.start_file(get_client_file_path(client_id.hex(), os.path.basename(file_name)) + PART_SUFFIX)
+
+    # A streamed file's total packets (and size) are 0 until its last packet, every packet before it is full.
+    client.set_tot_packets(tot_packets if tot_packets else None)
+    if tot_packets:
+        amt_to_write = max(0, min(MAX_PACK_LENGTH, content_size - (pack_num - 1) * MAX_PACK_LENGTH))
+    else:
+        amt_to_write = MAX_PACK_LENGTH
+
+    # Add the current packet's data, without the last packet's padding.
+    client.add_packet_data(content[:amt_to_write])
+
+    # If all packets were received, decrypt, calc CRC and return response code 1603.
     if client.received_entire_file():
-        decrypt_file_calc_crc(client, client_id, content_size)
+        if not client.is_bundle():
+            decrypt_file_calc_crc(client, get_client_file_path(client_id.hex(), os.path.basename(client.get_file_name())))
+            return ReqState.FILE_RECEIVED_CRC
+
+        bundle_path = create_temp_file('bundle-')
+        try:
+            decrypt_file_calc_crc(client, bundle_path)
+        except Exception:
+            remove_client_file(bundle_path)
+            raise
+        # A bundle that can't be unpacked (a malformed index, or a file whose CRC does not match its entry) is rejected.
+        if not unpack_bundle(client, client_id, bundle_path):
+            return ReqState.GENERAL_ERROR
         return ReqState.FILE_RECEIVED_CRC
 
     # If not all packets were received, return response code indicating no response.
     return ReqState.AWAIT_PACKET
 
 
-def decrypt_file_calc_crc(client: Client, client_id: bytes, content_size) -> None:
+def decrypt_file_calc_crc(client: Client, file_path: str) -> None:
     """
-    Decrypt the client's file and calculate CRC.
+    Decrypt the client's received file into the given path and calculate CRC.
 
-    :param content_size:
     :param client: The client object.
-    :param client_id: The client id corresponding to the provided client object.
+    :param file_path: The path the decrypted file is written to.
     """
-    # Create directory for the file and write all packets' data into it.
-    str_id: str = client_id.hex()
-    size = 0
-    create_directory(str_id)
-    existing_file_name = os.path.basename(client.get_file_name())
-    client_file_path: str = get_client_file_path(str_id, existing_file_name)
-    with open(client_file_path, 'wb') as client_file:
-        for pack_num, pack_data in client.get_packets().items():
-            amt_to_write = min(MAX_PACK_LENGTH, content_size - (pack_num-1)*MAX_PACK_LENGTH)
-            stripped_data = pack_data[:amt_to_write]
-            client_file.write(stripped_data)
-            size += len(stripped_data)
-
-    # Get the decrypted file data and write it back to the file in binary format.
-    decrypted_data = decrypt_file_using_aes_key(client_file_path, client.get_aes_key())
-    client.set_content_size(size)
-
-    with open(client_file_path, 'wb') as client_file:
-        client_file.write(decrypted_data)
-
-    # Calculate CRC and save it.
-    crc = memcrc(decrypted_data)
+    # Decrypt the received data a chunk at a time, calculating the CRC on the way, then drop the encrypted data.
+    part_file_path: str = client.get_part_path()
+    crc = decrypt_file_using_aes_key(part_file_path, client.get_aes_key(), file_path)
+    remove_client_file(part_file_path)
+
+    client.set_content_size(client.get_received_size())
     client.set_crc(crc)
 
 
+def unpack_bundle(client: Client, client_id: bytes, bundle_path: str) -> bool:
+    """
+    Unpack the client's received bundle into the client's directory, then drop the bundle (a temporary file, outside the
+    client's directory). The bundle is the header (magic
+    and amount of files), an index entry per file followed by its name, and then the files' contents in the index's order.
+    Every file is written next to its place and checked against its entry's CRC, the files only replace the client's
+    existing files once all of them were checked - a bundle is unpacked entirely or not at all. A bundle naming two files
+    alike (the files are kept by their names only) is rejected before anything is written.
+
+    :param client: The client object.
+    :param client_id: The client id corresponding to the provided client object.
+    :param bundle_path: The path of the decrypted bundle.
+
+    :return: Whether the bundle was unpacked.
+    """
+    header_size = struct.calcsize(bundle_header_format)
+    entry_size = struct.calcsize(bundle_entry_format)
+    written: list[str] = []
+    unpacked = False
+
+    try:
+        with open(bundle_path, 'rb') as bundle:
+            magic, files_amount = struct.unpack(bundle_header_format, bundle.read(header_size))
+            if magic != bundle_magic:
+                return False
+
+            entries = []
+            names = set()
+            for _ in range(files_amount):
+                size, crc, name_length = struct.unpack(bundle_entry_format, bundle.read(entry_size))
+                # The files are kept by their names only, whichever separator the client's paths use.
+                name = os.path.basename(decodes_utf8(bundle.read(name_length)).replace('\\', '/'))
+                if not name or os.path.normcase(name) in names:
+                    return False
+                names.add(os.path.normcase(name))
+                entries.append((size, crc, name))
+
+            for size, crc, name in entries:
+                content = bundle.read(size)
+                if len(content) != size or memcrc(content) != crc:
+                    return False
+                part_path = get_client_file_path(client_id.hex(), name) + PART_SUFFIX
+                with open(part_path, 'wb') as part_file:
+                    part_file.write(content)
+                written.append(part_path)
+
+            # Nothing may follow the last file.
+            if bundle.read(1):
+                return False
+
+        file_paths = [part_path[:-len(PART_SUFFIX)] for part_path in written]
+        for part_path, file_path in zip(written, file_paths):
+            os.replace(part_path, file_path)
+        client.set_bundle_files(file_paths)
+        unpacked = True
+    except (struct.error, OSError):
+        return False
+    finally:
+        if not unpacked:
+            for part_path in written:
+                remove_client_file(part_path)
+        remove_client_file(bundle_path)
+
+    return True
+
+
 def register(server, name: str) -> ReqState:
     """
     Process Register request (825).
@@ -184,14 +339,47 @@ def reconnect(server, client_id: bytes, name: str) -> ReqState:
     # If the client is registered, create AES key, save it, and return successful reconnection state.
     aes_key = create_aes_key()
     server.get_client(client_id).set_aes_key(aes_key)
-    server.get_client(client_id).clear_dict()  # Clear the packet dictionary.
+    server.get_client(client_id).clear_packets()  # Drop the packets received so far.
 
     return ReqState.RECONNECTED_SUCCESSFULLY
 
 
+def ecdh_reconnect(server, client_id: bytes, name: str) -> ReqState:
+    """
+    Process ECDH Reconnection request (830).
+    # ASSUMPTIONS: * If the client cannot reconnect, the server tries registration instead.
+
+    :param server: The server that communicates with the clients.
+    :param client_id: The id of the client requesting reconnection.
+    :param name: The name of the client requesting reconnection.
+
+    :return: The response code generated by the server.
+    """
+    print("got to handle ecdh reconnect!")
+
+    if not server.client_registered(client_id, name) or (server.get_client(client_id).get_ecdh_public_key() is None):
+        server.remove_client_if_registered(client_id, name)
+        reg = register(server, name)
+
+        # If the client is not registered but can register, return that the client needs to register.
+        if reg == ReqState.REGISTERED_SUCCESSFULLY:
+            return ReqState.NOT_REGISTERED_OR_INVALID_KEY
+        return ReqState.GENERAL_ERROR
+
+    # If the client is registered, agree on a new AES key using a fresh server key pair, save it, and return successful
+    # reconnection state.
+    client: Client = server.get_client(client_id)
+    server_public_key, aes_key = derive_ecdh_aes_key(client.get_ecdh_public_key(), client_id)
+    client.set_server_ecdh_public_key(server_public_key)
+    client.set_aes_key(aes_key)
+    client.clear_packets()  # Drop the packets received so far.
+
+    return ReqState.ECDH_RECONNECTED_SUCCESSFULLY
+
+
 def crc_requests(server, client_id: bytes, code: RequestCodes, file_name: str) -> ReqState:
     """
-    Process CRC related requests (900-902).
+    Process CRC related requests (900-903).
 
     :param server: The server that communicates with the clients.
     :param client_id: The client's id.
@@ -210,17 +398,27 @@ def crc_requests(server, client_id: bytes, code: RequestCodes, file_name: str) -
 
     # delete user file if the crc was incorrect.
     if code == RequestCodes.INVALID_CRC_SENDING_AGAIN or code == RequestCodes.FOURTH_TIME_INVALID_CRC:
-        str_id = client_id.decode('utf-8', 'ignore')
         client = server.get_client(client_id)
-        existing_file_name = os.path.basename(client.get_file_name())
-        path = get_client_file_path(str_id, existing_file_name)
-        remove_client_file(path)
+        # A bundle was already unpacked and dropped, its files are deleted instead (there are none if it wasn't unpacked).
+        if client.is_bundle():
+            for path in client.get_bundle_files():
+                remove_client_file(path)
+            client.set_bundle_files([])
+        else:
+            str_id = client_id.decode('utf-8', 'ignore')
+            existing_file_name = os.path.basename(client.get_file_name())
+            path = get_client_file_path(str_id, existing_file_name)
+            remove_client_file(path)
 
     # If the request is 901 - 'Invalid CRC, sending again', no response is needed.
     if code == RequestCodes.INVALID_CRC_SENDING_AGAIN:
-        server.get_client(client_id).clear_dict()  # Clear the packet dictionary.
+        server.get_client(client_id).clear_packets()  # Drop the packets received so far.
         return ReqState.AWAIT_FILE
 
+    # Valid request code 903, returning response code 1612 with a new session ticket.
+    if code == RequestCodes.VALID_CRC_TICKET:
+        return ReqState.MESSAGE_RECEIVED_TICKET
+
     # Valid request codes 900/902, returning response code 1604.
     return ReqState.MESSAGE_RECEIVED
 
@@ -233,5 +431,11 @@ requests_functions = {
     828: handle_sending_file,
     900: handle_one_param,
     901: handle_one_param,
-    902: handle_one_param
+    902: handle_one_param,
+    829: handle_sending_ecdh_key,
+    830: handle_one_param,
+    831: handle_ticket_reconnection,
+    834: handle_ticket_reconnection,
+    832: handle_sending_file,
+    903: handle_one_param
 }
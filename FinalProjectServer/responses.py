@@ -8,11 +8,17 @@ PAYLOAD_SIZES = {
     1600: 16,
     1601: 0,
     1602: 144,
-    1603: 279,
+    1603: 283,
     1604: 16,
     1605: 144,
     1606: 16,
-    1607: 0
+    1607: 0,
+    1610: 48,
+    1611: 48,
+    1612: 156,
+    1613: 0,
+    1614: 4,
+    1615: 0
 }
 
 
@@ -94,8 +100,10 @@ class PublicKeyReceived(Response):
 
 
 class FileReceivedCrc(Response):
-    def __init__(self, code, payload_size, client_id, content_size, file_name, cksum):
-        super().__init__(code, payload_size)
+    def __init__(self, code, client_id, content_size, file_name, cksum, version=utils.default_version):
+        # The content size is 64 bit since version 4, a client of an older version gets the payload it expects.
+        self._format = utils.response_format(code, version)
+        super().__init__(code, struct.calcsize(self._format))
         self._client_id = client_id
         self._content_size = content_size
         self._file_name = file_name
@@ -108,8 +116,7 @@ class FileReceivedCrc(Response):
         :return: A bytes object containing the file received crc response fields -
                  version, code, payload size, client id, content size, file name, and the cksum.
         """
-        return super().pack_request_header() + struct.pack(utils.responses_formats[self._code],
-                                                           self._client_id, self._content_size,
+        return super().pack_request_header() + struct.pack(self._format, self._client_id, self._content_size,
                                                            self._file_name, self._cksum)
 
     def run(self, conn: socket.socket) -> None:
@@ -192,3 +199,124 @@ class GeneralError(Response):
     def run(self, conn: socket.socket) -> None:
         packed_msg = self.pack_general_error()
         conn.sendall(packed_msg)
+
+
+class EcdhKeyReceived(Response):
+    def __init__(self, code, payload_size, client_id, server_public_key):
+        super().__init__(code, payload_size)
+        self._client_id = client_id
+        self._server_public_key = server_public_key
+
+    def pack_ecdh_key_received(self) -> bytes:
+        """
+        Pack the ecdh key received response using the struct module.
+
+        :return: A bytes object containing the ecdh key received response fields -
+                 version, code, payload size, client id, and the server's X25519 public key.
+        """
+        return super().pack_request_header() + \
+            struct.pack(utils.responses_formats[self._code], self._client_id, self._server_public_key)
+
+    def run(self, conn: socket.socket) -> None:
+        packed_msg = self.pack_ecdh_key_received()
+        conn.sendall(packed_msg)
+
+
+class EcdhReconnectionSucceeded(Response):
+    def __init__(self, code, payload_size, client_id, server_public_key):
+        super().__init__(code, payload_size)
+        self._client_id = client_id
+        self._server_public_key = server_public_key
+
+    def pack_ecdh_reconnection_succeeded(self) -> bytes:
+        """
+        Pack the ecdh reconnection succeeded response using the struct module.
+
+        :return: A bytes object containing the ecdh reconnection succeeded response fields -
+                 version, code, payload size, client id, and the server's X25519 public key.
+        """
+        return super().pack_request_header() + \
+            struct.pack(utils.responses_formats[self._code], self._client_id, self._server_public_key)
+
+    def run(self, conn: socket.socket) -> None:
+        packed_msg = self.pack_ecdh_reconnection_succeeded()
+        conn.sendall(packed_msg)
+
+
+class MessageReceivedTicket(Response):
+    def __init__(self, code, payload_size, client_id, lifetime, enc_resumption_key, ticket):
+        super().__init__(code, payload_size)
+        self._client_id = client_id
+        self._lifetime = lifetime
+        self._enc_resumption_key = enc_resumption_key
+        self._ticket = ticket
+
+    def pack_message_received_ticket(self) -> bytes:
+        """
+        Pack the message received ticket response using the struct module.
+
+        :return: A bytes object containing the message received ticket response fields -
+                 version, code, payload size, client id, ticket lifetime, encrypted resumption key, and the ticket.
+        """
+        return super().pack_request_header() + \
+            struct.pack(utils.responses_formats[self._code], self._client_id, self._lifetime,
+                        self._enc_resumption_key, self._ticket)
+
+    def run(self, conn: socket.socket) -> None:
+        packed_msg = self.pack_message_received_ticket()
+        conn.sendall(packed_msg)
+
+
+class TicketRejected(Response):
+    def __init__(self, code, payload_size):
+        super().__init__(code, payload_size)
+
+    def pack_ticket_rejected(self):
+        """
+        Pack the ticket rejected response using the struct module.
+
+        :return: A bytes object containing the ticket rejected response fields -
+                 version, code, and the payload size.
+        """
+        return super().pack_request_header()
+
+    def run(self, conn: socket.socket) -> None:
+        packed_msg = self.pack_ticket_rejected()
+        conn.sendall(packed_msg)
+
+
+class TicketAccepted(Response):
+    def __init__(self, code, payload_size):
+        super().__init__(code, payload_size)
+
+    def pack_ticket_accepted(self):
+        """
+        Pack the ticket accepted response using the struct module.
+
+        :return: A bytes object containing the ticket accepted response fields -
+                 version, code, and the payload size.
+        """
+        return super().pack_request_header()
+
+    def run(self, conn: socket.socket) -> None:
+        packed_msg = self.pack_ticket_accepted()
+        conn.sendall(packed_msg)
+
+
+class MultiplexAccepted(Response):
+    def __init__(self, code, payload_size, stream_window):
+        super().__init__(code, payload_size)
+        self._stream_window = stream_window
+
+    def pack_multiplex_accepted(self):
+        """
+        Pack the multiplex accepted response using the struct module.
+
+        :return: A bytes object containing the multiplex accepted response fields -
+                 version, code, payload size, and the credit every stream starts with.
+        """
+        return super().pack_request_header() + struct.pack(utils.responses_formats[self._code], self._stream_window)
+
+    def run(self, conn: socket.socket) -> None:
+        packed_msg = self.pack_multiplex_accepted()
+        conn.sendall(packed_msg)
@@ -1,10 +1,13 @@
 from clients import Client
 import socket
 import struct
-from utils import ReqState, requests_formats, encrypt_aes_key, RequestCodes, decodes_utf8
+from utils import ReqState, requests_formats, encrypt_aes_key, RequestCodes, decodes_utf8, request_format, recv_exactly
+from utils import create_aes_key, encrypt_using_aes_key, create_session_ticket, ticket_lifetime
 from requests_handling import requests_functions
+from multiplexing import serve_multiplexed
 from responses import PAYLOAD_SIZES
 import responses
+import utils
 import threading
 
 HEADER_SIZE = 23
@@ -76,8 +79,8 @@ class Server:
                 return self._clients[client_id].get_name() == client_name
         return False
 
-    def handle_request(self, conn: socket.socket, client_id: bytes, code: RequestCodes, payload_size: int) -> \
-            tuple[ReqState, tuple | None]:
+    def handle_request(self, conn: socket.socket, client_id: bytes, code: RequestCodes, payload_size: int,
+                       version: int) -> tuple[ReqState, tuple | None]:
         """
         Handle receiving, unpacking, and processing the client's request.
 
@@ -85,11 +88,12 @@ class Server:
         :param client_id: The client's id.
         :param code: The request code.
         :param payload_size: The size of the request's payload.
+        :param version: The client's version, the Sending File request's format depends on it.
 
         :return: The response code generated by the server.
         """
         # Receiving the payload from the socket.
-        payload = conn.recv(payload_size)
+        payload = recv_exactly(conn, payload_size)
         code_int = code.value
 
         # If the client gave an invalid code, return false and the error.
@@ -97,10 +101,11 @@ class Server:
             return ReqState.GENERAL_ERROR, None
 
         # Unpacking the payload using the formats, and calling the correct function to handle the request.
-        unpacked_payload = struct.unpack(requests_formats[code_int], payload)
+        unpacked_payload = struct.unpack(request_format(code_int, version), payload)
         return requests_functions[code_int](self, client_id, code, unpacked_payload), unpacked_payload
 
-    def handle_response(self, conn: socket.socket, client_id: bytes, code: ReqState, unpacked_request_payload) -> None:
+    def handle_response(self, conn: socket.socket, client_id: bytes, code: ReqState, unpacked_request_payload,
+                        version: int = utils.default_version) -> None:
         """
         Handle sending the server response back to the client.
 
@@ -109,6 +114,7 @@ class Server:
         :param code: The response code.
         :param unpacked_request_payload: The request's unpacked payload, used for accessing the newly created client id,
                in case the response is either registration suceeded (1600), or reconnection failed (1606).
+        :param version: The client's version, the File Received CRC response's format depends on it.
         """
         code_int: int = code.value
         print("the response code is -", code_int)
@@ -130,9 +136,8 @@ class Server:
             case ReqState.FILE_RECEIVED_CRC:
                 client = self.get_client(client_id)
                 bytes_file_name = client.get_file_name().encode('utf-8')
-                response = responses.FileReceivedCrc(code_int, PAYLOAD_SIZES[code_int], client_id,
-                                                     client.get_content_size(), bytes_file_name,
-                                                     client.get_crc())
+                response = responses.FileReceivedCrc(code_int, client_id, client.get_content_size(), bytes_file_name,
+                                                     client.get_crc(), version)
             case ReqState.MESSAGE_RECEIVED:
                 response = responses.MessageReceived(code_int, PAYLOAD_SIZES[code_int], client_id)
             case ReqState.RECONNECTED_SUCCESSFULLY:
@@ -141,29 +146,71 @@ class Server:
                 aes_key = client.get_aes_key()
                 enc_aes_key = encrypt_aes_key(aes_key, pub_key)
                 response = responses.ReconnectionSucceeded(code_int, PAYLOAD_SIZES[code_int], client_id, enc_aes_key)
+            case ReqState.ECDH_KEY_RECEIVED:
+                client = self.get_client(client_id)
+                response = responses.EcdhKeyReceived(code_int, PAYLOAD_SIZES[code_int], client_id,
+                                                     client.get_server_ecdh_public_key())
+            case ReqState.ECDH_RECONNECTED_SUCCESSFULLY:
+                client = self.get_client(client_id)
+                response = responses.EcdhReconnectionSucceeded(code_int, PAYLOAD_SIZES[code_int], client_id,
+                                                               client.get_server_ecdh_public_key())
             case ReqState.NOT_REGISTERED_OR_INVALID_KEY:
                 name: str = decodes_utf8(unpacked_request_payload[0])
                 get_id = self.get_uuid_by_name(name)
                 response = responses.ReconnectionFailed(code_int, PAYLOAD_SIZES[code_int],
                                                         client_id=get_id)
+            case ReqState.MESSAGE_RECEIVED_TICKET:
+                # Issue a ticket with a new resumption key, sent to the client encrypted using the current AES key.
+                client = self.get_client(client_id)
+                resumption_key = create_aes_key()
+                enc_resumption_key = encrypt_using_aes_key(resumption_key, client.get_aes_key())
+                ticket = create_session_ticket(client_id, resumption_key)
+                response = responses.MessageReceivedTicket(code_int, PAYLOAD_SIZES[code_int], client_id,
+                                                           ticket_lifetime, enc_resumption_key, ticket)
+            case ReqState.TICKET_REJECTED:
+                response = responses.TicketRejected(code_int, PAYLOAD_SIZES[code_int])
+            case ReqState.TICKET_ACCEPTED:
+                response = responses.TicketAccepted(code_int, PAYLOAD_SIZES[code_int])
             case ReqState.GENERAL_ERROR:
                 response = responses.GeneralError(code_int, PAYLOAD_SIZES[code_int])
+            case ReqState.MULTIPLEX_ACCEPTED:
+                response = responses.MultiplexAccepted(code_int, PAYLOAD_SIZES[code_int], utils.stream_window)
             case _:
                 return
         response.run(conn)
 
-    def handle_client(self, conn, address):
+    @staticmethod
+    def discard_file_packet(conn: socket.socket, payload_size: int, version: int) -> bool:
+        """
+        Receive a Sending File (828) or Sending Bundle (832) packet and drop it.
+
+        :param conn: The connection object responsible for transferring messages between the server and the client.
+        :param payload_size: The size of the request's payload.
+        :param version: The client's version.
+
+        :return: Whether the dropped packet was the file's last packet.
+        """
+        payload = recv_exactly(conn, payload_size)
+        _, _, pack_num, tot_packets, _, _ = struct.unpack(request_format(RequestCodes.SENDING_FILE.value, version), payload)
+        return pack_num == tot_packets
+
+    def handle_client(self, conn, address, multiplexed: bool = False):
         """
         Handle client communication in a separate thread.
 
         :param conn: The connection object responsible for transferring messages between the server and the client.
         :param address: The client's address.
+        :param multiplexed: Whether conn is a stream of a multiplexed connection (see multiplexing.py), which can't be
+               multiplexed again.
         """
+        # Set when a session ticket is rejected, the file packets the client sent along with it must be dropped.
+        discarding_packets = False
+
         while True:
             print(f"\nConnected to {address}. Waiting for request!")
-            header = conn.recv(HEADER_SIZE)
+            header = recv_exactly(conn, HEADER_SIZE)
 
-            if len(header) == 0:
+            if len(header) < HEADER_SIZE:
                 print(f"Client {address} disconnected.")
                 conn.close()
                 break
@@ -173,10 +220,34 @@ class Server:
 
             print("code =", code)
 
+            # A Multiplex request turns the connection into a multiplexed one, from now on it carries framed streams.
+            if code == RequestCodes.MULTIPLEX.value and not multiplexed:
+                recv_exactly(conn, payload_size)
+                self.handle_response(conn, client_id, ReqState.MULTIPLEX_ACCEPTED, None, version)
+                serve_multiplexed(self, conn, address)
+                break
+
+            # Drop the packets sent along with a rejected ticket, and reject the ticket after the last one.
+            if discarding_packets and code in (RequestCodes.SENDING_FILE.value, RequestCodes.SENDING_BUNDLE.value):
+                if self.discard_file_packet(conn, payload_size, version):
+                    discarding_packets = False
+                    self.handle_response(conn, client_id, ReqState.TICKET_REJECTED, None)
+                continue
+
+            # A request this server doesn't know (e.g. of a newer client) gets a General Error, the client may fall back to an older one.
+            if code not in RequestCodes._value2member_map_:
+                recv_exactly(conn, payload_size)
+                self.handle_response(conn, client_id, ReqState.GENERAL_ERROR, None)
+                continue
+
             # Call a function to handle the client's request.
             response_code, unpacked_request_payload = self.handle_request(conn, client_id, RequestCodes(code),
-                                                                          payload_size)
-            self.handle_response(conn, client_id, response_code, unpacked_request_payload)
+                                                                          payload_size, version)
+            # A checked ticket is answered at once, the packets sent along with an unchecked one are dropped first.
+            if response_code == ReqState.TICKET_REJECTED and code == RequestCodes.TICKET_RECONNECTION.value:
+                discarding_packets = True
+                continue
+            self.handle_response(conn, client_id, response_code, unpacked_request_payload, version)
 
     def run(self) -> None:
         sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
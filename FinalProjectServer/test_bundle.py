@@ -0,0 +1,105 @@
+"""
+Tests of the server's bundle unpacking against the bundle fixture packed by the client (FinalProjectTests/fixtures/bundle.bin),
+so the client's packing and the server's unpacking are pinned to the same bytes. Run from this directory with
+'python -m unittest test_bundle'.
+"""
+
+import os
+import shutil
+import tempfile
+import unittest
+from unittest import mock
+
+import utils
+from clients import Client
+from cksum import memcrc
+from requests_handling import unpack_bundle
+
+FIXTURE_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'FinalProjectTests', 'fixtures', 'bundle.bin')
+
+# The files the fixture was packed from, as FinalProjectTests/bundle_tests.cpp writes them.
+FIXTURE_FILES = {
+    'alpha.txt': b'Alpha, the first file of the bundle fixture.\n',
+    'beta.bin': bytes(range(256)),
+    'empty.dat': b'',
+}
+
+
+class UnpackBundleTest(unittest.TestCase):
+    def setUp(self):
+        self.users_directory = tempfile.mkdtemp()
+        patcher = mock.patch.object(utils, 'users_directory', self.users_directory)
+        patcher.start()
+        self.addCleanup(patcher.stop)
+        self.addCleanup(shutil.rmtree, self.users_directory, True)
+
+        self.client_id = bytes(range(16))
+        self.client_directory = os.path.join(self.users_directory, self.client_id.hex())
+        os.makedirs(self.client_directory)
+        self.client = Client('tester')
+
+        with open(FIXTURE_PATH, 'rb') as fixture:
+            self.fixture = fixture.read()
+
+    def write_bundle(self, content: bytes) -> str:
+        """
+        Write the given content into a temporary file, like a received and decrypted bundle.
+
+        :param content: The bundle's content.
+
+        :return: The path of the bundle.
+        """
+        fd, path = tempfile.mkstemp(prefix='bundle-')
+        with os.fdopen(fd, 'wb') as bundle:
+            bundle.write(content)
+        self.addCleanup(lambda: os.path.exists(path) and os.remove(path))
+        return path
+
+    def test_unpacks_fixture(self):
+        bundle_path = self.write_bundle(self.fixture)
+
+        self.assertTrue(unpack_bundle(self.client, self.client_id, bundle_path))
+        self.assertFalse(os.path.exists(bundle_path))
+        self.assertEqual(sorted(os.listdir(self.client_directory)), sorted(FIXTURE_FILES))
+        for name, content in FIXTURE_FILES.items():
+            with open(os.path.join(self.client_directory, name), 'rb') as file:
+                self.assertEqual(file.read(), content)
+        self.assertEqual(sorted(self.client.get_bundle_files()),
+                         sorted(os.path.join(self.client_directory, name) for name in FIXTURE_FILES))
+
+    def test_known_crc_vectors(self):
+        # The CRCs POSIX cksum prints, which FinalProjectTests/cksum_tests.cpp checks the client's CRC against.
+        self.assertEqual(memcrc(b''), 4294967295)
+        self.assertEqual(memcrc(b'a'), 1220704766)
+        self.assertEqual(memcrc(b'123456789'), 930766865)
+        self.assertEqual(memcrc(bytes(i % 256 for i in range(100000))), 2448995759)
+
+    def test_rejects_corrupted_file(self):
+        # The last byte belongs to beta.bin, whose CRC no longer matches its index entry.
+        bundle_path = self.write_bundle(self.fixture[:-1] + bytes([self.fixture[-1] ^ 0xff]))
+
+        self.assertFalse(unpack_bundle(self.client, self.client_id, bundle_path))
+        self.assertFalse(os.path.exists(bundle_path))
+        self.assertEqual(os.listdir(self.client_directory), [])
+
+    def test_rejects_truncated_bundle(self):
+        bundle_path = self.write_bundle(self.fixture[:-1])
+
+        self.assertFalse(unpack_bundle(self.client, self.client_id, bundle_path))
+        self.assertEqual(os.listdir(self.client_directory), [])
+
+    def test_rejects_trailing_bytes(self):
+        bundle_path = self.write_bundle(self.fixture + b'\0')
+
+        self.assertFalse(unpack_bundle(self.client, self.client_id, bundle_path))
+        self.assertEqual(os.listdir(self.client_directory), [])
+
+    def test_rejects_bad_magic(self):
+        bundle_path = self.write_bundle(b'XXXX' + self.fixture[4:])
+
+        self.assertFalse(unpack_bundle(self.client, self.client_id, bundle_path))
+        self.assertEqual(os.listdir(self.client_directory), [])
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -1,34 +1,120 @@
 from enum import Enum
 import uuid
 import os
+import struct
+import time
+import threading
+import tempfile
 from Crypto.Random import get_random_bytes
 from Crypto.Cipher import PKCS1_OAEP, AES
 from Crypto.PublicKey.RSA import RsaKey
-from Crypto.Util.Padding import unpad
-
-default_version = 3
+from Crypto.Util.Padding import pad, unpad
+from Crypto.PublicKey import ECC
+from Crypto.Protocol.DH import key_agreement, import_x25519_public_key
+from Crypto.Protocol.KDF import HKDF
+from Crypto.Hash import SHA256
+from cksum import Crc
+
+default_version = 4
+legacy_version = 3  # Clients of version 3 send 32 bit file sizes and 16 bit packet counters.
+decrypt_chunk_size = 1024 * 1024  # Bytes of a received file decrypted at a time, a multiple of the AES block size.
 users_directory = 'users'
+ecdh_hkdf_info = b'FinalProject AES key'
+ticket_lifetime = 3600  # Seconds a session ticket can be used for reconnecting.
+ticket_format = '<16s 32s Q'  # The session ticket's plaintext - client id, resumption AES key and expiry time.
+ticket_key = get_random_bytes(32)  # Session tickets are only valid until the server restarts.
+used_tickets: dict[bytes, int] = {}  # The nonces of the session tickets already used, kept until the tickets expire.
+used_tickets_lock = threading.Lock()
+bundle_magic = b'FPB1'
+bundle_header_format = '<4s I'  # A bundle's magic and amount of files.
+bundle_entry_format = '<I I H'  # A bundled file's size, CRC and name length, followed by the name.
+stream_window = 256 * 1024  # Bytes a client may send on a multiplexed stream before the server grants it more credit.
 
 requests_formats = {
     825: '255s',
     826: '255s 160s',
     827: '255s',
-    828: '<I I H H 255s 1024s',
+    828: '<Q Q Q Q 255s 1024s',
     900: '255s',
     901: '255s',
-    902: '255s'
+    902: '255s',
+    829: '255s 32s',
+    830: '255s',
+    831: '255s 88s',
+    832: '<Q Q Q Q 255s 1024s',
+    903: '255s',
+    834: '255s 88s'
 }
 
 responses_formats = {
     1600: '16s',
     1602: '16s 128s',
-    1603: '<16s I 255s I',
+    1603: '<16s Q 255s I',
     1604: '16s',
     1605: '16s 128s',
-    1606: '16s'
+    1606: '16s',
+    1610: '16s 32s',
+    1611: '16s 32s',
+    1612: '<16s I 48s 88s',
+    1614: '<I'
+}
+
+# The formats that differ for clients of legacy_version - the Sending File request, and the content size in its response.
+legacy_requests_formats = {
+    828: '<I I H H 255s 1024s'
+}
+
+legacy_responses_formats = {
+    1603: '<16s I 255s I'
 }
 
 
+def request_format(code: int, version: int) -> str:
+    """
+    Returns the format of the payload of the given request, as sent by a client of the given version.
+
+    :param code: The request code.
+    :param version: The client's version.
+
+    :returns: The struct format of the request's payload.
+    """
+    if version <= legacy_version and code in legacy_requests_formats:
+        return legacy_requests_formats[code]
+    return requests_formats[code]
+
+
+def response_format(code: int, version: int) -> str:
+    """
+    Returns the format of the payload of the given response, as expected by a client of the given version.
+
+    :param code: The response code.
+    :param version: The client's version.
+
+    :returns: The struct format of the response's payload.
+    """
+    if version <= legacy_version and code in legacy_responses_formats:
+        return legacy_responses_formats[code]
+    return responses_formats[code]
+
+
+def recv_exactly(conn, size: int) -> bytes:
+    """
+    Receives exactly the given number of bytes from the connection - a single recv may return fewer.
+
+    :param conn: The connection to receive from.
+    :param size: The number of bytes to receive.
+
+    :returns: The received bytes, fewer than size only if the client disconnected.
+    """
+    data = bytearray()
+    while len(data) < size:
+        chunk = conn.recv(size - len(data))
+        if not chunk:
+            break
+        data += chunk
+    return bytes(data)
+
+
 def create_uuid() -> bytes:
     """
     Creates a new uuid and returns its byte form.
@@ -75,26 +161,116 @@ def encrypt_aes_key(aes_key: bytes, public_key: RsaKey) -> bytes:
     return encrypted_aes_key
 
 
-def decrypt_file_using_aes_key(file_path: str, aes_key: bytes) -> bytes:
+def derive_ecdh_aes_key(client_public_key: bytes, client_id: bytes, key_size=256) -> tuple[bytes, bytes]:
     """
-    Decrypts the data of the file with the provided path.
+    Agrees on a new AES key with the client, using a fresh X25519 key pair of the server and the client's public key.
+    The shared secret is expanded using HKDF-SHA256, with the client id as the salt.
 
-    :param file_path: The path to the file whose data is to be decrypted.
-    :param aes_key: The AES key used to decrypt the file data.
+    :param client_public_key: The client's raw X25519 public key.
+    :param client_id: The client's id.
+    :param key_size: The size of the new key in bits.
 
-    :returns: A bytes object representing the decrypted data.
+    :returns: A tuple of the server's raw X25519 public key (to be sent to the client), and the new AES key.
+    """
+    server_key = ECC.generate(curve='Curve25519')
+
+    def kdf(shared_secret: bytes) -> bytes:
+        return HKDF(shared_secret, key_size // 8, client_id, SHA256, context=ecdh_hkdf_info)
+
+    aes_key = key_agreement(static_pub=import_x25519_public_key(client_public_key), eph_priv=server_key, kdf=kdf)
+    return server_key.public_key().export_key(format='raw'), aes_key
+
+
+def encrypt_using_aes_key(data: bytes, aes_key: bytes) -> bytes:
+    """
+    Encrypts the given data using the provided AES key, the same way the client encrypts its files.
+
+    :param data: The data to encrypt.
+    :param aes_key: The AES key used to encrypt the data.
+
+    :returns: A bytes object representing the encrypted data.
     """
     iv = bytes(16)
+    cipher = AES.new(aes_key, AES.MODE_CBC, iv)
+    return cipher.encrypt(pad(data, AES.block_size))
+
+
+def create_session_ticket(client_id: bytes, resumption_key: bytes) -> bytes:
+    """
+    Creates a session ticket, which lets the client reconnect using the resumption key without a handshake.
+    The ticket is encrypted and authenticated using the server's ticket key, so only the server can read it.
+
+    :param client_id: The id of the client the ticket is issued for.
+    :param resumption_key: The AES key the client will use when reconnecting with the ticket.
+
+    :returns: The session ticket - the nonce, the encrypted ticket fields and the authentication tag.
+    """
+    cipher = AES.new(ticket_key, AES.MODE_GCM)
+    plain = struct.pack(ticket_format, client_id, resumption_key, int(time.time()) + ticket_lifetime)
+    encrypted, tag = cipher.encrypt_and_digest(plain)
+    return cipher.nonce + encrypted + tag
+
+
+def open_session_ticket(ticket: bytes) -> tuple[bytes, bytes] | None:
+    """
+    Checks the given session ticket and extracts its fields. A ticket is only accepted once, so a captured Ticket
+    Reconnection request (and the file packets sent along with it) can't be replayed.
+
+    :param ticket: The session ticket presented by the client.
 
-    with open(file_path, 'rb') as file:
-        encrypted_data = file.read()
+    :returns: A tuple of the client id and the resumption key, or None if the ticket is forged, expired or already used.
+    """
+    nonce, encrypted, tag = ticket[:16], ticket[16:-16], ticket[-16:]
+    cipher = AES.new(ticket_key, AES.MODE_GCM, nonce=nonce)
+    try:
+        plain = cipher.decrypt_and_verify(encrypted, tag)
+    except ValueError:
+        return None
+
+    client_id, resumption_key, expiry = struct.unpack(ticket_format, plain)
+    now = time.time()
+    if expiry < now:
+        return None
+
+    with used_tickets_lock:
+        # An expired ticket is rejected by its expiry, its nonce no longer needs to be kept.
+        for used_nonce in [used_nonce for used_nonce, used_expiry in used_tickets.items() if used_expiry < now]:
+            del used_tickets[used_nonce]
+        if nonce in used_tickets:
+            return None
+        used_tickets[nonce] = expiry
+    return client_id, resumption_key
+
+
+def decrypt_file_using_aes_key(file_path: str, aes_key: bytes, output_path: str) -> int:
+    """
+    Decrypts the data of the file with the provided path into the output file, decrypt_chunk_size bytes at a time - the
+    file is never read into memory as a whole.
+
+    :param file_path: The path to the file whose data is to be decrypted.
+    :param aes_key: The AES key used to decrypt the file data.
+    :param output_path: The path the decrypted data is written to.
 
+    :returns: The CRC of the decrypted data.
+    """
+    iv = bytes(16)
     cipher = AES.new(aes_key, AES.MODE_CBC, iv)
-    padded_data = cipher.decrypt(encrypted_data)
+    crc = Crc()
 
-    decrypted_data = unpad(padded_data, AES.block_size)
+    with open(file_path, 'rb') as file, open(output_path, 'wb') as output:
+        # The last block holds the padding, so the last decrypted block is held back until the end of the file.
+        last_block = b''
+        while chunk := file.read(decrypt_chunk_size):
+            data = last_block + cipher.decrypt(chunk)
+            last_block = data[-AES.block_size:]
+            output.write(data[:-AES.block_size])
+            crc.update(data[:-AES.block_size])
 
-    return decrypted_data
+        data = unpad(last_block, AES.block_size)
+        output.write(data)
+        crc.update(data)
+
+    return crc.final()
 
 
 def create_directory(dir_name: str) -> bool:
@@ -130,6 +306,20 @@ def remove_client_file(file_path: str):
     os.remove(file_path)
 
 
+def create_temp_file(prefix: str) -> str:
+    """
+    Create an empty file in the system's temporary directory, outside every client's directory - a name the server picked
+    can't be the name of a client's file.
+
+    :param prefix: The prefix of the file's name.
+
+    :return: The path of the created file.
+    """
+    fd, path = tempfile.mkstemp(prefix=prefix)
+    os.close(fd)
+    return path
+
+
 # An enum class for client requests and their codes.
 class RequestCodes(Enum):
     """
@@ -142,6 +332,13 @@ class RequestCodes(Enum):
     VALID_CRC = 900
     INVALID_CRC_SENDING_AGAIN = 901
     FOURTH_TIME_INVALID_CRC = 902
+    SENDING_ECDH_KEY = 829
+    ECDH_RECONNECTION = 830
+    TICKET_RECONNECTION = 831
+    SENDING_BUNDLE = 832
+    MULTIPLEX = 833
+    VALID_CRC_TICKET = 903
+    CHECKED_TICKET_RECONNECTION = 834
 
 
 class ReqState(Enum):
@@ -157,6 +354,12 @@ class ReqState(Enum):
     RECONNECTED_SUCCESSFULLY = 1605
     NOT_REGISTERED_OR_INVALID_KEY = 1606
     GENERAL_ERROR = 1607
+    ECDH_KEY_RECEIVED = 1610
+    ECDH_RECONNECTED_SUCCESSFULLY = 1611
+    MESSAGE_RECEIVED_TICKET = 1612
+    TICKET_REJECTED = 1613
+    MULTIPLEX_ACCEPTED = 1614
+    TICKET_ACCEPTED = 1615
 
     AWAIT_FILE = 1608  # Used as the response code for request 901 - 'invalid CRC, sending again'.
     AWAIT_PACKET = 1609  # Used as the response code for request 828, when it's not the final packet.
@@ -0,0 +1,137 @@
+#include "tests.hpp"
+#include "bundle.hpp"
+#include "AESWrapper.h"
+
+/*
+	The files of the bundle fixture (fixtures\bundle.bin) - FinalProjectServer\test_bundle.py unpacks the same fixture with the
+	server's unpack_bundle, so the client's packing and the server's unpacking are pinned to the same bytes.
+*/
+static const std::string ALPHA_CONTENT = "Alpha, the first file of the bundle fixture.\n";
+static const std::vector<std::string> FIXTURE_FILES = { "alpha.txt", "beta.bin", "empty.dat" };
+
+// This method returns the content of the fixture's file of the given index.
+static std::string fixture_file_content(size_t i) {
+	if (i == 0) {
+		return ALPHA_CONTENT;
+	}
+	if (i == 1) {
+		std::string bytes(256, '\0');
+		for (size_t b = 0; b < bytes.size(); b++) {
+			bytes[b] = static_cast<char>(b);
+		}
+		return bytes;
+	}
+	return "";
+}
+
+// The fixture's files, written into the executable's directory (which a bundle's file paths are relative to) while the object lives.
+struct FixtureFiles {
+	FixtureFiles() {
+		for (size_t i = 0; i < FIXTURE_FILES.size(); i++) {
+			std::ofstream out(EXE_DIR_FILE_PATH(FIXTURE_FILES[i]), std::ios::binary | std::ios::trunc);
+			std::string content = fixture_file_content(i);
+			out.write(content.data(), content.size());
+		}
+	}
+	~FixtureFiles() {
+		std::error_code ec;
+		for (const std::string& file : FIXTURE_FILES) {
+			std::filesystem::remove(EXE_DIR_FILE_PATH(file), ec);
+		}
+	}
+};
+
+// This method packs the fixture's files and returns the bundle's plaintext content, decrypting what the bundle would send.
+static std::string pack_fixture(FileBundle& bundle) {
+	std::string key(AESWrapper::DEFAULT_KEYLENGTH, '\x5a');
+	bundle.refresh(key);
+	ByteView ciphertext = bundle.next(static_cast<size_t>(bundle.getContentSize()));
+	CHECK_EQUAL(static_cast<uint64_t>(ciphertext.size()), bundle.getContentSize());
+
+	AESWrapper aes(reinterpret_cast<const unsigned char*>(key.data()), static_cast<unsigned int>(key.size()));
+	return aes.decrypt(reinterpret_cast<const char*>(ciphertext.data()), static_cast<unsigned int>(ciphertext.size()));
+}
+
+// The packed bundle is the fixture, byte for byte - a change of the format has to be made on both sides, and the fixture updated.
+static void pack_test() {
+	FileBundle bundle(bundle_name(1), FIXTURE_FILES);
+	std::string content;
+	{
+		FixtureFiles files;
+		content = pack_fixture(bundle);
+	}
+
+	CHECK_EQUAL(static_cast<uint64_t>(content.size()), bundle.getOrigSize());
+	CHECK_EQUAL(bundle.getCksum(), memcrc(content.data(), content.size()));
+	check_fixture("bundle.bin", content);
+}
+
+// The fixture reads back with the wire layouts into the files it was packed from, and the bundle's fingerprints match them.
+static void layout_test() {
+	FileBundle bundle(bundle_name(1), FIXTURE_FILES);
+	std::string content;
+	{
+		FixtureFiles files;
+		content = pack_fixture(bundle);
+	}
+
+	const uint8_t* data = reinterpret_cast<const uint8_t*>(content.data());
+	CHECK(content.size() >= BundleHeaderLayout::size);
+	CHECK(memcmp(data, BUNDLE_MAGIC, sizeof(BUNDLE_MAGIC)) == 0);
+	CHECK_EQUAL(BundleHeaderLayout::get<1>(data), static_cast<uint32_t>(FIXTURE_FILES.size()));
+
+	size_t pos = BundleHeaderLayout::size;
+	std::vector<uint32_t> sizes;
+	for (size_t i = 0; i < FIXTURE_FILES.size(); i++) {
+		CHECK(content.size() - pos >= BundleEntryLayout::size);
+		uint32_t size = BundleEntryLayout::get<0>(data + pos);
+		uint32_t crc = BundleEntryLayout::get<1>(data + pos);
+		uint16_t name_length = BundleEntryLayout::get<2>(data + pos);
+		pos += BundleEntryLayout::size;
+
+		std::string expected = fixture_file_content(i);
+		CHECK_EQUAL(size, static_cast<uint32_t>(expected.size()));
+		CHECK_EQUAL(crc, static_cast<uint32_t>(memcrc(expected.data(), expected.size())));
+		CHECK_EQUAL(crc, bundle.getFingerprints()[i].cksum);
+		CHECK(content.size() - pos >= name_length);
+		CHECK_EQUAL(content.substr(pos, name_length), FIXTURE_FILES[i]);
+		pos += name_length;
+		sizes.push_back(size);
+	}
+
+	for (size_t i = 0; i < FIXTURE_FILES.size(); i++) {
+		CHECK(content.size() - pos >= sizes[i]);
+		CHECK(content.compare(pos, sizes[i], fixture_file_content(i)) == 0);
+		pos += sizes[i];
+	}
+	CHECK_EQUAL(pos, content.size());
+}
+
+// The content is only encrypted again when the key changes.
+static void refresh_test() {
+	FixtureFiles files;
+	FileBundle bundle(bundle_name(1), FIXTURE_FILES);
+	CHECK(bundle.refresh(std::string(AESWrapper::DEFAULT_KEYLENGTH, 'a')));
+	CHECK(!bundle.refresh(std::string(AESWrapper::DEFAULT_KEYLENGTH, 'a')));
+	CHECK(bundle.refresh(std::string(AESWrapper::DEFAULT_KEYLENGTH, 'b')));
+}
+
+// A missing file fails the packing instead of leaving a hole in the bundle.
+static void missing_file_test() {
+	FileBundle bundle(bundle_name(1), { "missing.txt" });
+	bool thrown = false;
+	try {
+		bundle.load();
+	}
+	catch (std::runtime_error&) {
+		thrown = true;
+	}
+	CHECK(thrown);
+}
+
+void register_bundle_tests() {
+	register_test("bundle_pack", pack_test);
+	register_test("bundle_layout", layout_test);
+	register_test("bundle_refresh", refresh_test);
+	register_test("bundle_missing_file", missing_file_test);
+}
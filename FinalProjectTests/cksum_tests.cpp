@@ -0,0 +1,49 @@
+#include "tests.hpp"
+#include "cksum.hpp"
+#include "utils.hpp"
+
+// The CRCs POSIX cksum prints for the same input - the server's cksum.py must agree with them too.
+static void known_vectors_test() {
+	CHECK_EQUAL(memcrc("", 0), 4294967295UL);
+	CHECK_EQUAL(memcrc("a", 1), 1220704766UL);
+	CHECK_EQUAL(memcrc("123456789", 9), 930766865UL);
+	std::string fox = "The quick brown fox jumps over the lazy dog";
+	CHECK_EQUAL(memcrc(fox.data(), fox.size()), 2074844392UL);
+}
+
+// Long enough for the slicing loop, starting at every alignment - bytes i % 256, as printed by cksum.
+static void long_input_test() {
+	std::string buffer(100000 + 7, '\0');
+	for (size_t offset = 0; offset < 8; offset++) {
+		for (size_t i = 0; i < 100000; i++) {
+			buffer[offset + i] = static_cast<char>(i % 256);
+		}
+		CHECK_EQUAL(memcrc(buffer.data() + offset, 100000), 2448995759UL);
+	}
+}
+
+// A CRC updated a piece at a time, in pieces of every size up to a few slices, is the CRC of the whole.
+static void incremental_test() {
+	std::string buffer(10000, '\0');
+	for (size_t i = 0; i < buffer.size(); i++) {
+		buffer[i] = static_cast<char>(i * 7 + 3);
+	}
+	unsigned long whole = memcrc(buffer.data(), buffer.size());
+
+	for (size_t piece = 1; piece <= 3 * CRC_SLICES; piece++) {
+		Crc crc;
+		for (size_t pos = 0; pos < buffer.size(); pos += piece) {
+			crc.update(buffer.data() + pos, MIN(piece, buffer.size() - pos));
+		}
+		CHECK_EQUAL(crc.final(), whole);
+	}
+
+	Crc empty;
+	CHECK_EQUAL(empty.final(), memcrc("", 0));
+}
+
+void register_cksum_tests() {
+	register_test("cksum_known_vectors", known_vectors_test);
+	register_test("cksum_long_input", long_input_test);
+	register_test("cksum_incremental", incremental_test);
+}
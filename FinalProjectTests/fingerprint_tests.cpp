@@ -0,0 +1,155 @@
+#include "tests.hpp"
+#include "fingerprint.hpp"
+
+// This method returns a fingerprint whose every field is derived from the given seed.
+static FileFingerprint make_test_fingerprint(uint32_t seed, size_t chunks) {
+	FileFingerprint fingerprint;
+	fingerprint.identity = { 1000 + seed, 4096 * static_cast<uint64_t>(chunks), 1700000000000000000LL + seed };
+	fingerprint.cksum = seed * 2654435761u;
+	for (size_t i = 0; i < chunks; i++) {
+		fingerprint.chunks.push_back(seed + static_cast<uint32_t>(i));
+	}
+	fingerprint.confirmed_by = seed % 2 ? 0 : 0x1234567890abcdefULL + seed;
+	return fingerprint;
+}
+
+// This method checks the index holds the given fingerprint for the path.
+static void check_lookup(const FingerprintIndex& index, const std::string& path, const FileFingerprint& expected) {
+	FileFingerprint fingerprint;
+	CHECK(index.lookup(path, fingerprint));
+	CHECK(fingerprint.identity == expected.identity);
+	CHECK_EQUAL(fingerprint.cksum, expected.cksum);
+	CHECK(fingerprint.chunks == expected.chunks);
+	CHECK_EQUAL(fingerprint.confirmed_by, expected.confirmed_by);
+}
+
+// This method returns the content of the file at the given path.
+static std::string read_all(const std::string& path) {
+	std::ifstream in(path, std::ios::binary);
+	return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+// This method writes the given content into the file at the given path.
+static void write_all(const std::string& path, const std::string& content) {
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write(content.data(), content.size());
+}
+
+/*
+	This method records the given fingerprints into a new index, and returns its journal as it was before the index was closed
+	(closing it merges the journal away) - the journal of a client that stopped before compacting its index.
+*/
+static std::string write_journal(const std::vector<std::pair<std::string, FileFingerprint>>& records) {
+	std::string path = scratch_path("writer.idx");
+	std::string journal;
+	{
+		FingerprintIndex index(path);
+		for (const auto& record : records) {
+			index.update(record.first, record.second);
+		}
+		journal = read_all(path + ".journal");
+	}
+	std::filesystem::remove(path);
+	return journal;
+}
+
+// An index opened over a journal (and no table) replays it - the latest record of a path wins.
+static void journal_replay_test() {
+	std::string journal = write_journal({
+		{ "C:\\a.txt", make_test_fingerprint(1, 0) },
+		{ "C:\\b.txt", make_test_fingerprint(2, 3) },
+		{ "C:\\a.txt", make_test_fingerprint(3, 1) }
+	});
+	std::string path = scratch_path("fingerprints.idx");
+	write_all(path + ".journal", journal);
+
+	FingerprintIndex index(path);
+	check_lookup(index, "C:\\a.txt", make_test_fingerprint(3, 1));
+	check_lookup(index, "C:\\b.txt", make_test_fingerprint(2, 3));
+	FileFingerprint fingerprint;
+	CHECK(!index.lookup("C:\\c.txt", fingerprint));
+}
+
+// A record cut short is ignored and cut off the journal, so a record appended after it is replayed whole.
+static void torn_journal_test() {
+	std::string journal = write_journal({
+		{ "C:\\a.txt", make_test_fingerprint(1, 2) },
+		{ "C:\\b.txt", make_test_fingerprint(2, 2) }
+	});
+	std::string path = scratch_path("fingerprints.idx");
+	write_all(path + ".journal", journal.substr(0, journal.size() - 1));
+
+	std::string replayed;
+	{
+		FingerprintIndex index(path);
+		check_lookup(index, "C:\\a.txt", make_test_fingerprint(1, 2));
+		FileFingerprint fingerprint;
+		CHECK(!index.lookup("C:\\b.txt", fingerprint));
+
+		index.update("C:\\c.txt", make_test_fingerprint(4, 1));
+		replayed = read_all(path + ".journal");
+	}
+
+	// The client stopped again before compacting.
+	std::filesystem::remove(path);
+	write_all(path + ".journal", replayed);
+	FingerprintIndex index(path);
+	check_lookup(index, "C:\\a.txt", make_test_fingerprint(1, 2));
+	check_lookup(index, "C:\\c.txt", make_test_fingerprint(4, 1));
+}
+
+// Closing the index merges the journal into the table, which holds the same fingerprints when the index is opened again.
+static void compaction_test() {
+	std::string path = scratch_path("fingerprints.idx");
+	{
+		FingerprintIndex index(path);
+		for (uint32_t i = 0; i < 100; i++) {
+			index.update("C:\\file" + std::to_string(i), make_test_fingerprint(i, i % 5));
+		}
+	}
+	CHECK(std::filesystem::exists(path));
+	CHECK(!std::filesystem::exists(path + ".journal"));
+
+	{
+		// A journal over the table replaces some of its records.
+		FingerprintIndex index(path);
+		index.update("C:\\file7", make_test_fingerprint(1007, 2));
+		index.compact();
+	}
+
+	FingerprintIndex index(path);
+	for (uint32_t i = 0; i < 100; i++) {
+		check_lookup(index, "C:\\file" + std::to_string(i), i == 7 ? make_test_fingerprint(1007, 2) : make_test_fingerprint(i, i % 5));
+	}
+}
+
+// A journal that isn't one (a torn header, or another format) is ignored, and doesn't keep the next updates from being replayed.
+static void invalid_journal_test() {
+	std::string path = scratch_path("fingerprints.idx");
+	for (const std::string& invalid : { std::string("FP"), std::string("NOTAJOURNAL.....") }) {
+		write_all(path + ".journal", invalid);
+		std::string journal;
+		{
+			FingerprintIndex index(path);
+			FileFingerprint fingerprint;
+			CHECK(!index.lookup("C:\\a.txt", fingerprint));
+			index.update("C:\\a.txt", make_test_fingerprint(5, 1));
+			journal = read_all(path + ".journal");
+		}
+
+		std::filesystem::remove(path);
+		write_all(path + ".journal", journal);
+		{
+			FingerprintIndex index(path);
+			check_lookup(index, "C:\\a.txt", make_test_fingerprint(5, 1));
+		}
+		std::filesystem::remove(path);
+	}
+}
+
+void register_fingerprint_tests() {
+	register_test("fingerprint_journal_replay", journal_replay_test);
+	register_test("fingerprint_torn_journal", torn_journal_test);
+	register_test("fingerprint_compaction", compaction_test);
+	register_test("fingerprint_invalid_journal", invalid_journal_test);
+}
@@ -0,0 +1,132 @@
+#include "tests.hpp"
+#include "ring.hpp"
+#include <numeric>
+
+// Values pushed and popped a few at a time, many times around the ring - they come out in order across the wraparound.
+template <typename Ring>
+static void wraparound_test() {
+	Ring ring(4);
+	int next_pushed = 0, next_popped = 0;
+	int values[3];
+
+	for (int round = 0; round < 100; round++) {
+		for (int i = 0; i < 3; i++) {
+			CHECK(ring.tryPush(next_pushed++));
+		}
+		size_t amount = ring.tryPopBatch(values, 3);
+		CHECK_EQUAL(amount, static_cast<size_t>(3));
+		for (size_t i = 0; i < amount; i++) {
+			CHECK_EQUAL(values[i], next_popped++);
+		}
+	}
+}
+
+// The capacity is rounded up to a power of two - a ring of 3 holds 4 values, the 5th push fails until a value is popped.
+template <typename Ring>
+static void full_and_empty_test() {
+	Ring ring(3);
+	int values[8];
+	std::atomic<bool> cancelled(true);
+
+	CHECK_EQUAL(ring.tryPopBatch(values, 8), static_cast<size_t>(0));
+	CHECK_EQUAL(ring.popBatch(values, 8, cancelled), static_cast<size_t>(0));
+
+	for (int i = 0; i < 4; i++) {
+		CHECK(ring.tryPush(i));
+	}
+	CHECK(!ring.tryPush(4));
+	CHECK(!ring.push(4, cancelled));
+
+	CHECK_EQUAL(ring.tryPopBatch(values, 1), static_cast<size_t>(1));
+	CHECK_EQUAL(values[0], 0);
+	CHECK(ring.tryPush(4));
+	CHECK(!ring.tryPush(5));
+
+	// A batch may stop short of the values pushed since the consumer last looked, the rest come with the next one.
+	size_t popped = 0, amount;
+	while ((amount = ring.tryPopBatch(values + popped, 8 - popped)) > 0) {
+		popped += amount;
+	}
+	CHECK_EQUAL(popped, static_cast<size_t>(4));
+	for (int i = 0; i < 4; i++) {
+		CHECK_EQUAL(values[i], i + 1);
+	}
+}
+
+// A producer far ahead of its consumer waits on the full ring instead of dropping values.
+template <typename Ring>
+static void blocking_handoff_test() {
+	constexpr int VALUES = 100000;
+	Ring ring(8);
+	std::atomic<bool> never(false);
+
+	std::thread producer([&ring, &never]() {
+		for (int i = 0; i < VALUES; i++) {
+			ring.push(i, never);
+		}
+	});
+
+	int values[16];
+	int expected = 0;
+	bool ordered = true;
+	while (expected < VALUES) {
+		size_t amount = ring.popBatch(values, 16, never);
+		for (size_t i = 0; i < amount; i++) {
+			ordered = ordered && values[i] == expected;
+			expected++;
+		}
+	}
+	producer.join();
+
+	CHECK(ordered);
+	CHECK_EQUAL(ring.tryPopBatch(values, 16), static_cast<size_t>(0));
+}
+
+// Many producers and consumers sharing an MpmcRing - every value is taken exactly once.
+static void mpmc_many_threads_test() {
+	constexpr int THREADS = 4;
+	constexpr int VALUES_PER_THREAD = 20000;
+	MpmcRing<int> ring(16);
+	std::atomic<bool> never(false);
+	std::atomic<int> remaining(THREADS * VALUES_PER_THREAD);
+	std::vector<long long> sums(THREADS, 0);
+	std::vector<std::thread> threads;
+
+	for (int t = 0; t < THREADS; t++) {
+		threads.emplace_back([&ring, &never, t]() {
+			for (int i = 0; i < VALUES_PER_THREAD; i++) {
+				ring.push(t * VALUES_PER_THREAD + i, never);
+			}
+		});
+		threads.emplace_back([&ring, &remaining, &sums, t]() {
+			int value;
+			while (remaining.load() > 0) {
+				if (ring.tryPop(value)) {
+					sums[t] += value;
+					remaining--;
+				}
+				else {
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	long long total = THREADS * VALUES_PER_THREAD;
+	CHECK_EQUAL(std::accumulate(sums.begin(), sums.end(), 0LL), total * (total - 1) / 2);
+	int value;
+	CHECK(!ring.tryPop(value));
+}
+
+void register_ring_tests() {
+	register_test("spsc_ring_wraparound", wraparound_test<SpscRing<int>>);
+	register_test("mpmc_ring_wraparound", wraparound_test<MpmcRing<int>>);
+	register_test("spsc_ring_full_and_empty", full_and_empty_test<SpscRing<int>>);
+	register_test("mpmc_ring_full_and_empty", full_and_empty_test<MpmcRing<int>>);
+	register_test("spsc_ring_blocking_handoff", blocking_handoff_test<SpscRing<int>>);
+	register_test("mpmc_ring_blocking_handoff", blocking_handoff_test<MpmcRing<int>>);
+	register_test("mpmc_ring_many_threads", mpmc_many_threads_test);
+}
@@ -0,0 +1,112 @@
+#include "test.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace {
+	struct Test {
+		std::string name;
+		TestFunction function;
+	};
+
+	std::vector<Test>& registered_tests() {
+		static std::vector<Test> tests;
+		return tests;
+	}
+
+	// Visual Studio runs the tests in the project's directory, where the fixtures directory is.
+	std::string fixtures_dir = "fixtures";
+	bool update_fixtures = false;
+	std::filesystem::path scratch_dir;
+}
+
+void register_test(std::string name, TestFunction function) {
+	registered_tests().push_back({ name, function });
+}
+
+std::string scratch_path(const std::string& name) {
+	return (scratch_dir / name).string();
+}
+
+void check_fixture(const std::string& name, const std::string& content) {
+	std::filesystem::path path = std::filesystem::path(fixtures_dir) / name;
+
+	if (update_fixtures) {
+		std::ofstream out(path, std::ios::binary);
+		out.write(content.data(), content.size());
+		if (!out) {
+			throw CheckFailure("Cannot write the fixture " + path.string() + ".");
+		}
+		std::cout << "  wrote " << path.string() << std::endl;
+		return;
+	}
+
+	std::ifstream in(path, std::ios::binary);
+	if (!in.is_open()) {
+		throw CheckFailure("Cannot open the fixture " + path.string() + ", run from FinalProjectTests or pass --fixtures=<dir>.");
+	}
+	std::string fixture((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	if (fixture.size() != content.size()) {
+		throw CheckFailure("The content is " + std::to_string(content.size()) + " bytes, the fixture " + name + " is " + std::to_string(fixture.size()) + " bytes.");
+	}
+	auto mismatch = std::mismatch(content.begin(), content.end(), fixture.begin());
+	if (mismatch.first != content.end()) {
+		throw CheckFailure("The content differs from the fixture " + name + " at byte " + std::to_string(mismatch.first - content.begin()) + ".");
+	}
+}
+
+/*
+	Flags:
+		--filter=<text>		Only run tests whose name contains the given text.
+		--fixtures=<dir>	The directory of the fixtures, fixtures (in the working directory) by default.
+		--update_fixtures	Write the fixtures from the current code instead of comparing against them.
+*/
+int run_tests(int argc, char* argv[]) {
+	std::string filter;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg.rfind("--filter=", 0) == 0) {
+			filter = arg.substr(strlen("--filter="));
+		}
+		else if (arg.rfind("--fixtures=", 0) == 0) {
+			fixtures_dir = arg.substr(strlen("--fixtures="));
+		}
+		else if (arg == "--update_fixtures") {
+			update_fixtures = true;
+		}
+		else {
+			std::cerr << "Error: unknown or invalid flag " << arg << "." << std::endl;
+			std::cerr << "Usage: " << argv[0] << " [--filter=<text>] [--fixtures=<dir>] [--update_fixtures]" << std::endl;
+			return 1;
+		}
+	}
+
+	scratch_dir = std::filesystem::temp_directory_path() / "FinalProjectTests";
+	size_t passed = 0, failed = 0;
+
+	for (const Test& test : registered_tests()) {
+		if (test.name.find(filter) == std::string::npos) {
+			continue;
+		}
+
+		std::filesystem::remove_all(scratch_dir);
+		std::filesystem::create_directories(scratch_dir);
+		try {
+			test.function();
+			std::cout << "[ PASS ] " << test.name << std::endl;
+			passed++;
+		}
+		catch (std::exception& e) {
+			std::cout << "[ FAIL ] " << test.name << std::endl << "  " << e.what() << std::endl;
+			failed++;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::remove_all(scratch_dir, ec);
+	std::cout << passed << " passed, " << failed << " failed." << std::endl;
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,54 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*
+	A small unit test harness, in the spirit of the benchmark harness - without adding another dependency to the build.
+	Each test is a function, a failed CHECK throws out of it and fails the test, the other tests still run.
+	Tests comparing against a fixture (a file under FinalProjectTests\fixtures) use check_fixture, so the fixture can be written
+	again with --update_fixtures when the format it pins changes on purpose.
+*/
+class CheckFailure : public std::runtime_error {
+	public:
+		using std::runtime_error::runtime_error;
+};
+
+typedef void (*TestFunction)();
+
+// This method registers a test.
+void register_test(std::string name, TestFunction function);
+// This method runs all registered tests according to the command line flags, returns the process's exit code.
+int run_tests(int argc, char* argv[]);
+
+// This method returns the path of the given file in a directory of scratch files, emptied before every test.
+std::string scratch_path(const std::string& name);
+// This method checks the content is the given fixture's, byte for byte - or writes it as the fixture with --update_fixtures.
+void check_fixture(const std::string& name, const std::string& content);
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			std::ostringstream check_message; \
+			check_message << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed"; \
+			throw CheckFailure(check_message.str()); \
+		} \
+	} while (0)
+
+#define CHECK_EQUAL(actual, expected) \
+	do { \
+		auto check_actual = (actual); \
+		auto check_expected = (expected); \
+		if (!(check_actual == check_expected)) { \
+			std::ostringstream check_message; \
+			check_message << __FILE__ << ":" << __LINE__ << ": CHECK_EQUAL(" #actual ", " #expected ") failed: " \
+				<< check_actual << " != " << check_expected; \
+			throw CheckFailure(check_message.str()); \
+		} \
+	} while (0)
+
+#endif
@@ -0,0 +1,17 @@
+#include "tests.hpp"
+#include "utils.hpp"
+
+/*
+	Unit tests of the client's building blocks - the ones whose output is kept on disk or checked by the server, where a
+	change that still runs fine locally breaks the other side. Run with --filter=<text> to run some of them.
+*/
+int main(int argc, char* argv[]) {
+	std::filesystem::create_directories(EXE_DIR);
+
+	register_cksum_tests();
+	register_ring_tests();
+	register_fingerprint_tests();
+	register_bundle_tests();
+
+	return run_tests(argc, argv);
+}
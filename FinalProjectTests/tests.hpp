@@ -0,0 +1,12 @@
+#ifndef TESTS_H
+#define TESTS_H
+
+#include "test.hpp"
+
+// These methods register the tests of a module each.
+void register_cksum_tests();
+void register_ring_tests();
+void register_fingerprint_tests();
+void register_bundle_tests();
+
+#endif